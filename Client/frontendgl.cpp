@@ -3,6 +3,8 @@
 #include "fimagegl.h"
 #include "fshadergl.h"
 #include "fsoundalib.h"
+#include "../Puyolib/global.h"
+#include <cmath>
 
 FrontendGL::FrontendGL(QGLWidget* gl, GameAudio* audio, ppvs::FeInput& input, GLExtensions& ext, QObject* parent)
 	: QObject(parent)
@@ -203,6 +205,48 @@ void FrontendGL::drawRect(ppvs::FeImage* image, double subx, double suby, double
 	glEnd();
 }
 
+void FrontendGL::drawRects(ppvs::FeImage* image, const ppvs::FeQuad* quads, size_t count)
+{
+	FImageGL* qimg = (FImageGL*)image;
+	double tw = 1., th = 1.;
+
+	if (qimg) {
+		qimg->bind();
+		tw = qimg->width();
+		th = qimg->height();
+	} else
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+	// The quads are placed here instead of with the matrix, so they all fit in one glBegin
+	glBegin(GL_QUADS);
+	for (size_t i = 0; i < count; i++) {
+		const ppvs::FeQuad& q = quads[i];
+		double u1, v1, u2, v2;
+		u1 = v1 = u2 = v2 = 0.;
+		if (qimg) {
+			u1 = (q.subX + 0.25) / tw;
+			v1 = 1. - (q.subY + q.subH - 0.5) / th;
+			u2 = (q.subX + q.subW - 0.25) / tw;
+			v2 = 1. - (q.subY + 0.5) / th;
+		}
+
+		const double angle = -q.rotation * ppvs::kPiD / 180.;
+		const double c = cos(angle) * q.scale, s = sin(angle) * q.scale;
+		const double corners[4][4] = {
+			{ 0.25, 0.25, u1, v2 },
+			{ q.subW - 0.25, 0.25, u2, v2 },
+			{ q.subW - 0.25, q.subH + 0.25, u2, v1 },
+			{ 0.25, q.subH + 0.25, u1, v1 },
+		};
+		for (const auto& corner : corners) {
+			const double x = corner[0] - q.centerX, y = corner[1] - q.centerY;
+			glTexCoord2d(corner[2], corner[3]);
+			glVertex2d(q.x + c * x - s * y, q.y + s * x + c * y);
+		}
+	}
+	glEnd();
+}
+
 void FrontendGL::clear()
 {
 	glClear(GL_COLOR_BUFFER_BIT);
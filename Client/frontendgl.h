@@ -40,6 +40,7 @@ public:
 	void enableAlphaTesting(float tolerance) override;
 	void disableAlphaTesting() override;
 	void drawRect(ppvs::FeImage* image, double subx, double suby, double subw, double subh) override;
+	void drawRects(ppvs::FeImage* image, const ppvs::FeQuad* quads, size_t count) override;
 
 	void clear() override;
 	void swapBuffers() override;
@@ -218,6 +218,10 @@ void GameWidgetGL::keyPressEvent(QKeyEvent* k)
 		} else if (mGame->m_replayState == ReplayState::FAST_FORWARD_X4) {
 			mGame->m_replayState = ReplayState::FAST_FORWARD;
 		}
+	} else if (mGame && mGame->m_settings->recording == ppvs::RecordState::REPLAYING && (k->key() == Qt::Key_PageDown || k->key() == Qt::Key_PageUp)) {
+		// Skip 30 seconds without drawing the frames in between
+		const int step = k->key() == Qt::Key_PageDown ? 30 * 60 : -30 * 60;
+		mGame->m_replaySeekTarget = std::max(mGame->m_data->matchTimer + step, 0);
 	}
 }
 
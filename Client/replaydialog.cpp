@@ -3,7 +3,44 @@
 #include "gamewidget.h"
 #include "settings.h"
 #include "ui_replaydialog.h"
+#include "../Puyolib/ReplayIndex.h"
+#include <QDate>
 #include <QFileDialog>
+#include <QTimer>
+
+namespace {
+
+// Shown at once, the status label tells how many more there are
+constexpr size_t kLibraryLimit = 1000;
+
+// Rules of the items in SearchRulesComboBox, each also finds the offline rules of its mode
+const ppvs::Rules kLibraryRules[] = {
+	ppvs::Rules::TSU_ONLINE,
+	ppvs::Rules::FEVER_ONLINE,
+	ppvs::Rules::FEVER15_ONLINE,
+	ppvs::Rules::ENDLESSFEVERVS_ONLINE,
+};
+
+QString rulesName(ppvs::Rules rules)
+{
+	switch (rules) {
+	case ppvs::Rules::TSU:
+	case ppvs::Rules::TSU_ONLINE:
+		return QObject::tr("Tsu", "ModeTsu");
+	case ppvs::Rules::FEVER:
+	case ppvs::Rules::FEVER_ONLINE:
+		return QObject::tr("Fever", "ModeFever");
+	case ppvs::Rules::FEVER15_ONLINE:
+		return QObject::tr("Fever (15th)", "ModeFever15");
+	case ppvs::Rules::ENDLESSFEVERVS:
+	case ppvs::Rules::ENDLESSFEVERVS_ONLINE:
+		return QObject::tr("Endless Fever VS", "ModeEndlessFeverVs");
+	default:
+		return QObject::tr("Other", "ModeOther");
+	}
+}
+
+}
 
 ReplayDialog::ReplayDialog(QWidget* parent, GameManager* gameManager)
 	: QDialog(parent)
@@ -17,6 +54,21 @@ ReplayDialog::ReplayDialog(QWidget* parent, GameManager* gameManager)
 		ui->ReplayOption1RadioButton->setChecked(true);
 	else if (settings.integer("launcher", "hidenames", 0) == 2)
 		ui->ReplayOption2RadioButton->setChecked(true);
+
+	ui->SearchFromDateEdit->setDate(QDate::currentDate().addMonths(-1));
+	ui->SearchToDateEdit->setDate(QDate::currentDate());
+	connect(ui->SearchLineEdit, &QLineEdit::textChanged, this, &ReplayDialog::updateLibrary);
+	connect(ui->SearchRulesComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &ReplayDialog::updateLibrary);
+	connect(ui->SearchFromDateEdit, &QDateEdit::dateChanged, this, &ReplayDialog::updateLibrary);
+	connect(ui->SearchToDateEdit, &QDateEdit::dateChanged, this, &ReplayDialog::updateLibrary);
+
+	// The index is brought up to date in the background, the list follows it
+	ppvs::ReplayIndex::shared().startScan();
+	libraryGeneration = ppvs::ReplayIndex::shared().generation();
+	libraryTimer = new QTimer(this);
+	connect(libraryTimer, &QTimer::timeout, this, &ReplayDialog::checkLibrary);
+	libraryTimer->start(250);
+	updateLibrary();
 }
 
 ReplayDialog::~ReplayDialog()
@@ -84,3 +136,75 @@ void ReplayDialog::on_FileDialog_Finished(const QStringList& selected) const
 {
 	ui->PlaylistListWidget->addItems(selected);
 }
+
+void ReplayDialog::on_AddSelectedPushButton_clicked() const
+{
+	for (QTreeWidgetItem* item : ui->LibraryTreeWidget->selectedItems())
+		ui->PlaylistListWidget->addItem(item->data(0, Qt::UserRole).toString());
+}
+
+void ReplayDialog::on_LibraryTreeWidget_itemDoubleClicked(QTreeWidgetItem* item, int) const
+{
+	ui->PlaylistListWidget->addItem(item->data(0, Qt::UserRole).toString());
+}
+
+void ReplayDialog::on_SearchDateCheckBox_toggled(bool checked)
+{
+	ui->SearchFromDateEdit->setEnabled(checked);
+	ui->SearchToDateEdit->setEnabled(checked);
+	updateLibrary();
+}
+
+void ReplayDialog::checkLibrary()
+{
+	const ppvs::ReplayIndex& index = ppvs::ReplayIndex::shared();
+	if (index.generation() != libraryGeneration) {
+		libraryGeneration = index.generation();
+		updateLibrary();
+	} else if (!index.isScanning()) {
+		libraryTimer->stop();
+		updateLibrary();
+	}
+}
+
+void ReplayDialog::updateLibrary()
+{
+	const ppvs::ReplayIndex& index = ppvs::ReplayIndex::shared();
+	ppvs::ReplayFilter filter;
+	filter.name = ui->SearchLineEdit->text().toStdString();
+	if (ui->SearchRulesComboBox->currentIndex() > 0)
+		filter.rules = static_cast<int>(kLibraryRules[ui->SearchRulesComboBox->currentIndex() - 1]);
+	if (ui->SearchDateCheckBox->isChecked()) {
+		filter.from = ui->SearchFromDateEdit->date().toString("yyyy/MM/dd").toStdString();
+		filter.to = ui->SearchToDateEdit->date().toString("yyyy/MM/dd").toStdString();
+	}
+
+	size_t total = 0;
+	const std::vector<ppvs::ReplayIndexEntry> entries = index.find(filter, kLibraryLimit, &total);
+
+	QList<QTreeWidgetItem*> items;
+	for (const ppvs::ReplayIndexEntry& entry : entries) {
+		QStringList players;
+		for (const ppvs::ReplayIndexEntry::Player& player : entry.players)
+			players << QString("%1 (%2)").arg(QString::fromStdString(player.name)).arg(player.wins);
+		const int seconds = entry.duration / 60;
+
+		QTreeWidgetItem* item = new QTreeWidgetItem;
+		item->setText(0, QString::fromStdString(entry.date + " " + entry.time));
+		item->setText(1, players.join(" - "));
+		item->setText(2, rulesName(entry.rules));
+		item->setText(3, QString::asprintf("%d:%02d", seconds / 60, seconds % 60));
+		item->setData(0, Qt::UserRole, QString::fromStdString(entry.path));
+		item->setToolTip(0, QString::fromStdString(entry.path));
+		items << item;
+	}
+	ui->LibraryTreeWidget->clear();
+	ui->LibraryTreeWidget->addTopLevelItems(items);
+
+	QString status = total > entries.size()
+		? tr("Showing %1 of %2 replays", "ReplayLibraryLimited").arg(entries.size()).arg(total)
+		: tr("%1 replays", "ReplayLibraryCount").arg(total);
+	if (index.isScanning())
+		status += " " + tr("(indexing...)", "ReplayLibraryIndexing");
+	ui->LibraryStatusLabel->setText(status);
+}
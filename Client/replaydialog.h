@@ -2,6 +2,9 @@
 
 #include <QDialog>
 
+class QTimer;
+class QTreeWidgetItem;
+
 namespace Ui {
 class ReplayDialog;
 }
@@ -24,8 +27,15 @@ private slots:
 	void on_PlaySelectedPushButton_clicked() const;
 	void on_CloseButton_clicked();
 	void on_FileDialog_Finished(const QStringList& selected) const;
+	void on_AddSelectedPushButton_clicked() const;
+	void on_LibraryTreeWidget_itemDoubleClicked(QTreeWidgetItem* item, int column) const;
+	void on_SearchDateCheckBox_toggled(bool checked);
+	void checkLibrary();
+	void updateLibrary();
 
 private:
 	Ui::ReplayDialog* ui;
 	GameManager* gameManager;
+	QTimer* libraryTimer;
+	unsigned int libraryGeneration = 0;
 };
@@ -25,8 +25,19 @@ RenderTargetSoft::RenderTargetSoft(SDL_Window* window, bool enableDebug)
 	setViewport(w, h);
 }
 
+RenderTargetSoft::RenderTargetSoft(const int width, const int height, bool enableDebug)
+	: m_window(nullptr)
+	, m_debugMode(enableDebug)
+{
+	setViewport(width, height);
+}
+
 void RenderTargetSoft::present()
 {
+	if (!m_window) {
+		return;
+	}
+
 	SDL_Surface* backBuffer = SDL_CreateRGBSurfaceFrom(
 		m_colorBuffer.data(),
 		m_scaledViewport.x,
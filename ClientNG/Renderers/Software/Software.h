@@ -85,6 +85,9 @@ class RenderTargetSoft final : public RenderTarget {
 public:
 	explicit RenderTargetSoft(SDL_Window* window, bool enableDebug = false);
 
+	// Renders into memory only, present() does nothing
+	RenderTargetSoft(int width, int height, bool enableDebug = false);
+
 	~RenderTargetSoft() override = default;
 
 	void clear(const float r, const float g, const float b, const float a) override
@@ -113,6 +116,9 @@ public:
 	[[nodiscard]] const glm::mat4& modelView() const { return m_modelView; }
 	[[nodiscard]] const glm::ivec2& viewport() const override { return m_scaledViewport; }
 
+	// One pixel per value, see packRgba
+	[[nodiscard]] const std::vector<uint32_t>& colorBuffer() const { return m_colorBuffer; }
+
 	void render(PolyShader shader, const std::vector<Vertex>& vertices, const std::vector<unsigned short>& indices);
 	void renderTriangle(PolyShader shader, const glm::mat4& transform, const Vertex& v0, const Vertex& v1, const Vertex& v2);
 
@@ -0,0 +1,306 @@
+#include "ReplayExport.h"
+
+#include "../Puyolib/Game.h"
+#include "../Puyolib/NullFrontend.h"
+#include "../Puyolib/WorkerPool.h"
+#include "Renderers/Software/Software.h"
+#include "Scenes/Game/Frontend.h"
+
+#include <alib/mixer.h>
+#include <spng.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace PuyoVS::ClientNG {
+
+namespace {
+
+constexpr int kSampleRate = 44100;
+constexpr int kChannels = 2;
+constexpr int kSamplesPerFrame = kSampleRate / 60;
+constexpr int kWavHeaderSize = 44;
+
+// Frames to keep simulating after the recorded duration before giving up
+constexpr int kExtraFrames = 60 * 60;
+
+// Frames kept after the match is over
+constexpr int kTailFrames = 2 * 60;
+
+ppvs::GameSettings* replaySettings(const std::string& replay)
+{
+	auto* settings = new ppvs::GameSettings(ppvs::RuleSetInfo(ppvs::Rules::TSU));
+	settings->numPlayers = 2;
+	settings->numHumans = 0;
+	settings->startWithCharacterSelect = false;
+	settings->pickColors = false;
+	settings->playMusic = false;
+	settings->recording = ppvs::RecordState::REPLAYING;
+	settings->replayKeyframeBudget = 0;
+	settings->replayPlayList.push_back(replay);
+	return settings;
+}
+
+bool isFinished(const ppvs::Game& game)
+{
+	for (const auto& player : game.m_players) {
+		if (player->m_active && player->m_loseWin == ppvs::LoseWinState::NOWIN) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// False if the file is not a replay this version can play
+bool readHeader(const std::string& replay, ppvs::ReplayHeader& header)
+{
+	std::ifstream in(replay, std::ios::binary);
+	in.read(reinterpret_cast<char*>(&header), sizeof(ppvs::ReplayHeader));
+	return in && std::memcmp(header.mw, "RPVS", 4) == 0 && header.versionNumber <= kReplayVersion;
+}
+
+// Number of frames to export. Simulated with the same settings as the export, only
+// nothing is drawn.
+int countFrames(const std::string& replay, const ppvs::ReplayHeader& header)
+{
+	// gRng is per thread and only seeded on the main one. Every playback seeds it
+	// from the replay, so they all agree.
+	ppvs::gRng.init_genrand(header.randomSeed);
+
+	ppvs::Game game(replaySettings(replay));
+	game.initGame(new ppvs::NullFrontend);
+	game.nextReplay();
+	const int limit = std::max(header.duration, 0) + kExtraFrames;
+	int frames = 0;
+	while (!isFinished(game) && game.m_data->matchTimer < limit) {
+		game.playGame();
+		frames++;
+	}
+	return frames + kTailFrames;
+}
+
+void putLe(std::vector<char>& out, const unsigned int v, const int bytes)
+{
+	for (int i = 0; i < bytes; i++) {
+		out.push_back(static_cast<char>(v >> (8 * i)));
+	}
+}
+
+std::vector<char> wavHeader(const int frames)
+{
+	const unsigned int dataSize = static_cast<unsigned int>(frames) * kSamplesPerFrame * kChannels * 2;
+	std::vector<char> header;
+	header.insert(header.end(), { 'R', 'I', 'F', 'F' });
+	putLe(header, kWavHeaderSize - 8 + dataSize, 4);
+	header.insert(header.end(), { 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' });
+	putLe(header, 16, 4);
+	putLe(header, 1, 2); // PCM
+	putLe(header, kChannels, 2);
+	putLe(header, kSampleRate, 4);
+	putLe(header, kSampleRate * kChannels * 2, 4);
+	putLe(header, kChannels * 2, 2);
+	putLe(header, 16, 2);
+	header.insert(header.end(), { 'd', 'a', 't', 'a' });
+	putLe(header, dataSize, 4);
+	return header;
+}
+
+bool writePng(const std::string& path, std::vector<unsigned char>& rgba, const int width, const int height)
+{
+	spng_ctx* ctx = spng_ctx_new(SPNG_CTX_ENCODER);
+	spng_set_option(ctx, SPNG_ENCODE_TO_BUFFER, 1);
+	// The frames are meant to be encoded again, so size matters less than speed
+	spng_set_option(ctx, SPNG_IMG_COMPRESSION_LEVEL, 1);
+	spng_ihdr header {};
+	header.width = static_cast<uint32_t>(width);
+	header.height = static_cast<uint32_t>(height);
+	header.bit_depth = 8;
+	header.color_type = SPNG_COLOR_TYPE_TRUECOLOR_ALPHA;
+	spng_set_ihdr(ctx, &header);
+	int error = spng_encode_image(ctx, rgba.data(), rgba.size(), SPNG_FMT_PNG, SPNG_ENCODE_FINALIZE);
+	size_t size = 0;
+	void* png = error == 0 ? spng_get_png_buffer(ctx, &size, &error) : nullptr;
+	spng_ctx_free(ctx);
+	if (!png) {
+		return false;
+	}
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write(static_cast<const char*>(png), static_cast<std::streamsize>(size));
+	free(png);
+	return static_cast<bool>(out);
+}
+
+std::string framePath(const std::string& output, const int frame)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "frames/%06d.png", frame);
+	return output + name;
+}
+
+// Plays the replay from the start and writes the frames in [first, end)
+bool exportRange(const ExportSettings& settings, const ppvs::ReplayHeader& header, const int first, const int end, std::atomic<int>& done)
+{
+	// Particles and other random visuals come from gRng, seeded the same way as in
+	// countFrames
+	ppvs::gRng.init_genrand(header.randomSeed);
+
+	Renderers::Software::RenderTargetSoft target(settings.width, settings.height);
+	alib::SoftwareMixer mixer;
+	mixer.setFormat(kSampleRate, kChannels);
+	ppvs::Game game(replaySettings(settings.replay));
+	game.initGame(new Scenes::Game::GameFrontend(&target, settings.audio ? &mixer : nullptr));
+	game.nextReplay();
+
+	std::fstream video;
+	if (settings.format == ExportFormat::Raw) {
+		video.open(settings.output + "video.rgba", std::ios::in | std::ios::out | std::ios::binary);
+	}
+	std::fstream audio;
+	if (settings.audio) {
+		audio.open(settings.output + "audio.wav", std::ios::in | std::ios::out | std::ios::binary);
+	}
+	if ((settings.format == ExportFormat::Raw && !video.is_open()) || (settings.audio && !audio.is_open())) {
+		return false;
+	}
+
+	const size_t frameSize = static_cast<size_t>(settings.width) * settings.height * 4;
+	const size_t pcmSize = static_cast<size_t>(kSamplesPerFrame) * kChannels * 2;
+	std::vector<unsigned char> rgba(frameSize);
+	std::vector<float> mixed(static_cast<size_t>(kSamplesPerFrame) * kChannels);
+	std::vector<char> pcm(pcmSize);
+	if (video.is_open()) {
+		video.seekp(static_cast<std::streamoff>(frameSize * first));
+	}
+	if (audio.is_open()) {
+		audio.seekp(static_cast<std::streamoff>(kWavHeaderSize + pcmSize * first));
+	}
+
+	for (int frame = 0; frame < end; frame++) {
+		game.playGame();
+
+		// Mixed from the start, so that sounds started before the range are heard
+		if (settings.audio) {
+			int length = kSamplesPerFrame;
+			mixer.read(mixed.data(), length);
+			if (frame >= first) {
+				for (size_t i = 0; i < mixed.size(); i++) {
+					const auto sample = static_cast<int>(std::clamp(mixed[i], -1.0f, 1.0f) * 32767.0f);
+					pcm[i * 2] = static_cast<char>(sample);
+					pcm[i * 2 + 1] = static_cast<char>(sample >> 8);
+				}
+				audio.write(pcm.data(), static_cast<std::streamsize>(pcm.size()));
+			}
+		}
+		if (frame < first) {
+			continue;
+		}
+
+		game.renderGame();
+		const auto& pixels = target.colorBuffer();
+		for (size_t i = 0; i < pixels.size(); i++) {
+			rgba[i * 4] = static_cast<unsigned char>(pixels[i] >> 24);
+			rgba[i * 4 + 1] = static_cast<unsigned char>(pixels[i] >> 16);
+			rgba[i * 4 + 2] = static_cast<unsigned char>(pixels[i] >> 8);
+			rgba[i * 4 + 3] = static_cast<unsigned char>(pixels[i]);
+		}
+		if (settings.format == ExportFormat::Raw) {
+			video.write(reinterpret_cast<const char*>(rgba.data()), static_cast<std::streamsize>(rgba.size()));
+		} else if (!writePng(framePath(settings.output, frame), rgba, settings.width, settings.height)) {
+			return false;
+		}
+		done++;
+	}
+	return (!video.is_open() || video.good()) && (!audio.is_open() || audio.good());
+}
+
+}
+
+int exportReplay(const ExportSettings& input)
+{
+	ExportSettings settings = input;
+	if (!settings.output.empty() && settings.output.back() != '/') {
+		settings.output += '/';
+	}
+	const int threads = settings.threads > 0 ? settings.threads : std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+
+	// Before the threads start, so they don't race to set up the globals
+	ppvs::initGlobal();
+
+	ppvs::ReplayHeader header {};
+	const int frames = readHeader(settings.replay, header) ? countFrames(settings.replay, header) : 0;
+	if (frames <= kTailFrames) {
+		fprintf(stderr, "Cannot read replay %s\n", settings.replay.c_str());
+		return 1;
+	}
+
+	// The ranges write to their own part of the files, so these are made at full size first
+	std::error_code error;
+	fs::create_directories(settings.output + (settings.format == ExportFormat::Png ? "frames" : ""), error);
+	const size_t frameSize = static_cast<size_t>(settings.width) * settings.height * 4;
+	bool ok = !error;
+	if (ok && settings.format == ExportFormat::Raw) {
+		std::ofstream(settings.output + "video.rgba", std::ios::binary | std::ios::trunc).close();
+		fs::resize_file(settings.output + "video.rgba", frameSize * frames, error);
+		ok = !error;
+	}
+	if (ok && settings.audio) {
+		const std::vector<char> header = wavHeader(frames);
+		std::ofstream(settings.output + "audio.wav", std::ios::binary | std::ios::trunc).write(header.data(), kWavHeaderSize);
+		fs::resize_file(settings.output + "audio.wav", kWavHeaderSize + static_cast<uintmax_t>(frames) * kSamplesPerFrame * kChannels * 2, error);
+		ok = !error;
+	}
+	if (!ok) {
+		fprintf(stderr, "Cannot write to %s: %s\n", settings.output.c_str(), error.message().c_str());
+		return 1;
+	}
+
+	const int ranges = std::min(threads, frames);
+	std::vector<char> results(ranges, 0);
+	std::atomic<int> done { 0 };
+	std::atomic<int> running { ranges };
+	const auto start = std::chrono::steady_clock::now();
+	std::thread progress([&] {
+		while (running > 0) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			fprintf(stderr, "\r%d/%d frames", done.load(), frames);
+		}
+	});
+	ppvs::WorkerPool pool(threads - 1);
+	pool.run(ranges, [&](const int i) {
+		const int first = static_cast<int>(static_cast<long long>(frames) * i / ranges);
+		const int end = static_cast<int>(static_cast<long long>(frames) * (i + 1) / ranges);
+		results[i] = exportRange(settings, header, first, end, done) ? 1 : -1;
+		running--;
+	});
+	progress.join();
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	fprintf(stderr, "\r%d frames (%.1f s of video) in %.2f s with %d threads: %.0f frames/s\n",
+		frames, frames / 60.0, seconds, threads, seconds > 0 ? frames / seconds : 0.0);
+	if (std::find(results.begin(), results.end(), -1) != results.end()) {
+		fprintf(stderr, "Writing to %s failed\n", settings.output.c_str());
+		return 1;
+	}
+
+	const std::string audioInput = settings.audio ? " -i audio.wav" : "";
+	if (settings.format == ExportFormat::Raw) {
+		fprintf(stderr, "Encode with: ffmpeg -f rawvideo -pixel_format rgba -video_size %dx%d -framerate 60 -i video.rgba%s match.mp4\n",
+			settings.width, settings.height, audioInput.c_str());
+	} else {
+		fprintf(stderr, "Encode with: ffmpeg -framerate 60 -i frames/%%06d.png%s match.mp4\n", audioInput.c_str());
+	}
+	return 0;
+}
+
+}
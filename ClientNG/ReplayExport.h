@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+
+namespace PuyoVS::ClientNG {
+
+enum class ExportFormat {
+	Png, // frames/000000.png and so on
+	Raw, // video.rgba, every frame after the other without any header
+};
+
+struct ExportSettings {
+	std::string replay;
+	std::string output; // Folder, made if missing
+	ExportFormat format = ExportFormat::Png;
+	int width = 640;
+	int height = 480;
+	int threads = 0; // 0 for one per core
+	bool audio = true; // audio.wav, 16 bit stereo at 44100 Hz
+};
+
+// Renders a replay at 60 frames per second with the software renderer, as fast as
+// the CPU allows and without opening a window. The frames are split in one range
+// per thread. Every range plays the replay from the start but only draws its own
+// frames, so the output is the same as drawing everything in order. Returns the
+// exit code for main.
+int exportReplay(const ExportSettings& settings);
+
+}
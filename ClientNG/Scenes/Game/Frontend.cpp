@@ -3,13 +3,18 @@
 #include <glm/ext/matrix_clip_space.hpp>
 #include <glm/ext/matrix_transform.hpp>
 
+#include <algorithm>
+#include <cmath>
+
 namespace PuyoVS::ClientNG::Scenes::Game {
 
-GameFrontend::GameFrontend(Renderers::RenderTarget* target)
+GameFrontend::GameFrontend(Renderers::RenderTarget* target, alib::Mixer* mixer)
 	: m_target(target)
+	, m_mixer(mixer)
 {
 	m_blankTexture = m_target->makeTexture();
 	m_quadBuffer = m_target->makeBuffer();
+	m_batchBuffer = m_target->makeBuffer();
 
 	m_quadVertices[0].tex = { 0, 1 };
 	m_quadVertices[1].tex = { 1, 1 };
@@ -68,6 +73,8 @@ ppvs::FeFont* GameFrontend::loadFont(const char* nameu8, double fontSize)
 
 ppvs::FeSound* GameFrontend::loadSound(const char* nameu8)
 {
+	if (m_mixer)
+		return new GameSound(m_mixer, nameu8);
 	return new GameSound();
 }
 
@@ -227,6 +234,58 @@ void GameFrontend::drawRect(ppvs::FeImage* image, double subx, double suby, doub
 	m_quadBuffer->render(Renderers::PolyShader::Simple);
 }
 
+void GameFrontend::drawRects(ppvs::FeImage* image, const ppvs::FeQuad* quads, size_t count)
+{
+	// Indices are 16 bit, so a batch has at most this many quads
+	constexpr size_t kMaxQuads = 0x10000 / 4;
+
+	double tw = 1., th = 1.;
+	if (image) {
+		static_cast<GameImage*>(image)->bind();
+		tw = image->width();
+		th = image->height();
+	} else {
+		m_blankTexture->bind(0);
+	}
+	m_target->setModelView(m_matrixStack.top());
+
+	while (count > 0) {
+		const size_t n = std::min(count, kMaxQuads);
+		m_batchVertices.resize(n * 4);
+		m_batchIndices.resize(n * 6);
+		for (size_t i = 0; i < n; i++) {
+			const ppvs::FeQuad& q = quads[i];
+			double u1 = 0., t1 = 0., u2 = 0., t2 = 0.;
+			if (image) {
+				u1 = (q.subX + 0.25) / tw;
+				t1 = (q.subY + 0.5) / th;
+				u2 = (q.subX + q.subW - 0.25) / tw;
+				t2 = (q.subY + q.subH - 0.5) / th;
+			}
+
+			// Same placement as the matrix calls of Sprite::draw
+			const float c = std::cos(-q.rotation) * q.scale, s = std::sin(-q.rotation) * q.scale;
+			const float corners[4][2] = { { 0.25f, 0.25f }, { q.subW - 0.25f, 0.25f }, { q.subW - 0.25f, q.subH + 0.25f }, { 0.25f, q.subH + 0.25f } };
+			const glm::vec2 tex[4] = { { u1, t1 }, { u2, t1 }, { u2, t2 }, { u1, t2 } };
+			for (size_t k = 0; k < 4; k++) {
+				const float x = corners[k][0] - q.centerX, y = corners[k][1] - q.centerY;
+				auto& vertex = m_batchVertices[i * 4 + k];
+				vertex.pos = { q.x + c * x - s * y, q.y + s * x + c * y, 0 };
+				vertex.tex = tex[k];
+				vertex.color = m_color;
+			}
+			for (size_t k = 0; k < 6; k++) {
+				m_batchIndices[i * 6 + k] = static_cast<unsigned short>(i * 4 + m_quadIndices[k]);
+			}
+		}
+		m_batchBuffer->uploadIndices(m_batchIndices.data(), m_batchIndices.size());
+		m_batchBuffer->uploadVertices(m_batchVertices.data(), m_batchVertices.size());
+		m_batchBuffer->render(Renderers::PolyShader::Simple);
+		quads += n;
+		count -= n;
+	}
+}
+
 void GameFrontend::clear()
 {
 	m_target->clear(0, 0, 0, 1);
@@ -299,12 +358,22 @@ void GameText::draw(float x, float y)
 {
 }
 
+GameSound::GameSound(alib::Mixer* mixer, const char* nameu8)
+	: m_mixer(mixer)
+	, m_stream(nameu8)
+{
+}
+
 void GameSound::play()
 {
+	if (m_mixer && !m_stream.error())
+		m_mixer->play(m_stream);
 }
 
 void GameSound::stop()
 {
+	if (m_mixer && !m_stream.error())
+		m_stream.stop();
 }
 
 }
@@ -2,13 +2,16 @@
 #include "../../../Puyolib/Frontend.h"
 #include "../../Renderers/Renderer.h"
 
+#include <alib/mixer.h>
 #include <stack>
+#include <vector>
 
 namespace PuyoVS::ClientNG::Scenes::Game {
 
 class GameFrontend final : public ppvs::Frontend {
 public:
-	GameFrontend(Renderers::RenderTarget* target);
+	// Sounds are only played if there is a mixer
+	GameFrontend(Renderers::RenderTarget* target, alib::Mixer* mixer = nullptr);
 	~GameFrontend() override;
 
 	ppvs::FeImage* loadImage(const char* nameu8) override;
@@ -40,6 +43,7 @@ public:
 	void enableAlphaTesting(float tolerance) override;
 	void disableAlphaTesting() override;
 	void drawRect(ppvs::FeImage* image, double subx, double suby, double subw, double subh) override;
+	void drawRects(ppvs::FeImage* image, const ppvs::FeQuad* quads, size_t count) override;
 
 	void clear() override;
 	void swapBuffers() override;
@@ -48,11 +52,15 @@ public:
 
 private:
     Renderers::RenderTarget* m_target;
+	alib::Mixer* m_mixer;
 	std::stack<glm::mat4> m_matrixStack;
 	std::unique_ptr<Renderers::PolyBuffer> m_quadBuffer;
 	std::unique_ptr<Renderers::Texture> m_blankTexture;
     Renderers::Vertex m_quadVertices[4] {};
 	unsigned short m_quadIndices[6] = { 0, 1, 2, 2, 3, 0 };
+	std::unique_ptr<Renderers::PolyBuffer> m_batchBuffer;
+	std::vector<Renderers::Vertex> m_batchVertices;
+	std::vector<unsigned short> m_batchIndices;
 	glm::vec4 m_color{};
 	ppvs::FeInput m_inputState{};
 };
@@ -108,8 +116,15 @@ public:
 
 class GameSound final : public ppvs::FeSound {
 public:
+	GameSound() = default;
+	GameSound(alib::Mixer* mixer, const char* nameu8);
+
 	void play() override;
 	void stop() override;
+
+private:
+	alib::Mixer* m_mixer = nullptr;
+	alib::Stream m_stream;
 };
 
 }
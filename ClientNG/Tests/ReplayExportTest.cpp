@@ -0,0 +1,134 @@
+// Records a match and exports it with one thread and with several. Every range of
+// frames plays the replay from the start on its own thread, so the video and audio
+// must be the same as when one thread renders everything in order.
+
+#include "../../Puyolib/Game.h"
+#include "../../Puyolib/NullFrontend.h"
+#include "../../Puyolib/Tests/Check.h"
+#include "../ReplayExport.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+using namespace ppvs;
+
+namespace {
+
+constexpr int kMaxFrames = 60000;
+
+// Two human players press random buttons until the first match is saved. Returns
+// the replay file.
+std::string recordReplay()
+{
+	auto* settings = new GameSettings(RuleSetInfo(Rules::TSU));
+	settings->numPlayers = 2;
+	settings->numHumans = 2;
+	settings->useCpuPlayers = true; // Offline
+	settings->startWithCharacterSelect = false;
+	settings->pickColors = false;
+	settings->playSound = false;
+	settings->playMusic = false;
+	settings->headless = true;
+	settings->recording = RecordState::RECORDING;
+	auto* front = new NullFrontend;
+	Game game(settings);
+	game.initGame(front);
+	gRng.init_genrand(1);
+	game.m_menuSelect = 0;
+	game.m_currentGameStatus = GameStatus::REMATCHING;
+	for (auto* player : game.m_players) {
+		player->m_active = true;
+		player->m_rematch = true;
+	}
+
+	// Hold a random set of buttons for a few frames, then let go
+	std::mt19937 rng(1);
+	std::uniform_int_distribution<int> buttons(0, 63);
+	for (int i = 0; i < kMaxFrames; i++) {
+		for (int pl = 0; pl < 2; pl++) {
+			const int held = i % 8 < 6 ? buttons(rng) : 0;
+			front->setInputState(pl, { false, (held & 1) != 0, (held & 6) == 2, (held & 6) == 4, (held & 24) == 8, (held & 24) == 16, false });
+		}
+		game.playGame();
+
+		// Local players don't record where their pieces land, and a replay only places
+		// a piece when it reads that. Piece n of both players is put in column n / 2 % 6
+		// with color n / 2 % 4, so every second piece pops.
+		const int time = game.m_data->matchTimer;
+		if (time > 0 && time % 60 == 0) {
+			const int piece = time / 60;
+			const int x = piece / 2 % 6;
+			const int color = piece / 2 % 4;
+			for (auto* player : game.m_players) {
+				MessageEvent message { time, "" };
+				std::snprintf(message.message, sizeof(message.message), "p|%d|%d|0|%d|12|%d|11|0|0|0|0|0|0|0|2|0", color, color, x, x);
+				player->m_recordMessages.push_back(message);
+			}
+		}
+
+		std::error_code error;
+		for (fs::recursive_directory_iterator it("User/Replays", error), end; !error && it != end; it.increment(error)) {
+			if (it->path().extension() == ".rvs") {
+				return fs::absolute(it->path()).string();
+			}
+		}
+	}
+	return "";
+}
+
+std::vector<char> readFile(const fs::path& path)
+{
+	std::ifstream in(path, std::ios::binary);
+	return { std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+}
+
+}
+
+int main()
+{
+	// The replay is recorded in a folder of its own, the export runs in the working
+	// directory to find the game's images and sounds
+	const fs::path cwd = fs::current_path();
+	const fs::path dir = fs::temp_directory_path() / "puyovs-exporttest";
+	fs::remove_all(dir);
+	fs::create_directories(dir / "User");
+	fs::current_path(dir);
+	const std::string replay = recordReplay();
+	fs::current_path(cwd);
+
+	if (CHECK(!replay.empty())) {
+		PuyoVS::ClientNG::ExportSettings settings;
+		settings.replay = replay;
+		settings.format = PuyoVS::ClientNG::ExportFormat::Raw;
+		// Small frames keep the test fast, the whole match is still exported
+		settings.width = 64;
+		settings.height = 48;
+
+		settings.output = (dir / "sequential").string();
+		settings.threads = 1;
+		CHECK(PuyoVS::ClientNG::exportReplay(settings) == 0);
+		settings.output = (dir / "ranges").string();
+		settings.threads = 3;
+		CHECK(PuyoVS::ClientNG::exportReplay(settings) == 0);
+
+		for (const char* name : { "video.rgba", "audio.wav" }) {
+			const std::vector<char> sequential = readFile(dir / "sequential" / name);
+			const std::vector<char> ranges = readFile(dir / "ranges" / name);
+			CHECK(!sequential.empty());
+			if (!CHECK(sequential == ranges)) {
+				std::fprintf(stderr, "%s differs\n", name);
+			}
+		}
+		const std::vector<char> video = readFile(dir / "sequential" / "video.rgba");
+		CHECK(std::any_of(video.begin(), video.end(), [](const char c) { return c != 0; }));
+	}
+
+	fs::remove_all(dir);
+	return testResult();
+}
@@ -1,10 +1,53 @@
 #include "Game.h"
+#include "ReplayExport.h"
 
 #include <SDL.h>
 #include <SDL_ttf.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+int printUsage(const char* name)
+{
+	SDL_Log("Usage: %s --export <replay> <folder> [--raw] [--no-audio] [--size WxH] [-j threads]", name);
+	return 1;
+}
+
+// vs2 --export <replay> <folder> [--raw] [--no-audio] [--size WxH] [-j threads]
+int exportMain(int argc, char** argv)
+{
+	PuyoVS::ClientNG::ExportSettings settings;
+	settings.replay = argv[2];
+	settings.output = argv[3];
+	for (int i = 4; i < argc; i++) {
+		if (strcmp(argv[i], "--raw") == 0) {
+			settings.format = PuyoVS::ClientNG::ExportFormat::Raw;
+		} else if (strcmp(argv[i], "--no-audio") == 0) {
+			settings.audio = false;
+		} else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+			if (sscanf(argv[++i], "%dx%d", &settings.width, &settings.height) != 2 || settings.width <= 0 || settings.height <= 0) {
+				return printUsage(argv[0]);
+			}
+		} else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			settings.threads = atoi(argv[++i]);
+		} else {
+			return printUsage(argv[0]);
+		}
+	}
+	return PuyoVS::ClientNG::exportReplay(settings);
+}
+
+}
 
 int main(int argc, char** argv)
 {
+	// Exporting needs neither a window nor an audio device
+	if (argc >= 4 && strcmp(argv[1], "--export") == 0) {
+		return exportMain(argc, argv);
+	}
+
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) != 0) {
 		SDL_Log("Unable to initialize SDL: %s", SDL_GetError());
 		return 1;
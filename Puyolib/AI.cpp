@@ -1,132 +1,101 @@
 #include "AI.h"
+#include "Game.h"
 #include "Player.h"
+#include "WorkerPool.h"
 
 namespace ppvs {
 
-AI::AI(Player* pl)
-	: m_player(pl)
-{
-}
-
-void AI::prepare(const MovePuyoType mpt, const int color1, const int color2)
-{
-	m_type = mpt;
-	m_color1 = color1;
-	m_color2 = color2;
-	m_bigColor = color1;
-	m_timer = 0;
-	m_player->m_controls.m_down = 0;
-}
-
-void AI::findLargest()
-{
-	// Try all positions and rotations
-	const FieldProp prop = m_player->m_activeField->getProperties();
-	int remember = 0;
-	for (int i = 0; i < prop.gridX; i++) {
-		m_pos[0].x = i;
-		m_pos[0].y = prop.gridY;
-		for (int j = 0; j < 4; j++) { // Set rotation
-			if (m_type != MovePuyoType::BIG)
-				m_rotation = j;
-			else
-				m_color1 = j;
-			setRotation();
-
-			if (const int current = predictChain(); current > remember) {
-				m_bestPos = i;
-				m_bestRot = j;
-				remember = current;
-			}
-		}
-	}
-	if ((remember == 0 || remember == 1) && !m_pinch) {
-		// Randomize
-		m_bestPos = getRandom(prop.gridX);
-		m_bestRot = getRandom(4);
+namespace {
 
-		// Reduce chances of bestpos being 2 or 3
-		for (int i = 0; i < 2; i++)
-			if (m_bestPos == 2 || m_bestPos == 3)
-				m_bestPos = getRandom(prop.gridX);
-	}
-	m_bestChain = remember;
-}
-
-void AI::setRotation()
+void setRotation(const MovePuyoType type, PosVectorInt pos[4], const int rotation)
 {
 	// Refresh
-	m_pos[1].x = 0;
-	m_pos[1].y = 0;
-	m_pos[2].x = 0;
-	m_pos[2].y = 0;
-	m_pos[3].x = 0;
-	m_pos[3].y = 0;
-
-	if (m_type == MovePuyoType::DOUBLET || m_type == MovePuyoType::TRIPLET) {
+	pos[1].x = 0;
+	pos[1].y = 0;
+	pos[2].x = 0;
+	pos[2].y = 0;
+	pos[3].x = 0;
+	pos[3].y = 0;
+
+	if (type == MovePuyoType::DOUBLET || type == MovePuyoType::TRIPLET) {
 		// Set variables
-		if (m_rotation == 0) {
-			m_pos[1].x = m_pos[0].x;
-			m_pos[1].y = m_pos[0].y + 1;
-		} else if (m_rotation == 1) {
-			m_pos[1].x = m_pos[0].x + 1;
-			m_pos[1].y = m_pos[0].y;
-		} else if (m_rotation == 2) {
-			m_pos[1].x = m_pos[0].x;
-			m_pos[1].y = m_pos[0].y - 1;
-		} else if (m_rotation == 3) {
-			m_pos[1].x = m_pos[0].x - 1;
-			m_pos[1].y = m_pos[0].y;
+		if (rotation == 0) {
+			pos[1].x = pos[0].x;
+			pos[1].y = pos[0].y + 1;
+		} else if (rotation == 1) {
+			pos[1].x = pos[0].x + 1;
+			pos[1].y = pos[0].y;
+		} else if (rotation == 2) {
+			pos[1].x = pos[0].x;
+			pos[1].y = pos[0].y - 1;
+		} else if (rotation == 3) {
+			pos[1].x = pos[0].x - 1;
+			pos[1].y = pos[0].y;
 		}
 	}
-	if (m_type == MovePuyoType::TRIPLET) {
+	if (type == MovePuyoType::TRIPLET) {
 		// Set variables
-		if (m_rotation == 1) {
-			m_pos[2].x = m_pos[0].x;
-			m_pos[2].y = m_pos[0].y + 1;
-		} else if (m_rotation == 2) {
-			m_pos[2].x = m_pos[0].x + 1;
-			m_pos[2].y = m_pos[0].y;
-		} else if (m_rotation == 3) {
-			m_pos[2].x = m_pos[0].x;
-			m_pos[2].y = m_pos[0].y - 1;
-		} else if (m_rotation == 0) {
-			m_pos[2].x = m_pos[0].x - 1;
-			m_pos[2].y = m_pos[0].y;
+		if (rotation == 1) {
+			pos[2].x = pos[0].x;
+			pos[2].y = pos[0].y + 1;
+		} else if (rotation == 2) {
+			pos[2].x = pos[0].x + 1;
+			pos[2].y = pos[0].y;
+		} else if (rotation == 3) {
+			pos[2].x = pos[0].x;
+			pos[2].y = pos[0].y - 1;
+		} else if (rotation == 0) {
+			pos[2].x = pos[0].x - 1;
+			pos[2].y = pos[0].y;
 		}
 	}
-	if (m_type == MovePuyoType::QUADRUPLET || m_type == MovePuyoType::BIG) {
+	if (type == MovePuyoType::QUADRUPLET || type == MovePuyoType::BIG) {
 		// Quadruplet and big simply stay in pos==1 state
-		m_pos[1].x = m_pos[0].x + 1;
-		m_pos[1].y = m_pos[0].y;
-		m_pos[2].x = m_pos[0].x;
-		m_pos[2].y = m_pos[0].y + 1;
-		m_pos[3].x = m_pos[0].x + 1;
-		m_pos[3].y = m_pos[0].y + 1;
+		pos[1].x = pos[0].x + 1;
+		pos[1].y = pos[0].y;
+		pos[2].x = pos[0].x;
+		pos[2].y = pos[0].y + 1;
+		pos[3].x = pos[0].x + 1;
+		pos[3].y = pos[0].y + 1;
 	}
 }
 
-int AI::predictChain()
+// Shadow positions and colors of a piece dropped at column x, returns the number of puyos
+// or 0 if a puyo is stuck in the wall. isEmpty tells which cells are free.
+template <class IsEmpty>
+int projectPiece(const AIPiece& piece, const int gridX, const int gridY, const int x, const int rotation,
+	IsEmpty isEmpty, PosVectorInt tempPos[4], int colors[4])
 {
-	const FieldProp prop = m_player->m_activeField->getProperties();
-	const int maxHeight = prop.gridY;
+	const MovePuyoType type = piece.type;
+	// Big puyo don't rotate, the rotation picks their color instead
+	const int color1 = type == MovePuyoType::BIG ? rotation : piece.color1;
+	const int color2 = piece.color2;
+	const int maxHeight = gridY;
 	bool moveUp[4] {};
-	PosVectorInt tempPos[4] {};
-	int colors[4] {};
+	PosVectorInt pos[4] {};
+
+	pos[0].x = x;
+	pos[0].y = gridY;
+	setRotation(type, pos, rotation);
 
 	// Check if any puyo is stuck in wall
-	for (const auto& pos : m_pos) {
-		if (pos.x < 0 || pos.x >= prop.gridX) {
+	for (const auto& p : pos) {
+		if (p.x < 0 || p.x >= gridX) {
 			return 0;
 		}
 	}
 
+	for (int k = 0; k < 4; k++) {
+		tempPos[k] = PosVectorInt();
+		colors[k] = 0;
+	}
+
 	int n = 2;
-	if (m_type == MovePuyoType::TRIPLET || m_type == MovePuyoType::TRIPLET_R) {
+	if (type == MovePuyoType::TRIPLET || type == MovePuyoType::TRIPLET_R) {
 		n = 3;
 		tempPos[3].x = -1;
 		tempPos[3].y = -1;
-	} else if (m_type == MovePuyoType::QUADRUPLET || m_type == MovePuyoType::BIG) {
+	} else if (type == MovePuyoType::QUADRUPLET || type == MovePuyoType::BIG) {
 		n = 4;
 	} else {
 		tempPos[2].x = -1;
@@ -139,8 +108,8 @@ int AI::predictChain()
 	for (int k = 0; k < n; k++) {
 		moveUp[k] = false;
 		for (int j = 1; j < 5; j++) {
-			// Compare m_pos with rest
-			if (m_pos[k].y > m_pos[(k + j) % 4].y && m_pos[k].x == m_pos[(k + j) % 4].x)
+			// Compare pos with rest
+			if (pos[k].y > pos[(k + j) % 4].y && pos[k].x == pos[(k + j) % 4].x)
 				moveUp[k] = true;
 		}
 	}
@@ -148,9 +117,9 @@ int AI::predictChain()
 	// Project every color downwards
 	for (int k = 0; k < n; k++) {
 		int i = 0;
-		while (m_player->m_activeField->isEmpty(m_pos[k].x, m_pos[k].y - i) && i < maxHeight) {
-			tempPos[k].x = m_pos[k].x;
-			tempPos[k].y = m_pos[k].y - i;
+		while (isEmpty(pos[k].x, pos[k].y - i) && i < maxHeight) {
+			tempPos[k].x = pos[k].x;
+			tempPos[k].y = pos[k].y - i;
 
 			i++;
 		}
@@ -160,41 +129,263 @@ int AI::predictChain()
 	}
 
 	// Set colors
-	colors[0] = m_color1;
-	colors[1] = m_color2;
-	if (m_type == MovePuyoType::TRIPLET_R) {
-		colors[1] = m_color1;
-		colors[2] = m_color2;
-	} else if (m_type == MovePuyoType::QUADRUPLET) {
-		if (m_rotation == 0) {
-			colors[0] = m_color2;
-			colors[1] = m_color2;
-			colors[2] = m_color1;
-			colors[3] = m_color1;
-		} else if (m_rotation == 1) {
-			colors[0] = m_color2;
-			colors[1] = m_color1;
-			colors[2] = m_color2;
-			colors[3] = m_color1;
-		} else if (m_rotation == 2) {
-			colors[0] = m_color1;
-			colors[1] = m_color1;
-			colors[2] = m_color2;
-			colors[3] = m_color2;
-		} else if (m_rotation == 3) {
-			colors[0] = m_color1;
-			colors[1] = m_color2;
-			colors[2] = m_color1;
-			colors[3] = m_color2;
+	colors[0] = color1;
+	colors[1] = color2;
+	if (type == MovePuyoType::TRIPLET_R) {
+		colors[1] = color1;
+		colors[2] = color2;
+	} else if (type == MovePuyoType::QUADRUPLET) {
+		if (rotation == 0) {
+			colors[0] = color2;
+			colors[1] = color2;
+			colors[2] = color1;
+			colors[3] = color1;
+		} else if (rotation == 1) {
+			colors[0] = color2;
+			colors[1] = color1;
+			colors[2] = color2;
+			colors[3] = color1;
+		} else if (rotation == 2) {
+			colors[0] = color1;
+			colors[1] = color1;
+			colors[2] = color2;
+			colors[3] = color2;
+		} else if (rotation == 3) {
+			colors[0] = color1;
+			colors[1] = color2;
+			colors[2] = color1;
+			colors[3] = color2;
+		}
+	} else if (type == MovePuyoType::BIG) {
+		colors[0] = color1;
+		colors[1] = color1;
+		colors[2] = color1;
+		colors[3] = color1;
+	}
+
+	return n;
+}
+
+}
+
+AI::AI(Player* pl)
+	: m_player(pl)
+{
+}
+
+AI::~AI()
+{
+	stopSearch();
+}
+
+void AI::prepare(const MovePuyoType mpt, const int color1, const int color2)
+{
+	// A search that was never used, e.g. because the piece was placed early
+	stopSearch();
+
+	m_type = mpt;
+	m_color1 = color1;
+	m_color2 = color2;
+	m_bigColor = color1;
+	m_timer = 0;
+	m_player->m_controls.m_down = 0;
+	m_nextPieces.clear();
+}
+
+// Pieces after the current one, in order. Only used by strategies that look ahead.
+void AI::addNextPiece(const MovePuyoType mpt, const int color1, const int color2)
+{
+	m_nextPieces.push_back({ mpt, color1, color2 });
+}
+
+void AI::setStrategy(const AIStrategy strategy, const BeamSearchSettings& settings)
+{
+	stopSearch();
+	m_strategy = strategy;
+	if (strategy == AIStrategy::BEAM) {
+		m_beamSearch = std::make_unique<BeamSearch>(settings);
+	} else {
+		m_beamSearch.reset();
+	}
+}
+
+void AI::findLargest()
+{
+	takeSnapshot();
+	finishSearch(search({ 0, m_bestPos, m_bestRot, m_bestChain }));
+}
+
+void AI::startSearch(const int thinkFrames)
+{
+	takeSnapshot();
+	const SearchResult start { 0, m_bestPos, m_bestRot, m_bestChain };
+
+	// Without a snapshot the search has to read the live field
+	if (!m_useFieldState || thinkFrames <= 0) {
+		finishSearch(search(start));
+		return;
+	}
+
+	auto task = std::make_shared<std::packaged_task<SearchResult()>>([this, start] { return search(start); });
+	m_search = task->get_future();
+	if (!WorkerPool::shared().post([task] { (*task)(); })) {
+		// No threads to run it on
+		m_search = {};
+		finishSearch(search(start));
+		return;
+	}
+	m_thinking = true;
+	m_thinkFrames = thinkFrames;
+}
+
+bool AI::update()
+{
+	if (!m_thinking) {
+		return true;
+	}
+	if (m_thinkFrames > 0) {
+		m_thinkFrames--;
+		return false;
+	}
+	m_thinking = false;
+
+	// A late search is waited for. Dropping it would let the speed of the machine pick
+	// the move, and replays and online play would no longer agree.
+	finishSearch(m_search.get());
+	return true;
+}
+
+// Cancel a search that is running or was never used and wait for it, which doesn't
+// take long once it is cancelled
+void AI::stopSearch()
+{
+	if (m_search.valid()) {
+		m_cancel = true;
+		m_search.wait();
+		m_search = {};
+	}
+	m_cancel = false;
+	m_thinking = false;
+}
+
+// Everything the search needs from the player is copied here, on the game thread
+void AI::takeSnapshot()
+{
+	m_gridX = m_player->m_activeField->getProperties().gridX;
+	m_puyoToClear = m_player->m_currentGame->m_currentRuleSet->m_puyoToClear;
+	m_spawn = m_player->m_movePuyo.getSpawnPoint();
+	m_useFieldState = m_player->m_activeField->getFieldState(m_fieldState);
+}
+
+// Try all positions and rotations, starting from the previous move. Runs on the
+// worker pool for startSearch, so it only reads the snapshot and writes its result.
+AI::SearchResult AI::search(SearchResult result)
+{
+	if (m_strategy == AIStrategy::BEAM && searchBeam(result)) {
+		result.largest = -1;
+		return result;
+	}
+
+	m_candidates.assign(m_gridX * 4, 0);
+	const auto evaluateColumn = [this](const int i) {
+		if (m_cancel.load(std::memory_order_relaxed)) {
+			return;
+		}
+		for (int j = 0; j < 4; j++) { // Rotation, or color of big puyo
+			m_candidates[i * 4 + j] = predictChain(i, j);
+		}
+	};
+
+	// Columns only read the snapshot, so they can be evaluated on the worker pool.
+	// The fallback goes through the live field and has to stay on this thread.
+	if (m_useFieldState) {
+		WorkerPool::shared().run(m_gridX, evaluateColumn);
+	} else {
+		for (int i = 0; i < m_gridX; i++) {
+			evaluateColumn(i);
+		}
+	}
+
+	// Pick in search order so ties always go to the first candidate
+	int remember = 0;
+	for (int i = 0; i < m_gridX; i++) {
+		for (int j = 0; j < 4; j++) {
+			if (const int current = m_candidates[i * 4 + j]; current > remember) {
+				result.pos = i;
+				result.rot = j;
+				remember = current;
+			}
+		}
+	}
+	result.largest = remember;
+	return result;
+}
+
+// Runs on the game thread, getRandom isn't thread safe
+void AI::finishSearch(const SearchResult& result)
+{
+	m_bestPos = result.pos;
+	m_bestRot = result.rot;
+	if (result.largest < 0) {
+		m_bestChain = result.chain;
+		return;
+	}
+	const int largest = result.largest;
+	if ((largest == 0 || largest == 1) && !m_pinch) {
+		// Randomize
+		m_bestPos = getRandom(m_gridX);
+		m_bestRot = getRandom(4);
+
+		// Reduce chances of bestpos being 2 or 3
+		for (int i = 0; i < 2; i++)
+			if (m_bestPos == 2 || m_bestPos == 3)
+				m_bestPos = getRandom(m_gridX);
+	}
+	m_bestChain = largest;
+}
+
+// Look ahead over the next pieces, falls back to the greedy search if that's not possible
+bool AI::searchBeam(SearchResult& result)
+{
+	if (!m_beamSearch || !m_useFieldState) {
+		return false;
+	}
+
+	AIPiece pieces[8];
+	int numPieces = 0;
+	pieces[numPieces++] = { m_type, m_color1, m_color2 };
+	for (const auto& piece : m_nextPieces) {
+		if (numPieces == 8) {
+			break;
 		}
-	} else if (m_type == MovePuyoType::BIG) {
-		colors[0] = m_color1;
-		colors[1] = m_color1;
-		colors[2] = m_color1;
-		colors[3] = m_color1;
+		pieces[numPieces++] = piece;
+	}
+
+	return m_beamSearch->search(m_fieldState, pieces, numPieces, m_puyoToClear, m_spawn, result.pos, result.rot, result.chain, &m_cancel);
+}
+
+int AI::dropPiece(const FieldState& state, const AIPiece& piece, const int x, const int rotation, PosVectorInt shadowPos[4], int colors[4])
+{
+	return projectPiece(piece, state.width(), state.height(), x, rotation,
+		[&state](const int px, const int py) { return state.isEmpty(px, py); }, shadowPos, colors);
+}
+
+int AI::predictChain(const int x, const int rotation) const
+{
+	const AIPiece piece { m_type, m_color1, m_color2 };
+	PosVectorInt tempPos[4] {};
+	int colors[4] {};
+
+	if (m_useFieldState) {
+		const int n = dropPiece(m_fieldState, piece, x, rotation, tempPos, colors);
+		return n ? m_fieldState.virtualChain(tempPos, n, colors, m_puyoToClear, &m_chainStats) : 0;
 	}
 
-	return m_player->m_activeField->virtualChain(tempPos, n, colors);
+	Field* field = m_player->m_activeField;
+	const FieldProp prop = field->getProperties();
+	const int n = projectPiece(piece, prop.gridX, prop.gridY, x, rotation,
+		[field](const int px, const int py) { return field->isEmpty(px, py); }, tempPos, colors);
+	return n ? field->virtualChain(tempPos, n, colors) : 0;
 }
 
 }
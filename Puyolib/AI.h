@@ -1,7 +1,13 @@
 #pragma once
 
+#include "BeamSearch.h"
 #include "DropPattern.h"
 #include "FieldProp.h"
+#include "FieldState.h"
+#include <atomic>
+#include <future>
+#include <memory>
+#include <vector>
 
 namespace ppvs {
 
@@ -10,7 +16,7 @@ class Player;
 class AI final {
 public:
 	explicit AI(Player* pl);
-	~AI() = default;
+	~AI();
 
 	AI(const AI&) = delete;
 	AI& operator=(const AI&) = delete;
@@ -18,8 +24,27 @@ public:
 	AI& operator=(AI&&) = delete;
 
 	void prepare(MovePuyoType mpt, int color1, int color2);
+	void addNextPiece(MovePuyoType mpt, int color1, int color2);
 	void findLargest();
 
+	// Asynchronous findLargest: the search runs on a snapshot of the field on the
+	// worker pool and its result is used on the thinkFrames-th call of update(), so the
+	// move is the same as with the synchronous search, just thinkFrames later. update()
+	// waits for a search that isn't done by then.
+	void startSearch(int thinkFrames);
+	// Call every frame of the move phase, returns true once m_bestPos and m_bestRot are set
+	bool update();
+
+	void setStrategy(AIStrategy strategy, const BeamSearchSettings& settings = {});
+	[[nodiscard]] AIStrategy getStrategy() const { return m_strategy; }
+
+	// Chain table lookups of this player's searches
+	[[nodiscard]] const ChainTable::Stats& getChainStats() const { return m_chainStats; }
+
+	// Shadow positions and colors of a piece dropped at column x. rotation is the
+	// color for big puyo. Returns the number of puyos, 0 if it doesn't fit.
+	static int dropPiece(const FieldState& state, const AIPiece& piece, int x, int rotation, PosVectorInt shadowPos[4], int colors[4]);
+
 	int m_bestPos = 0;
 	int m_bestRot = 0;
 	int m_bestChain = 0;
@@ -27,15 +52,42 @@ public:
 	bool m_pinch = false;
 
 private:
-	int predictChain();
-	void setRotation();
+	// Move found by search(). largest is the longest chain of the greedy search, or -1
+	// if the beam search decided, which sets chain instead.
+	struct SearchResult {
+		int largest = 0;
+		int pos = 0;
+		int rot = 0;
+		int chain = 0;
+	};
+
+	void takeSnapshot();
+	void stopSearch();
+	SearchResult search(SearchResult result);
+	void finishSearch(const SearchResult& result);
+	int predictChain(int x, int rotation) const;
+	bool searchBeam(SearchResult& result);
 	MovePuyoType m_type = MovePuyoType::DOUBLET;
-	PosVectorInt m_pos[4] = {};
-	unsigned int m_rotation = 0u;
 	int m_color1 = 0, m_color2 = 0;
 	unsigned int m_bigColor = 0;
+	FieldState m_fieldState; // Snapshot of the active field during findLargest
+	bool m_useFieldState = false;
+	int m_gridX = 0;
+	int m_puyoToClear = 4;
+	PosVectorInt m_spawn;
+	std::vector<int> m_candidates; // Chain for every position * 4 + rotation
+	std::vector<AIPiece> m_nextPieces;
+	AIStrategy m_strategy = AIStrategy::GREEDY;
+	std::unique_ptr<BeamSearch> m_beamSearch;
+	mutable ChainTable::Stats m_chainStats; // Counted from the const predictChain
 
 	Player* m_player;
+
+	// Search running on the worker pool, only touches the members above
+	std::future<SearchResult> m_search;
+	std::atomic<bool> m_cancel { false };
+	bool m_thinking = false; // The move waits for m_search
+	int m_thinkFrames = 0;
 };
 
 }
@@ -1,7 +1,7 @@
 #include "Animation.h"
 
-#include <algorithm>
 #include <cmath>
+#include <iostream>
 #include <utility>
 
 namespace ppvs {
@@ -23,150 +23,59 @@ void Animation::init(GameData* g, PosVectorFloat offsetPos, float scale, std::st
 {
 	m_gameData = g;
 	clearSprites();
-	m_paths.clear();
+	clearSounds();
 	m_sourceFolder = std::move(folder);
 	m_offset = offsetPos;
 	m_globalScale = scale;
 	m_duration = maxTime;
 	m_error = false;
 
-	if (bool loadOk = m_doc.LoadFile(m_sourceFolder + scriptName); !loadOk) {
+	m_timeline = AnimationTimeline::load(m_sourceFolder + scriptName);
+	if (!m_timeline) {
 		m_error = true;
-		std::cout << m_sourceFolder + scriptName + " could not be loaded\n"
+		std::cerr << m_sourceFolder + scriptName + " could not be loaded\n"
 				  << std::endl;
 		return;
 	}
+	if (!m_timeline->playable()) {
+		m_error = true;
+		return;
+	}
 
 	// Initialize sprites etc.
-	TiXmlHandle docHandle(&m_doc);
-
-	// Find init
-	if (TiXmlElement* init = docHandle.FirstChild("animations").FirstChild("init").ToElement()) {
-		// Traverse through init's inner elements
-		TiXmlNode* initChild = nullptr;
-		while ((initChild = init->IterateChildren(initChild)) != nullptr) {
-			if (initChild->ValueStr() == "sprite") {
-				// Get sprite name
-				std::string spriteName;
-				if (initChild->ToElement()->Attribute("name")) {
-					spriteName = initChild->ToElement()->Attribute("name");
-				} else {
-					// Cannot find sprite name
-					continue; // Must have a name!
-				}
-
-				// Check if before something else
-				std::string before;
-				if (initChild->ToElement()->Attribute("before")) {
-					before = initChild->ToElement()->Attribute("before");
-				}
-
-				// Traverse through sprite's elements
-				TiXmlNode* spriteChild = nullptr;
-				while ((spriteChild = initChild->IterateChildren(spriteChild)) != nullptr) {
-					// Get image name
-					if (spriteChild->ValueStr() == "image") {
-						std::string imageName = spriteChild->ToElement()->GetText();
-						// Now we can add the sprite
-						newSprite(spriteName, imageName, before);
-					}
-
-					// Get sub-rectangle
-					if (spriteChild->ValueStr() == "rect") {
-						// Find x, y, width and height attributes.
-						int x, y, width, height;
-						if (spriteChild->ToElement()->Attribute("x", &x) && spriteChild->ToElement()->Attribute("y", &y) && spriteChild->ToElement()->Attribute("width", &width) && spriteChild->ToElement()->Attribute("height", &height)) {
-							setRect(
-								spriteName,
-								static_cast<float>(x),
-								static_cast<float>(y),
-								static_cast<float>(width),
-								static_cast<float>(height));
-						}
-					}
-
-					// Get center
-					if (spriteChild->ValueStr() == "center") {
-						// Find x, y, width and height attributes.
-						int x, y;
-						if (spriteChild->ToElement()->Attribute("x", &x) && spriteChild->ToElement()->Attribute("y", &y)) {
-							setCenter(spriteName, static_cast<float>(x), static_cast<float>(y));
-						}
-					}
-
-					// Bound sprite
-					if (spriteChild->ValueStr() == "bind") {
-						// Find x, y, width and height attributes.
-						int x, y;
-						if (spriteChild->ToElement()->Attribute("parent") && spriteChild->ToElement()->Attribute("x", &x) && spriteChild->ToElement()->Attribute("y", &y)) {
-							std::string parent = spriteChild->ToElement()->Attribute("parent");
-
-							// Set parent and add self to parent as child
-							m_sprites[spriteName].parent = parent;
-							addChild(
-								parent,
-								spriteName,
-								static_cast<float>(x),
-								static_cast<float>(y));
-						}
-					}
-
-					if (spriteChild->ValueStr() == "blend") {
-						if (spriteChild->ToElement()->Attribute("mode")) {
-							std::string mode = spriteChild->ToElement()->Attribute("mode");
-							setBlendMode(spriteName, mode);
-						}
-					}
-				}
-			} else if (initChild->ValueStr() == "path") {
-				std::string pathname;
-
-				// Get path name
-				if (initChild->ToElement()->Attribute("name")) {
-					pathname = initChild->ToElement()->Attribute("name");
-				} else {
-					// Cannot find name
-					continue; // Must have a name!
-				}
-
-				// Traverse through path's elements
-				TiXmlNode* pathChild = nullptr;
-				while ((pathChild = initChild->IterateChildren(pathChild)) != nullptr) {
-					// Add nodes
-					if (pathChild->ValueStr() == "node") {
-						int x, y;
-						if (pathChild->ToElement()->Attribute("x", &x) && pathChild->ToElement()->Attribute("y", &y)) {
-							// Add node
-							PosVectorFloat pv(static_cast<float>(x), static_cast<float>(y));
-							m_paths[pathname].push_back(pv);
-						}
-					}
-				}
-			} else if (initChild->ValueStr() == "sound") {
-				std::string spriteName;
-				// Get sprite name
-				if (initChild->ToElement()->Attribute("name")) {
-					spriteName = initChild->ToElement()->Attribute("name");
-				} else {
-					// Cannot find sprite name
-					continue; // Must have a name!
-				}
-
-				// Traverse through sprite's elements
-				TiXmlNode* spriteChild = nullptr;
-				while ((spriteChild = initChild->IterateChildren(spriteChild)) != nullptr) {
-					// Get file name
-					if (spriteChild->ValueStr() == "file") {
-						std::string imageName = spriteChild->ToElement()->GetText();
-						// Now we can add the sprite
-						newSound(spriteName, imageName);
-					}
-				}
-			}
+	m_sprites.resize(m_timeline->sprites().size());
+	for (size_t i = 0; i < m_sprites.size(); i++) {
+		const AnimationTimeline::SpriteDef& def = m_timeline->sprites()[i];
+		Sprite* sprite = m_sprites[i].sprite = new Sprite();
+		sprite->setImage(m_gameData->front->loadImage(m_sourceFolder + def.image));
+		if (sprite->getImage()) {
+			sprite->getImage()->setFilter(FilterType::LinearFilter);
 		}
-	} else {
-		m_error = true;
+		if (def.hasRect) {
+			sprite->setSubRect(def.rect[0], def.rect[1], def.rect[2], def.rect[3]);
+		}
+		if (def.hasCenter) {
+			sprite->setCenter(def.center[0], def.center[1]);
+		}
+		if (def.hasBlend) {
+			sprite->setBlendMode(def.blend);
+		}
+	}
+	for (const auto& def : m_timeline->sounds()) {
+		m_sounds.push_back(new Sound);
+		setBuffer(*m_sounds.back(), m_gameData->front->loadSound(m_sourceFolder + def.file));
 	}
+
+	m_sequence = m_timeline->findSequence(m_animationName);
+	resetSprites();
+}
+
+void Animation::prepareAnimation(const std::string& c)
+{
+	m_t = 0;
+	m_animationName = c;
+	m_sequence = m_timeline ? m_timeline->findSequence(c) : -1;
+	resetSprites();
 }
 
 void Animation::playAnimation()
@@ -178,556 +87,332 @@ void Animation::playAnimation()
 	// The timer t runs from 0 to 120 (2 seconds)
 	if (m_t <= m_duration) {
 		// animationName must be set beforehand
-		if (m_animationName.empty()) {
+		if (m_sequence < 0) {
 			return;
 		}
 
-		TiXmlHandle docHandle(&m_doc);
-		// Find animation element
-		if (TiXmlElement* anim = docHandle.FirstChild("animations").FirstChild(m_animationName.c_str()).ToElement()) {
-			// Traverse through keyframes
-			TiXmlNode* animChild = nullptr;
-			while ((animChild = anim->IterateChildren(animChild)) != nullptr) {
-				if (animChild->ValueStr() == "event") {
-					// Get start time
-					int startTime;
-					if (animChild->ToElement()->Attribute("start", &startTime)) {
-						// Check if keyframe is started
-						if (startTime > m_t)
-							continue;
-					} else {
-						// Erroneous keyframe element: start time must be defined
-						continue;
-					}
-
-					// Traverse through keyframes' elements
-					TiXmlNode* keyFrameChild = nullptr;
-					while ((keyFrameChild = animChild->IterateChildren(keyFrameChild)) != nullptr) {
-						// Play sound
-						if (startTime == m_t) {
-							if (keyFrameChild->ValueStr() == "playSound") {
-								if (keyFrameChild->ToElement()->Attribute("name")) {
-									std::string soundName = keyFrameChild->ToElement()->Attribute("name");
-									playSound(soundName);
-								}
-							}
-						}
-
-						// Set loop point
-						if (keyFrameChild->ValueStr() == "loop") {
-							int time = m_t;
-							if (keyFrameChild->ToElement()->Attribute("t", &time))
-								m_t = time;
-						}
-						// Get sprite name
-						std::string spriteName;
-						if (keyFrameChild->ToElement()->Attribute("name")) {
-							spriteName = keyFrameChild->ToElement()->Attribute("name");
-						} else {
-							// All animation functions must point to a sprite name!
-							continue;
-						}
-
-						// Instantly change sprite property
-						// Set sub-rectangle
-						if (keyFrameChild->ValueStr() == "rect") {
-							// Find x, y, width and height attributes.
-							int x, y, width, height;
-							if (keyFrameChild->ToElement()->Attribute("x", &x) && keyFrameChild->ToElement()->Attribute("y", &y) && keyFrameChild->ToElement()->Attribute("width", &width) && keyFrameChild->ToElement()->Attribute("height", &height)) {
-								setRect(
-									spriteName,
-									static_cast<float>(x),
-									static_cast<float>(y),
-									static_cast<float>(width),
-									static_cast<float>(height));
-							}
-						}
-
-						// Set center
-						if (keyFrameChild->ValueStr() == "center") {
-							// Find x and y attributes.
-							int x, y;
-							if (keyFrameChild->ToElement()->Attribute("x", &x) && keyFrameChild->ToElement()->Attribute("y", &y))
-								setCenter(
-									spriteName,
-									static_cast<float>(x),
-									static_cast<float>(y));
-						}
-
-						// Set position
-						if (keyFrameChild->ValueStr() == "position") {
-							int x, y;
-							if (keyFrameChild->ToElement()->Attribute("x", &x) && keyFrameChild->ToElement()->Attribute("y", &y)) {
-								setPosition(
-									spriteName,
-									static_cast<float>(x),
-									static_cast<float>(y));
-							}
-						}
-						if (keyFrameChild->ValueStr() == "blend") {
-							if (keyFrameChild->ToElement()->Attribute("mode")) {
-								std::string mode = keyFrameChild->ToElement()->Attribute("mode");
-								setBlendMode(spriteName, mode);
-							}
-						}
-
-						// Is the animation ready to be played?
-						int keyFrameDuration;
-						if (keyFrameChild->ToElement()->Attribute("duration", &keyFrameDuration)) {
-							if (m_t > startTime + keyFrameDuration) {
-								// The duration has passed
-								continue;
-							}
-						} else {
-							// Duration of a function must be defined!
-							continue;
-						}
-
-						// Get type
-						std::string type;
-						if (keyFrameChild->ToElement()->Attribute("type")) {
-							type = keyFrameChild->ToElement()->Attribute("type");
-						} else {
-							// Default type
-							type = "none";
-						}
-
-						// Animation
-						// Transform scale
-						if (keyFrameChild->ValueStr() == "scaleX") {
-							double startVal, endVal, alpha, beta;
-							if (!keyFrameChild->ToElement()->Attribute("alpha", &alpha)) {
-								alpha = 0;
-							}
-							if (!keyFrameChild->ToElement()->Attribute("beta", &beta)) {
-								beta = 0;
-							}
-							if (keyFrameChild->ToElement()->Attribute("startVal", &startVal) && keyFrameChild->ToElement()->Attribute("endVal", &endVal)) {
-								setScaleX(spriteName, static_cast<float>(getLocalTimer(type, startVal, endVal, (m_t - startTime) * 1.0 / keyFrameDuration, alpha, beta)));
-							}
-						}
-						if (keyFrameChild->ValueStr() == "scaleY") {
-							double startVal, endVal, alpha, beta;
-							if (!keyFrameChild->ToElement()->Attribute("alpha", &alpha)) {
-								alpha = 0;
-							}
-							if (!keyFrameChild->ToElement()->Attribute("beta", &beta)) {
-								beta = 0;
-							}
-							if (keyFrameChild->ToElement()->Attribute("startVal", &startVal) && keyFrameChild->ToElement()->Attribute("endVal", &endVal)) {
-								setScaleY(spriteName, static_cast<float>(getLocalTimer(type, startVal, endVal, (m_t - startTime) * 1.0 / keyFrameDuration, alpha, beta)));
-							}
-						}
-
-						// Set transparency
-						if (keyFrameChild->ValueStr() == "transparency") {
-							double startVal, endVal, alpha, beta;
-							if (!keyFrameChild->ToElement()->Attribute("alpha", &alpha)) {
-								alpha = 0;
-							}
-							if (!keyFrameChild->ToElement()->Attribute("beta", &beta)) {
-								beta = 0;
-							}
-							if (keyFrameChild->ToElement()->Attribute("startVal", &startVal) && keyFrameChild->ToElement()->Attribute("endVal", &endVal)) {
-								setTransparency(spriteName, static_cast<float>(getLocalTimer(type, startVal, endVal, (m_t - startTime) * 1.0 / keyFrameDuration, alpha, beta)));
-							}
-						}
-
-						if (keyFrameChild->ValueStr() == "rotation") {
-							double startVal, endVal, alpha, beta;
-							if (!keyFrameChild->ToElement()->Attribute("alpha", &alpha)) {
-								alpha = 0;
-							}
-							if (!keyFrameChild->ToElement()->Attribute("beta", &beta)) {
-								beta = 0;
-							}
-							if (keyFrameChild->ToElement()->Attribute("startVal", &startVal) && keyFrameChild->ToElement()->Attribute("endVal", &endVal)) {
-								setAngle(spriteName, static_cast<float>(getLocalTimer(type, startVal, endVal, (m_t - startTime) * 1.0 / keyFrameDuration, alpha, beta)));
-							}
-						}
-
-						if (keyFrameChild->ValueStr() == "move") {
-							double startVal, endVal, alpha, beta;
-							if (!keyFrameChild->ToElement()->Attribute("alpha", &alpha)) {
-								alpha = 0;
-							}
-							if (!keyFrameChild->ToElement()->Attribute("beta", &beta)) {
-								beta = 0;
-							}
-							if (keyFrameChild->ToElement()->Attribute("startVal", &startVal) && keyFrameChild->ToElement()->Attribute("endVal", &endVal) && keyFrameChild->ToElement()->Attribute("path")) {
-								std::string pathName = keyFrameChild->ToElement()->Attribute("path");
-								move(spriteName, pathName, static_cast<float>(getLocalTimer(type, startVal, endVal, (m_t - startTime) * 1.0 / keyFrameDuration, alpha, beta)));
-							}
-						}
-
-						// Color
-						if (keyFrameChild->ValueStr() == "color") {
-							double startVal, endVal, alpha, beta;
-							if (!keyFrameChild->ToElement()->Attribute("alpha", &alpha)) {
-								alpha = 0;
-							}
-							if (!keyFrameChild->ToElement()->Attribute("beta", &beta)) {
-								beta = 0;
-							}
-							if (keyFrameChild->ToElement()->Attribute("startVal", &startVal) && keyFrameChild->ToElement()->Attribute("endVal", &endVal) && keyFrameChild->ToElement()->Attribute("rgb")) {
-								// Split into two
-								std::string rgb = keyFrameChild->ToElement()->Attribute("rgb");
-								setColor(spriteName, rgb, static_cast<float>(getLocalTimer(type, startVal, endVal, (m_t - startTime) * 1.0 / keyFrameDuration, alpha, beta)));
-							}
-						}
-					}
-				}
+		// Events are sorted by start time: stop at the first one that has not started.
+		// A loop can move the timer while the events are played.
+		for (const auto& event : m_timeline->sequences()[m_sequence].events) {
+			if (event.start > m_t) {
+				break;
+			}
+			for (uint32_t i = event.firstOp; i < event.firstOp + event.numOps; i++) {
+				play(event.start, m_timeline->op(i));
 			}
-			m_t++;
 		}
+		m_t++;
 	}
 
 	if (m_t > m_duration && m_t < 900) {
 		// End animation: hide all sprites
 		for (auto& sprite : m_sprites) {
-			sprite.second.transparency = 0;
+			sprite.transparency = 0;
 		}
 		m_t = 1000;
 	}
 }
 
-// Draw all sprites
-void Animation::draw()
+void Animation::play(const int start, const AnimationTimeline::Op& op)
 {
-	updateSprites();
-	for (const auto& drawSprite : m_drawSprites) {
-		drawSprite->sprite->draw(m_gameData->front);
+	using Opcode = AnimationTimeline::Opcode;
+
+	switch (op.opcode) {
+	case Opcode::PlaySound:
+		if (start == m_t) {
+			playSound(op.sound);
+		}
+		return;
+	case Opcode::Loop:
+		// Set loop point
+		m_t = op.time;
+		return;
+
+	// Instantly change sprite property
+	case Opcode::Rect:
+		setRect(op.sprite, op.x, op.y, op.width, op.height);
+		return;
+	case Opcode::Center:
+		setCenter(op.sprite, op.x, op.y);
+		return;
+	case Opcode::Position:
+		setPosition(op.sprite, op.x, op.y);
+		return;
+	case Opcode::Blend:
+		setBlendMode(op.sprite, op.blend);
+		return;
+	default:
+		break;
 	}
-}
 
-// Define new sprite
-void Animation::newSprite(const std::string& name, const std::string& image, const std::string& before)
-{
-	m_sprites[name].sprite = new Sprite();
-	m_sprites[name].sprite->setImage(m_gameData->front->loadImage(m_sourceFolder + image));
-	m_gameData->front->loadImage(m_sourceFolder + image)->setFilter(FilterType::LinearFilter);
-	m_sprites[name].angle = 0;
-	m_sprites[name].transparency = 0;
-	m_sprites[name].position.x = 0;
-	m_sprites[name].position.y = 0;
-	m_sprites[name].pathPos.x = 0;
-	m_sprites[name].pathPos.y = 0;
-	m_sprites[name].scale.x = 1;
-	m_sprites[name].scale.y = 1;
-	m_sprites[name].childOffset.x = 0;
-	m_sprites[name].childOffset.y = 0;
-	m_sprites[name].parent = "";
-
-	if (before.empty()) {
-		// Add sprite at the end
-		m_drawSprites.push_back(&m_sprites[name]);
-	} else {
-		// Find other sprite and insert at that position
-		m_drawSprites.insert(std::find(m_drawSprites.begin(), m_drawSprites.end(), &m_sprites[before]), &m_sprites[name]);
+	// Is the animation ready to be played?
+	if (m_t > start + op.curve.frames()) {
+		// The duration has passed
+		return;
+	}
+	const float value = op.curve.at(m_t - start);
+
+	switch (op.opcode) {
+	case Opcode::ScaleX:
+		setScaleX(op.sprite, value);
+		break;
+	case Opcode::ScaleY:
+		setScaleY(op.sprite, value);
+		break;
+	case Opcode::Transparency:
+		setTransparency(op.sprite, value);
+		break;
+	case Opcode::Rotation:
+		setAngle(op.sprite, value);
+		break;
+	case Opcode::Move:
+		move(op.sprite, op.path, value);
+		break;
+	case Opcode::Color:
+		setColor(op.sprite, op.fromColor, op.toColor, value);
+		break;
+	default:
+		break;
 	}
 }
 
-void Animation::newSound(const std::string& name, const std::string& buffer)
+SpriteHandle Animation::findSprite(const std::string& name) const
 {
-	m_sounds[name] = new Sound;
-	setBuffer(*m_sounds[name], m_gameData->front->loadSound(m_sourceFolder + buffer));
+	return m_timeline && !m_sprites.empty() ? m_timeline->findSprite(name) : SpriteHandle {};
 }
 
-// Add child to parent
-void Animation::addChild(const std::string& parent, const std::string& child, const float x, const float y)
+// Draw all sprites
+void Animation::draw()
 {
-	m_sprites[parent].children.push_back(child);
-	m_sprites[child].transparency = 1; // Child's transparency is 1 by default
-	m_sprites[child].childOffset.x = x;
-	m_sprites[child].childOffset.y = y;
+	if (!m_timeline || m_sprites.empty()) {
+		return;
+	}
+	updateSprites();
+	for (const int i : m_timeline->drawOrder()) {
+		m_sprites[i].sprite->draw(m_gameData->front);
+	}
 }
 
-void Animation::setRect(const std::string& name, const float x, const float y, const float width, const float height)
+void Animation::setRect(const SpriteHandle sprite, const float x, const float y, const float width, const float height)
 {
-	if (!spriteExists(name))
+	if (!spriteExists(sprite))
 		return;
-	m_sprites[name].sprite->setSubRect(
+	m_sprites[sprite.index].sprite->setSubRect(
 		static_cast<int>(x),
 		static_cast<int>(y),
 		static_cast<int>(width),
 		static_cast<int>(height));
 }
 
-void Animation::setCenter(const std::string& name, const float x, const float y)
+void Animation::setCenter(const SpriteHandle sprite, const float x, const float y)
 {
-	if (!spriteExists(name))
+	if (!spriteExists(sprite))
 		return;
-	m_sprites[name].sprite->setCenter(
+	m_sprites[sprite.index].sprite->setCenter(
 		static_cast<int>(x),
 		static_cast<int>(y));
 }
 
-void Animation::setPosition(const std::string& name, const float x, const float y)
+void Animation::setPosition(const SpriteHandle sprite, const float x, const float y)
 {
-	if (!spriteExists(name))
+	if (!spriteExists(sprite))
 		return;
-	m_sprites[name].position.x = x;
-	m_sprites[name].position.y = y;
+	m_sprites[sprite.index].position.x = x;
+	m_sprites[sprite.index].position.y = y;
 }
 
-void Animation::setBlendMode(const std::string& name, std::string blend)
+void Animation::setBlendMode(const SpriteHandle sprite, const BlendingMode blend)
 {
-	if (!spriteExists(name))
+	if (!spriteExists(sprite))
 		return;
-	blend = Lower(blend);
-	if (blend == "none")
-		m_sprites[name].sprite->setBlendMode(BlendingMode::NoBlending);
-	else if (blend == "add")
-		m_sprites[name].sprite->setBlendMode(BlendingMode::AdditiveBlending);
-	else if (blend == "multiply")
-		m_sprites[name].sprite->setBlendMode(BlendingMode::MultiplyBlending);
-	else if (blend == "alpha")
-		m_sprites[name].sprite->setBlendMode(BlendingMode::AlphaBlending);
+	m_sprites[sprite.index].sprite->setBlendMode(blend);
 }
 
-void Animation::setScaleX(const std::string& name, const float x)
+void Animation::setScaleX(const SpriteHandle sprite, const float x)
 {
-	if (!spriteExists(name))
+	if (!spriteExists(sprite))
 		return;
-	m_sprites[name].scale.x = x;
+	m_sprites[sprite.index].scale.x = x;
 }
 
-void Animation::setScaleY(const std::string& name, const float y)
+void Animation::setScaleY(const SpriteHandle sprite, const float y)
 {
-	if (!spriteExists(name))
+	if (!spriteExists(sprite))
 		return;
-	m_sprites[name].scale.y = y;
+	m_sprites[sprite.index].scale.y = y;
 }
 
-void Animation::setAngle(const std::string& name, const float x)
+void Animation::setAngle(const SpriteHandle sprite, const float x)
 {
-	if (!spriteExists(name))
+	if (!spriteExists(sprite))
 		return;
-	m_sprites[name].angle = x;
+	m_sprites[sprite.index].angle = x;
 }
 
-void Animation::setTransparency(const std::string& name, const float x)
+void Animation::setTransparency(const SpriteHandle sprite, const float x)
 {
-	if (!spriteExists(name))
+	if (!spriteExists(sprite))
 		return;
-	m_sprites[name].transparency = x;
+	m_sprites[sprite.index].transparency = x;
 }
 
-void Animation::setVisible(const std::string& name, const bool x)
+void Animation::setVisible(const SpriteHandle sprite, const bool x)
 {
-	if (!spriteExists(name))
+	if (!spriteExists(sprite))
 		return;
-	m_sprites[name].sprite->setVisible(x);
+	m_sprites[sprite.index].sprite->setVisible(x);
 }
 
-void Animation::setColor(const std::string& name, const std::string& color, float x)
+void Animation::setColor(const SpriteHandle sprite, const int from[3], const int to[3], float x)
 {
-	if (!spriteExists(name))
+	if (!spriteExists(sprite))
 		return;
-
-	// Get rgb values from string
-	int r1, g1, b1, r2, g2, b2;
-	sscanf(color.c_str(), "#%2x%2x%2x#%2x%2x%2x", &r1, &g1, &b1, &r2, &g2, &b2);
-
-	// Set color
-	m_sprites[name].sprite->setColor(
-		static_cast<float>(r1) + x * static_cast<float>(r2 - r1),
-		static_cast<float>(g1) + x * static_cast<float>(g2 - g1),
-		static_cast<float>(b1) + x * static_cast<float>(b2 - b1));
+	m_sprites[sprite.index].sprite->setColor(
+		static_cast<float>(from[0]) + x * static_cast<float>(to[0] - from[0]),
+		static_cast<float>(from[1]) + x * static_cast<float>(to[1] - from[1]),
+		static_cast<float>(from[2]) + x * static_cast<float>(to[2] - from[2]));
 }
 
 // Set position according to path
-void Animation::move(const std::string& name, const std::string& path, float x)
+void Animation::move(const SpriteHandle sprite, const int path, float x)
 {
-	// Check if path has more than 1 node
-	if (!spriteExists(name)) {
+	if (!spriteExists(sprite) || path < 0 || static_cast<size_t>(path) >= m_timeline->paths().size()) {
 		return;
 	}
 
-	if (m_paths[path].empty()) {
+	const AnimationTimeline::Path& p = m_timeline->paths()[path];
+
+	// Check if path has more than 1 node
+	if (p.nodes.empty()) {
 		return;
 	}
 
-	if (m_paths[path].size() == 1) {
-		m_sprites[name].pathPos.x = m_paths[path][0].x;
-		m_sprites[name].pathPos.y = m_paths[path][0].y;
+	if (p.nodes.size() == 1) {
+		m_sprites[sprite.index].pathPos.x = p.nodes[0].x;
+		m_sprites[sprite.index].pathPos.y = p.nodes[0].y;
 		return;
 	}
 
 	// Get total distance of path
-	const float totalDist = getTotalDistance(path);
+	const float totalDist = p.totalDistance;
 	if (totalDist == 0) // NOLINT(clang-diagnostic-float-equal)
 		return; // Danger of dividing by 0
 
 	// x must be between 0 and 1
 	if (x >= 0 && x < 1) {
-		const PosVectorFloat pv = getPosition(path, x * totalDist);
-		m_sprites[name].pathPos.x = pv.x;
-		m_sprites[name].pathPos.y = pv.y;
+		const PosVectorFloat pv = getPosition(p.nodes, x * totalDist);
+		m_sprites[sprite.index].pathPos.x = pv.x;
+		m_sprites[sprite.index].pathPos.y = pv.y;
 	} else if (x < 0) {
 		// Extrapolate from start
-		const PosVectorFloat pv = getPositionExtra(path, x, totalDist, true);
-		m_sprites[name].pathPos.x = pv.x;
-		m_sprites[name].pathPos.y = pv.y;
+		const PosVectorFloat pv = getPositionExtra(p.nodes, x, totalDist, true);
+		m_sprites[sprite.index].pathPos.x = pv.x;
+		m_sprites[sprite.index].pathPos.y = pv.y;
 	} else if (x >= 1) {
 		// Extrapolate from end
-		const PosVectorFloat pv = getPositionExtra(path, x - 1, totalDist, false);
-		m_sprites[name].pathPos.x = pv.x;
-		m_sprites[name].pathPos.y = pv.y;
+		const PosVectorFloat pv = getPositionExtra(p.nodes, x - 1, totalDist, false);
+		m_sprites[sprite.index].pathPos.x = pv.x;
+		m_sprites[sprite.index].pathPos.y = pv.y;
 	}
 }
 
-void Animation::playSound(const std::string& name)
+void Animation::playSound(const int sound)
 {
 	if (m_gameData && m_gameData->playSounds)
-		m_sounds[name]->play(m_gameData);
-}
-
-bool Animation::spriteExists(const std::string& name)
-{
-	return m_sprites.find(name) == m_sprites.end() ? false : true;
+		m_sounds[sound]->play(m_gameData);
 }
 
 void Animation::clearSprites()
 {
 	for (const auto& sprite : m_sprites) {
-		delete sprite.second.sprite;
+		delete sprite.sprite;
 	}
 	m_sprites.clear();
-	m_drawSprites.clear();
+	m_sequence = -1;
 }
 
 void Animation::clearSounds()
 {
-	for (const auto& it : m_sounds) {
-		delete it.second;
+	for (const auto* sound : m_sounds) {
+		delete sound;
 	}
-	// Clear sounds map
 	m_sounds.clear();
 }
 
 // Updates all properties of the sprite
 void Animation::updateSprites()
 {
-	for (auto& [name, sprite] : m_sprites) {
-		// Do not update if it's a child
-		if (!sprite.parent.empty()) {
+	// Parents come before their children, so they are up to date when a child gets to them
+	for (const auto& [index, parent] : m_timeline->hierarchy()) {
+		const AnimationSprite& sprite = m_sprites[index];
+		if (parent < 0) {
+			sprite.sprite->setPosition(
+				(sprite.position.x + sprite.pathPos.x) * m_globalScale + m_offset.x,
+				(sprite.position.y + sprite.pathPos.y) * m_globalScale + m_offset.y);
+			sprite.sprite->setScaleX(sprite.scale.x * m_globalScale);
+			sprite.sprite->setScaleY(sprite.scale.y * m_globalScale);
+			sprite.sprite->setRotation(sprite.angle);
+			sprite.sprite->setTransparency(sprite.transparency);
 			continue;
 		}
 
-		sprite.sprite->setPosition(
-			(sprite.position.x + sprite.pathPos.x) * m_globalScale + m_offset.x,
-			(sprite.position.y + sprite.pathPos.y) * m_globalScale + m_offset.y);
-		sprite.sprite->setScaleX(sprite.scale.x * m_globalScale);
-		sprite.sprite->setScaleY(sprite.scale.y * m_globalScale);
-		sprite.sprite->setRotation(sprite.angle);
-		sprite.sprite->setTransparency(sprite.transparency);
-		updateChildren(name);
-	}
-}
-
-void Animation::updateChildren(const std::string& parent)
-{
-	AnimationSprite& parentSprite = m_sprites[parent];
-	for (size_t i = 0; i < parentSprite.children.size(); i++) {
-		std::string& child = parentSprite.children[i];
-		const AnimationSprite& childSprite = m_sprites[child];
+		const AnimationSprite& parentSprite = m_sprites[parent];
+		const PosVectorFloat& childOffset = m_timeline->sprites()[index].childOffset;
 
 		// Scale
 		const float psx = parentSprite.sprite->getScaleX();
 		const float psy = parentSprite.sprite->getScaleY();
-		const float csx = childSprite.scale.x;
-		const float csy = childSprite.scale.y;
-		childSprite.sprite->setScaleX(psx * csx);
-		childSprite.sprite->setScaleY(psy * csy);
+		const float csx = sprite.scale.x;
+		const float csy = sprite.scale.y;
+		sprite.sprite->setScaleX(psx * csx);
+		sprite.sprite->setScaleY(psy * csy);
 
 		// Rotation
 		const float pr = parentSprite.sprite->getAngle();
-		const float cr = childSprite.angle;
-		childSprite.sprite->setRotation(pr + cr);
+		const float cr = sprite.angle;
+		sprite.sprite->setRotation(pr + cr);
 
 		// Transparency
 		const float pt = parentSprite.sprite->getTransparency();
-		const float ct = childSprite.transparency;
-		childSprite.sprite->setTransparency(pt * ct);
+		const float ct = sprite.transparency;
+		sprite.sprite->setTransparency(pt * ct);
 
 		// Position
 		const float px = (parentSprite.sprite->getX() - m_offset.x) / m_globalScale;
 		const float py = (parentSprite.sprite->getY() - m_offset.y) / m_globalScale;
-		const float cx = childSprite.position.x + childSprite.pathPos.x + childSprite.childOffset.x;
-		const float cy = childSprite.position.y + childSprite.pathPos.y + childSprite.childOffset.y;
+		const float cx = sprite.position.x + sprite.pathPos.x + childOffset.x;
+		const float cy = sprite.position.y + sprite.pathPos.y + childOffset.y;
 		const float r = sqrt(cx * cx * psx * psx + cy * cy * psy * psy);
 		const float a = atan2(-cy * psy, cx * psx) * 180 / kPiF;
-		childSprite.sprite->setPosition(
+		sprite.sprite->setPosition(
 			m_offset.x + (px + r * cos((pr + a) * kPiF / 180)) * m_globalScale,
 			m_offset.y + (py + r * sin((pr + a) * kPiF / -180)) * m_globalScale);
-
-		// Update children
-		updateChildren(child);
 	}
 }
 
 void Animation::resetSprites()
 {
-	for (auto& sprite : m_sprites) {
-		sprite.second.pathPos.x = 0;
-		sprite.second.pathPos.y = 0;
-		sprite.second.position.x = 0;
-		sprite.second.position.y = 0;
-		sprite.second.scale.x = 1;
-		sprite.second.scale.y = 1;
-		sprite.second.angle = 0;
-		sprite.second.transparency = 0;
-		if (!sprite.second.parent.empty()) {
-			sprite.second.transparency = 1;
+	for (size_t i = 0; i < m_sprites.size(); i++) {
+		AnimationSprite& sprite = m_sprites[i];
+		sprite.pathPos.x = 0;
+		sprite.pathPos.y = 0;
+		sprite.position.x = 0;
+		sprite.position.y = 0;
+		sprite.scale.x = 1;
+		sprite.scale.y = 1;
+		sprite.angle = 0;
+		sprite.transparency = 0;
+		if (m_timeline->sprites()[i].parent >= 0) {
+			sprite.transparency = 1;
 		}
 	}
 }
 
-double Animation::getLocalTimer(const std::string& type, const double startVal, const double endVal, const double t, const double alpha, const double beta) const
-{
-	// Input t must go from 0 to 1
-	double out = 0;
-	if (type == "linear")
-		out = (endVal - startVal) * t + startVal;
-	else if (type == "quadratic")
-		out = (endVal - startVal) * t * t + startVal;
-	else if (type == "squareroot")
-		out = (endVal - startVal) * pow(t, 0.5) + startVal;
-	else if (type == "cubic")
-		out = (endVal - startVal) * t * t * t + startVal;
-	else if (type == "cuberoot")
-		out = (endVal - startVal) * pow(t, 1.0 / 3.0) + startVal;
-	else if (type == "exponential")
-		out = (endVal - startVal) / (exp(alpha) - 1) * exp(alpha * t) + startVal - (endVal - startVal) / (exp(alpha) - 1);
-	else if (type == "elastic") // beta=wave number
-		out = (endVal - startVal) / (exp(alpha) - 1) * cos(beta * t * 2 * kPiD) * exp(alpha * t) + startVal - (endVal - startVal) / (exp(alpha) - 1);
-	else if (type == "sin")
-		out = startVal + endVal * sin(alpha * t * 2 * kPiD); // s=offset, e=amplitude, alpha=wave number
-	else if (type == "cos")
-		out = startVal + endVal * cos(alpha * t * 2 * kPiD); // s=offset, e=amplitude, alpha=wave number
-	return out;
-}
-
-float Animation::getTotalDistance(const std::string& path)
-{
-	if (m_paths[path].size() <= 1) {
-		return 0;
-	}
-	float distance = 0;
-
-	for (auto it = m_paths[path].begin() + 1; it < m_paths[path].end(); ++it) {
-		const PosVectorFloat diff = *(it - 1) - *it;
-		distance += sqrt(diff.x * diff.x + diff.y * diff.y);
-	}
-	return distance;
-}
-
-PosVectorFloat Animation::getPosition(const std::string& path, const float target)
+PosVectorFloat Animation::getPosition(const Nodes& nodes, const float target)
 {
 	float distance = 0;
 
-	for (auto it = m_paths[path].begin() + 1; it < m_paths[path].end(); ++it) {
+	for (auto it = nodes.begin() + 1; it < nodes.end(); ++it) {
 		const PosVectorFloat diff = *(it - 1) - *it;
 		const float nodeDistance = sqrt(diff.x * diff.x + diff.y * diff.y);
 		distance += nodeDistance;
@@ -746,19 +431,19 @@ PosVectorFloat Animation::getPosition(const std::string& path, const float targe
 	return {};
 }
 
-PosVectorFloat Animation::getPositionExtra(const std::string& path, const float target, const float totalDist, const bool start)
+PosVectorFloat Animation::getPositionExtra(const Nodes& nodes, const float target, const float totalDist, const bool start)
 {
 	PosVectorFloat diff;
-	std::vector<PosVectorFloat>::iterator it;
+	Nodes::const_iterator it;
 	int x = 0;
 	if (start) {
 		// Get first nodes
-		it = m_paths[path].begin() + 1;
+		it = nodes.begin() + 1;
 		diff = *(it - 1) - *it;
 		x = -1;
 	} else {
 		// Get end nodes
-		it = m_paths[path].end() - 1;
+		it = nodes.end() - 1;
 		diff = *(it - 1) - *it;
 	}
 
@@ -1,29 +1,25 @@
 #pragma once
 
+#include "AnimationTimeline.h"
 #include "FieldProp.h"
 #include "Sprite.h"
 #include "global.h"
-#include "tinyxml.h"
-#include <list>
-#include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace ppvs {
 
+// State of a sprite of the timeline with the same index
 struct AnimationSprite {
 	Sprite* sprite = nullptr;
-	std::string parent;
 	PosVectorFloat position {};
-	PosVectorFloat childOffset {};
 	PosVectorFloat pathPos {};
 	PosVectorFloat scale {};
 	float angle = 0.f;
 	float transparency = 0.f;
-	std::vector<std::string> children;
 };
 
-typedef std::vector<PosVectorFloat> Nodes;
-
 class Animation final {
 public:
 	Animation();
@@ -35,58 +31,50 @@ public:
 	Animation& operator=(Animation&&) = delete;
 
 	void init(GameData* g, PosVectorFloat offsetPos, float scale, std::string folder = "", const std::string& scriptName = "animation.xml", int maxTime = 120);
-	void prepareAnimation(const std::string& c)
-	{
-		m_t = 0;
-		m_animationName = c;
-		resetSprites();
-	}
+	void prepareAnimation(const std::string& c);
 	void playAnimation();
 	void draw();
 
-	// Callback functions
-	void newSprite(const std::string& name, const std::string& image, const std::string& before);
-	void newSound(const std::string& name, const std::string& buffer);
-	void addChild(const std::string& parent, const std::string& child, float x, float y);
-	void setRect(const std::string& name, float x, float y, float width, float height);
-	void setCenter(const std::string& name, float x, float y);
-	void setPosition(const std::string& name, float x, float y);
-	void setBlendMode(const std::string& name, std::string blend);
-	void setScaleX(const std::string& name, float x);
-	void setScaleY(const std::string& name, float y);
-	void setAngle(const std::string& name, float x);
-	void setTransparency(const std::string& name, float x);
-	void setVisible(const std::string& name, bool x);
-	void setColor(const std::string& name, const std::string& color, float x);
-	void move(const std::string& name, const std::string& path, float x);
-	void playSound(const std::string& name);
+	// Sprite of the script with this name, invalid if there is none
+	[[nodiscard]] SpriteHandle findSprite(const std::string& name) const;
+
+	// Callback functions, invalid sprites are ignored
+	void setRect(SpriteHandle sprite, float x, float y, float width, float height);
+	void setCenter(SpriteHandle sprite, float x, float y);
+	void setPosition(SpriteHandle sprite, float x, float y);
+	void setBlendMode(SpriteHandle sprite, BlendingMode blend);
+	void setScaleX(SpriteHandle sprite, float x);
+	void setScaleY(SpriteHandle sprite, float y);
+	void setAngle(SpriteHandle sprite, float x);
+	void setTransparency(SpriteHandle sprite, float x);
+	void setVisible(SpriteHandle sprite, bool x);
+	void setColor(SpriteHandle sprite, const int from[3], const int to[3], float x);
+	void move(SpriteHandle sprite, int path, float x);
+	void playSound(int sound);
 
 	PosVectorFloat m_offset;
 	float m_globalScale = 0.f;
 
 private:
-	bool spriteExists(const std::string& name);
+	[[nodiscard]] bool spriteExists(const SpriteHandle sprite) const { return sprite.index >= 0 && static_cast<size_t>(sprite.index) < m_sprites.size(); }
 	void clearSprites();
 	void clearSounds();
+	void play(int start, const AnimationTimeline::Op& op);
 	void updateSprites();
-	void updateChildren(const std::string& parent);
 	void resetSprites();
-	[[nodiscard]] double getLocalTimer(const std::string& type, double startVal, double endVal, double t, double alpha = 1, double beta = 1) const;
-	float getTotalDistance(const std::string& path);
-	PosVectorFloat getPosition(const std::string& path, float target);
-	PosVectorFloat getPositionExtra(const std::string& path, float target, float totalDist, bool start);
+	PosVectorFloat getPosition(const Nodes& nodes, float target);
+	PosVectorFloat getPositionExtra(const Nodes& nodes, float target, float totalDist, bool start);
 
 	int m_t;
 	int m_duration;
 	std::string m_animationName;
-	std::map<std::string, AnimationSprite> m_sprites;
-	std::list<AnimationSprite*> m_drawSprites;
-	std::map<std::string, Nodes> m_paths;
-	std::map<std::string, Sound*> m_sounds;
+	int m_sequence = -1; // Index of m_animationName in the timeline
+	std::shared_ptr<const AnimationTimeline> m_timeline;
+	std::vector<AnimationSprite> m_sprites;
+	std::vector<Sound*> m_sounds;
 	GameData* m_gameData = nullptr;
 	std::string m_sourceFolder;
 	bool m_error;
-	TiXmlDocument m_doc;
 };
 
 }
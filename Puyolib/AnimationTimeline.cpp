@@ -0,0 +1,341 @@
+#include "AnimationTimeline.h"
+#include "global.h"
+#include "tinyxml.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <mutex>
+
+namespace ppvs {
+
+namespace {
+
+template <typename T>
+int findByName(const std::vector<T>& items, const std::string& name)
+{
+	for (size_t i = 0; i < items.size(); i++) {
+		if (items[i].name == name) {
+			return static_cast<int>(i);
+		}
+	}
+	return -1;
+}
+
+bool parseBlendMode(std::string mode, BlendingMode& blend)
+{
+	mode = Lower(mode);
+	if (mode == "none")
+		blend = BlendingMode::NoBlending;
+	else if (mode == "add")
+		blend = BlendingMode::AdditiveBlending;
+	else if (mode == "multiply")
+		blend = BlendingMode::MultiplyBlending;
+	else if (mode == "alpha")
+		blend = BlendingMode::AlphaBlending;
+	else
+		return false;
+	return true;
+}
+
+}
+
+std::shared_ptr<const AnimationTimeline> AnimationTimeline::load(const std::string& fileName)
+{
+	static std::mutex mutex;
+	static std::map<std::string, std::shared_ptr<const AnimationTimeline>> cache;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (const auto it = cache.find(fileName); it != cache.end()) {
+		return it->second;
+	}
+
+	TiXmlDocument doc;
+	if (!doc.LoadFile(fileName)) {
+		return nullptr;
+	}
+	std::shared_ptr<AnimationTimeline> timeline(new AnimationTimeline);
+	timeline->compile(doc);
+	cache.emplace(fileName, timeline);
+	return timeline;
+}
+
+int AnimationTimeline::findSequence(const std::string& name) const
+{
+	if (name.empty()) {
+		return -1;
+	}
+	return findByName(m_sequences, name);
+}
+
+SpriteHandle AnimationTimeline::findSprite(const std::string& name) const
+{
+	return { findByName(m_sprites, name) };
+}
+
+void AnimationTimeline::compile(TiXmlDocument& doc)
+{
+	TiXmlHandle docHandle(&doc);
+	const TiXmlElement* animations = docHandle.FirstChild("animations").ToElement();
+	if (!animations) {
+		return;
+	}
+
+	if (const TiXmlElement* init = animations->FirstChildElement("init")) {
+		compileInit(init);
+		m_playable = true;
+	}
+
+	// Every element is an animation, the first one of a name hides the others
+	for (const TiXmlElement* element = animations->FirstChildElement(); element; element = element->NextSiblingElement()) {
+		if (findByName(m_sequences, element->ValueStr()) < 0) {
+			compileSequence(element);
+		}
+	}
+}
+
+void AnimationTimeline::compileInit(const TiXmlElement* init)
+{
+	// Parents are resolved once all sprites are known
+	std::vector<std::string> parents;
+
+	for (const TiXmlElement* element = init->FirstChildElement(); element; element = element->NextSiblingElement()) {
+		const char* name = element->Attribute("name");
+		if (!name) {
+			continue; // Must have a name!
+		}
+
+		if (element->ValueStr() == "sprite") {
+			// Only a sprite with an image exists
+			const TiXmlElement* image = element->FirstChildElement("image");
+			if (!image || !image->GetText()) {
+				continue;
+			}
+
+			int index = findByName(m_sprites, name);
+			if (index < 0) {
+				index = static_cast<int>(m_sprites.size());
+				m_sprites.emplace_back();
+				m_sprites.back().name = name;
+				parents.emplace_back();
+
+				// Draw before another sprite, or on top of all so far
+				const char* before = element->Attribute("before");
+				const int beforeIndex = before ? findByName(m_sprites, before) : -1;
+				m_drawOrder.insert(std::find(m_drawOrder.begin(), m_drawOrder.end(), beforeIndex), index);
+			}
+
+			SpriteDef& sprite = m_sprites[index];
+			sprite.image = image->GetText();
+			for (const TiXmlElement* child = element->FirstChildElement(); child; child = child->NextSiblingElement()) {
+				if (child->ValueStr() == "rect") {
+					int x = 0, y = 0, width = 0, height = 0;
+					if (child->Attribute("x", &x) && child->Attribute("y", &y) && child->Attribute("width", &width) && child->Attribute("height", &height)) {
+						sprite.hasRect = true;
+						sprite.rect[0] = x;
+						sprite.rect[1] = y;
+						sprite.rect[2] = width;
+						sprite.rect[3] = height;
+					}
+				} else if (child->ValueStr() == "center") {
+					int x = 0, y = 0;
+					if (child->Attribute("x", &x) && child->Attribute("y", &y)) {
+						sprite.hasCenter = true;
+						sprite.center[0] = x;
+						sprite.center[1] = y;
+					}
+				} else if (child->ValueStr() == "bind") {
+					int x = 0, y = 0;
+					if (child->Attribute("parent") && child->Attribute("x", &x) && child->Attribute("y", &y)) {
+						parents[index] = child->Attribute("parent");
+						sprite.childOffset = PosVectorFloat(static_cast<float>(x), static_cast<float>(y));
+					}
+				} else if (child->ValueStr() == "blend") {
+					if (child->Attribute("mode")) {
+						sprite.hasBlend = parseBlendMode(child->Attribute("mode"), sprite.blend);
+					}
+				}
+			}
+		} else if (element->ValueStr() == "path") {
+			int index = findByName(m_paths, name);
+			if (index < 0) {
+				index = static_cast<int>(m_paths.size());
+				m_paths.emplace_back();
+				m_paths.back().name = name;
+			}
+			for (const TiXmlElement* node = element->FirstChildElement("node"); node; node = node->NextSiblingElement("node")) {
+				int x = 0, y = 0;
+				if (node->Attribute("x", &x) && node->Attribute("y", &y)) {
+					m_paths[index].nodes.emplace_back(static_cast<float>(x), static_cast<float>(y));
+				}
+			}
+		} else if (element->ValueStr() == "sound") {
+			for (const TiXmlElement* file = element->FirstChildElement("file"); file; file = file->NextSiblingElement("file")) {
+				if (!file->GetText()) {
+					continue;
+				}
+				int index = findByName(m_sounds, name);
+				if (index < 0) {
+					index = static_cast<int>(m_sounds.size());
+					m_sounds.emplace_back();
+					m_sounds.back().name = name;
+				}
+				m_sounds[index].file = file->GetText();
+			}
+		}
+	}
+
+	for (size_t i = 0; i < m_sprites.size(); i++) {
+		const int parent = parents[i].empty() ? -1 : findByName(m_sprites, parents[i]);
+		if (parent < 0 || parent == static_cast<int>(i)) {
+			continue;
+		}
+		m_sprites[i].parent = parent;
+	}
+
+	// Roots first, then the sprites bound to each entry in turn. Sprites bound in
+	// a circle are never reached and never updated.
+	for (size_t i = 0; i < m_sprites.size(); i++) {
+		if (m_sprites[i].parent < 0) {
+			m_hierarchy.push_back({ static_cast<int>(i), -1 });
+		}
+	}
+	for (size_t n = 0; n < m_hierarchy.size(); n++) {
+		const int parent = m_hierarchy[n].sprite;
+		for (size_t i = 0; i < m_sprites.size(); i++) {
+			if (m_sprites[i].parent == parent) {
+				m_hierarchy.push_back({ static_cast<int>(i), parent });
+			}
+		}
+	}
+
+	for (Path& path : m_paths) {
+		for (size_t i = 1; i < path.nodes.size(); i++) {
+			const PosVectorFloat diff = path.nodes[i - 1] - path.nodes[i];
+			path.totalDistance += std::sqrt(diff.x * diff.x + diff.y * diff.y);
+		}
+	}
+}
+
+void AnimationTimeline::compileSequence(const TiXmlElement* element)
+{
+	Sequence sequence;
+	sequence.name = element->ValueStr();
+
+	for (const TiXmlElement* eventElement = element->FirstChildElement("event"); eventElement; eventElement = eventElement->NextSiblingElement("event")) {
+		Event event;
+		if (!eventElement->Attribute("start", &event.start)) {
+			continue; // Start time must be defined
+		}
+		event.firstOp = static_cast<uint32_t>(m_ops.size());
+
+		// Elements that can't do anything are left out
+		for (const TiXmlElement* child = eventElement->FirstChildElement(); child; child = child->NextSiblingElement()) {
+			const std::string& value = child->ValueStr();
+			Op op;
+
+			if (value == "playSound") {
+				if (child->Attribute("name") && (op.sound = findByName(m_sounds, child->Attribute("name"))) >= 0) {
+					op.opcode = Opcode::PlaySound;
+					m_ops.push_back(op);
+				}
+				continue;
+			}
+			if (value == "loop") {
+				if (child->QueryIntAttribute("t", &op.time) == TIXML_SUCCESS) {
+					op.opcode = Opcode::Loop;
+					m_ops.push_back(op);
+				}
+				continue;
+			}
+
+			// All other elements point to a sprite
+			if (!child->Attribute("name") || !(op.sprite = findSprite(child->Attribute("name"))).valid()) {
+				continue;
+			}
+
+			int x = 0, y = 0, width = 0, height = 0;
+			if (value == "rect") {
+				if (child->Attribute("x", &x) && child->Attribute("y", &y) && child->Attribute("width", &width) && child->Attribute("height", &height)) {
+					op.opcode = Opcode::Rect;
+					op.x = static_cast<float>(x);
+					op.y = static_cast<float>(y);
+					op.width = static_cast<float>(width);
+					op.height = static_cast<float>(height);
+					m_ops.push_back(op);
+				}
+				continue;
+			}
+			if (value == "center" || value == "position") {
+				if (child->Attribute("x", &x) && child->Attribute("y", &y)) {
+					op.opcode = value == "center" ? Opcode::Center : Opcode::Position;
+					op.x = static_cast<float>(x);
+					op.y = static_cast<float>(y);
+					m_ops.push_back(op);
+				}
+				continue;
+			}
+			if (value == "blend") {
+				if (child->Attribute("mode") && parseBlendMode(child->Attribute("mode"), op.blend)) {
+					op.opcode = Opcode::Blend;
+					m_ops.push_back(op);
+				}
+				continue;
+			}
+
+			// Interpolated elements need a duration and a range
+			if (value == "scaleX")
+				op.opcode = Opcode::ScaleX;
+			else if (value == "scaleY")
+				op.opcode = Opcode::ScaleY;
+			else if (value == "transparency")
+				op.opcode = Opcode::Transparency;
+			else if (value == "rotation")
+				op.opcode = Opcode::Rotation;
+			else if (value == "move")
+				op.opcode = Opcode::Move;
+			else if (value == "color")
+				op.opcode = Opcode::Color;
+			else
+				continue;
+
+			int duration = 0;
+			double startVal = 0., endVal = 0., alpha = 0., beta = 0.;
+			if (!child->Attribute("duration", &duration) || !child->Attribute("startVal", &startVal) || !child->Attribute("endVal", &endVal)) {
+				continue;
+			}
+			child->Attribute("alpha", &alpha);
+			child->Attribute("beta", &beta);
+			const Easing type = child->Attribute("type") ? easingFromName(child->Attribute("type")) : Easing::None;
+
+			if (op.opcode == Opcode::Move) {
+				if (!child->Attribute("path") || (op.path = findByName(m_paths, child->Attribute("path"))) < 0 || m_paths[op.path].nodes.empty()) {
+					continue;
+				}
+			} else if (op.opcode == Opcode::Color) {
+				if (!child->Attribute("rgb")) {
+					continue;
+				}
+				unsigned int rgb[6] {};
+				sscanf(child->Attribute("rgb"), "#%2x%2x%2x#%2x%2x%2x", &rgb[0], &rgb[1], &rgb[2], &rgb[3], &rgb[4], &rgb[5]);
+				for (int i = 0; i < 3; i++) {
+					op.fromColor[i] = static_cast<int>(rgb[i]);
+					op.toColor[i] = static_cast<int>(rgb[i + 3]);
+				}
+			}
+			op.curve = EasingTable(type, startVal, endVal, duration, alpha, beta);
+			m_ops.push_back(op);
+		}
+
+		event.numOps = static_cast<uint32_t>(m_ops.size()) - event.firstOp;
+		if (event.numOps > 0) {
+			sequence.events.push_back(event);
+		}
+	}
+
+	std::stable_sort(sequence.events.begin(), sequence.events.end(), [](const Event& a, const Event& b) { return a.start < b.start; });
+	m_sequences.push_back(std::move(sequence));
+}
+
+}
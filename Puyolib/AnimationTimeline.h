@@ -0,0 +1,147 @@
+#pragma once
+
+#include "Easing.h"
+#include "FieldProp.h"
+#include "Frontend.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class TiXmlDocument;
+class TiXmlElement;
+
+namespace ppvs {
+
+typedef std::vector<PosVectorFloat> Nodes;
+
+// A sprite of a timeline, looked up by name once instead of on every use
+struct SpriteHandle {
+	int index = -1;
+
+	[[nodiscard]] bool valid() const { return index >= 0; }
+};
+
+// An animation script compiled for playback. Names are resolved to indices, every
+// element becomes an opcode with its parameters already read, and the events of an
+// animation are sorted by start time. A timeline never changes after it is loaded,
+// so all Animation objects playing the same script share one.
+class AnimationTimeline final {
+public:
+	enum class Opcode : uint8_t {
+		PlaySound,
+		Loop,
+		// Instant, applied every frame once the event has started
+		Rect,
+		Center,
+		Position,
+		Blend,
+		// Interpolated over the duration of the element
+		ScaleX,
+		ScaleY,
+		Transparency,
+		Rotation,
+		Move,
+		Color,
+	};
+
+	struct Op {
+		Opcode opcode {};
+		SpriteHandle sprite;
+		int sound = -1; // PlaySound
+		int path = -1; // Move
+		int time = 0; // Loop
+		float x = 0.f, y = 0.f, width = 0.f, height = 0.f; // Rect, Center and Position
+		BlendingMode blend = BlendingMode::AlphaBlending;
+		EasingTable curve; // Value of an interpolated op for every frame of its duration
+		int fromColor[3] {}, toColor[3] {};
+	};
+
+	// Ops of an event are m_ops[firstOp] to m_ops[firstOp + numOps - 1], in document order
+	struct Event {
+		int start = 0;
+		uint32_t firstOp = 0;
+		uint32_t numOps = 0;
+	};
+
+	struct Sequence {
+		std::string name;
+		std::vector<Event> events; // Sorted by start, stable
+	};
+
+	struct SpriteDef {
+		std::string name;
+		std::string image;
+		int parent = -1; // Sprite it is bound to
+		PosVectorFloat childOffset {};
+		bool hasRect = false;
+		int rect[4] {};
+		bool hasCenter = false;
+		int center[2] {};
+		bool hasBlend = false;
+		BlendingMode blend = BlendingMode::AlphaBlending;
+	};
+
+	// Entry of the sprite hierarchy, see hierarchy()
+	struct SpriteLink {
+		int sprite;
+		int parent;
+	};
+
+	struct Path {
+		std::string name;
+		Nodes nodes;
+		float totalDistance = 0.f;
+	};
+
+	struct SoundDef {
+		std::string name;
+		std::string file;
+	};
+
+	~AnimationTimeline() = default;
+
+	AnimationTimeline(const AnimationTimeline&) = delete;
+	AnimationTimeline& operator=(const AnimationTimeline&) = delete;
+	AnimationTimeline(AnimationTimeline&&) = delete;
+	AnimationTimeline& operator=(AnimationTimeline&&) = delete;
+
+	// Compiled script of a file. Scripts are cached by file name for the rest of the
+	// process, files that could not be loaded are tried again on the next call.
+	static std::shared_ptr<const AnimationTimeline> load(const std::string& fileName);
+
+	// False if the script has no init section
+	[[nodiscard]] bool playable() const { return m_playable; }
+
+	[[nodiscard]] const std::vector<SpriteDef>& sprites() const { return m_sprites; }
+	[[nodiscard]] const std::vector<int>& drawOrder() const { return m_drawOrder; }
+	// Sprites that are not bound to anything and all sprites bound to them, every
+	// sprite after its parent
+	[[nodiscard]] const std::vector<SpriteLink>& hierarchy() const { return m_hierarchy; }
+	[[nodiscard]] const std::vector<Path>& paths() const { return m_paths; }
+	[[nodiscard]] const std::vector<SoundDef>& sounds() const { return m_sounds; }
+	[[nodiscard]] const std::vector<Sequence>& sequences() const { return m_sequences; }
+	[[nodiscard]] const Op& op(const uint32_t i) const { return m_ops[i]; }
+
+	// Index of the animation with this name, -1 if there is none
+	[[nodiscard]] int findSequence(const std::string& name) const;
+	[[nodiscard]] SpriteHandle findSprite(const std::string& name) const;
+
+private:
+	AnimationTimeline() = default;
+
+	void compile(TiXmlDocument& doc);
+	void compileInit(const TiXmlElement* init);
+	void compileSequence(const TiXmlElement* element);
+
+	bool m_playable = false;
+	std::vector<SpriteDef> m_sprites;
+	std::vector<int> m_drawOrder;
+	std::vector<SpriteLink> m_hierarchy;
+	std::vector<Path> m_paths;
+	std::vector<SoundDef> m_sounds;
+	std::vector<Sequence> m_sequences;
+	std::vector<Op> m_ops;
+};
+
+}
@@ -0,0 +1,211 @@
+#include "BeamSearch.h"
+#include "AI.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace ppvs {
+
+namespace {
+
+using Column = FieldState::Column;
+
+int bitCount(const Column v)
+{
+#if defined(_MSC_VER)
+	return static_cast<int>(__popcnt(v));
+#else
+	return __builtin_popcount(v);
+#endif
+}
+
+// Longest chain that one more puyo on top of any column would set off. Only colors
+// touching the landing spot can connect, so only those are tried.
+int chainPotential(const FieldState& state, const int puyoToClear)
+{
+	int best = 0;
+	const int top = state.height() - 3;
+	for (int x = 0; x < state.width(); x++) {
+		const int y = bitCount(state.occupied(x));
+		if (y >= top) {
+			continue;
+		}
+
+		const int neighbors[3] = { state.getColor(x, y - 1), state.getColor(x - 1, y), state.getColor(x + 1, y) };
+		for (int i = 0; i < 3; i++) {
+			const int color = neighbors[i];
+			if (color < 0 || (i > 0 && color == neighbors[0]) || (i > 1 && color == neighbors[1])) {
+				continue;
+			}
+			FieldState copy = state;
+			copy.addColorPuyo(x, y, color);
+			best = std::max(best, copy.simulateChain(puyoToClear));
+		}
+	}
+	return best;
+}
+
+// Number of horizontally or vertically touching puyo pairs of the same color
+int connections(const FieldState& state)
+{
+	const Column visible = state.visibleRows();
+	int n = 0;
+	for (int color = 0; color < FieldState::kMaxColors; color++) {
+		for (int x = 0; x < state.width(); x++) {
+			const Column column = state.colorColumn(color, x) & visible;
+			if (!column) {
+				continue;
+			}
+			n += bitCount(column & column >> 1);
+			if (x < state.width() - 1) {
+				n += bitCount(column & state.colorColumn(color, x + 1));
+			}
+		}
+	}
+	return n;
+}
+
+}
+
+int defaultBeamEvaluation(const FieldState& state, const int chain, const int puyoToClear)
+{
+	int score = 0;
+
+	if (chain >= 2) {
+		score += chain * chain * 200;
+	}
+
+	const int potential = chainPotential(state, puyoToClear);
+	score += potential * potential * 100;
+
+	score += connections(state) * 10;
+
+	// Keep the stack low
+	for (int x = 0; x < state.width(); x++) {
+		const int height = bitCount(state.occupied(x));
+		score -= height * height;
+	}
+	return score;
+}
+
+BeamSearch::BeamSearch(BeamSearchSettings settings)
+	: m_settings(std::move(settings))
+{
+}
+
+bool BeamSearch::search(const FieldState& state, const AIPiece pieces[], const int numPieces, const int puyoToClear,
+	const PosVectorInt spawn, int& bestPos, int& bestRot, int& bestChain, const std::atomic<bool>* cancel)
+{
+	using Clock = std::chrono::steady_clock;
+	const bool timed = m_settings.timeLimit > 0;
+	const Clock::time_point deadline = timed ? Clock::now() + std::chrono::microseconds(m_settings.timeLimit) : Clock::time_point();
+	const BeamEvaluation& evaluation = m_settings.evaluation ? m_settings.evaluation : BeamEvaluation(defaultBeamEvaluation);
+	const int width = state.width();
+	const int beamWidth = std::max(m_settings.beamWidth, 1);
+
+	m_depth = 0;
+	m_beam.assign(1, Node());
+	m_beam[0].state = state;
+	m_beam[0].valid = true;
+
+	int placements = 0;
+	for (int level = 0; level < numPieces; level++) {
+		const AIPiece& piece = pieces[level];
+		const int candidates = width * 4;
+		placements += static_cast<int>(m_beam.size()) * candidates;
+		if (placements > m_settings.nodeBudget) {
+			break;
+		}
+		m_children.resize(m_beam.size() * candidates);
+
+		// One task per field and column, every task fills the slots of its 4 rotations
+		std::atomic<bool> expired { false };
+		WorkerPool::shared().run(static_cast<int>(m_beam.size()) * width, [&](const int task) {
+			const Node& parent = m_beam[task / width];
+			const int x = task % width;
+			for (int rotation = 0; rotation < 4; rotation++) {
+				Node& child = m_children[(task / width) * candidates + x * 4 + rotation];
+				child.valid = false;
+				if (expired.load(std::memory_order_relaxed)) {
+					continue;
+				}
+				if ((timed && Clock::now() > deadline) || (cancel && cancel->load(std::memory_order_relaxed))) {
+					expired = true;
+					continue;
+				}
+
+				PosVectorInt shadowPos[4];
+				int colors[4];
+				const int n = AI::dropPiece(parent.state, piece, x, rotation, shadowPos, colors);
+				if (n == 0) {
+					continue;
+				}
+				child.state = parent.state;
+				if (!child.state.place(shadowPos, n, colors)) {
+					continue;
+				}
+				const int chain = child.state.simulateChain(puyoToClear);
+				if (child.state.isPuyo(spawn.x, spawn.y)) {
+					continue;
+				}
+
+				child.chain = std::max(parent.chain, chain);
+				if (level == 0) {
+					child.firstPos = x;
+					child.firstRot = rotation;
+					child.firstChain = chain;
+				} else {
+					child.firstPos = parent.firstPos;
+					child.firstRot = parent.firstRot;
+					child.firstChain = parent.firstChain;
+				}
+				child.score = evaluation(child.state, child.chain, puyoToClear);
+				child.valid = true;
+			}
+		});
+		if (expired) {
+			break;
+		}
+
+		// Keep the best fields, the earlier candidate wins ties
+		m_order.clear();
+		for (int i = 0; i < static_cast<int>(m_children.size()); i++) {
+			if (m_children[i].valid) {
+				m_order.push_back(i);
+			}
+		}
+		if (m_order.empty()) {
+			break;
+		}
+		const auto better = [this](const int a, const int b) {
+			if (m_children[a].score != m_children[b].score) {
+				return m_children[a].score > m_children[b].score;
+			}
+			return a < b;
+		};
+		const int keep = std::min(beamWidth, static_cast<int>(m_order.size()));
+		std::partial_sort(m_order.begin(), m_order.begin() + keep, m_order.end(), better);
+
+		m_beam.resize(keep);
+		for (int i = 0; i < keep; i++) {
+			m_beam[i] = m_children[m_order[i]];
+		}
+		m_depth++;
+	}
+
+	if (m_depth == 0) {
+		return false;
+	}
+
+	bestPos = m_beam[0].firstPos;
+	bestRot = m_beam[0].firstRot;
+	bestChain = m_beam[0].firstChain;
+	return true;
+}
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "DropPattern.h"
+#include "FieldState.h"
+#include <atomic>
+#include <functional>
+#include <vector>
+
+namespace ppvs {
+
+// A piece to place: the current one or one from the next list
+struct AIPiece {
+	MovePuyoType type = MovePuyoType::DOUBLET;
+	int color1 = 0;
+	int color2 = 0;
+};
+
+// Scores a field after a sequence of moves, higher is better. chain is the longest
+// chain set off by any of those moves.
+using BeamEvaluation = std::function<int(const FieldState& state, int chain, int puyoToClear)>;
+
+// Weighs the longest chain set off, the chain that a single extra puyo would
+// trigger, connected puyos and the height of the stack
+int defaultBeamEvaluation(const FieldState& state, int chain, int puyoToClear);
+
+struct BeamSearchSettings {
+	int beamWidth = 16; // Fields kept after every piece
+	int nodeBudget = 2000; // Placements tried per move, a level that would go over it isn't started
+	// Microseconds per move, 0 for none. A level that doesn't finish in time is dropped,
+	// so with a limit the move depends on how fast the machine is.
+	int timeLimit = 0;
+	BeamEvaluation evaluation; // Empty: defaultBeamEvaluation
+};
+
+// Looks ahead over the current piece and the pieces in the next list. Every level
+// places one piece in all positions on every field in the beam and keeps the best
+// beamWidth results. Levels are expanded on the worker pool; ties go to the earlier
+// candidate and the budget is counted in whole levels, so without a time limit the
+// outcome is the same on every machine.
+class BeamSearch final {
+public:
+	explicit BeamSearch(BeamSearchSettings settings = {});
+
+	void setSettings(const BeamSearchSettings& settings) { m_settings = settings; }
+	[[nodiscard]] const BeamSearchSettings& getSettings() const { return m_settings; }
+
+	// Find the best placement for pieces[0]. A field loses when spawn gets covered.
+	// Returns false if no level finished, the outputs are left alone in that case.
+	// Setting cancel stops the search like running out of time.
+	bool search(const FieldState& state, const AIPiece pieces[], int numPieces, int puyoToClear,
+		PosVectorInt spawn, int& bestPos, int& bestRot, int& bestChain, const std::atomic<bool>* cancel = nullptr);
+
+	// Levels completed by the last search
+	[[nodiscard]] int getDepth() const { return m_depth; }
+
+private:
+	struct Node {
+		FieldState state;
+		int score = 0;
+		int chain = 0; // Longest chain so far
+		int firstPos = 0, firstRot = 0, firstChain = 0; // Move of the first piece that leads here
+		bool valid = false;
+	};
+
+	BeamSearchSettings m_settings;
+	std::vector<Node> m_beam;
+	std::vector<Node> m_children;
+	std::vector<int> m_order;
+	int m_depth = 0;
+};
+
+}
@@ -0,0 +1,68 @@
+#include "ChainTable.h"
+#include <algorithm>
+
+namespace ppvs {
+
+ChainTable::ChainTable(const int sizeLog2)
+{
+	const uint64_t size = uint64_t(1) << std::clamp(sizeLog2, 1, 30);
+	m_mask = size - 1;
+	m_slots = std::make_unique<std::atomic<uint64_t>[]>(size);
+	clear();
+}
+
+// 64k slots of 8 bytes
+ChainTable& ChainTable::shared()
+{
+	static ChainTable table(16);
+	return table;
+}
+
+bool ChainTable::find(const uint64_t key, int& chain, Stats* stats)
+{
+	const uint64_t slot = m_slots[key & m_mask].load(std::memory_order_relaxed);
+	if (slot != 0 && (slot & ~kChainMask) == (key & ~kChainMask)) {
+		chain = static_cast<int>(slot & kChainMask);
+		m_stats.hits.fetch_add(1, std::memory_order_relaxed);
+		if (stats) {
+			stats->hits.fetch_add(1, std::memory_order_relaxed);
+		}
+		return true;
+	}
+	m_stats.misses.fetch_add(1, std::memory_order_relaxed);
+	if (stats) {
+		stats->misses.fetch_add(1, std::memory_order_relaxed);
+	}
+	return false;
+}
+
+void ChainTable::store(const uint64_t key, const int chain)
+{
+	// Keys that would look like an empty slot, or chains that don't fit, are not stored
+	if ((key & ~kChainMask) == 0 || chain < 0 || static_cast<uint64_t>(chain) > kChainMask) {
+		return;
+	}
+	m_slots[key & m_mask].store((key & ~kChainMask) | static_cast<uint64_t>(chain), std::memory_order_relaxed);
+}
+
+void ChainTable::clear()
+{
+	for (uint64_t i = 0; i <= m_mask; i++) {
+		m_slots[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+double ChainTable::Stats::hitRate() const
+{
+	const uint64_t found = hits.load(std::memory_order_relaxed);
+	const uint64_t total = found + misses.load(std::memory_order_relaxed);
+	return total == 0 ? 0.0 : 100.0 * static_cast<double>(found) / static_cast<double>(total);
+}
+
+void ChainTable::Stats::reset()
+{
+	hits.store(0, std::memory_order_relaxed);
+	misses.store(0, std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace ppvs {
+
+// Fixed size table of chain lengths by field hash (see FieldState::hash), shared by
+// every field and thread. Each slot is one atomic word holding part of the key and
+// the chain length, so lookups and stores never lock. A newer result simply replaces
+// whatever was in its slot.
+class ChainTable final {
+public:
+	explicit ChainTable(int sizeLog2);
+	~ChainTable() = default;
+
+	ChainTable(const ChainTable&) = delete;
+	ChainTable& operator=(const ChainTable&) = delete;
+	ChainTable(ChainTable&&) = delete;
+	ChainTable& operator=(ChainTable&&) = delete;
+
+	// Hits and misses of a set of lookups, such as those of one AI player
+	struct Stats {
+		std::atomic<uint64_t> hits { 0 };
+		std::atomic<uint64_t> misses { 0 };
+
+		// Percentage of lookups that were found
+		[[nodiscard]] double hitRate() const;
+		void reset();
+	};
+
+	static ChainTable& shared();
+
+	// Returns false if the key isn't stored. The lookup is counted in the table's
+	// stats, and in stats as well if given.
+	bool find(uint64_t key, int& chain, Stats* stats = nullptr);
+	void store(uint64_t key, int chain);
+	void clear();
+
+	[[nodiscard]] uint64_t getHits() const { return m_stats.hits.load(std::memory_order_relaxed); }
+	[[nodiscard]] uint64_t getMisses() const { return m_stats.misses.load(std::memory_order_relaxed); }
+	[[nodiscard]] double getHitRate() const { return m_stats.hitRate(); }
+	void resetStats() { m_stats.reset(); }
+
+private:
+	static constexpr uint64_t kChainMask = 0xFF; // Low byte holds the chain, the rest verifies the key
+
+	std::unique_ptr<std::atomic<uint64_t>[]> m_slots;
+	uint64_t m_mask = 0;
+	Stats m_stats; // All lookups
+};
+
+}
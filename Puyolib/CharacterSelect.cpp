@@ -100,7 +100,7 @@ void CharacterSelect::play()
 	}
 
 	if (m_timer <= 60 && m_timer > 0) {
-		m_background.setTransparency(static_cast<float>(interpolate("linear", 0.0, 0.5, m_timer / 60.0)));
+		m_background.setTransparency(static_cast<float>(interpolate(Easing::Linear, 0.0, 0.5, m_timer / 60.0)));
 	}
 
 	if (m_timer <= 80 && m_timer > 0) {
@@ -109,7 +109,7 @@ void CharacterSelect::play()
 			constexpr int width = 8;
 			for (int j = 0; j < width; j++) {
 				const double tt = m_timer / 20.0 - (i * width + j) / 12.0;
-				float move = static_cast<float>(interpolate("exponential", 1, 0, tt, -2, 1));
+				float move = static_cast<float>(interpolate(Easing::Exponential, 1, 0, tt, -2, 1));
 				if (move > 1) {
 					move = 1;
 				} else if (move < 0) {
@@ -139,7 +139,7 @@ void CharacterSelect::play()
 				posY = 480.f - static_cast<float>(i / width) * 128.f * m_scale; // NOLINT(bugprone-integer-division)
 			}
 			const double tt = static_cast<double>(m_timer) / 30.0 - static_cast<double>(i) * 1.0 / static_cast<double>(numPlayers);
-			float move = static_cast<float>(interpolate("elastic", 1, 0, tt, -5, 0.5));
+			float move = static_cast<float>(interpolate(Easing::Elastic, 1, 0, tt, -5, 0.5));
 			if (move > -0.001f && move < 0.001f)
 				move = 0;
 			m_nameHolder[i].setPosition(posX, posY + 2.f + 320.f * move);
@@ -338,7 +338,7 @@ void CharacterSelect::play()
 	if (m_timer < 0 && m_timer > -60) {
 		const float t = static_cast<float>(m_timer + 60) / 60.0f; // From 0 to 1
 		m_background.setTransparency(
-			static_cast<float>(interpolate("linear", 0.0, 0.5, -m_timer / 60.0)));
+			static_cast<float>(interpolate(Easing::Linear, 0.0, 0.5, -m_timer / 60.0)));
 
 		// Set invisible
 		for (int i = 0; i < numPlayers; i++) {
@@ -367,7 +367,7 @@ void CharacterSelect::play()
 			constexpr int width = 8;
 			for (int j = 0; j < width; j++) {
 				const double tt = static_cast<double>(-m_timer) / 20.0 - static_cast<double>(i * width + j) / 12.0;
-				float move = static_cast<float>(interpolate("exponential", 1, 0, tt, -2, 1));
+				float move = static_cast<float>(interpolate(Easing::Exponential, 1, 0, tt, -2, 1));
 
 				if (move > 1) {
 					move = 1;
@@ -397,7 +397,7 @@ void CharacterSelect::play()
 				posY = 480.f - static_cast<float>(i / width) * 128.f * m_scale; // NOLINT(bugprone-integer-division)
 			}
 			const double tt = static_cast<double>(-m_timer) / 30.0 - static_cast<double>(i) / static_cast<double>(numPlayers);
-			float move = static_cast<float>(interpolate("elastic", 1, 0, tt, -5, 0.5));
+			float move = static_cast<float>(interpolate(Easing::Elastic, 1, 0, tt, -5, 0.5));
 			if (move > -0.001f && move < 0.001f) {
 				move = 0;
 			}
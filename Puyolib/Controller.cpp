@@ -1,4 +1,6 @@
 #include "Controller.h"
+#include "StateStream.h"
+#include <algorithm>
 
 namespace ppvs {
 
@@ -93,54 +95,56 @@ void Controller::setState(const FeInput& input, int t)
 		if (m_state == RecordState::RECORDING && t > 0)
 			record(t);
 	} else {
-		// Check event by looping through vector
-		// If the time is -1, it's considered as processed
-		for (auto& m_recordEvent : m_recordEvents) {
-			if (m_recordEvent.time != -1 && m_recordEvent.time == t) {
-				// Process all events with the correct time
-				switch (m_recordEvent.ev) {
-				case 0:
-					m_dUp = true;
-					break;
-				case 1:
-					m_dUp = false;
-					break;
-				case 2:
-					m_dDown = true;
-					break;
-				case 3:
-					m_dDown = false;
-					break;
-				case 4:
-					m_dLeft = true;
-					break;
-				case 5:
-					m_dLeft = false;
-					break;
-				case 6:
-					m_dRight = true;
-					break;
-				case 7:
-					m_dRight = false;
-					break;
-				case 8:
-					m_dA = true;
-					break;
-				case 9:
-					m_dA = false;
-					break;
-				case 10:
-					m_dB = true;
-					break;
-				case 11:
-					m_dB = false;
-					break;
-				default:
-					break;
-				}
-				m_recordEvent.time = -1;
-			} else if (m_recordEvent.time > t)
+		// Continue from the cursor, it only has to search again if the time went back
+		if (m_eventCursor > m_recordEvents.size()
+			|| (m_eventCursor > 0 && m_recordEvents[m_eventCursor - 1].time >= t)) {
+			seekEvents(t);
+		}
+		while (m_eventCursor < m_recordEvents.size() && m_recordEvents[m_eventCursor].time < t) {
+			m_eventCursor++;
+		}
+		// Process all events with the correct time
+		for (; m_eventCursor < m_recordEvents.size() && m_recordEvents[m_eventCursor].time == t; m_eventCursor++) {
+			switch (m_recordEvents[m_eventCursor].ev) {
+			case 0:
+				m_dUp = true;
+				break;
+			case 1:
+				m_dUp = false;
+				break;
+			case 2:
+				m_dDown = true;
+				break;
+			case 3:
+				m_dDown = false;
+				break;
+			case 4:
+				m_dLeft = true;
+				break;
+			case 5:
+				m_dLeft = false;
+				break;
+			case 6:
+				m_dRight = true;
+				break;
+			case 7:
+				m_dRight = false;
+				break;
+			case 8:
+				m_dA = true;
 				break;
+			case 9:
+				m_dA = false;
+				break;
+			case 10:
+				m_dB = true;
+				break;
+			case 11:
+				m_dB = false;
+				break;
+			default:
+				break;
+			}
 		}
 		// Set controls
 		if (m_dUp)
@@ -198,6 +202,40 @@ void Controller::release()
 	m_dStart = false;
 }
 
+// Button state, the recorded events stay as they are
+void Controller::syncState(StateStream& stream)
+{
+	stream.value(m_down);
+	stream.value(m_up);
+	stream.value(m_left);
+	stream.value(m_right);
+	stream.value(m_a);
+	stream.value(m_b);
+	stream.value(m_start);
+	stream.value(m_delayDown);
+	stream.value(m_delayUp);
+	stream.value(m_delayLeft);
+	stream.value(m_delayRight);
+	stream.value(m_delayA);
+	stream.value(m_delayB);
+	stream.value(m_delayStart);
+	stream.value(m_dUp);
+	stream.value(m_dDown);
+	stream.value(m_dLeft);
+	stream.value(m_dRight);
+	stream.value(m_dA);
+	stream.value(m_dB);
+	stream.value(m_dStart);
+}
+
+void Controller::seekEvents(const int time)
+{
+	const auto it = std::lower_bound(m_recordEvents.begin(), m_recordEvents.end(), time, [](const ControllerEvent& event, const int t) {
+		return event.time < t;
+	});
+	m_eventCursor = static_cast<size_t>(it - m_recordEvents.begin());
+}
+
 void Controller::record(int t)
 {
 	if (m_up > 0 && m_dUp == false) {
@@ -22,6 +22,7 @@ struct ControllerEvent {
 };
 
 struct FeInput;
+class StateStream;
 
 class Controller {
 public:
@@ -45,11 +46,17 @@ public:
 	void setState(const FeInput& input, int t);
 	void release();
 	void record(int t);
+	void syncState(StateStream& stream);
+
+	// Move the playback cursor to the first event at or after time
+	void seekEvents(int time);
 
 	RecordState m_state = RecordState::NOT_RECORDING;
-	std::vector<ControllerEvent> m_recordEvents;
+	std::vector<ControllerEvent> m_recordEvents; // Sorted by time
 
 private:
+	size_t m_eventCursor = 0; // Next event to play back
+
 	// Delayed checking
 	bool m_dUp = false;
 	bool m_dDown = false;
@@ -0,0 +1,88 @@
+#include "Easing.h"
+#include "global.h"
+
+#include <cmath>
+
+namespace ppvs {
+
+Easing easingFromName(const std::string& name)
+{
+	if (name == "linear")
+		return Easing::Linear;
+	if (name == "quadratic")
+		return Easing::Quadratic;
+	if (name == "squareroot")
+		return Easing::SquareRoot;
+	if (name == "cubic")
+		return Easing::Cubic;
+	if (name == "cuberoot")
+		return Easing::CubeRoot;
+	if (name == "exponential")
+		return Easing::Exponential;
+	if (name == "elastic")
+		return Easing::Elastic;
+	if (name == "sin")
+		return Easing::Sin;
+	if (name == "cos")
+		return Easing::Cos;
+	return Easing::None;
+}
+
+double interpolate(const Easing type, const double s, const double e, const double t, const double alpha, const double beta)
+{
+	switch (type) {
+	case Easing::Linear:
+		return (e - s) * t + s;
+	case Easing::Quadratic:
+		return (e - s) * t * t + s;
+	case Easing::SquareRoot:
+		return (e - s) * pow(t, 0.5) + s;
+	case Easing::Cubic:
+		return (e - s) * t * t * t + s;
+	case Easing::CubeRoot:
+		return (e - s) * pow(t, 1.0 / 3.0) + s;
+	case Easing::Exponential:
+		return (e - s) / (exp(alpha) - 1) * exp(alpha * t) + s - (e - s) / (exp(alpha) - 1);
+	case Easing::Elastic:
+		return (e - s) / (exp(alpha) - 1) * cos(beta * t * 2 * kPiD) * exp(alpha * t) + s - (e - s) / (exp(alpha) - 1);
+	case Easing::Sin:
+		return s + e * sin(alpha * t * 2 * kPiD);
+	case Easing::Cos:
+		return s + e * cos(alpha * t * 2 * kPiD);
+	case Easing::None:
+		break;
+	}
+	return 0;
+}
+
+EasingTable::EasingTable(const Easing type, const double startVal, const double endVal, const int frames, const double alpha, const double beta)
+	: m_type(type)
+	, m_startVal(startVal)
+	, m_endVal(endVal)
+	, m_alpha(alpha)
+	, m_beta(beta)
+	, m_frames(frames)
+{
+	if (frames < 0 || frames > kMaxFrames) {
+		return;
+	}
+	m_values.resize(frames + 1);
+	for (int i = 0; i <= frames; i++) {
+		m_values[i] = compute(i);
+	}
+}
+
+float EasingTable::at(const int frame) const
+{
+	if (frame >= 0 && static_cast<size_t>(frame) < m_values.size()) {
+		return m_values[frame];
+	}
+	return compute(frame);
+}
+
+float EasingTable::compute(const int frame) const
+{
+	return static_cast<float>(interpolate(m_type, m_startVal, m_endVal, frame * 1.0 / m_frames, m_alpha, m_beta));
+}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ppvs {
+
+// Curves of interpolate(). Animation scripts use the names in lowercase.
+enum class Easing : uint8_t {
+	None, // Always 0
+	Linear,
+	Quadratic,
+	SquareRoot,
+	Cubic,
+	CubeRoot,
+	Exponential, // alpha is the growth rate
+	Elastic, // alpha is the growth rate, beta the wave number
+	Sin, // startVal is the offset, endVal the amplitude, alpha the wave number
+	Cos,
+};
+
+// Curve with this name, None if there is none
+Easing easingFromName(const std::string& name);
+
+// Input t must go from 0 to 1
+double interpolate(Easing type, double startVal, double endVal, double t, double alpha = 1, double beta = 1);
+
+// A curve for something that moves one frame at a time: the value at frame n is the
+// one at t = n / frames. Frames 0 to frames are sampled up front, unless there are
+// too many of them, and others are computed when asked for.
+class EasingTable final {
+public:
+	static constexpr int kMaxFrames = 600;
+
+	EasingTable() = default;
+	EasingTable(Easing type, double startVal, double endVal, int frames, double alpha = 1, double beta = 1);
+
+	[[nodiscard]] float at(int frame) const;
+
+	[[nodiscard]] int frames() const { return m_frames; }
+
+private:
+	[[nodiscard]] float compute(int frame) const;
+
+	Easing m_type = Easing::None;
+	double m_startVal = 0., m_endVal = 0.;
+	double m_alpha = 1., m_beta = 1.;
+	int m_frames = 0;
+	std::vector<float> m_values;
+};
+
+}
@@ -1,4 +1,5 @@
 #include "FeverCounter.h"
+#include "StateStream.h"
 #include <cmath>
 
 namespace ppvs {
@@ -84,6 +85,18 @@ void FeverCounter::addTime(const int t)
 	}
 }
 
+void FeverCounter::syncState(StateStream& stream)
+{
+	stream.value(m_endless);
+	stream.value(m_seconds);
+	stream.value(m_maxSeconds);
+	stream.value(m_timer);
+	stream.value(m_updateTimer);
+	stream.value(m_count);
+	stream.value(m_realCount);
+	stream.value(m_visible);
+}
+
 void FeverCounter::update()
 {
 	// Update seconds
@@ -6,6 +6,8 @@
 
 namespace ppvs {
 
+class StateStream;
+
 class FeverCounter {
 public:
 	explicit FeverCounter(const GameData* gameData);
@@ -23,6 +25,7 @@ public:
 	void addTime(int t);
 	void setSeconds(const int t) { m_seconds = t; }
 	void update();
+	void syncState(StateStream& stream);
 	void setVisible(const bool b) { m_visible = b; }
 	void setPositionSeconds(PosVectorFloat pv);
 	[[nodiscard]] PosVectorFloat getPositionSeconds() const { return m_positionSeconds; }
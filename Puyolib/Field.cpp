@@ -2,6 +2,8 @@
 #include "../PVS_ENet/PVS_Client.h"
 #include "Game.h"
 #include "Player.h"
+#include "StateHash.h"
+#include "StateStream.h"
 #include <algorithm>
 #include <utility>
 #include <cmath>
@@ -10,21 +12,27 @@ using namespace std;
 
 namespace ppvs {
 
-Field::Field() = default;
+namespace {
+
+constexpr size_t kParticleCapacity = 2048;
+constexpr size_t kParticleThrowCapacity = 512;
+
+constexpr ParticleStyle kParticleStyle { 0.3f, 1.2f, -0.05f, 11.f, 10.f, kPuyoX, kPuyoY };
+constexpr ParticleStyle kParticleThrowStyle { 0.5f, 1.2f, 0.03f, kPuyoX / 2, kPuyoY / 2, kPuyoX, kPuyoY };
+
+}
+
+Field::Field()
+	: m_particles(kParticleStyle, kParticleCapacity)
+	, m_particlesThrow(kParticleThrowStyle, kParticleThrowCapacity)
+{
+}
 
 Field::~Field()
 {
-	// Destroy particles, throw puyo, destroying puyos
-	while (!m_particles.empty()) {
-		delete m_particles.back();
-		m_particles.pop_back();
-	}
-	while (!m_particlesThrow.empty()) {
-		delete m_particlesThrow.back();
-		m_particlesThrow.pop_back();
-	}
+	// Destroy destroying puyos
 	while (!m_deletedPuyo.empty()) {
-		delete m_deletedPuyo.back();
+		m_puyoPool.release(m_deletedPuyo.back());
 		m_deletedPuyo.pop_back();
 	}
 	if (m_fieldInit) {
@@ -68,38 +76,31 @@ void Field::init(const FieldProp properties, Player* pl)
 // Initializes both puyo array and puyo array copy
 void Field::createPuyoArray()
 {
-	m_fieldPuyoArray = new Puyo**[m_properties.gridX];
-	m_fieldPuyoArrayCopy = new Puyo**[m_properties.gridX];
-
-	for (int i = 0; i < m_properties.gridX; i++) {
-		m_fieldPuyoArray[i] = new Puyo*[m_properties.gridY];
-		m_fieldPuyoArrayCopy[i] = new Puyo*[m_properties.gridY];
-	}
-
 	// Initialize the puyo array with null
-	for (int i = 0; i < m_properties.gridX; i++) {
-		for (int j = 0; j < m_properties.gridY; j++) {
-			m_fieldPuyoArray[i][j] = nullptr;
-			m_fieldPuyoArrayCopy[i][j] = nullptr;
-		}
-	}
+	const size_t size = static_cast<size_t>(m_properties.gridX) * static_cast<size_t>(m_properties.gridY);
+	m_cells.assign(size, FieldCell());
+	m_puyos.assign(size, nullptr);
+	m_cellsCopy.assign(size, FieldCell());
+	m_puyosCopy.assign(size, nullptr);
 
 	m_fieldInit = true;
+	m_allDirty = true;
+	m_dirtyCells.clear();
+	m_version++;
 }
 
 // Delete all puyo in array or copy
 void Field::freePuyo(const bool copy)
 {
-	for (int i = 0; i < m_properties.gridX; i++) {
-		for (int j = 0; j < m_properties.gridY; j++) {
-			if (!copy) {
-				delete m_fieldPuyoArray[i][j];
-				m_fieldPuyoArray[i][j] = nullptr;
-			} else {
-				delete m_fieldPuyoArrayCopy[i][j];
-				m_fieldPuyoArrayCopy[i][j] = nullptr;
-			}
-		}
+	if (!copy) {
+		m_version++;
+	}
+	std::vector<Puyo*>& puyos = copy ? m_puyosCopy : m_puyos;
+	std::vector<FieldCell>& cells = copy ? m_cellsCopy : m_cells;
+	for (size_t i = 0; i < puyos.size(); i++) {
+		m_puyoPool.release(puyos[i]);
+		puyos[i] = nullptr;
+		cells[i] = FieldCell();
 	}
 	m_fieldInit = false;
 }
@@ -107,15 +108,36 @@ void Field::freePuyo(const bool copy)
 // Delete array and array copy
 void Field::freePuyoArray()
 {
-	for (int i = 0; i < m_properties.gridX; i++) {
-		delete[] m_fieldPuyoArray[i];
-		delete[] m_fieldPuyoArrayCopy[i];
-	}
-	delete[] m_fieldPuyoArray;
-	delete[] m_fieldPuyoArrayCopy;
+	m_cells.clear();
+	m_puyos.clear();
+	m_cellsCopy.clear();
+	m_puyosCopy.clear();
 	m_fieldInit = false;
 }
 
+// Put a puyo in a cell, the cell takes over its type and color
+void Field::setPuyo(const int x, const int y, Puyo* puyo)
+{
+	const int i = cellIndex(x, y);
+	m_puyos[i] = puyo;
+	m_cells[i] = FieldCell();
+	if (puyo) {
+		m_cells[i].type = static_cast<uint8_t>(puyo->getType());
+		m_cells[i].color = static_cast<int8_t>(puyo->getType() == COLORPUYO ? puyo->getColor() : -1);
+	}
+}
+
+// Move the contents of cell x,y to the empty cell x,toY
+void Field::moveCell(const int x, const int y, const int toY)
+{
+	const int from = cellIndex(x, y);
+	const int to = cellIndex(x, toY);
+	m_puyos[to] = m_puyos[from];
+	m_cells[to] = m_cells[from];
+	m_puyos[from] = nullptr;
+	m_cells[from] = FieldCell();
+}
+
 // Get screen coordinates of top, with an offset
 PosVectorFloat Field::getTopCoordinates(float offset) const
 {
@@ -189,16 +211,12 @@ bool Field::isEmpty(const int x, const int y) const
 		return false;
 	}
 
-	// Exception: the upper field stretches out to infinity
-	if (y > m_properties.gridY - 1 && x > 0 && x < m_properties.gridX - 1) {
-		return true;
-	}
-
-	if (m_fieldPuyoArray[x][y] == nullptr) {
-		return true;
+	// Exception: the upper field stretches out to infinity, except for the outer columns
+	if (y > m_properties.gridY - 1) {
+		return x > 0 && x < m_properties.gridX - 1;
 	}
 
-	return false;
+	return m_cells[cellIndex(x, y)].type == NOPUYO;
 }
 
 // Check if a puyo exist in this position
@@ -209,11 +227,7 @@ bool Field::isPuyo(const int x, const int y) const
 		return false;
 	}
 
-	if (m_fieldPuyoArray[x][y] == nullptr) {
-		return false;
-	}
-
-	return true;
+	return m_cells[cellIndex(x, y)].type != NOPUYO;
 }
 
 // Retrieves color from field (if puyo is a color puyo anyway)
@@ -224,16 +238,8 @@ int Field::getColor(const int x, const int y) const
 		return -1;
 	}
 
-	if (!isPuyo(x, y)) {
-		return -1;
-	}
-
-	if (m_fieldPuyoArray[x][y]->getType() != COLORPUYO) {
-		return -1;
-	}
-
-	// Ask the corresponding puyo what color it is
-	return m_fieldPuyoArray[x][y]->getColor();
+	// Only color puyo have a color in their cell
+	return m_cells[cellIndex(x, y)].color;
 }
 
 // This function creates a colored puyo on the field
@@ -254,11 +260,12 @@ bool Field::addColorPuyo(const int x, const int y, const int color, const int fa
 	const auto spriteYReal = static_cast<float>((m_properties.gridY - 3 - y - offset) * m_properties.gridHeight);
 
 	// Create a new puyo at x,y index
-	m_fieldPuyoArray[x][y] = new ColorPuyo(x, y, color, this, spriteXReal, spriteYReal, m_data);
+	setPuyo(x, y, m_puyoPool.acquire<ColorPuyo>(x, y, color, this, spriteXReal, spriteYReal));
+	markDirty(x, y);
 
 	// Set initial condition
-	m_fieldPuyoArray[x][y]->m_fallFlag = fallFlag;
-	m_fieldPuyoArray[x][y]->m_fallDelay = static_cast<float>(fallDelay);
+	puyoAt(x, y)->m_fallFlag = fallFlag;
+	puyoAt(x, y)->m_fallDelay = static_cast<float>(fallDelay);
 
 	return true;
 }
@@ -281,11 +288,12 @@ bool Field::addNuisancePuyo(const int x, const int y, const int fallFlag, const
 	const auto spriteYReal = static_cast<float>((m_properties.gridY - 3 - y - offset) * m_properties.gridHeight);
 
 	// Create a new puyo at x,y index
-	m_fieldPuyoArray[x][y] = new NuisancePuyo(x, y, 0, this, spriteXReal, spriteYReal, m_data);
+	setPuyo(x, y, m_puyoPool.acquire<NuisancePuyo>(x, y, 0, this, spriteXReal, spriteYReal));
+	markDirty(x, y);
 
 	// Set initial state
-	m_fieldPuyoArray[x][y]->m_fallFlag = fallFlag;
-	m_fieldPuyoArray[x][y]->m_fallDelay = static_cast<float>(fallDelay);
+	puyoAt(x, y)->m_fallFlag = fallFlag;
+	puyoAt(x, y)->m_fallDelay = static_cast<float>(fallDelay);
 
 	return true;
 }
@@ -308,7 +316,7 @@ int Field::dropSingle(const int x, const int y)
 		return -1; // Nothing to drop
 	}
 
-	if (!m_fieldPuyoArray[x][y]->m_droppable) {
+	if (!puyoAt(x, y)->m_droppable) {
 		return -1; // Cannot drop
 	}
 
@@ -339,9 +347,9 @@ int Field::dropSingle(const int x, const int y)
 	}
 
 	// Drop puyo down
-	m_fieldPuyoArray[x][emptyY] = m_fieldPuyoArray[x][y];
-	m_fieldPuyoArray[x][emptyY]->setPosY(emptyY);
-	m_fieldPuyoArray[x][y] = nullptr;
+	moveCell(x, y, emptyY);
+	puyoAt(x, emptyY)->setPosY(emptyY);
+	markDirty(x, emptyY);
 
 	return emptyY;
 }
@@ -349,30 +357,32 @@ int Field::dropSingle(const int x, const int y)
 // Get puyo at position
 Puyo* Field::get(const int x, const int y) const
 {
-	if (isEmpty(x, y)) {
+	if (!isPuyo(x, y)) {
 		return nullptr;
 	}
 
-	return m_fieldPuyoArray[x][y];
+	return puyoAt(x, y);
 }
 
 // Set puyo, returns true if success
-bool Field::set(int x, int y, Puyo* newPuyo) const
+bool Field::set(int x, int y, Puyo* newPuyo)
 {
 	// Invalid position
 	if (x >= m_properties.gridX || x < 0 || y >= m_properties.gridY || y < 0) {
 		return false;
 	}
 
-	m_fieldPuyoArray[x][y] = newPuyo;
+	setPuyo(x, y, newPuyo);
+	m_version++;
 
 	return true;
 }
 
-void Field::clearFieldVal(int x, int y) const
+void Field::clearFieldVal(int x, int y)
 {
 	if (isPuyo(x, y)) {
-		m_fieldPuyoArray[x][y] = nullptr;
+		setPuyo(x, y, nullptr);
+		m_version++;
 	}
 }
 
@@ -384,11 +394,7 @@ PuyoType Field::getPuyoType(int x, int y) const
 		return NOPUYO;
 	}
 
-	if (!isPuyo(x, y)) {
-		return NOPUYO;
-	}
-
-	return m_fieldPuyoArray[x][y]->getType();
+	return static_cast<PuyoType>(m_cells[cellIndex(x, y)].type);
 }
 
 // Connect to a neighboring puyo
@@ -400,7 +406,7 @@ void Field::setLink(const int x, const int y, const Direction dir) const
 	}
 
 	if (isPuyo(x, y)) {
-		m_fieldPuyoArray[x][y]->setLink(dir);
+		puyoAt(x, y)->setLink(dir);
 	}
 }
 
@@ -413,7 +419,7 @@ void Field::unsetLink(const int x, const int y, const Direction dir) const
 	}
 
 	if (isPuyo(x, y)) {
-		m_fieldPuyoArray[x][y]->unsetLink(dir);
+		puyoAt(x, y)->unsetLink(dir);
 	}
 }
 
@@ -425,13 +431,18 @@ bool Field::findConnected(int x, int y, int n, std::vector<PosVectorInt>& v)
 	pos.y = y;
 
 	// Initial check of first puyo
-	if (!isPuyo(pos.x, pos.y) || m_fieldPuyoArray[pos.x][pos.y]->getType() != COLORPUYO || m_fieldPuyoArray[pos.x][pos.y]->m_mark != false || m_fieldPuyoArray[pos.x][pos.y]->m_destroy != false) {
+	if (!isPuyo(pos.x, pos.y)) {
+		return false;
+	}
+	FieldCell& cell = m_cells[cellIndex(pos.x, pos.y)];
+	if (cell.type != COLORPUYO || cell.flags & (FieldCell::kMarked | FieldCell::kDestroy)) {
 		return false;
 	}
 
 	// Find connecting color puyo and fill vector v
 	int connected = 1;
-	m_fieldPuyoArray[pos.x][pos.y]->m_mark = true;
+	cell.flags |= FieldCell::kMarked;
+	m_marked.push_back(pos);
 	v.push_back(pos);
 	findConnectedLoop(pos, connected, v);
 
@@ -448,21 +459,89 @@ bool Field::findConnected(int x, int y, int n, std::vector<PosVectorInt>& v)
 }
 
 // Unmark all puyo in field
-void Field::unmark() const
+void Field::unmark()
 {
-	for (int i = 0; i < m_properties.gridX; i++) {
-		for (int j = 0; j < m_properties.gridY; j++) {
-			if (isPuyo(i, j)) {
-				m_fieldPuyoArray[i][j]->m_mark = false;
+	for (auto& cell : m_cells) {
+		cell.flags &= ~FieldCell::kMarked;
+	}
+	m_marked.clear();
+}
+
+// Unmark the puyos marked since the last call, cheaper than unmark() on a big field
+void Field::clearMarks()
+{
+	for (const auto& pos : m_marked) {
+		m_cells[cellIndex(pos.x, pos.y)].flags &= ~FieldCell::kMarked;
+	}
+	m_marked.clear();
+}
+
+// A puyo was put at x,y
+void Field::markDirty(const int x, const int y)
+{
+	m_version++;
+	if (m_allDirty) {
+		return;
+	}
+
+	// Searching the whole field is cheaper at this point
+	if (m_dirtyCells.size() >= static_cast<size_t>(m_properties.gridX * m_properties.gridY)) {
+		m_allDirty = true;
+		m_dirtyCells.clear();
+		return;
+	}
+	m_dirtyCells.push_back({ x, y });
+}
+
+// Cells from which to search for groups, in field order. Groups that have no puyo
+// that changed since the last chain search were already too small back then.
+void Field::getDirtySeeds(std::vector<PosVectorInt>& seeds) const
+{
+	seeds.clear();
+	if (m_allDirty) {
+		for (int i = 0; i < m_properties.gridX; i++) {
+			for (int j = 0; j < m_properties.gridY - 3; j++) {
+				seeds.emplace_back(i, j);
 			}
 		}
+		return;
+	}
+
+	for (const auto& pos : m_dirtyCells) {
+		if (pos.y < m_properties.gridY - 3) {
+			seeds.push_back(pos);
+		}
 	}
+	std::sort(seeds.begin(), seeds.end(), [](const PosVectorInt& a, const PosVectorInt& b) {
+		return a.x != b.x ? a.x < b.x : a.y < b.y;
+	});
+	seeds.erase(std::unique(seeds.begin(), seeds.end(), [](const PosVectorInt& a, const PosVectorInt& b) {
+		return a.x == b.x && a.y == b.y;
+	}), seeds.end());
+}
+
+// All puyos in groups of at least puyoToClear that contain a seed, in field order
+void Field::findPoppingPuyos(const std::vector<PosVectorInt>& seeds, const int puyoToClear, std::vector<PosVectorInt>& popping)
+{
+	popping.clear();
+	for (const auto& seed : seeds) {
+		if (findConnected(seed.x, seed.y, puyoToClear, m_vector)) {
+			popping.insert(popping.end(), m_vector.begin(), m_vector.end());
+			m_vector.clear();
+		}
+	}
+	clearMarks();
+
+	std::sort(popping.begin(), popping.end(), [](const PosVectorInt& a, const PosVectorInt& b) {
+		return a.x != b.x ? a.x < b.x : a.y < b.y;
+	});
 }
 
 // Recursive function that checks neighbors
 void Field::findConnectedLoop(const PosVectorInt pos, int& connected, std::vector<PosVectorInt>& v)
 {
-	m_fieldPuyoArray[pos.x][pos.y]->m_mark = true;
+	m_cells[cellIndex(pos.x, pos.y)].flags |= FieldCell::kMarked;
+	const int color = m_cells[cellIndex(pos.x, pos.y)].color;
 	PosVectorInt posCopy;
 	posCopy.x = pos.x;
 	posCopy.y = pos.y;
@@ -470,13 +549,16 @@ void Field::findConnectedLoop(const PosVectorInt pos, int& connected, std::vecto
 		{ 0, 1 }, { 1, 0 }, { 0, -1 }, { -1, 0 }
 	};
 	for (auto [hor, ver] : search) {
-		if (isPuyo(pos.x + hor, pos.y + ver) && m_fieldPuyoArray[pos.x + hor][pos.y + ver]->getType() == COLORPUYO
-			&& m_fieldPuyoArray[pos.x + hor][pos.y + ver]->m_mark == false
-			&& m_fieldPuyoArray[pos.x + hor][pos.y + ver]->getColor() == m_fieldPuyoArray[pos.x][pos.y]->getColor()
-			&& pos.y + ver != m_properties.gridY - 3) {
+		if (!isPuyo(pos.x + hor, pos.y + ver) || pos.y + ver == m_properties.gridY - 3) {
+			continue;
+		}
+		// Color puyo of the same color that wasn't visited yet
+		if (FieldCell& neighbor = m_cells[cellIndex(pos.x + hor, pos.y + ver)]; neighbor.type == COLORPUYO && !(neighbor.flags & FieldCell::kMarked) && neighbor.color == color) {
 			connected++;
 			posCopy.x = pos.x + hor; // Need a copy of pos to pass on
 			posCopy.y = pos.y + ver;
+			neighbor.flags |= FieldCell::kMarked;
+			m_marked.push_back(posCopy);
 			v.push_back(posCopy);
 			findConnectedLoop(posCopy, connected, v);
 		}
@@ -499,76 +581,126 @@ int Field::count() const
 	return n;
 }
 
-// Predict chain
-int Field::predictChain()
+// Copy field contents into a bitboard, returns false if the field can't be represented
+bool Field::getFieldState(FieldState& state) const
 {
-	// Copy original array into array copy
+	if (!FieldState::fits(m_properties.gridX, m_properties.gridY)) {
+		return false;
+	}
+
+	state.reset(m_properties.gridX, m_properties.gridY);
 	for (int i = 0; i < m_properties.gridX; i++) {
 		for (int j = 0; j < m_properties.gridY; j++) {
-			// Copy pointer
-			m_fieldPuyoArrayCopy[i][j] = m_fieldPuyoArray[i][j];
-			// Copy puyo
-			if (isPuyo(i, j)) {
-				m_fieldPuyoArray[i][j] = m_fieldPuyoArray[i][j]->clone();
+			if (!isPuyo(i, j)) {
+				continue;
+			}
+			const Puyo* puyo = puyoAt(i, j);
+			bool added = false;
+			switch (puyo->getType()) {
+			case COLORPUYO:
+				added = state.addColorPuyo(i, j, puyo->getColor());
+				break;
+			case NUISANCEPUYO:
+				added = state.addNuisancePuyo(i, j);
+				break;
+			case HARDPUYO:
+				added = state.addHardPuyo(i, j, static_cast<const HardPuyo*>(puyo)->m_vlife);
+				break;
+			default:
+				break;
+			}
+			if (!added) {
+				return false;
 			}
 		}
 	}
 
+	return true;
+}
+
+// Predict chain
+int Field::predictChain()
+{
+	const int puyoToClear = m_player->m_currentGame->m_currentRuleSet->m_puyoToClear;
+	if (FieldState state; getFieldState(state)) {
+		return state.predictChain(puyoToClear);
+	}
+
+	// Put the original cells aside and work on copies of the puyos
+	m_cellsCopy = m_cells;
+	m_puyosCopy = m_puyos;
+	for (size_t i = 0; i < m_puyos.size(); i++) {
+		if (m_puyos[i]) {
+			m_puyos[i] = m_puyoPool.clone(*m_puyos[i]);
+			m_cells[i].flags = 0;
+		}
+	}
+
+	// Only groups with a changed puyo can pop. drop() below adds the moved puyos to the
+	// dirty cells, the ones of the real field are put aside until the end.
+	std::vector<PosVectorInt> seeds;
+	getDirtySeeds(seeds);
+	std::vector<PosVectorInt> dirtyCells;
+	dirtyCells.swap(m_dirtyCells);
+	const bool allDirty = m_allDirty;
+	const uint64_t version = m_version;
+	m_allDirty = false;
+
 	// Find chain
 	bool foundChain; // Local variable
 	int chainN = 0;
 	do {
 		foundChain = false;
-		unmark();
-		// Loop through field to find connected puyo
-		for (int i = 0; i < m_properties.gridX; i++) {
-			for (int j = 0; j < m_properties.gridY - 3; j++) {
-				if (findConnected(i, j, m_player->m_currentGame->m_currentRuleSet->m_puyoToClear, m_vector)) {
-					foundChain = true;
-
-					// Loop through connected puyo
-					while (!m_vector.empty()) {
-						const PosVectorInt pv = m_vector.back();
-						m_vector.pop_back();
-
-						// Set popped group
-						// Check neighbors to find nuisance
-						if (isPuyo(pv.x, pv.y + 1) && pv.y + 1 != m_properties.gridY - 3)
-							m_fieldPuyoArray[pv.x][pv.y + 1]->neighborPop(this, true);
-						if (isPuyo(pv.x + 1, pv.y))
-							m_fieldPuyoArray[pv.x + 1][pv.y]->neighborPop(this, true);
-						if (isPuyo(pv.x, pv.y - 1))
-							m_fieldPuyoArray[pv.x][pv.y - 1]->neighborPop(this, true);
-						if (isPuyo(pv.x - 1, pv.y))
-							m_fieldPuyoArray[pv.x - 1][pv.y]->neighborPop(this, true);
-
-						// Delete puyo
-						delete m_fieldPuyoArray[pv.x][pv.y];
-						m_fieldPuyoArray[pv.x][pv.y] = nullptr;
-					}
+		// Loop through seeds to find connected puyo
+		for (const auto& seed : seeds) {
+			if (findConnected(seed.x, seed.y, puyoToClear, m_vector)) {
+				foundChain = true;
+
+				// Loop through connected puyo
+				while (!m_vector.empty()) {
+					const PosVectorInt pv = m_vector.back();
+					m_vector.pop_back();
+
+					// Set popped group
+					// Check neighbors to find nuisance
+					if (isPuyo(pv.x, pv.y + 1) && pv.y + 1 != m_properties.gridY - 3)
+						puyoAt(pv.x, pv.y + 1)->neighborPop(this, true);
+					if (isPuyo(pv.x + 1, pv.y))
+						puyoAt(pv.x + 1, pv.y)->neighborPop(this, true);
+					if (isPuyo(pv.x, pv.y - 1))
+						puyoAt(pv.x, pv.y - 1)->neighborPop(this, true);
+					if (isPuyo(pv.x - 1, pv.y))
+						puyoAt(pv.x - 1, pv.y)->neighborPop(this, true);
+
+					// Delete puyo
+					m_puyoPool.release(puyoAt(pv.x, pv.y));
+					setPuyo(pv.x, pv.y, nullptr);
 				}
 			}
 		}
+		clearMarks();
 
 		// Drop puyo and add to chain number
 		if (foundChain) {
 			chainN++;
 			drop();
+			getDirtySeeds(seeds);
+			m_dirtyCells.clear();
+			m_allDirty = false;
 		}
 	} while (foundChain);
 
+	m_dirtyCells.swap(dirtyCells);
+	m_allDirty = allDirty;
+
 	// Delete temporary puyos
 	freePuyo(false);
 	m_fieldInit = true;
 
 	// Restore original
-	for (int i = 0; i < m_properties.gridX; i++) {
-		for (int j = 0; j < m_properties.gridY; j++) {
-			// Copy pointer
-			m_fieldPuyoArray[i][j] = m_fieldPuyoArrayCopy[i][j];
-			m_fieldPuyoArrayCopy[i][j] = nullptr;
-		}
-	}
+	m_cells.swap(m_cellsCopy);
+	m_puyos.swap(m_puyosCopy);
+	m_version = version;
 
 	return chainN;
 }
@@ -577,22 +709,109 @@ int Field::predictChain()
 void Field::removePuyo(const int x, int y)
 {
 	if (isPuyo(x, y)) {
-		m_fieldPuyoArray[x][y]->m_destroy = true;
-		m_deletedPuyo.push_back(m_fieldPuyoArray[x][y]);
+		puyoAt(x, y)->m_destroy = true;
+		m_cells[cellIndex(x, y)].flags |= FieldCell::kDestroy;
+		m_deletedPuyo.push_back(puyoAt(x, y));
+		m_version++;
 	}
 }
 
 // Clean up field
-void Field::clearField() const
+void Field::clearField()
 {
+	m_version++;
 	for (int i = 0; i < m_properties.gridX; i++) {
 		for (int j = 0; j < m_properties.gridY; j++) {
 			if (!isEmpty(i, j)) {
-				delete m_fieldPuyoArray[i][j];
-				m_fieldPuyoArray[i][j] = nullptr;
+				m_puyoPool.release(puyoAt(i, j));
+				setPuyo(i, j, nullptr);
+			}
+		}
+	}
+}
+
+// Hash of the type and color of every cell and whether it is popping
+uint32_t Field::getContentHash() const
+{
+	StateHasher hasher;
+	for (const FieldCell& cell : m_cells) {
+		hasher.add(cell.type | static_cast<uint8_t>(cell.color) << 8 | (cell.flags & FieldCell::kDestroy) << 16);
+	}
+	return hasher.get();
+}
+
+// Create a puyo of some type for syncState, the rest of its state is read after this
+Puyo* Field::makePuyo(const PuyoType type, const int x, const int y, const int color)
+{
+	switch (type) {
+	case COLORPUYO:
+		return m_puyoPool.acquire<ColorPuyo>(x, y, color, this, 0, 0);
+	case NUISANCEPUYO:
+		return m_puyoPool.acquire<NuisancePuyo>(x, y, 0, this, 0, 0);
+	case HARDPUYO:
+		return m_puyoPool.acquire<HardPuyo>(x, y, 0, this, 0, 0);
+	default:
+		return nullptr;
+	}
+}
+
+// Puyos in the field and the ones still popping. Particles are left out.
+void Field::syncState(StateStream& stream)
+{
+	stream.value(m_visible);
+	stream.value(m_transformScale);
+	stream.value(m_sweepFall);
+
+	if (stream.isLoading()) {
+		clearField();
+		while (!m_deletedPuyo.empty()) {
+			m_puyoPool.release(m_deletedPuyo.back());
+			m_deletedPuyo.pop_back();
+		}
+		m_particles.clear();
+		m_particlesThrow.clear();
+		m_allDirty = true;
+		m_dirtyCells.clear();
+		m_glowInput.valid = false;
+	}
+
+	// Type and color first, they are needed to create the puyo
+	const auto syncPuyo = [&](Puyo*& puyo, const int x, const int y) {
+		uint8_t type = puyo ? static_cast<uint8_t>(puyo->getType()) : static_cast<uint8_t>(NOPUYO);
+		int color = puyo ? puyo->getColor() : 0;
+		stream.value(type);
+		if (type == NOPUYO) {
+			return;
+		}
+		stream.value(color);
+		if (stream.isLoading()) {
+			puyo = makePuyo(static_cast<PuyoType>(type), x, y, color);
+			if (!puyo) {
+				stream.fail();
+				return;
+			}
+		}
+		puyo->syncState(stream);
+	};
+	for (int i = 0; i < m_properties.gridX; i++) {
+		for (int j = 0; j < m_properties.gridY; j++) {
+			Puyo* puyo = puyoAt(i, j);
+			syncPuyo(puyo, i, j);
+			if (stream.isLoading() && puyo) {
+				setPuyo(i, j, puyo);
 			}
 		}
 	}
+
+	size_t popping = m_deletedPuyo.size();
+	stream.value(popping);
+	for (size_t i = 0; i < popping && !stream.failed(); i++) {
+		Puyo* puyo = stream.isLoading() ? nullptr : m_deletedPuyo[i];
+		syncPuyo(puyo, 0, 0);
+		if (stream.isLoading() && puyo) {
+			m_deletedPuyo.push_back(puyo);
+		}
+	}
 }
 
 //============================
@@ -623,7 +842,7 @@ void Field::drawField() const
 	for (int i = 0; i < m_properties.gridX; i++) {
 		for (int j = 0; j < m_properties.gridY; j++) {
 			if (isPuyo(i, j)) {
-				m_fieldPuyoArray[i][j]->draw(m_data->front);
+				puyoAt(i, j)->draw(m_data->front);
 			}
 		}
 	}
@@ -634,14 +853,10 @@ void Field::drawField() const
 	}
 
 	// Draw particles on the field
-	for (const auto particle : m_particles) {
-		particle->draw(m_data->front);
-	}
+	m_particles.draw(m_data->front, m_data->imgPuyo);
 
 	// Draw throwPuyo on the field
-	for (const auto particleThrow : m_particlesThrow) {
-		particleThrow->draw(m_data->front);
-	}
+	m_particlesThrow.draw(m_data->front, m_data->imgPuyo);
 }
 
 void Field::draw() const
@@ -661,10 +876,11 @@ void Field::createPuyo()
 	}
 
 	// Turn off glow
+	m_glowInput.valid = false;
 	for (int i = 0; i < m_properties.gridX; i++) {
 		for (int j = 0; j < m_properties.gridY; j++) {
 			if (isPuyo(i, j)) {
-				m_fieldPuyoArray[i][j]->m_glow = false;
+				puyoAt(i, j)->m_glow = false;
 			}
 		}
 	}
@@ -705,6 +921,7 @@ void Field::createPuyo()
 		// 4[pos x1]5[pos y1]6[pos x2]7[pos y2]8[pos x3]9[pos y3]10[pos x4]11[pos y4]
 		// 12[score val]13[drop bonus]14[margin time]15[divider]16[bonus EQ]
 		if (m_player->m_currentGame->m_connected && m_player->getPlayerType() == HUMAN) {
+			m_player->sendStateHash();
 			char str[200];
 			sprintf(str, "p|%i|%i|%i|%i|%i|%i|%i|%i|%i|%i|%i|%i|%i|%i|%i|%i",
 				color1, color2, colorBig,
@@ -729,6 +946,9 @@ void Field::createPuyo()
 		// Receive
 		if ((m_player->getPlayerType() == ONLINE || m_player->m_currentGame->m_settings->recording == RecordState::REPLAYING)
 			&& !m_player->m_messages.empty() && m_player->m_messages.front()[0] == 'p') {
+			if (m_player->getPlayerType() == ONLINE) {
+				m_player->checkPeerStateHash();
+			}
 			int bEq = 0;
 			int marginTime = 0;
 			sscanf(m_player->m_messages.front().c_str(), "p|%i|%i|%i|%i|%i|%i|%i|%i|%i|%i|%i|%i|%i|%i|%i|%i",
@@ -829,9 +1049,9 @@ void Field::searchFallDelay() const
 			}
 			// After empty space found
 			if (foundEmpty == true && isPuyo(i, j)) {
-				m_fieldPuyoArray[i][j]->m_fallDelay = static_cast<float>(countDelay);
-				m_fieldPuyoArray[i][j]->m_fallFlag = 1;
-				m_fieldPuyoArray[i][j]->setFallTarget(count);
+				puyoAt(i, j)->m_fallDelay = static_cast<float>(countDelay);
+				puyoAt(i, j)->m_fallFlag = 1;
+				puyoAt(i, j)->setFallTarget(count);
 				count++;
 				countDelay++;
 				if (getPuyoType(i, j) == COLORPUYO)
@@ -892,9 +1112,9 @@ void Field::dropPuyo()
 					unsetLink(i, newY, LEFT);
 					unsetLink(i, newY, RIGHT);
 				}
-				m_fieldPuyoArray[i][newY]->m_fallDelay = static_cast<float>(countDelay);
-				m_fieldPuyoArray[i][newY]->m_fallFlag = 1;
-				m_fieldPuyoArray[i][newY]->setFallTarget(newY);
+				puyoAt(i, newY)->m_fallDelay = static_cast<float>(countDelay);
+				puyoAt(i, newY)->m_fallFlag = 1;
+				puyoAt(i, newY)->setFallTarget(newY);
 				countDelay++;
 			}
 		}
@@ -918,55 +1138,55 @@ void Field::fallPuyo()
 	for (int i = 0; i < m_properties.gridX; i++) {
 		for (int j = 0; j < m_properties.gridY; j++) {
 			if (isPuyo(i, j)) {
-				if (m_fieldPuyoArray[i][j]->m_fallFlag == 1 && m_fieldPuyoArray[i][j]->m_fallDelay <= m_sweepFall) {
-					m_fieldPuyoArray[i][j]->m_fallFlag = 2;
-					m_fieldPuyoArray[i][j]->setAccelerationY(0);
+				if (puyoAt(i, j)->m_fallFlag == 1 && puyoAt(i, j)->m_fallDelay <= m_sweepFall) {
+					puyoAt(i, j)->m_fallFlag = 2;
+					puyoAt(i, j)->setAccelerationY(0);
 				}
 				// Set gravity
-				if (m_fieldPuyoArray[i][j]->m_fallFlag == 2)
-					m_fieldPuyoArray[i][j]->addAccelerationY(m_player->m_gravity);
+				if (puyoAt(i, j)->m_fallFlag == 2)
+					puyoAt(i, j)->addAccelerationY(m_player->m_gravity);
 				// If it's not a faller, mark the puyo for a bounce.
 				// Search for Puyos that need to bounce. Use flag 0 for this
-				if (m_fieldPuyoArray[i][j]->m_fallFlag == 0 && m_fieldPuyoArray[i][j]->m_bounceFlag0 == false) {
-					m_fieldPuyoArray[i][j]->setAccelerationY(0);
-					m_fieldPuyoArray[i][j]->m_bounceFlag = 1;
-					m_fieldPuyoArray[i][j]->m_bounceTimer = 2;
-					m_fieldPuyoArray[i][j]->m_bounceFlag0 = true;
-					searchBounce(i, j, m_fieldPuyoArray[i][j]->posY() + 1);
+				if (puyoAt(i, j)->m_fallFlag == 0 && puyoAt(i, j)->m_bounceFlag0 == false) {
+					puyoAt(i, j)->setAccelerationY(0);
+					puyoAt(i, j)->m_bounceFlag = 1;
+					puyoAt(i, j)->m_bounceTimer = 2;
+					puyoAt(i, j)->m_bounceFlag0 = true;
+					searchBounce(i, j, puyoAt(i, j)->posY() + 1);
 				}
 				// Sound & voice when dropping nuisance
 				// Non-nuisance puyo
-				if (m_fieldPuyoArray[i][j]->m_fallFlag != 0 && m_fieldPuyoArray[i][j]->spriteY() > m_fieldPuyoArray[i][j]->targetY()
-					&& m_fieldPuyoArray[i][j]->getType() != NUISANCEPUYO) {
+				if (puyoAt(i, j)->m_fallFlag != 0 && puyoAt(i, j)->spriteY() > puyoAt(i, j)->targetY()
+					&& puyoAt(i, j)->getType() != NUISANCEPUYO) {
 					m_data->snd.drop.play(m_data);
 				}
 				// Nuisance puyo: normal drop
-				if (m_fieldPuyoArray[i][j]->m_fallFlag != 0 && m_fieldPuyoArray[i][j]->spriteY() > m_fieldPuyoArray[i][j]->targetY()
-					&& m_fieldPuyoArray[i][j]->getType() == NUISANCEPUYO && m_player->m_currentPhase != Phase::FALLGARBAGE) {
+				if (puyoAt(i, j)->m_fallFlag != 0 && puyoAt(i, j)->spriteY() > puyoAt(i, j)->targetY()
+					&& puyoAt(i, j)->getType() == NUISANCEPUYO && m_player->m_currentPhase != Phase::FALLGARBAGE) {
 					m_data->snd.drop.play(m_data);
 				}
 				// Nuisance puyo: garbage drop
-				if (m_fieldPuyoArray[i][j]->m_fallFlag != 0 && m_fieldPuyoArray[i][j]->spriteY() > m_fieldPuyoArray[i][j]->targetY()
-					&& m_fieldPuyoArray[i][j]->getType() == NUISANCEPUYO && m_fieldPuyoArray[i][j]->m_lastNuisance && m_player->m_garbageDropped < 6) {
+				if (puyoAt(i, j)->m_fallFlag != 0 && puyoAt(i, j)->spriteY() > puyoAt(i, j)->targetY()
+					&& puyoAt(i, j)->getType() == NUISANCEPUYO && puyoAt(i, j)->m_lastNuisance && m_player->m_garbageDropped < 6) {
 					m_player->m_garbageDropped = 0;
-					m_fieldPuyoArray[i][j]->m_lastNuisance = false;
+					puyoAt(i, j)->m_lastNuisance = false;
 					m_data->snd.nuisanceS.play(m_data);
 				}
-				if (m_fieldPuyoArray[i][j]->m_fallFlag != 0 && m_fieldPuyoArray[i][j]->spriteY() > m_fieldPuyoArray[i][j]->targetY()
-					&& m_fieldPuyoArray[i][j]->getType() == NUISANCEPUYO && m_fieldPuyoArray[i][j]->m_lastNuisance && m_player->m_garbageDropped >= 6) {
+				if (puyoAt(i, j)->m_fallFlag != 0 && puyoAt(i, j)->spriteY() > puyoAt(i, j)->targetY()
+					&& puyoAt(i, j)->getType() == NUISANCEPUYO && puyoAt(i, j)->m_lastNuisance && m_player->m_garbageDropped >= 6) {
 					if (m_player->m_garbageDropped < 24)
 						m_player->m_characterVoices.damage1.play(m_data);
 					else
 						m_player->m_characterVoices.damage2.play(m_data);
 					m_player->m_garbageDropped = 0;
-					m_fieldPuyoArray[i][j]->m_lastNuisance = false;
+					puyoAt(i, j)->m_lastNuisance = false;
 					m_data->snd.nuisanceL.play(m_data);
 				}
 
 				// Land proper
-				if (m_fieldPuyoArray[i][j]->m_fallFlag == 2 && m_fieldPuyoArray[i][j]->spriteY() > m_fieldPuyoArray[i][j]->targetY()) {
-					m_fieldPuyoArray[i][j]->m_bounceFlag0 = false;
-					m_fieldPuyoArray[i][j]->landProper();
+				if (puyoAt(i, j)->m_fallFlag == 2 && puyoAt(i, j)->spriteY() > puyoAt(i, j)->targetY()) {
+					puyoAt(i, j)->m_bounceFlag0 = false;
+					puyoAt(i, j)->landProper();
 				}
 			}
 		}
@@ -981,22 +1201,22 @@ void Field::bouncePuyo() const
 		for (int j = 0; j < m_properties.gridY; j++) {
 			if (isPuyo(i, j)) {
 				// Bounce puyo
-				if (m_fieldPuyoArray[i][j]->m_fallFlag == 0) {
-					m_fieldPuyoArray[i][j]->bounce();
+				if (puyoAt(i, j)->m_fallFlag == 0) {
+					puyoAt(i, j)->bounce();
 				}
 				// End of bounce
-				if (m_fieldPuyoArray[i][j]->m_bounceTimer > static_cast<float>(m_player->m_puyoBounceEnd)) {
+				if (puyoAt(i, j)->m_bounceTimer > static_cast<float>(m_player->m_puyoBounceEnd)) {
 					// Search connect
-					if (m_fieldPuyoArray[i][j]->getType() == COLORPUYO) {
+					if (puyoAt(i, j)->getType() == COLORPUYO) {
 						searchLink(i, j);
 					}
-					m_fieldPuyoArray[i][j]->setScaleX(1);
-					m_fieldPuyoArray[i][j]->setScaleY(1);
-					m_fieldPuyoArray[i][j]->m_bounceY = 0;
-					if (m_fieldPuyoArray[i][j]->m_bounceFlag == 1) {
-						m_fieldPuyoArray[i][j]->m_bounceFlag = 0;
+					puyoAt(i, j)->setScaleX(1);
+					puyoAt(i, j)->setScaleY(1);
+					puyoAt(i, j)->m_bounceY = 0;
+					if (puyoAt(i, j)->m_bounceFlag == 1) {
+						puyoAt(i, j)->m_bounceFlag = 0;
 					}
-					m_fieldPuyoArray[i][j]->m_bounceTimer = 0;
+					puyoAt(i, j)->m_bounceTimer = 0;
 				}
 			}
 		}
@@ -1010,15 +1230,15 @@ void Field::searchBounce(const int x, const int y, const int posY) const
 	for (int i = 0; i < posY; i++) {
 		if (isPuyo(x, y - i)) {
 			// Stop loop
-			if (funFlag == 1 && m_fieldPuyoArray[x][y - i]->m_hard == true) {
+			if (funFlag == 1 && puyoAt(x, y - i)->m_hard == true) {
 				// Loop back up
 				for (int j = 0; j <= i; j++) {
-					m_fieldPuyoArray[x][y - i + j]->m_bottomY = y - i;
+					puyoAt(x, y - i + j)->m_bottomY = y - i;
 				}
 				break;
 			}
 			// Default value
-			m_fieldPuyoArray[x][y - i]->m_bottomY = 0;
+			puyoAt(x, y - i)->m_bottomY = 0;
 		}
 		if (funFlag == 1 && y - i < 0) {
 			funFlag = 0;
@@ -1027,11 +1247,11 @@ void Field::searchBounce(const int x, const int y, const int posY) const
 		// Search for disconnect
 		// The count is what determines how many puyos disconnect
 		if (funFlag == 1 && count < 5) {
-			if (isPuyo(x, y - i) && m_fieldPuyoArray[x][y - i]->m_fallFlag == 0) {
+			if (isPuyo(x, y - i) && puyoAt(x, y - i)->m_fallFlag == 0) {
 				unsetLinkAll(x, y - i);
 				// Set bounceMultiplier
-				m_fieldPuyoArray[x][y - i]->m_bounceMultiplier = 1.f / static_cast<float>(pow(2.f, count - 1));
-				m_fieldPuyoArray[x][y - i]->m_bounceTimer = 2.f;
+				puyoAt(x, y - i)->m_bounceMultiplier = 1.f / static_cast<float>(pow(2.f, count - 1));
+				puyoAt(x, y - i)->m_bounceTimer = 2.f;
 			}
 			count++;
 		}
@@ -1042,46 +1262,48 @@ void Field::searchBounce(const int x, const int y, const int posY) const
 void Field::searchLink(int x, int y) const
 {
 	// Check down
-	if (isPuyo(x, y - 1) && m_fieldPuyoArray[x][y - 1]->getType() == COLORPUYO && m_fieldPuyoArray[x][y - 1]->m_fallFlag == 0 && m_fieldPuyoArray[x][y - 1]->getColor() == m_fieldPuyoArray[x][y]->getColor() && y != m_properties.gridY - 3) {
+	if (isPuyo(x, y - 1) && puyoAt(x, y - 1)->getType() == COLORPUYO && puyoAt(x, y - 1)->m_fallFlag == 0 && puyoAt(x, y - 1)->getColor() == puyoAt(x, y)->getColor() && y != m_properties.gridY - 3) {
 		// Do not connect in the invisible layers
-		m_fieldPuyoArray[x][y - 1]->setLink(ABOVE);
-		m_fieldPuyoArray[x][y]->setLink(BELOW);
+		puyoAt(x, y - 1)->setLink(ABOVE);
+		puyoAt(x, y)->setLink(BELOW);
 	}
 	// Check up
-	if (isPuyo(x, y + 1) && m_fieldPuyoArray[x][y + 1]->getType() == COLORPUYO && m_fieldPuyoArray[x][y + 1]->m_fallFlag == 0 && m_fieldPuyoArray[x][y + 1]->getColor() == m_fieldPuyoArray[x][y]->getColor() && y != m_properties.gridY - 4) {
+	if (isPuyo(x, y + 1) && puyoAt(x, y + 1)->getType() == COLORPUYO && puyoAt(x, y + 1)->m_fallFlag == 0 && puyoAt(x, y + 1)->getColor() == puyoAt(x, y)->getColor() && y != m_properties.gridY - 4) {
 		// Do not connect in the invisible layers
-		m_fieldPuyoArray[x][y + 1]->setLink(BELOW);
-		m_fieldPuyoArray[x][y]->setLink(ABOVE);
+		puyoAt(x, y + 1)->setLink(BELOW);
+		puyoAt(x, y)->setLink(ABOVE);
 	}
 	// Check right
-	if (isPuyo(x + 1, y) && m_fieldPuyoArray[x + 1][y]->getType() == COLORPUYO && m_fieldPuyoArray[x + 1][y]->m_fallFlag == 0 && m_fieldPuyoArray[x + 1][y]->getColor() == m_fieldPuyoArray[x][y]->getColor()) {
-		m_fieldPuyoArray[x + 1][y]->setLink(LEFT);
-		m_fieldPuyoArray[x][y]->setLink(RIGHT);
+	if (isPuyo(x + 1, y) && puyoAt(x + 1, y)->getType() == COLORPUYO && puyoAt(x + 1, y)->m_fallFlag == 0 && puyoAt(x + 1, y)->getColor() == puyoAt(x, y)->getColor()) {
+		puyoAt(x + 1, y)->setLink(LEFT);
+		puyoAt(x, y)->setLink(RIGHT);
 	}
-	if (isPuyo(x + 1, y) && m_fieldPuyoArray[x + 1][y]->getType() == COLORPUYO && m_fieldPuyoArray[x + 1][y]->m_fallFlag != 0 && m_fieldPuyoArray[x + 1][y]->getColor() == m_fieldPuyoArray[x][y]->getColor()) {
-		m_fieldPuyoArray[x + 1][y]->unsetLink(LEFT);
-		m_fieldPuyoArray[x][y]->unsetLink(RIGHT);
+	if (isPuyo(x + 1, y) && puyoAt(x + 1, y)->getType() == COLORPUYO && puyoAt(x + 1, y)->m_fallFlag != 0 && puyoAt(x + 1, y)->getColor() == puyoAt(x, y)->getColor()) {
+		puyoAt(x + 1, y)->unsetLink(LEFT);
+		puyoAt(x, y)->unsetLink(RIGHT);
 	}
 	// Check left
-	if (isPuyo(x - 1, y) && m_fieldPuyoArray[x - 1][y]->getType() == COLORPUYO && m_fieldPuyoArray[x - 1][y]->m_fallFlag == 0 && m_fieldPuyoArray[x - 1][y]->getColor() == m_fieldPuyoArray[x][y]->getColor()) {
-		m_fieldPuyoArray[x - 1][y]->setLink(RIGHT);
-		m_fieldPuyoArray[x][y]->setLink(LEFT);
-	} else if (isPuyo(x - 1, y) && m_fieldPuyoArray[x - 1][y]->getType() == COLORPUYO && m_fieldPuyoArray[x - 1][y]->m_fallFlag != 0 && m_fieldPuyoArray[x - 1][y]->getColor() == m_fieldPuyoArray[x][y]->getColor()) {
-		m_fieldPuyoArray[x - 1][y]->unsetLink(RIGHT);
-		m_fieldPuyoArray[x][y]->unsetLink(LEFT);
+	if (isPuyo(x - 1, y) && puyoAt(x - 1, y)->getType() == COLORPUYO && puyoAt(x - 1, y)->m_fallFlag == 0 && puyoAt(x - 1, y)->getColor() == puyoAt(x, y)->getColor()) {
+		puyoAt(x - 1, y)->setLink(RIGHT);
+		puyoAt(x, y)->setLink(LEFT);
+	} else if (isPuyo(x - 1, y) && puyoAt(x - 1, y)->getType() == COLORPUYO && puyoAt(x - 1, y)->m_fallFlag != 0 && puyoAt(x - 1, y)->getColor() == puyoAt(x, y)->getColor()) {
+		puyoAt(x - 1, y)->unsetLink(RIGHT);
+		puyoAt(x, y)->unsetLink(LEFT);
 	}
 }
 
 // End of phase 20
-void Field::endFallPuyoPhase() const
+void Field::endFallPuyoPhase()
 {
+	m_glowInput.valid = false;
+
 	// Loop through puyos
 	for (int i = 0; i < m_properties.gridX; i++) {
 		for (int j = 0; j < m_properties.gridY; j++) {
 			if (isPuyo(i, j)) {
-				m_fieldPuyoArray[i][j]->m_glow = false;
+				puyoAt(i, j)->m_glow = false;
 				// Check if any is bouncing falling or destroying
-				if (m_fieldPuyoArray[i][j]->m_fallFlag != 0 || m_fieldPuyoArray[i][j]->m_bounceTimer != 0) // NOLINT(clang-diagnostic-float-equal)
+				if (puyoAt(i, j)->m_fallFlag != 0 || puyoAt(i, j)->m_bounceTimer != 0) // NOLINT(clang-diagnostic-float-equal)
 					return;
 			}
 		}
@@ -1103,23 +1325,45 @@ void Field::endFallPuyoPhase() const
 void Field::searchChain()
 {
 	// Destroy 14th and 15th row
+	m_version++;
 	for (int i = 0; i < m_properties.gridX; i++) {
 		if (isPuyo(i, m_properties.gridY - 1)) {
-			delete m_fieldPuyoArray[i][m_properties.gridY - 1];
-			m_fieldPuyoArray[i][m_properties.gridY - 1] = nullptr;
+			m_puyoPool.release(puyoAt(i, m_properties.gridY - 1));
+			setPuyo(i, m_properties.gridY - 1, nullptr);
 		}
 		if (isPuyo(i, m_properties.gridY - 2)) {
-			delete m_fieldPuyoArray[i][m_properties.gridY - 2];
-			m_fieldPuyoArray[i][m_properties.gridY - 2] = nullptr;
+			m_puyoPool.release(puyoAt(i, m_properties.gridY - 2));
+			setPuyo(i, m_properties.gridY - 2, nullptr);
 		}
 	}
 
+	const int puyoToClear = m_player->m_currentGame->m_currentRuleSet->m_puyoToClear;
+
 	// Predict chain
 	if (m_player->m_chain == 0) {
 		m_player->m_predictedChain = 0;
 		m_player->m_predictedChain = predictChain();
 	}
 
+	// Find popping puyos first, only these can start a group
+	std::vector<PosVectorInt> seeds;
+	std::vector<PosVectorInt> popping;
+	getDirtySeeds(seeds);
+	findPoppingPuyos(seeds, puyoToClear, popping);
+	if (debugMode == 1 && !m_allDirty) {
+		// Compare with a search of the whole field
+		std::vector<PosVectorInt> poppingAll;
+		m_allDirty = true;
+		getDirtySeeds(seeds);
+		findPoppingPuyos(seeds, puyoToClear, poppingAll);
+		if (poppingAll.size() != popping.size() || !std::equal(popping.begin(), popping.end(), poppingAll.begin(), [](const PosVectorInt& a, const PosVectorInt& b) { return a.x == b.x && a.y == b.y; })) {
+			debugString += "chain search mismatch\n";
+			popping.swap(poppingAll);
+		}
+	}
+	m_dirtyCells.clear();
+	m_allDirty = false;
+
 	// Reset chain values
 	m_player->m_foundChain = false;
 	m_player->m_puyosPopped = 0;
@@ -1134,88 +1378,86 @@ void Field::searchChain()
 	m_player->m_rememberMaxY = 0;
 	m_player->m_rememberX = 0;
 
-	unmark();
-
 	// Find chain
-	// Loop through field
-	for (int i = 0; i < m_properties.gridX; i++) {
-		for (int j = 0; j < m_properties.gridY - 3; j++) {
-			if (findConnected(i, j, m_player->m_currentGame->m_currentRuleSet->m_puyoToClear, m_vector)) {
-				m_player->m_foundChain = true;
-				m_player->m_poppedChain = true;
+	// Loop through popping puyos in field order
+	for (const auto& [i, j] : popping) {
+		if (findConnected(i, j, puyoToClear, m_vector)) {
+			m_player->m_foundChain = true;
+			m_player->m_poppedChain = true;
 
-				// Loop through connected puyo
-				while (!m_vector.empty()) {
-					const PosVectorInt pv = m_vector.back();
-					m_vector.pop_back();
+			// Loop through connected puyo
+			while (!m_vector.empty()) {
+				const PosVectorInt pv = m_vector.back();
+				m_vector.pop_back();
 
-					// Set popped group
-					if (m_fieldPuyoArray[pv.x][pv.y]->getType() == COLORPUYO) {
-						switch (m_fieldPuyoArray[pv.x][pv.y]->getColor()) {
-						default:
-							break;
-						case 0:
-							m_player->m_groupR = 1;
-							break;
-						case 1:
-							m_player->m_groupG = 1;
-							break;
-						case 2:
-							m_player->m_groupB = 1;
-							break;
-						case 3:
-							m_player->m_groupY = 1;
-							break;
-						case 4:
-							m_player->m_groupP = 1;
-							break;
-						}
+				// Set popped group
+				if (puyoAt(pv.x, pv.y)->getType() == COLORPUYO) {
+					switch (puyoAt(pv.x, pv.y)->getColor()) {
+					default:
+						break;
+					case 0:
+						m_player->m_groupR = 1;
+						break;
+					case 1:
+						m_player->m_groupG = 1;
+						break;
+					case 2:
+						m_player->m_groupB = 1;
+						break;
+					case 3:
+						m_player->m_groupY = 1;
+						break;
+					case 4:
+						m_player->m_groupP = 1;
+						break;
 					}
+				}
 
-					// Add to puyo count
-					m_player->m_puyosPopped++;
-
-					// Check neighbors to find nuisance
-					if (isPuyo(pv.x, pv.y + 1) && pv.y + 1 != m_properties.gridY - 3) {
-						m_fieldPuyoArray[pv.x][pv.y + 1]->neighborPop(this, false);
-					}
-					if (isPuyo(pv.x + 1, pv.y)) {
-						m_fieldPuyoArray[pv.x + 1][pv.y]->neighborPop(this, false);
-					}
-					if (isPuyo(pv.x, pv.y - 1)) {
-						m_fieldPuyoArray[pv.x][pv.y - 1]->neighborPop(this, false);
-					}
-					if (isPuyo(pv.x - 1, pv.y)) {
-						m_fieldPuyoArray[pv.x - 1][pv.y]->neighborPop(this, false);
-					}
+				// Add to puyo count
+				m_player->m_puyosPopped++;
 
-					// Check if highest puyo
-					if (pv.y > m_player->m_rememberMaxY) {
-						m_player->m_rememberMaxY = pv.y;
-						m_player->m_rememberX = pv.x;
-					}
+				// Check neighbors to find nuisance
+				if (isPuyo(pv.x, pv.y + 1) && pv.y + 1 != m_properties.gridY - 3) {
+					puyoAt(pv.x, pv.y + 1)->neighborPop(this, false);
+				}
+				if (isPuyo(pv.x + 1, pv.y)) {
+					puyoAt(pv.x + 1, pv.y)->neighborPop(this, false);
+				}
+				if (isPuyo(pv.x, pv.y - 1)) {
+					puyoAt(pv.x, pv.y - 1)->neighborPop(this, false);
+				}
+				if (isPuyo(pv.x - 1, pv.y)) {
+					puyoAt(pv.x - 1, pv.y)->neighborPop(this, false);
+				}
 
-					// Pop puyo
-					removePuyo(pv.x, pv.y);
-					m_fieldPuyoArray[pv.x][pv.y] = nullptr;
+				// Check if highest puyo
+				if (pv.y > m_player->m_rememberMaxY) {
+					m_player->m_rememberMaxY = pv.y;
+					m_player->m_rememberX = pv.x;
 				}
 
-				// Add popped puyos to score
-				m_player->m_point += m_player->m_puyosPopped * 10;
+				// Pop puyo
+				removePuyo(pv.x, pv.y);
+				setPuyo(pv.x, pv.y, nullptr);
+			}
+
+			// Add popped puyos to score
+			m_player->m_point += m_player->m_puyosPopped * 10;
 
-				// Add link bonus
-				m_player->m_linkBonus += m_player->m_currentGame->m_currentRuleSet->getLinkBonus(m_player->m_puyosPopped);
+			// Add link bonus
+			m_player->m_linkBonus += m_player->m_currentGame->m_currentRuleSet->getLinkBonus(m_player->m_puyosPopped);
 
-				// Reset popped puyos
-				m_player->m_puyosPopped = 0;
-			}
+			// Reset popped puyos
+			m_player->m_puyosPopped = 0;
 		}
 	}
+	clearMarks();
 
 	// Calculate score
 	// (point and link bonus are calculated during loop)
 	if (m_player->m_foundChain) {
 		m_player->m_chain++;
+		m_player->m_maxChain = max(m_player->m_maxChain, m_player->m_chain);
 	} else {
 		// No chain: remove any bonus EQ
 		m_player->m_bonusEq = false;
@@ -1277,7 +1519,7 @@ void Field::popPuyoAnim()
 
 		// Check if it should be deleted
 		if (m_deletedPuyo[i]->destroyPuyo()) {
-			delete m_deletedPuyo[i];
+			m_puyoPool.release(m_deletedPuyo[i]);
 			m_deletedPuyo.erase(std::remove(m_deletedPuyo.begin(), m_deletedPuyo.end(), m_deletedPuyo[i]), m_deletedPuyo.end());
 		}
 	}
@@ -1285,54 +1527,54 @@ void Field::popPuyoAnim()
 
 // Other objects
 
-// Create a particle at position
-void Field::createParticle(const float x, const float y, const int color)
+// Create particles at position
+void Field::createParticles(const float x, const float y, const int color, const int count)
 {
-	m_particles.push_back(new Particle(
-		x + static_cast<float>(getRandom(11)) - 5.f,
-		y - static_cast<float>(m_properties.gridHeight) / 2.f + static_cast<float>(getRandom(11)) - 5,
-		color,
-		m_data));
+	if (m_data->headless) {
+		return;
+	}
+	const auto subX = static_cast<float>(5 * kPuyoX + color * kPuyoX);
+	const auto subY = static_cast<float>(11 * kPuyoY);
+	for (int i = 0; i < count; i++) {
+		const float posX = x + static_cast<float>(getRandom(11)) - 5.f;
+		const float posY = y - static_cast<float>(m_properties.gridHeight) / 2.f + static_cast<float>(getRandom(11)) - 5;
+
+		// Random initial speed
+		const float speedX = static_cast<float>(getRandom(601) - 300) / 100.0f;
+		const float speedY = -6 + static_cast<float>(getRandom(333)) / 100.0f;
+		m_particles.emit(posX, posY, subX, subY, speedX, speedY);
+	}
 }
 
-// Create a particle at position
+// Create a thrown puyo at the position of a puyo
 void Field::createParticleThrow(Puyo* p)
 {
-	if (!p) {
+	if (!p || m_data->headless) {
 		return;
 	}
+	int color = 0;
 	if (p->getType() == COLORPUYO) {
-		m_particlesThrow.push_back(new ParticleThrow(p->spriteX(), p->spriteY() - static_cast<float>(m_properties.gridHeight) / 2.f, p->getColor(), m_data));
+		color = p->getColor();
 	} else if (p->getType() == NUISANCEPUYO) {
-		m_particlesThrow.push_back(new ParticleThrow(p->spriteX(), p->spriteY() - static_cast<float>(m_properties.gridHeight) / 2.f, 6, m_data));
+		color = 6;
+	} else {
+		return;
 	}
+	const auto subX = static_cast<float>(2 * kPuyoX * (color / 2));
+	const auto subY = static_cast<float>(12 * kPuyoY + kPuyoY * (color % 2));
+
+	// Random initial speed
+	const float speedX = static_cast<float>(getRandom(601) - 300) / 100.0f;
+	const float speedY = -6.f + static_cast<float>(getRandom(333)) / 100.0f;
+	const auto rotateSpeed = static_cast<float>((getRandom(21) - 10) * 2);
+	m_particlesThrow.emit(p->spriteX(), p->spriteY() - static_cast<float>(m_properties.gridHeight) / 2.f, subX, subY, speedX, speedY, rotateSpeed);
 }
 
 // Move the particles
 void Field::animateParticle()
 {
-	if (getParticleNumber() > 0) {
-		for (int i = 0; i < getParticleNumber(); i++) {
-			m_particles[i]->play();
-
-			// Check if it needs to be deleted
-			if (m_particles[i]->shouldDestroy()) {
-				delete m_particles[i];
-				m_particles.erase(std::remove(m_particles.begin(), m_particles.end(), m_particles[i]), m_particles.end());
-			}
-		}
-	}
-
-	// Same for thrown puyos
-	for (size_t i = 0; i < m_particlesThrow.size(); i++) {
-		m_particlesThrow[i]->play();
-
-		// Check if it needs to be deleted
-		if (m_particlesThrow[i]->shouldDestroy()) {
-			delete m_particlesThrow[i];
-			m_particlesThrow.erase(std::remove(m_particlesThrow.begin(), m_particlesThrow.end(), m_particlesThrow[i]), m_particlesThrow.end());
-		}
-	}
+	m_particles.update();
+	m_particlesThrow.update();
 }
 
 int Field::getParticleNumber() const
@@ -1342,6 +1584,22 @@ int Field::getParticleNumber() const
 
 void Field::triggerGlow(PosVectorInt shadowPos[4], const int n, int colors[4])
 {
+	// Nothing to do if neither the field nor the shadow changed since the last call
+	bool same = m_glowInput.valid && m_glowInput.version == m_version && m_glowInput.n == n;
+	for (int i = 0; i < n && same; i++) {
+		same = m_glowInput.shadowPos[i].x == shadowPos[i].x && m_glowInput.shadowPos[i].y == shadowPos[i].y && m_glowInput.colors[i] == colors[i];
+	}
+	if (same) {
+		return;
+	}
+	m_glowInput.valid = true;
+	m_glowInput.version = m_version;
+	m_glowInput.n = n;
+	for (int i = 0; i < n; i++) {
+		m_glowInput.shadowPos[i] = shadowPos[i];
+		m_glowInput.colors[i] = colors[i];
+	}
+
 	// Check empty
 	for (int i = 0; i < n; i++) {
 		// Placing on impossible spot
@@ -1356,7 +1614,48 @@ void Field::triggerGlow(PosVectorInt shadowPos[4], const int n, int colors[4])
 		}
 	}
 
+	const int puyoToClear = m_player->m_currentGame->m_currentRuleSet->m_puyoToClear;
+	if (FieldState state; getFieldState(state)) {
+		// Add the shadow puyos to a copy of the field
+		for (int i = 0; i < n; i++) {
+			if (!state.addColorPuyo(shadowPos[i].x, shadowPos[i].y, colors[i])) {
+				// Error
+				shadowPos[i].x = -1;
+				shadowPos[i].y = -1;
+				debugString += "error";
+			}
+		}
+
+		// Un-glow all
+		for (int i = 0; i < m_properties.gridX; i++) {
+			for (int j = 0; j < m_properties.gridY; j++) {
+				if (isPuyo(i, j)) {
+					puyoAt(i, j)->m_glow = false;
+				}
+			}
+		}
+
+		// Glow the field puyos connected to the shadow
+		for (int i = 0; i < n; i++) {
+			FieldState::Column group[FieldState::kMaxColumns];
+			if (shadowPos[i].x < 0 || state.floodGroup(shadowPos[i].x, shadowPos[i].y, group) < puyoToClear) {
+				continue;
+			}
+			for (int x = 0; x < m_properties.gridX; x++) {
+				for (int y = 0; group[x]; y++, group[x] >>= 1) {
+					if (group[x] & 1 && isPuyo(x, y)) {
+						puyoAt(x, y)->m_glow = true;
+					}
+				}
+			}
+		}
+		return;
+	}
+
 	// Temporarily add puyos at the shadow positions
+	const size_t dirtyCount = m_dirtyCells.size();
+	const bool allDirty = m_allDirty;
+	const uint64_t version = m_version;
 	for (int i = 0; i < n; i++) {
 		if (isEmpty(shadowPos[i].x, shadowPos[i].y)) {
 			addColorPuyo(shadowPos[i].x, shadowPos[i].y, colors[i]);
@@ -1368,39 +1667,46 @@ void Field::triggerGlow(PosVectorInt shadowPos[4], const int n, int colors[4])
 		}
 	}
 
-	// Check if puyos are connected at these positions
-	unmark();
-
 	// Un-glow all
 	for (int i = 0; i < m_properties.gridX; i++) {
 		for (int j = 0; j < m_properties.gridY; j++) {
 			if (isPuyo(i, j)) {
-				m_fieldPuyoArray[i][j]->m_glow = false;
+				puyoAt(i, j)->m_glow = false;
 			}
 		}
 	}
 	for (int i = 0; i < n; i++) {
-		if (findConnected(shadowPos[i].x, shadowPos[i].y, m_player->m_currentGame->m_currentRuleSet->m_puyoToClear, m_vector)) {
+		if (findConnected(shadowPos[i].x, shadowPos[i].y, puyoToClear, m_vector)) {
 			// Loop through connected puyo
 			while (!m_vector.empty()) {
 				const PosVectorInt pv = m_vector.back();
 				m_vector.pop_back();
 				// Set to glow
-				m_fieldPuyoArray[pv.x][pv.y]->m_glow = true;
+				puyoAt(pv.x, pv.y)->m_glow = true;
 			}
 		}
 	}
+	clearMarks();
 
 	// Remove temporary puyo
 	for (int i = 0; i < n; i++) {
 		if (shadowPos[i].x >= 0 && shadowPos[i].y >= 0) {
-			delete m_fieldPuyoArray[shadowPos[i].x][shadowPos[i].y];
-			m_fieldPuyoArray[shadowPos[i].x][shadowPos[i].y] = nullptr;
+			m_puyoPool.release(puyoAt(shadowPos[i].x, shadowPos[i].y));
+			setPuyo(shadowPos[i].x, shadowPos[i].y, nullptr);
 		}
 	}
+	if (!allDirty && !m_allDirty) {
+		m_dirtyCells.resize(dirtyCount);
+	}
+	m_version = version;
 }
+
 int Field::virtualChain(PosVectorInt shadowPos[4], int n, int colors[4])
 {
+	if (FieldState state; getFieldState(state)) {
+		return state.virtualChain(shadowPos, n, colors, m_player->m_currentGame->m_currentRuleSet->m_puyoToClear);
+	}
+
 	// Check empty
 	for (int i = 0; i < n; i++) {
 		if (!isEmpty(shadowPos[i].x, shadowPos[i].y)) {
@@ -1417,7 +1723,11 @@ int Field::virtualChain(PosVectorInt shadowPos[4], int n, int colors[4])
 		}
 	}
 
-	// Temporarily add puyos at the shadow positions
+	// Temporarily add puyos at the shadow positions, they become the dirty cells
+	// that predictChain searches from
+	const size_t dirtyCount = m_dirtyCells.size();
+	const bool allDirty = m_allDirty;
+	const uint64_t version = m_version;
 	for (int i = 0; i < n; i++) {
 		if (isEmpty(shadowPos[i].x, shadowPos[i].y)) {
 			addColorPuyo(shadowPos[i].x, shadowPos[i].y, colors[i]);
@@ -1428,17 +1738,18 @@ int Field::virtualChain(PosVectorInt shadowPos[4], int n, int colors[4])
 		}
 	}
 
-	// Check if puyos are connected at these positions
-	unmark();
-
 	// Predict chain
 	const int predictedChain = predictChain();
+	if (!allDirty && !m_allDirty) {
+		m_dirtyCells.resize(dirtyCount);
+	}
+	m_version = version;
 
 	// Remove temporary puyo
 	for (int i = 0; i < n; i++) {
 		if (shadowPos[i].x >= 0 && shadowPos[i].y >= 0) {
-			delete m_fieldPuyoArray[shadowPos[i].x][shadowPos[i].y];
-			m_fieldPuyoArray[shadowPos[i].x][shadowPos[i].y] = nullptr;
+			m_puyoPool.release(puyoAt(shadowPos[i].x, shadowPos[i].y));
+			setPuyo(shadowPos[i].x, shadowPos[i].y, nullptr);
 		}
 	}
 
@@ -1463,6 +1774,7 @@ void Field::dropGarbage(const bool automatic, const int dropAmount)
 		}
 
 		m_player->m_garbageDropped = min(dropN, 30);
+		m_player->m_garbageReceived += m_player->m_garbageDropped;
 
 		// Reset nuisance drop pattern (doesn't affect legacy)
 		m_player->resetNuisanceDropPattern();
@@ -1478,7 +1790,7 @@ void Field::dropGarbage(const bool automatic, const int dropAmount)
 				const int newY = dropSingle(x, y);
 
 				// Set fall target
-				m_fieldPuyoArray[x][newY]->setFallTarget(newY);
+				puyoAt(x, newY)->setFallTarget(newY);
 
 				// Remember last one dropped
 				lastX = x;
@@ -1491,7 +1803,7 @@ void Field::dropGarbage(const bool automatic, const int dropAmount)
 
 		// Mark if last nuisance for dropping sound
 		if (lastX != -1 && lastY != -1) {
-			m_fieldPuyoArray[lastX][lastY]->m_lastNuisance = true;
+			puyoAt(lastX, lastY)->m_lastNuisance = true;
 		}
 
 		// Remove from GQ
@@ -1542,10 +1854,10 @@ void Field::loseDrop() const
 		for (int j = 0; j < m_properties.gridY; j++) {
 			if (isPuyo(i, j)) {
 				unsetLinkAll(i, j);
-				if (m_fieldPuyoArray[i][j]->accelerationY() < 0.1f) {
-					m_fieldPuyoArray[i][j]->setAccelerationY(static_cast<float>(static_cast<int>(sqrt(i + 2.) * 12) % 10) / 2.0f);
+				if (puyoAt(i, j)->accelerationY() < 0.1f) {
+					puyoAt(i, j)->setAccelerationY(static_cast<float>(static_cast<int>(sqrt(i + 2.) * 12) % 10) / 2.0f);
 				}
-				m_fieldPuyoArray[i][j]->addAccelerationY(0.2f);
+				puyoAt(i, j)->addAccelerationY(0.2f);
 			}
 		}
 	}
@@ -1564,14 +1876,14 @@ void Field::dropField(const std::string& fieldString)
 				// Drop after creation
 				const int newY = dropSingle(x, y);
 				// Set fall target
-				m_fieldPuyoArray[x][newY]->setFallTarget(newY);
+				puyoAt(x, newY)->setFallTarget(newY);
 			}
 		} else if (toInt(str) == 6) {
 			if (addNuisancePuyo(x, y, 1, static_cast<int>(i / m_properties.gridX))) {
 				// Drop after creation
 				const int newY = dropSingle(x, y);
 				// Set fall target
-				m_fieldPuyoArray[x][newY]->setFallTarget(newY);
+				puyoAt(x, newY)->setFallTarget(newY);
 			}
 		}
 	}
@@ -1597,14 +1909,14 @@ void Field::setFieldFromString(const std::string& fieldString)
 				// Drop after creation
 				const int newY = dropSingle(x, y);
 				// Set fall target
-				m_fieldPuyoArray[x][newY]->setFallTarget(newY);
+				puyoAt(x, newY)->setFallTarget(newY);
 			}
 		} else if (toInt(str) == 6) {
 			if (addNuisancePuyo(x, y, 1)) {
 				// Drop after creation
 				const int newY = dropSingle(x, y);
 				// Set fall target
-				m_fieldPuyoArray[x][newY]->setFallTarget(newY);
+				puyoAt(x, newY)->setFallTarget(newY);
 			}
 		}
 	}
@@ -1617,9 +1929,9 @@ std::string Field::getFieldString() const
 	for (int j = 0; j < m_properties.gridY; j++) {
 		for (int i = 0; i < m_properties.gridX; i++) {
 			if (isPuyo(i, j)) {
-				if (m_fieldPuyoArray[i][j]->getType() == COLORPUYO)
-					out += toString(m_fieldPuyoArray[i][j]->getColor() + 1);
-				else if (m_fieldPuyoArray[i][j]->getType() == NUISANCEPUYO)
+				if (puyoAt(i, j)->getType() == COLORPUYO)
+					out += toString(puyoAt(i, j)->getColor() + 1);
+				else if (puyoAt(i, j)->getType() == NUISANCEPUYO)
 					out += "6";
 			} else {
 				out += "0";
@@ -1641,15 +1953,16 @@ std::string Field::getFieldString() const
 // Destroys entire field and shows an animation of "throwing away" puyo
 void Field::throwAwayField()
 {
+	m_version++;
 	for (int i = 0; i < m_properties.gridX; i++) {
 		for (int j = 0; j < m_properties.gridY; j++) {
 			if (isPuyo(i, j)) {
 				// Create new throw puyo
-				createParticleThrow(m_fieldPuyoArray[i][j]);
+				createParticleThrow(puyoAt(i, j));
 
 				// Delete puyo
-				delete m_fieldPuyoArray[i][j];
-				m_fieldPuyoArray[i][j] = nullptr;
+				m_puyoPool.release(puyoAt(i, j));
+				setPuyo(i, j, nullptr);
 			}
 		}
 	}
@@ -1,15 +1,31 @@
 #pragma once
 
 #include "FieldProp.h"
+#include "FieldState.h"
 #include "OtherObjects.h"
+#include "ParticleBuffer.h"
 #include "Puyo.h"
+#include "PuyoPool.h"
 #include "global.h"
+#include <cstdint>
 #include <vector>
 
 namespace ppvs {
 
 class Game;
 class Player;
+class StateStream;
+
+// Gameplay data of a field cell. The Puyo that draws the cell is kept at the same
+// index of a parallel array, so chain logic doesn't have to touch Puyo objects.
+struct FieldCell {
+	static constexpr uint8_t kMarked = 1; // Visited by findConnected
+	static constexpr uint8_t kDestroy = 2; // Popped this turn
+
+	uint8_t type = NOPUYO; // PuyoType
+	int8_t color = -1;
+	uint8_t flags = 0;
+};
 
 class Field {
 public:
@@ -45,18 +61,26 @@ public:
 	void drop();
 	int dropSingle(int x, int y);
 	[[nodiscard]] Puyo* get(int x, int y) const;
-	bool set(int x, int y, Puyo*) const;
-	void clearFieldVal(int x, int y) const;
+	bool set(int x, int y, Puyo*);
+	void clearFieldVal(int x, int y);
 	[[nodiscard]] PuyoType getPuyoType(int x, int y) const;
 	void setLink(int x, int y, Direction dir) const;
 	void unsetLink(int x, int y, Direction dir) const;
 	bool findConnected(int x, int y, int n, std::vector<PosVectorInt>& v);
-	void unmark() const;
+	void unmark();
 	void findConnectedLoop(PosVectorInt pos, int& connected, std::vector<PosVectorInt>& v);
+	void clearMarks();
+	void getDirtySeeds(std::vector<PosVectorInt>& seeds) const;
 	[[nodiscard]] int count() const;
+	bool getFieldState(FieldState& state) const;
 	int predictChain();
 	void removePuyo(int x, int y);
-	void clearField() const;
+	void releasePuyo(Puyo* puyo) { m_puyoPool.release(puyo); } // Puyos of this field go back to its pool
+	[[nodiscard]] const PuyoPool::Stats& getPuyoPoolStats() const { return m_puyoPool.stats(); }
+	void clearField();
+	[[nodiscard]] uint64_t getVersion() const { return m_version; } // Changes whenever a puyo is added, moved or removed
+	[[nodiscard]] uint32_t getContentHash() const;
+	void syncState(StateStream& stream);
 
 	// Sprite related functions
 	void setVisible(bool);
@@ -72,7 +96,7 @@ public:
 	void bouncePuyo() const;
 	void searchBounce(int x, int y, int posY) const;
 	void searchLink(int x, int y) const;
-	void endFallPuyoPhase() const;
+	void endFallPuyoPhase();
 	void searchChain(); // Phase 30
 	void popPuyoAnim(); // Phase 32
 	void dropGarbage(bool automatic = true, int dropAmount = 0); // Phase 41
@@ -83,7 +107,7 @@ public:
 	void throwAwayField();
 
 	// Other objects
-	void createParticle(float x, float y, int color);
+	void createParticles(float x, float y, int color, int count);
 	void createParticleThrow(Puyo* p);
 	void animateParticle();
 	[[nodiscard]] int getParticleNumber() const;
@@ -94,18 +118,29 @@ public:
 
 private:
 	void createPuyoArray();
+	Puyo* makePuyo(PuyoType type, int x, int y, int color);
 	void freePuyo(bool copy);
 	void freePuyoArray();
-
+	[[nodiscard]] int cellIndex(const int x, const int y) const { return x * m_properties.gridY + y; }
+	[[nodiscard]] Puyo* puyoAt(const int x, const int y) const { return m_puyos[cellIndex(x, y)]; }
+	void setPuyo(int x, int y, Puyo* puyo);
+	void moveCell(int x, int y, int toY);
+	void markDirty(int x, int y);
+	void findPoppingPuyos(const std::vector<PosVectorInt>& seeds, int puyoToClear, std::vector<PosVectorInt>& popping);
+
+	PuyoPool m_puyoPool; // Every puyo of the field, including the copies made for predictions
 	bool m_fieldInit = false;
-	std::vector<Particle*> m_particles;
-	std::vector<ParticleThrow*> m_particlesThrow;
+	ParticleBuffer m_particles; // Spit out by popping puyos
+	ParticleBuffer m_particlesThrow; // Puyos thrown out of the field of a loser
 	std::vector<Puyo*> m_deletedPuyo;
 	Player* m_player = nullptr;
 	FieldProp m_properties {};
 	float m_centerX = 0.f, m_centerY = 0.f;
-	Puyo*** m_fieldPuyoArray = nullptr;
-	Puyo*** m_fieldPuyoArrayCopy = nullptr; // Useful for predicting chain
+	// Column major, see cellIndex. Columns are what drops and chain searches walk along.
+	std::vector<FieldCell> m_cells;
+	std::vector<Puyo*> m_puyos;
+	std::vector<FieldCell> m_cellsCopy; // Useful for predicting chain (only if FieldState can't hold the field)
+	std::vector<Puyo*> m_puyosCopy;
 
 	// Sprite related values
 	Sprite m_fieldSpriteFinal; // Drawn onto screen
@@ -116,6 +151,20 @@ private:
 	// Game-play related values
 	float m_sweepFall = 0.f;
 	std::vector<PosVectorInt> m_vector;
+	std::vector<PosVectorInt> m_marked; // Puyos marked by findConnected
+	std::vector<PosVectorInt> m_dirtyCells; // Cells that got a puyo since the last chain search
+	bool m_allDirty = true; // Search the whole field next time
+	uint64_t m_version = 0;
+
+	// Input of the last triggerGlow, the glow stays the same while it doesn't change
+	struct GlowInput {
+		bool valid = false;
+		uint64_t version = 0;
+		int n = 0;
+		PosVectorInt shadowPos[4];
+		int colors[4] {};
+	};
+	GlowInput m_glowInput;
 };
 
 }
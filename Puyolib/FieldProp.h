@@ -21,11 +21,11 @@ struct Pair {
 	{
 	}
 
-	Pair<T> operator+(const Pair<T>& p1)
+	Pair<T> operator+(const Pair<T>& p1) const
 	{
 		return Pair<T>(this->x + p1.x, this->y + p1.y);
 	}
-	Pair<T> operator-(const Pair<T>& p1)
+	Pair<T> operator-(const Pair<T>& p1) const
 	{
 		return Pair<T>(this->x - p1.x, this->y - p1.y);
 	}
@@ -0,0 +1,511 @@
+#include "FieldState.h"
+#include "ChainTable.h"
+#include "GroupSearch.h"
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace ppvs {
+
+namespace {
+
+using Column = FieldState::Column;
+
+int bitCount(const Column v)
+{
+#if defined(_MSC_VER)
+	return static_cast<int>(__popcnt(v));
+#else
+	return __builtin_popcount(v);
+#endif
+}
+
+// Packs the bits of value selected by mask into the lowest bits
+Column compress(Column value, Column mask)
+{
+	Column out = 0;
+	int bit = 0;
+	while (mask) {
+		if (value & mask & (~mask + 1)) {
+			out |= Column(1) << bit;
+		}
+		bit++;
+		mask &= mask - 1;
+	}
+	return out;
+}
+
+// Grow group inside allowed cells until it stops changing, returns size of group
+int expandGroup(Column group[], const Column allowed[], const int width, int lo, int hi)
+{
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (int i = std::max(lo - 1, 0); i <= std::min(hi + 1, width - 1); i++) {
+			Column grown = group[i] | group[i] << 1 | group[i] >> 1;
+			if (i > 0) {
+				grown |= group[i - 1];
+			}
+			if (i < width - 1) {
+				grown |= group[i + 1];
+			}
+			grown &= allowed[i];
+			if (grown != group[i]) {
+				group[i] = grown;
+				lo = std::min(lo, i);
+				hi = std::max(hi, i);
+				changed = true;
+			}
+		}
+	}
+
+	int size = 0;
+	for (int i = lo; i <= hi; i++) {
+		size += bitCount(group[i]);
+	}
+	return size;
+}
+
+uint64_t splitMix64(uint64_t& state)
+{
+	uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+int lowestBit(const Column v)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, v);
+	return static_cast<int>(index);
+#else
+	return __builtin_ctz(v);
+#endif
+}
+
+// Lookup key of a chain result, includes the rules that decide the outcome
+uint64_t chainKey(const uint64_t hash, const int width, const int height, const int puyoToClear)
+{
+	uint64_t seed = static_cast<uint64_t>(puyoToClear) << 16 | static_cast<uint64_t>(width) << 8 | static_cast<uint64_t>(height);
+	return hash ^ splitMix64(seed);
+}
+
+}
+
+FieldState::FieldState(const int width, const int height)
+{
+	reset(width, height);
+}
+
+bool FieldState::fits(const int width, const int height)
+{
+	return width > 0 && width <= kMaxColumns && height > 3 && height <= kMaxRows;
+}
+
+void FieldState::reset(const int width, const int height)
+{
+	m_width = std::clamp(width, 0, kMaxColumns);
+	m_height = std::clamp(height, 0, kMaxRows);
+	clear();
+}
+
+void FieldState::clear()
+{
+	m_hash = 0;
+	m_hashValid = true;
+	for (auto& color : m_color) {
+		std::fill(std::begin(color), std::end(color), 0);
+	}
+	std::fill(std::begin(m_nuisance), std::end(m_nuisance), 0);
+	std::fill(std::begin(m_hard), std::end(m_hard), 0);
+	std::fill(std::begin(m_hardCracked), std::end(m_hardCracked), 0);
+}
+
+bool FieldState::isEmpty(const int x, const int y) const
+{
+	// Special case: uninitialized position -> just say it's empty
+	if (x < -2 && y < -2) {
+		return true;
+	}
+
+	// Outside the field is regarded as nonempty
+	if (x > m_width - 1 || x < 0 || y < 0) {
+		return false;
+	}
+
+	// Exception: the upper field stretches out to infinity
+	if (y > m_height - 1) {
+		return x > 0 && x < m_width - 1;
+	}
+
+	return !(occupied(x) & Column(1) << y);
+}
+
+bool FieldState::isPuyo(const int x, const int y) const
+{
+	if (x > m_width - 1 || x < 0 || y > m_height - 1 || y < 0) {
+		return false;
+	}
+
+	return occupied(x) & Column(1) << y;
+}
+
+int FieldState::getColor(const int x, const int y) const
+{
+	if (x > m_width - 1 || x < 0 || y > m_height - 1 || y < 0) {
+		return -1;
+	}
+
+	for (int color = 0; color < kMaxColors; color++) {
+		if (m_color[color][x] & Column(1) << y) {
+			return color;
+		}
+	}
+	return -1;
+}
+
+PuyoType FieldState::getPuyoType(const int x, const int y) const
+{
+	if (getColor(x, y) >= 0) {
+		return COLORPUYO;
+	}
+	if (!isPuyo(x, y)) {
+		return NOPUYO;
+	}
+	return m_nuisance[x] & Column(1) << y ? NUISANCEPUYO : HARDPUYO;
+}
+
+bool FieldState::addColorPuyo(const int x, const int y, const int color)
+{
+	if (x >= m_width || x < 0 || y >= m_height || y < 0 || color < 0 || color >= kMaxColors) {
+		return false;
+	}
+	if (isPuyo(x, y)) {
+		return false;
+	}
+
+	m_color[color][x] |= Column(1) << y;
+	m_hash ^= puyoKey(color, x, y);
+	return true;
+}
+
+bool FieldState::addNuisancePuyo(const int x, const int y)
+{
+	if (x >= m_width || x < 0 || y >= m_height || y < 0) {
+		return false;
+	}
+	if (isPuyo(x, y)) {
+		return false;
+	}
+
+	m_nuisance[x] |= Column(1) << y;
+	m_hash ^= puyoKey(kNuisanceKind, x, y);
+	return true;
+}
+
+// Hard puyo can take two hits, any life above that is treated as 2
+bool FieldState::addHardPuyo(const int x, const int y, const int life)
+{
+	if (x >= m_width || x < 0 || y >= m_height || y < 0 || life <= 0) {
+		return false;
+	}
+	if (isPuyo(x, y)) {
+		return false;
+	}
+
+	m_hard[x] |= Column(1) << y;
+	m_hash ^= puyoKey(kHardKind, x, y);
+	if (life == 1) {
+		m_hardCracked[x] |= Column(1) << y;
+		m_hash ^= puyoKey(kHardCrackedKind, x, y);
+	}
+	return true;
+}
+
+void FieldState::removePuyo(const int x, const int y)
+{
+	if (x >= m_width || x < 0 || y >= m_height || y < 0) {
+		return;
+	}
+
+	const Column bit = Column(1) << y;
+	for (int color = 0; color < kMaxColors; color++) {
+		if (m_color[color][x] & bit) {
+			m_hash ^= puyoKey(color, x, y);
+		}
+	}
+	if (m_nuisance[x] & bit) {
+		m_hash ^= puyoKey(kNuisanceKind, x, y);
+	}
+	if (m_hard[x] & bit) {
+		m_hash ^= puyoKey(kHardKind, x, y);
+	}
+	if (m_hardCracked[x] & bit) {
+		m_hash ^= puyoKey(kHardCrackedKind, x, y);
+	}
+
+	for (auto& color : m_color) {
+		color[x] &= ~bit;
+	}
+	m_nuisance[x] &= ~bit;
+	m_hard[x] &= ~bit;
+	m_hardCracked[x] &= ~bit;
+}
+
+int FieldState::count() const
+{
+	int n = 0;
+	for (int i = 0; i < m_width; i++) {
+		n += bitCount(occupied(i));
+	}
+	return n;
+}
+
+FieldState::Column FieldState::occupied(const int x) const
+{
+	Column occupied = m_nuisance[x] | m_hard[x];
+	for (const auto& color : m_color) {
+		occupied |= color[x];
+	}
+	return occupied;
+}
+
+// Rows in which groups can pop (everything below the hidden row)
+FieldState::Column FieldState::visibleRows() const
+{
+	return (Column(1) << (m_height - 3)) - 1;
+}
+
+// Random key for every kind of puyo on every cell
+uint64_t FieldState::puyoKey(const int kind, const int x, const int y)
+{
+	static const auto* keys = [] {
+		static uint64_t table[kNumKinds][kMaxColumns][kMaxRows];
+		uint64_t seed = 0x5059564Full;
+		for (auto& kindKeys : table) {
+			for (auto& column : kindKeys) {
+				for (auto& key : column) {
+					key = splitMix64(seed);
+				}
+			}
+		}
+		return &table;
+	}();
+	return (*keys)[kind][x][y];
+}
+
+uint64_t FieldState::computeHash() const
+{
+	uint64_t hash = 0;
+	const auto addColumn = [&hash](const int kind, const int x, Column column) {
+		for (; column; column &= column - 1) {
+			hash ^= puyoKey(kind, x, lowestBit(column));
+		}
+	};
+	for (int i = 0; i < m_width; i++) {
+		for (int color = 0; color < kMaxColors; color++) {
+			addColumn(color, i, m_color[color][i]);
+		}
+		addColumn(kNuisanceKind, i, m_nuisance[i]);
+		addColumn(kHardKind, i, m_hard[i]);
+		addColumn(kHardCrackedKind, i, m_hardCracked[i]);
+	}
+	return hash;
+}
+
+uint64_t FieldState::hash() const
+{
+	return m_hashValid ? m_hash : computeHash();
+}
+
+void FieldState::rehash()
+{
+	m_hash = computeHash();
+	m_hashValid = true;
+}
+
+// Hash of the state after place(), without copying it
+uint64_t FieldState::placedHash(const PosVectorInt shadowPos[4], const int n, const int colors[4]) const
+{
+	uint64_t hash = this->hash();
+	for (int i = 0; i < n; i++) {
+		const int x = shadowPos[i].x, y = shadowPos[i].y;
+		if (x >= 0 && x < m_width && y >= 0 && y < m_height && colors[i] >= 0 && colors[i] < kMaxColors) {
+			hash ^= puyoKey(colors[i], x, y);
+		}
+	}
+	return hash;
+}
+
+// Drop all puyos down
+void FieldState::drop()
+{
+	m_hashValid = false;
+	for (int i = 0; i < m_width; i++) {
+		const Column occupied = this->occupied(i);
+
+		// Column has no gaps
+		if ((occupied & (occupied + 1)) == 0) {
+			continue;
+		}
+
+		for (auto& color : m_color) {
+			if (color[i]) {
+				color[i] = compress(color[i], occupied);
+			}
+		}
+		if (m_nuisance[i]) {
+			m_nuisance[i] = compress(m_nuisance[i], occupied);
+		}
+		if (m_hard[i]) {
+			m_hard[i] = compress(m_hard[i], occupied);
+			m_hardCracked[i] = compress(m_hardCracked[i], occupied);
+		}
+	}
+}
+
+// Find all color groups of at least puyoToClear puyos below the hidden row.
+// Adds the groups to popped and returns the number of puyos in them.
+int FieldState::findPoppingPuyos(const int puyoToClear, Column popped[kMaxColumns]) const
+{
+	return findPoppingGroups(m_color, kMaxColors, m_width, visibleRows(), puyoToClear, popped);
+}
+
+// Find the group connected to the color puyo at x,y and return its size.
+// Like Field::findConnected, the search never steps into the hidden row.
+int FieldState::floodGroup(const int x, const int y, Column group[kMaxColumns]) const
+{
+	std::fill(group, group + kMaxColumns, 0);
+
+	const int color = getColor(x, y);
+	if (color < 0) {
+		return 0;
+	}
+
+	const Column hiddenRow = Column(1) << (m_height - 3);
+	Column allowed[kMaxColumns] {};
+	for (int i = 0; i < m_width; i++) {
+		allowed[i] = m_color[color][i] & ~hiddenRow;
+	}
+	allowed[x] |= Column(1) << y;
+	group[x] = Column(1) << y;
+
+	return expandGroup(group, allowed, m_width, x, x);
+}
+
+// Neighboring nuisance and hard puyo of popped puyos take damage
+void FieldState::popNeighbors(const Column popped[kMaxColumns])
+{
+	const Column visible = visibleRows();
+	for (int i = 0; i < m_width; i++) {
+		const Column up = popped[i] << 1 & visible;
+		const Column down = popped[i] >> 1;
+		const Column left = i > 0 ? popped[i - 1] : 0;
+		const Column right = i < m_width - 1 ? popped[i + 1] : 0;
+		const Column once = up | down | left | right;
+		if (!once) {
+			continue;
+		}
+
+		m_nuisance[i] &= ~once;
+
+		if (m_hard[i]) {
+			const Column twice = (up & (down | left | right)) | (down & (left | right)) | (left & right);
+			const Column removed = (m_hard[i] & twice) | (m_hardCracked[i] & once);
+			m_hard[i] &= ~removed;
+			m_hardCracked[i] = (m_hardCracked[i] | (m_hard[i] & once)) & ~removed;
+		}
+	}
+}
+
+// Pop all groups once without dropping, returns true if anything popped
+bool FieldState::popGroups(const int puyoToClear)
+{
+	Column popped[kMaxColumns] {};
+	if (findPoppingPuyos(puyoToClear, popped) == 0) {
+		return false;
+	}
+
+	m_hashValid = false;
+	popNeighbors(popped);
+	for (auto& color : m_color) {
+		for (int i = 0; i < m_width; i++) {
+			color[i] &= ~popped[i];
+		}
+	}
+	return true;
+}
+
+// Resolve the full chain on this state, returns chain length
+int FieldState::simulateChain(const int puyoToClear)
+{
+	int chainN = 0;
+	while (popGroups(puyoToClear)) {
+		chainN++;
+		drop();
+	}
+	return chainN;
+}
+
+// Results are shared through ChainTable, so the same field is only simulated once
+int FieldState::predictChain(const int puyoToClear) const
+{
+	const uint64_t key = chainKey(hash(), m_width, m_height, puyoToClear);
+	int chain;
+	if (ChainTable::shared().find(key, chain)) {
+		return chain;
+	}
+
+	FieldState copy = *this;
+	chain = copy.simulateChain(puyoToClear);
+	ChainTable::shared().store(key, chain);
+	return chain;
+}
+
+// Place puyos at the shadow positions, returns false if one of them is taken
+bool FieldState::place(const PosVectorInt shadowPos[4], const int n, const int colors[4])
+{
+	// Check empty
+	for (int i = 0; i < n; i++) {
+		if (!isEmpty(shadowPos[i].x, shadowPos[i].y)) {
+			return false;
+		}
+	}
+
+	for (int i = 0; i < n; i++) {
+		if (shadowPos[i].y < m_height && isEmpty(shadowPos[i].x, shadowPos[i].y)) {
+			addColorPuyo(shadowPos[i].x, shadowPos[i].y, colors[i]);
+		}
+	}
+	return true;
+}
+
+// Place puyos at the shadow positions and resolve the chain, see Field::virtualChain
+int FieldState::virtualChain(const PosVectorInt shadowPos[4], const int n, const int colors[4], const int puyoToClear,
+	ChainTable::Stats* stats) const
+{
+	for (int i = 0; i < n; i++) {
+		if (!isEmpty(shadowPos[i].x, shadowPos[i].y)) {
+			return 0;
+		}
+	}
+
+	// The placed field is looked up like any other field
+	const uint64_t key = chainKey(placedHash(shadowPos, n, colors), m_width, m_height, puyoToClear);
+	int chain;
+	if (ChainTable::shared().find(key, chain, stats)) {
+		return chain;
+	}
+
+	FieldState copy = *this;
+	copy.place(shadowPos, n, colors);
+	chain = copy.simulateChain(puyoToClear);
+	ChainTable::shared().store(key, chain);
+	return chain;
+}
+
+}
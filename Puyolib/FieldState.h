@@ -0,0 +1,91 @@
+#pragma once
+
+#include "ChainTable.h"
+#include "FieldProp.h"
+#include "Puyo.h"
+#include <cstdint>
+
+namespace ppvs {
+
+// Compact value-type copy of the gameplay contents of a field.
+// Every column is stored as a bitmask (bit y set = row y occupied), with one set of
+// column masks per color plus masks for nuisance and hard puyo. Copying a FieldState
+// is a plain memory copy, so chain prediction never has to touch Puyo objects.
+class FieldState {
+public:
+	using Column = uint32_t;
+
+	static constexpr int kMaxColumns = 32;
+	static constexpr int kMaxRows = 32;
+	static constexpr int kMaxColors = 8;
+
+	FieldState() = default;
+	FieldState(int width, int height);
+
+	// Returns false if a field of this size can't be represented
+	[[nodiscard]] static bool fits(int width, int height);
+
+	void reset(int width, int height);
+	void clear();
+
+	[[nodiscard]] int width() const { return m_width; }
+	[[nodiscard]] int height() const { return m_height; }
+
+	// Same semantics as their counterparts in Field
+	[[nodiscard]] bool isEmpty(int x, int y) const;
+	[[nodiscard]] bool isPuyo(int x, int y) const;
+	[[nodiscard]] int getColor(int x, int y) const;
+	[[nodiscard]] PuyoType getPuyoType(int x, int y) const;
+	bool addColorPuyo(int x, int y, int color);
+	bool addNuisancePuyo(int x, int y);
+	bool addHardPuyo(int x, int y, int life = 2);
+	void removePuyo(int x, int y);
+	[[nodiscard]] int count() const;
+
+	// Raw column access
+	[[nodiscard]] Column occupied(int x) const;
+	[[nodiscard]] Column colorColumn(int color, int x) const { return m_color[color][x]; }
+	[[nodiscard]] Column nuisanceColumn(int x) const { return m_nuisance[x]; }
+	[[nodiscard]] Column hardColumn(int x) const { return m_hard[x]; }
+	[[nodiscard]] Column visibleRows() const;
+
+	// Zobrist hash of the contents, kept up to date by the add and remove functions.
+	// Two states with the same size and contents have the same hash.
+	[[nodiscard]] uint64_t hash() const;
+	void rehash();
+	[[nodiscard]] uint64_t placedHash(const PosVectorInt shadowPos[4], int n, const int colors[4]) const;
+
+	// Chain simulation
+	bool place(const PosVectorInt shadowPos[4], int n, const int colors[4]);
+	void drop();
+	// Adds every color group of at least puyoToClear puyos to popped and returns the
+	// number of puyos in them, not the number of groups
+	int findPoppingPuyos(int puyoToClear, Column popped[kMaxColumns]) const;
+	int floodGroup(int x, int y, Column group[kMaxColumns]) const;
+	bool popGroups(int puyoToClear);
+	int simulateChain(int puyoToClear);
+	[[nodiscard]] int predictChain(int puyoToClear) const;
+	[[nodiscard]] int virtualChain(const PosVectorInt shadowPos[4], int n, const int colors[4], int puyoToClear,
+		ChainTable::Stats* stats = nullptr) const;
+
+private:
+	void popNeighbors(const Column popped[kMaxColumns]);
+	[[nodiscard]] uint64_t computeHash() const;
+	[[nodiscard]] static uint64_t puyoKey(int kind, int x, int y);
+
+	// Kinds of puyo in the hash keys, colors come first
+	static constexpr int kNuisanceKind = kMaxColors;
+	static constexpr int kHardKind = kMaxColors + 1;
+	static constexpr int kHardCrackedKind = kMaxColors + 2;
+	static constexpr int kNumKinds = kMaxColors + 3;
+
+	int m_width = 0, m_height = 0;
+	Column m_color[kMaxColors][kMaxColumns] {};
+	Column m_nuisance[kMaxColumns] {};
+	Column m_hard[kMaxColumns] {};
+	Column m_hardCracked[kMaxColumns] {}; // Hard puyo that have one life left
+	uint64_t m_hash = 0;
+	bool m_hashValid = true; // Dropping and popping don't update the hash
+};
+
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
 
 namespace ppvs {
@@ -151,6 +152,17 @@ public:
 	virtual FeText* render(const char* str) = 0;
 };
 
+// One rectangle of a batch, see FeRenderTarget::drawRects. Placed like a Sprite with
+// the same values: the rectangle is scaled and rotated around its center, which ends
+// up at x, y.
+struct FeQuad {
+	float x, y;
+	float centerX, centerY; // Pixels from the top left, before scaling
+	float scale;
+	float rotation; // Like Sprite::setRotation, in the unit of rotate()
+	float subX, subY, subW, subH;
+};
+
 struct FeInput {
 	bool up, down, left, right, a, b, start;
 };
@@ -200,6 +212,8 @@ public:
 
 	// Drawing
 	virtual void drawRect(FeImage* image, double subX, double subY, double subW, double subH) = 0;
+	// Many rectangles of one image with the current matrix, color and blending
+	virtual void drawRects(FeImage* image, const FeQuad* quads, size_t count) = 0;
 
 	virtual void clear() = 0;
 	virtual void swapBuffers() = 0;
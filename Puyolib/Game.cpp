@@ -1,9 +1,14 @@
 #include "Game.h"
 #include "../PVS_ENet/PVS_Channel.h"
 #include "../PVS_ENet/PVS_Client.h"
+#include "ReplayFile.h"
+#include "StateStream.h"
+#include <algorithm>
+#include <climits>
 #include <cstdio>
 #include <ctime>
 #include <fstream>
+#include <iostream>
 #include <zlib.h>
 
 #ifdef _WIN32
@@ -127,6 +132,7 @@ void Game::loadGlobal()
 	m_data->windowFocus = true;
 	m_data->playSounds = m_settings->playSound;
 	m_data->playMusic = m_settings->playMusic;
+	m_data->headless = m_settings->headless;
 
 	m_statusFont = m_data->front->loadFont("Arial", 14);
 	setStatusText("");
@@ -182,6 +188,7 @@ void Game::loadImages() const
 		}
 	}
 	m_data->imgPuyo->setFilter(FilterType::LinearFilter);
+	m_data->puyoSkin.setImage(m_data->imgPuyo);
 
 	// Lights
 	m_data->imgLight = m_data->front->loadImage(m_baseAssetDir + "Data/Light.png");
@@ -542,32 +549,36 @@ void Game::playGame()
 	}
 
 	// Ready go
-	if (!m_players.empty()) {
-		m_readyGoObj.playAnimation();
+	if (!m_data->headless) {
+		if (!m_players.empty()) {
+			m_readyGoObj.playAnimation();
+		}
+		m_backgroundAnimation.playAnimation();
 	}
-	m_backgroundAnimation.playAnimation();
 
 	// Replay
 	if (m_settings->recording == RecordState::REPLAYING) {
 		const int t = m_data->matchTimer;
 		for (const auto& player : m_players) {
-			// Check event by looping through vector
-			// If the time is -1, it's considered as processed
-			for (size_t i = 0; i < player->m_recordMessages.size(); i++) {
-				if (player->m_recordMessages[i].time == t) {
-					// Process all events with the correct time
-					// Ignore color select
-					if (player->m_recordMessages[i].message[0] == 's'
-						|| player->m_recordMessages[i].message[0] == 'c') {
-						continue;
-					}
-
-					// Add message
-					player->addMessage(player->m_recordMessages[i].message);
-					player->m_recordMessages[i].time = -1;
-				} else if (player->m_recordMessages[i].time > t) {
-					break;
+			// Continue from the cursor, it only has to search again if the time went back
+			std::vector<MessageEvent>& messages = player->m_recordMessages;
+			size_t& cursor = player->m_recordMessageCursor;
+			if (cursor > messages.size() || (cursor > 0 && messages[cursor - 1].time >= t)) {
+				player->seekRecording(t);
+			}
+			while (cursor < messages.size() && messages[cursor].time < t) {
+				cursor++;
+			}
+			// Process all events with the correct time
+			for (; cursor < messages.size() && messages[cursor].time == t; cursor++) {
+				// Ignore color select
+				if (messages[cursor].message[0] == 's'
+					|| messages[cursor].message[0] == 'c') {
+					continue;
 				}
+
+				// Add message
+				player->addMessage(messages[cursor].message);
 			}
 		}
 	}
@@ -578,6 +589,9 @@ void Game::playGame()
 	for (const auto& player : m_players) {
 		player->play();
 	}
+	for (const auto& player : m_players) {
+		player->updateStateHash(m_data->matchTimer);
+	}
 
 	// Check end of match
 	checkEnd();
@@ -631,9 +645,26 @@ void Game::playGame()
 		}
 	}
 
+	// Keyframes to rewind to
+	if (m_settings->recording == RecordState::REPLAYING) {
+		captureKeyframe();
+	}
+
+	// Write what was recorded so far
+	if (m_settings->recording == RecordState::RECORDING) {
+		streamReplay();
+	}
+
 	if (m_backwardsOnce)
 		return;
 
+	// Replay turbo seek
+	if (m_settings->recording == RecordState::REPLAYING && m_replaySeekTarget >= 0) {
+		turboSeekReplay(m_replaySeekTarget);
+		m_replaySeekTarget = -1;
+		m_replayBackwardsTimer = m_data->matchTimer;
+	}
+
 	// Replay normal
 	if (m_settings->recording == RecordState::REPLAYING && m_replayState == ReplayState::NORMAL)
 		m_replayBackwardsTimer = m_data->matchTimer;
@@ -644,7 +675,10 @@ void Game::playGame()
 			m_replayBackwardsTimer -= 60;
 		}
 
-		if (!m_settings->oldReplayPlayList.empty()) {
+		if (seekReplay(m_replayBackwardsTimer)) {
+			m_replayState = ReplayState::NORMAL;
+		} else if (!m_settings->oldReplayPlayList.empty()) {
+			// No keyframe to go back to, play the replay again from the start
 			const bool soundSettings = m_settings->playSound;
 			m_settings->playSound = false;
 			m_data->playSounds = false;
@@ -653,14 +687,7 @@ void Game::playGame()
 			// Get ready to play
 			resetPlayers();
 			m_data->matchTimer = 0;
-			// Loop until time is reached
-			while (m_data->matchTimer < m_replayBackwardsTimer) {
-				m_replayState = ReplayState::NORMAL;
-				m_backwardsOnce = true;
-				playGame();
-				m_replayState = ReplayState::REWIND;
-			}
-			m_backwardsOnce = false;
+			simulateReplay(m_replayBackwardsTimer);
 			m_settings->playSound = soundSettings;
 			m_data->playSounds = soundSettings;
 			m_replayState = ReplayState::NORMAL;
@@ -846,6 +873,12 @@ void Game::resetPlayers()
 		}
 	}
 
+	// The last recorded match was never saved
+	if (m_replayStreaming) {
+		m_replayWriter->discard();
+		m_replayStreaming = false;
+	}
+
 	// Reset players
 	m_winsString = "";
 	for (const auto& player : m_players) {
@@ -1044,15 +1077,20 @@ std::string Game::sendUpdate() const
 	return str;
 }
 
-void Game::saveReplay() const
+void Game::saveReplay()
 {
 	if (m_settings->recording != RecordState::RECORDING) {
 		return;
 	}
 
 	if (m_activeAtStart == 0) {
+		if (m_replayStreaming) {
+			m_replayWriter->discard();
+			m_replayStreaming = false;
+		}
 		return;
 	}
+	startReplayStream();
 
 	time_t rawTime;
 	tm timeInfo {};
@@ -1064,8 +1102,8 @@ void Game::saveReplay() const
 	localtime_r(&rawTime, &timeInfo);
 #endif
 
-	// Open file
-	std::ofstream outfile;
+	// The writer creates the folders and moves the file there
+	std::vector<std::string> folders;
 	std::string replayfolder = "User/Replays/";
 
 	// Create userfolder
@@ -1078,13 +1116,13 @@ void Game::saveReplay() const
 	} else {
 		replayfolder += "Spectator/";
 	}
-	createFolder(replayfolder);
+	folders.push_back(replayfolder);
 
 	// Create datefolder
 	char dt[20];
 	strftime(dt, 20, "%Y-%m-%d", &timeInfo);
 	replayfolder += std::string(dt) + "/";
-	createFolder(replayfolder);
+	folders.push_back(replayfolder);
 
 	// Rulesname
 	std::string rulesname = "TSU_";
@@ -1107,7 +1145,26 @@ void Game::saveReplay() const
 		scorename = m_winsString;
 	}
 	std::string filename = rulesname + ft + playersname + scorename;
-	outfile.open((replayfolder + filename + ".rvs").c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+
+	// The rest of the input, in chunks like during the match
+	int lastFrame = 0;
+	for (const auto& player : m_players) {
+		for (const int time : { player->m_controls.m_recordEvents.empty() ? 0 : player->m_controls.m_recordEvents.back().time,
+				 player->m_recordMessages.empty() ? 0 : player->m_recordMessages.back().time,
+				 player->m_recordHashes.empty() ? 0 : player->m_recordHashes.back().time }) {
+			lastFrame = std::max(lastFrame, time);
+		}
+	}
+	std::vector<ReplayWriter::Chunk> chunks;
+	bool last = false;
+	while (!last) {
+		last = m_replayChunkFrame + kReplayChunkFrames > lastFrame;
+		chunks.push_back(takeReplayChunk(last ? INT_MAX : m_replayChunkFrame + kReplayChunkFrames));
+	}
+	std::vector<char> headers;
+	const auto addHeader = [&headers](const void* header, const size_t size) {
+		headers.insert(headers.end(), static_cast<const char*>(header), static_cast<const char*>(header) + size);
+	};
 
 	// Construct header
 	ReplayHeader rh = {
@@ -1122,7 +1179,7 @@ void Game::saveReplay() const
 	strftime(rh.date, 11, "%Y/%m/%d", &timeInfo);
 	strftime(rh.time, 9, "%H:%M:%S", &timeInfo);
 
-	outfile.write(reinterpret_cast<char*>(&rh), sizeof(ReplayHeader));
+	addHeader(&rh, sizeof(ReplayHeader));
 
 	ReplayRuleSetHeader rrh = {
 		m_settings->ruleSetInfo.ruleSetType,
@@ -1137,11 +1194,11 @@ void Game::saveReplay() const
 		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }
 	};
 
-	outfile.write(reinterpret_cast<char*>(&rrh), sizeof(ReplayRuleSetHeader));
+	addHeader(&rrh, sizeof(ReplayRuleSetHeader));
 
-	// Go through all players
-	for (auto& player : m_players) {
-		// Player header
+	// Player headers, their input follows in chunks
+	for (size_t i = 0; i < m_players.size(); i++) {
+		const Player* player = m_players[i];
 		int n = player->getPlayerNum();
 
 		ReplayPlayerHeader rph = {
@@ -1153,8 +1210,8 @@ void Game::saveReplay() const
 			player->getCharacter(),
 			static_cast<char>(player->m_activeAtStart),
 			static_cast<char>(player->m_colors),
-			static_cast<int>(player->m_controls.m_recordEvents.size() * sizeof(ControllerEvent)),
-			static_cast<int>(player->m_recordMessages.size() * sizeof(MessageEvent)),
+			m_replayEventsWritten[i],
+			m_replayMessagesWritten[i],
 			0,
 			0
 		};
@@ -1163,75 +1220,59 @@ void Game::saveReplay() const
 		std::string name = player->m_previousName.substr(0, 31);
 		strcpy(rph.name, name.c_str());
 
-		// Compress move vector
-		int movLength = static_cast<int>(player->m_controls.m_recordEvents.size() * sizeof(ControllerEvent));
-		auto movComprLength = static_cast<unsigned long>(static_cast<float>(movLength) * 1.1f + 12);
-		auto* movcompressed = new unsigned char[movComprLength];
-		if (movLength != 0) {
-			int z_result = compress(
-				movcompressed,
-				&movComprLength,
-				reinterpret_cast<unsigned char*>(&player->m_controls.m_recordEvents[0]),
-				movLength);
-
-			// Check result
-			if (z_result != Z_OK) {
-				// Stop
-				outfile.close();
-				remove((replayfolder + filename + ".rvs").c_str());
-				return;
-			}
-			// Update size
-			rph.vectorSizeCompressedMovement = static_cast<int>(movComprLength);
+		addHeader(&rph, sizeof(ReplayPlayerHeader));
+	}
 
-			encode("pvs2424", reinterpret_cast<char*>(movcompressed), static_cast<int>(movComprLength));
-		} else
-			movComprLength = 0;
-
-		// Compress messages
-		int mesLength = static_cast<int>(player->m_recordMessages.size() * sizeof(MessageEvent));
-		auto mesComprLength = static_cast<unsigned long>((static_cast<float>(mesLength) * 1.1f) + 12);
-		auto* mescompressed = new unsigned char[mesComprLength];
-		if (mesLength != 0) {
-			int z_result = compress(
-				mescompressed,
-				&mesComprLength,
-				reinterpret_cast<unsigned char*>(&player->m_recordMessages[0]),
-				mesLength);
+	m_replayWriter->finish(std::move(chunks), std::move(headers), std::move(folders), replayfolder + filename + ".rvs");
+	m_replayStreaming = false;
+}
 
-			// Check result
-			if (z_result != Z_OK) {
-				// Stop
-				outfile.close();
-				remove((replayfolder + filename + ".rvs").c_str());
-				return;
-			}
-			// Update size
-			rph.vectorSizeCompressedMessage = static_cast<int>(mesComprLength);
-			encode("pvs2424", reinterpret_cast<char*>(mescompressed), static_cast<int>(mesComprLength));
-		} else
-			mesComprLength = 0;
+// A recorded match starts, from now on its input is written while playing
+void Game::startReplayStream()
+{
+	if (m_replayStreaming || m_settings->recording != RecordState::RECORDING) {
+		return;
+	}
+	if (!m_replayWriter) {
+		m_replayWriter = std::make_unique<ReplayWriter>("User/Replays/");
+	}
+	m_replayStreaming = true;
+	m_replayChunkFrame = 0;
+	m_replayEventsWritten.assign(m_players.size(), 0);
+	m_replayMessagesWritten.assign(m_players.size(), 0);
+}
 
-		// Write compressed
-		outfile.write(reinterpret_cast<char*>(&rph), sizeof(ReplayPlayerHeader));
-		if (movLength != 0)
-			outfile.write(reinterpret_cast<char*>(movcompressed), movComprLength);
-		if (mesLength != 0)
-			outfile.write(reinterpret_cast<char*>(mescompressed), mesComprLength);
+// Moves the recorded input from the start of the next chunk until end out of the players
+ReplayWriter::Chunk Game::takeReplayChunk(const int end)
+{
+	std::vector<ReplayStreams> streams;
+	for (const auto& player : m_players) {
+		streams.push_back({ &player->m_controls.m_recordEvents, &player->m_recordMessages, &player->m_recordHashes });
+	}
+	ReplayWriter::Chunk chunk = ReplayWriter::takeChunk(m_replayChunkFrame, end, streams);
+	for (size_t i = 0; i < m_players.size(); i++) {
+		m_replayEventsWritten[i] += static_cast<int>(chunk.events[i].size());
+		m_replayMessagesWritten[i] += static_cast<int>(chunk.messages[i].size());
+	}
+	m_replayChunkFrame = end;
+	return chunk;
+}
 
-		// Remove compressed
-		delete[] movcompressed;
-		player->m_controls.m_recordEvents.clear();
-		// Remove compressed
-		delete[] mescompressed;
-		player->m_recordMessages.clear();
+// Hands every finished chunk to the writer. If it is behind, the input stays with the
+// players until the next frame.
+void Game::streamReplay()
+{
+	const size_t headerSize = sizeof(ReplayHeader) + sizeof(ReplayRuleSetHeader) + m_players.size() * sizeof(ReplayPlayerHeader);
+	while (m_replayStreaming && m_data->matchTimer >= m_replayChunkFrame + kReplayChunkFrames && !m_replayWriter->isFull()) {
+		m_replayWriter->addChunk(takeReplayChunk(m_replayChunkFrame + kReplayChunkFrames), headerSize);
 	}
-	outfile.close();
 }
 
 void Game::loadReplay(const std::string& filename)
 {
 	m_settings->recording = RecordState::REPLAYING;
+	m_replayKeyframes.configure(m_settings->replayKeyframeInterval, m_settings->replayKeyframeBudget);
+	m_replayKeyframes.clear();
 	m_connected = false;
 	m_network = nullptr;
 
@@ -1297,6 +1338,7 @@ void Game::loadReplay(const std::string& filename)
 		return;
 
 	unsigned int sizePrevious = sizeof(ReplayHeader) + sizeof(ReplayRuleSetHeader);
+	std::vector<ReplayStreams> streams;
 	for (const auto& player : m_players) {
 		// Read player header
 		ReplayPlayerHeader rph {};
@@ -1312,6 +1354,14 @@ void Game::loadReplay(const std::string& filename)
 		player->m_colors = static_cast<unsigned char>(rph.colors);
 		player->m_controls.m_recordEvents.clear();
 		player->m_recordMessages.clear();
+		player->m_recordHashes.clear();
+
+		// Version 4 stores the input of all players in chunks after the headers
+		if (m_currentReplayVersion >= 4) {
+			streams.push_back({ &player->m_controls.m_recordEvents, &player->m_recordMessages, &player->m_recordHashes });
+			sizePrevious += sizeof(ReplayPlayerHeader);
+			continue;
+		}
 
 		// Size of vectors
 		unsigned long movSize = rph.vectorSizeMovement;
@@ -1364,7 +1414,15 @@ void Game::loadReplay(const std::string& filename)
 		// Update size
 		sizePrevious += sizeof(ReplayPlayerHeader) + movSizeComp + mesSizeComp;
 	}
+	if (!streams.empty() && !readReplayChunks(infile, m_currentReplayVersion, streams)) {
+		// The players are left without input, which plays as nobody pressing anything
+		std::cerr << filename << " is damaged, its input could not be read\n";
+	}
 	infile.close();
+
+	for (const auto& player : m_players) {
+		player->seekRecording(0);
+	}
 }
 
 void Game::nextReplay()
@@ -1417,6 +1475,133 @@ void Game::previousReplay()
 	m_replayTimer = 0;
 }
 
+// Go to a frame of the replay that is playing, starting from the nearest keyframe
+// before it. Returns false if there is no keyframe to start from.
+bool Game::seekReplay(const int frame)
+{
+	if (m_settings->recording != RecordState::REPLAYING) {
+		return false;
+	}
+
+	// Just continue if the frame is ahead and there is no keyframe in between
+	const Keyframe* keyframe = m_replayKeyframes.find(frame);
+	if (frame >= m_data->matchTimer && (!keyframe || keyframe->frame <= m_data->matchTimer)) {
+		simulateReplay(frame);
+		return true;
+	}
+	if (!keyframe) {
+		return false;
+	}
+
+	StateStream stream(keyframe->state.data(), keyframe->state.size());
+	syncState(stream);
+	if (stream.failed()) {
+		m_replayKeyframes.clear();
+		return false;
+	}
+	for (const auto& player : m_players) {
+		player->seekRecording(m_data->matchTimer);
+	}
+	simulateReplay(frame);
+	return true;
+}
+
+// Like seekReplay, but the frames in between are only simulated, as if running
+// headless: no particles, animations or sounds. Nothing is drawn until it returns.
+bool Game::turboSeekReplay(const int frame)
+{
+	const bool headless = m_data->headless;
+	m_data->headless = true;
+	const bool found = seekReplay(frame);
+	m_data->headless = headless;
+	if (found && !headless) {
+		refreshPresentation();
+	}
+	return found;
+}
+
+// Rebuild what is only shown from the state of the match, like loading a keyframe
+// does, so that the first frame drawn after skipping the presentation is correct
+void Game::refreshPresentation()
+{
+	std::vector<char> state;
+	StateStream save(state);
+	syncState(save);
+	StateStream load(state.data(), state.size());
+	syncState(load);
+}
+
+// Play replay frames without sound until the match timer reaches frame
+void Game::simulateReplay(const int frame)
+{
+	const bool soundSettings = m_settings->playSound;
+	const ReplayState replayState = m_replayState;
+	m_settings->playSound = false;
+	m_data->playSounds = false;
+	m_backwardsOnce = true;
+	m_replayState = ReplayState::NORMAL;
+	while (m_data->matchTimer < frame) {
+		const int matchTimer = m_data->matchTimer;
+		playGame();
+
+		// The match timer was reset, the frame is not in this replay
+		if (m_data->matchTimer <= matchTimer) {
+			break;
+		}
+	}
+	m_backwardsOnce = false;
+	m_replayState = replayState;
+	m_settings->playSound = soundSettings;
+	m_data->playSounds = soundSettings;
+}
+
+void Game::captureKeyframe()
+{
+	const int frame = m_data->matchTimer;
+
+	// The match timer was reset, the keyframes are of what came before
+	if (frame == 1) {
+		m_replayKeyframes.clear();
+	}
+	if (!m_replayKeyframes.wants(frame)) {
+		return;
+	}
+
+	std::vector<char> state;
+	StateStream stream(state);
+	syncState(stream);
+	state.shrink_to_fit();
+	m_replayKeyframes.add(frame, std::move(state));
+}
+
+// State of the match for replay keyframes. Menus, music and the AI are left out,
+// replays don't have CPU players.
+void Game::syncState(StateStream& stream)
+{
+	stream.value(m_data->matchTimer);
+	stream.value(m_data->globalTimer);
+	stream.value(m_currentGameStatus);
+	stream.value(m_menuSelect);
+	stream.value(m_timerEndMatch);
+	stream.value(m_choiceTimer);
+	stream.value(m_colorTimer);
+	stream.value(m_activeAtStart);
+	stream.value(m_randomSeedNextList);
+	stream.value(m_replayTimer);
+	stream.value(m_stopChaining);
+	stream.string(m_winsString);
+
+	size_t players = m_players.size();
+	stream.value(players);
+	if (players != m_players.size()) {
+		stream.fail();
+		return;
+	}
+	for (const auto& player : m_players) {
+		player->syncState(stream);
+	}
+}
+
 void Game::rankedMatch()
 {
 	if (m_currentGameStatus != GameStatus::IDLE && m_currentGameStatus != GameStatus::WAITING || !m_settings->rankedMatch) {
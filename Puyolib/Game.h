@@ -4,12 +4,15 @@
 #include "CharacterSelect.h"
 #include "Frontend.h"
 #include "GameSettings.h"
+#include "Keyframes.h"
 #include "Menu.h"
 #include "Player.h"
+#include "ReplayWriter.h"
 #include "RuleSet/RuleSet.h"
 #include "Sprite.h"
 #include "global.h"
 #include <iostream>
+#include <memory>
 #include <string>
 
 enum class GameStatus {
@@ -28,7 +31,7 @@ enum class ReplayState {
 	REWIND,
 };
 
-constexpr int kReplayVersion = 3;
+constexpr int kReplayVersion = 5;
 
 struct PVS_Client;
 
@@ -50,6 +53,7 @@ struct NetworkMessage {
 };
 
 class Frontend;
+class StateStream;
 
 class Game {
 public:
@@ -112,18 +116,23 @@ public:
 	bool m_forceStatusText = false;
 	TranslatableStrings m_translatableStrings {};
 
-	void saveReplay() const;
+	void startReplayStream();
+	void saveReplay();
 	void loadReplay(const std::string& filename);
 	int m_replayTimer = 3 * 60;
 	std::string m_winsString;
 	void nextReplay();
 	void previousReplay();
+	bool seekReplay(int frame);
+	bool turboSeekReplay(int frame);
+	int m_replaySeekTarget = -1; // Frame to turbo seek to on the next frame, -1 for none
 	int m_currentReplayVersion = 0;
 	ReplayState m_replayState = ReplayState::NORMAL;
 	int m_replayBackwardsTimer = 0;
 	bool m_backwardsOnce = false;
 	bool m_legacyRng = false; // See loadReplay
 	bool m_legacyNuisanceDrop = false;
+	KeyframeStore m_replayKeyframes;
 
 	// Ranked match
 	void rankedMatch();
@@ -165,6 +174,19 @@ private:
 	void setStatusText(const char* utf8);
 
 	bool m_playNext = true; // Helper variable for replays
+	void syncState(StateStream& stream);
+	void captureKeyframe();
+	void simulateReplay(int frame);
+	void refreshPresentation();
+
+	// Recording
+	std::unique_ptr<ReplayWriter> m_replayWriter; // Made for the first recorded match
+	bool m_replayStreaming = false; // From the start of a recorded match until it is saved
+	int m_replayChunkFrame = 0; // First frame that wasn't handed to the writer
+	std::vector<int> m_replayEventsWritten; // Per player, for the headers
+	std::vector<int> m_replayMessagesWritten;
+	ReplayWriter::Chunk takeReplayChunk(int end);
+	void streamReplay();
 };
 
 }
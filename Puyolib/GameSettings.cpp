@@ -61,9 +61,19 @@ GameSettings::GameSettings(const RuleSetInfo& ruleSetInfo)
 	swapABConfirm = false;
 	pickColors = true;
 	useCpuPlayers = false;
+	cpuBeamWidth = 16;
+	cpuNodeBudget = 2000;
+	cpuTimeLimit = 0;
+	cpuThinkAsync = false;
+	cpuThinkFrames = 4;
 	spectating = false;
 	recording = RecordState::NOT_RECORDING;
 	showNames = 0;
+	replayKeyframeInterval = 120;
+	replayKeyframeBudget = 32 * 1024 * 1024;
+	stateHashInterval = 60;
+	stateHashTurns = 0;
+	headless = false;
 	rankedMatch = false;
 	maxWins = 2;
 
@@ -73,12 +73,23 @@ struct GameSettings {
 	bool startWithCharacterSelect;
 	bool pickColors;
 	bool useCpuPlayers; // This is set for testing or endless
+	std::map<int, AIStrategy> cpuStrategies; // By player number, CPU players not listed use AIStrategy::GREEDY
+	int cpuBeamWidth;
+	int cpuNodeBudget; // Placements tried per move for AIStrategy::BEAM
+	int cpuTimeLimit; // Microseconds per move for AIStrategy::BEAM, 0 for no limit. Makes moves depend on CPU speed.
+	bool cpuThinkAsync; // Search in the background instead of stalling the frame
+	int cpuThinkFrames; // Frames into the move phase at which an asynchronous search is used, a late one is waited for
 	bool spectating; // Set on if player intends to spectate match
 	int showNames; // For replays, 0=show all, 1=not p1, 2=hide all
+	bool headless; // Simulate only, for use with NullFrontend
 
 	// Replay
 	std::deque<std::string> replayPlayList;
 	std::deque<std::string> oldReplayPlayList;
+	int replayKeyframeInterval; // Frames between keyframes, seeking simulates at most this many
+	size_t replayKeyframeBudget; // Bytes, 0 turns keyframes off
+	int stateHashInterval; // Frames between state hashes kept in replays, 0 turns them off
+	int stateHashTurns; // Turns between state hashes sent to the peer, 0 = off (older versions don't know them)
 
 	// Account settings
 };
@@ -0,0 +1,115 @@
+#include "GroupSearch.h"
+#include "GroupSearchKernel.h"
+
+#include <algorithm>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || defined(_M_IX86_FP) && _M_IX86_FP >= 2
+#define PPVS_GROUPSEARCH_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace ppvs {
+
+static_assert(std::is_same_v<Column, FieldState::Column>);
+static_assert(kKernelMaxColumns == FieldState::kMaxColumns && kKernelMaxColors == FieldState::kMaxColors);
+
+// Defined in GroupSearchAvx2.cpp, which is built with AVX2 enabled
+#ifdef PPVS_GROUPSEARCH_AVX2
+int findPoppingGroupsAvx2(const FieldState::Column colors[][FieldState::kMaxColumns], int numColors, int width,
+	FieldState::Column rows, int puyoToClear, FieldState::Column popped[FieldState::kMaxColumns]);
+#endif
+
+namespace {
+
+#ifdef PPVS_GROUPSEARCH_SSE2
+struct Sse2Ops {
+	using Vec = __m128i;
+	static constexpr int kLanes = 4;
+
+	static Vec load(const Column* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+	static void store(Column* p, const Vec v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+	static Vec bitOr(const Vec a, const Vec b) { return _mm_or_si128(a, b); }
+	static Vec bitAnd(const Vec a, const Vec b) { return _mm_and_si128(a, b); }
+	static Vec up(const Vec v) { return _mm_slli_epi32(v, 1); }
+	static Vec down(const Vec v) { return _mm_srli_epi32(v, 1); }
+	static bool differs(const Vec a, const Vec b) { return _mm_movemask_epi8(_mm_cmpeq_epi32(a, b)) != 0xFFFF; }
+};
+#endif
+
+bool cpuHasAvx2()
+{
+#if defined(PPVS_GROUPSEARCH_AVX2) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return false;
+	}
+	__cpuid(info, 1);
+	// OSXSAVE and AVX, then check that the OS saves the YMM registers
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6) {
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#elif defined(PPVS_GROUPSEARCH_AVX2)
+	return __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
+}
+
+SimdLevel detectSimdLevel()
+{
+	if (cpuHasAvx2()) {
+		return SimdLevel::AVX2;
+	}
+#ifdef PPVS_GROUPSEARCH_SSE2
+	return SimdLevel::SSE2;
+#else
+	return SimdLevel::SCALAR;
+#endif
+}
+
+const SimdLevel kSupportedLevel = detectSimdLevel();
+SimdLevel gSimdLevel = kSupportedLevel;
+
+}
+
+SimdLevel getSupportedSimdLevel()
+{
+	return kSupportedLevel;
+}
+
+SimdLevel getSimdLevel()
+{
+	return gSimdLevel;
+}
+
+void setSimdLevel(const SimdLevel level)
+{
+	gSimdLevel = std::min(level, kSupportedLevel);
+}
+
+int findPoppingGroups(const FieldState::Column colors[][FieldState::kMaxColumns], const int numColors, const int width,
+	const FieldState::Column rows, const int puyoToClear, FieldState::Column popped[FieldState::kMaxColumns])
+{
+	switch (gSimdLevel) {
+#ifdef PPVS_GROUPSEARCH_AVX2
+	case SimdLevel::AVX2:
+		return findPoppingGroupsAvx2(colors, numColors, width, rows, puyoToClear, popped);
+#endif
+#ifdef PPVS_GROUPSEARCH_SSE2
+	case SimdLevel::SSE2: {
+		GroupSearchKernel<Sse2Ops> kernel;
+		return kernel.run(colors, numColors, width, rows, puyoToClear, popped);
+	}
+#endif
+	default: {
+		GroupSearchKernel<ScalarOps> kernel;
+		return kernel.run(colors, numColors, width, rows, puyoToClear, popped);
+	}
+	}
+}
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "FieldState.h"
+
+namespace ppvs {
+
+// Instruction set used by the group search kernel
+enum class SimdLevel {
+	SCALAR,
+	SSE2,
+	AVX2
+};
+
+// Best level supported by this build and CPU
+SimdLevel getSupportedSimdLevel();
+
+// Level in use, defaults to the supported level. Setting a level higher than
+// supported falls back to the supported one. Useful to compare implementations.
+SimdLevel getSimdLevel();
+void setSimdLevel(SimdLevel level);
+
+// Find every color group of at least puyoToClear puyos inside the given rows.
+// colors holds numColors planes of width columns. All groups are OR'ed into popped,
+// returns the number of popped puyos.
+int findPoppingGroups(const FieldState::Column colors[][FieldState::kMaxColumns], int numColors, int width,
+	FieldState::Column rows, int puyoToClear, FieldState::Column popped[FieldState::kMaxColumns]);
+
+}
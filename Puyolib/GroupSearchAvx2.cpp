@@ -0,0 +1,34 @@
+// This file is compiled with AVX2 enabled. Only call into it after checking
+// the CPU supports it (see GroupSearch.cpp). It must not include anything but the
+// kernel and the intrinsics, see GroupSearchKernel.h.
+
+#include "GroupSearchKernel.h"
+#include <immintrin.h>
+
+namespace ppvs {
+
+namespace {
+
+struct Avx2Ops {
+	using Vec = __m256i;
+	static constexpr int kLanes = 8;
+
+	static Vec load(const Column* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+	static void store(Column* p, const Vec v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+	static Vec bitOr(const Vec a, const Vec b) { return _mm256_or_si256(a, b); }
+	static Vec bitAnd(const Vec a, const Vec b) { return _mm256_and_si256(a, b); }
+	static Vec up(const Vec v) { return _mm256_slli_epi32(v, 1); }
+	static Vec down(const Vec v) { return _mm256_srli_epi32(v, 1); }
+	static bool differs(const Vec a, const Vec b) { return _mm256_movemask_epi8(_mm256_cmpeq_epi32(a, b)) != -1; }
+};
+
+}
+
+int findPoppingGroupsAvx2(const Column colors[][kKernelMaxColumns], const int numColors, const int width,
+	const Column rows, const int puyoToClear, Column popped[kKernelMaxColumns])
+{
+	GroupSearchKernel<Avx2Ops> kernel;
+	return kernel.run(colors, numColors, width, rows, puyoToClear, popped);
+}
+
+}
@@ -0,0 +1,233 @@
+#pragma once
+
+// Group search kernel shared by the scalar, SSE2 and AVX2 builds in GroupSearch.cpp
+// and GroupSearchAvx2.cpp. Everything in here has internal linkage, so every
+// translation unit gets its own copy compiled for its own instruction set.
+// GroupSearchAvx2.cpp is built with AVX2 enabled, so this header must not pull in
+// any inline or template code that other translation units use as well: the linker
+// keeps a single copy of those, and it could be the AVX2 one. That is why it only
+// includes <cstdint> and does not use FieldState or the standard algorithms.
+
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace ppvs {
+
+namespace {
+
+// Same as FieldState::Column, kMaxColumns and kMaxColors, checked in GroupSearch.cpp
+using Column = uint32_t;
+constexpr int kKernelMaxColumns = 32;
+constexpr int kKernelMaxColors = 8;
+
+// Colors are laid out side by side with an empty column in between, so a single
+// pass dilates every color at once and groups can't leak into the next color.
+// Index 0 is an empty column too, and there is padding for the widest vector.
+constexpr int kGroupSearchBuffer = 1 + kKernelMaxColors * (kKernelMaxColumns + 1) + 8 + 1;
+
+inline int popCount(const Column v)
+{
+#if defined(_MSC_VER)
+	return static_cast<int>(__popcnt(v));
+#else
+	return __builtin_popcount(v);
+#endif
+}
+
+inline void fillColumns(Column* first, const Column* last, const Column value)
+{
+	for (; first != last; ++first) {
+		*first = value;
+	}
+}
+
+inline void copyColumns(const Column* first, const Column* last, Column* out)
+{
+	for (; first != last; ++first, ++out) {
+		*out = *first;
+	}
+}
+
+struct ScalarOps {
+	using Vec = Column;
+	static constexpr int kLanes = 1;
+
+	static Vec load(const Column* p) { return *p; }
+	static void store(Column* p, const Vec v) { *p = v; }
+	static Vec bitOr(const Vec a, const Vec b) { return a | b; }
+	static Vec bitAnd(const Vec a, const Vec b) { return a & b; }
+	static Vec up(const Vec v) { return v << 1; }
+	static Vec down(const Vec v) { return v >> 1; }
+	static bool differs(const Vec a, const Vec b) { return a != b; }
+};
+
+template <class Ops>
+struct GroupSearchKernel {
+	using Vec = typename Ops::Vec;
+
+	int m_stride = 1; // Columns per color, including the empty column
+	int m_end = 1; // One past the last column in use, rounded up to full vectors
+	alignas(32) Column m_mask[kGroupSearchBuffer];
+	alignas(32) Column m_group[kGroupSearchBuffer];
+
+	// Grow m_group inside m_mask until it stops changing
+	void dilate()
+	{
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (int i = 1; i < m_end; i += Ops::kLanes) {
+				const Vec g = Ops::load(m_group + i);
+				Vec grown = Ops::bitOr(Ops::bitOr(g, Ops::up(g)), Ops::down(g));
+				grown = Ops::bitOr(grown, Ops::bitOr(Ops::load(m_group + i - 1), Ops::load(m_group + i + 1)));
+				grown = Ops::bitAnd(grown, Ops::load(m_mask + i));
+				if (Ops::differs(grown, g)) {
+					Ops::store(m_group + i, grown);
+					changed = true;
+				}
+			}
+		}
+	}
+
+	// Cells from which every group of at least n puyos (n <= 4) can be reached.
+	// A group of 2 has a cell with a neighbor, a group of 3 has a cell with two
+	// neighbors, and a group of 4 or more has a cell with three neighbors or two
+	// adjacent cells with two neighbors each.
+	void seedSmallGroups(const int n)
+	{
+		for (int i = 1; i < m_end; i += Ops::kLanes) {
+			const Vec m = Ops::load(m_mask + i);
+			const Vec u = Ops::bitAnd(m, Ops::down(m));
+			const Vec d = Ops::bitAnd(m, Ops::up(m));
+			const Vec l = Ops::bitAnd(m, Ops::load(m_mask + i - 1));
+			const Vec r = Ops::bitAnd(m, Ops::load(m_mask + i + 1));
+			if (n == 2) {
+				Ops::store(m_group + i, Ops::bitOr(Ops::bitOr(u, d), Ops::bitOr(l, r)));
+				continue;
+			}
+			const Vec ud = Ops::bitAnd(u, d);
+			const Vec lr = Ops::bitAnd(l, r);
+			const Vec two = Ops::bitOr(Ops::bitOr(ud, lr), Ops::bitAnd(Ops::bitOr(u, d), Ops::bitOr(l, r)));
+			Ops::store(m_group + i, two);
+		}
+		if (n == 3) {
+			return;
+		}
+
+		// Keep cells with two neighbors that touch another one, or that have three neighbors
+		alignas(32) Column seed[kGroupSearchBuffer] {};
+		for (int i = 1; i < m_end; i += Ops::kLanes) {
+			const Vec m = Ops::load(m_mask + i);
+			const Vec two = Ops::load(m_group + i);
+			const Vec u = Ops::bitAnd(m, Ops::down(m));
+			const Vec d = Ops::bitAnd(m, Ops::up(m));
+			const Vec l = Ops::bitAnd(m, Ops::load(m_mask + i - 1));
+			const Vec r = Ops::bitAnd(m, Ops::load(m_mask + i + 1));
+			const Vec three = Ops::bitOr(Ops::bitAnd(Ops::bitAnd(u, d), Ops::bitOr(l, r)),
+				Ops::bitAnd(Ops::bitAnd(l, r), Ops::bitOr(u, d)));
+			Vec touching = Ops::bitOr(Ops::up(two), Ops::down(two));
+			touching = Ops::bitOr(touching, Ops::bitOr(Ops::load(m_group + i - 1), Ops::load(m_group + i + 1)));
+			Ops::store(seed + i, Ops::bitOr(three, Ops::bitAnd(two, touching)));
+		}
+		copyColumns(seed, seed + m_end + 1, m_group);
+	}
+
+	int run(const Column colors[][kKernelMaxColumns], const int numColors, const int width,
+		const Column rows, const int puyoToClear, Column popped[kKernelMaxColumns])
+	{
+		// Lay out the non-empty colors
+		m_stride = width + 1;
+		int blocks = 0;
+		for (int c = 0; c < numColors; c++) {
+			Column* block = m_mask + 1 + blocks * m_stride;
+			Column any = 0;
+			for (int x = 0; x < width; x++) {
+				block[x] = colors[c][x] & rows;
+				any |= block[x];
+			}
+			if (!any) {
+				continue;
+			}
+			block[width] = 0;
+			blocks++;
+		}
+		if (blocks == 0) {
+			return 0;
+		}
+		const int used = blocks * m_stride;
+		m_end = 1 + (used + Ops::kLanes - 1) / Ops::kLanes * Ops::kLanes;
+		m_mask[0] = 0;
+		fillColumns(m_mask + 1 + used, m_mask + m_end + 1, 0);
+		fillColumns(m_group, m_group + m_end + 1, 0);
+
+		if (puyoToClear <= 1) {
+			copyColumns(m_mask, m_mask + m_end + 1, m_group);
+		} else if (puyoToClear <= 4) {
+			seedSmallGroups(puyoToClear);
+			dilate();
+		} else {
+			findLargeGroups(blocks, width, puyoToClear);
+		}
+
+		// Fold the colors back together
+		int count = 0;
+		for (int b = 0; b < blocks; b++) {
+			const Column* block = m_group + 1 + b * m_stride;
+			for (int x = 0; x < width; x++) {
+				popped[x] |= block[x];
+				count += popCount(block[x]);
+			}
+		}
+		return count;
+	}
+
+	// Flood one group per color at a time and keep the ones that are large enough
+	void findLargeGroups(const int blocks, const int width, const int puyoToClear)
+	{
+		alignas(32) Column result[kGroupSearchBuffer] {};
+
+		bool seeded = true;
+		while (seeded) {
+			seeded = false;
+			fillColumns(m_group, m_group + m_end + 1, 0);
+			for (int b = 0; b < blocks; b++) {
+				const int offset = 1 + b * m_stride;
+				for (int x = 0; x < width; x++) {
+					if (const Column m = m_mask[offset + x]) {
+						m_group[offset + x] = m & (~m + 1);
+						seeded = true;
+						break;
+					}
+				}
+			}
+			if (!seeded) {
+				break;
+			}
+
+			dilate();
+
+			for (int b = 0; b < blocks; b++) {
+				const int offset = 1 + b * m_stride;
+				int size = 0;
+				for (int x = 0; x < width; x++) {
+					size += popCount(m_group[offset + x]);
+				}
+				for (int x = 0; x < width; x++) {
+					m_mask[offset + x] &= ~m_group[offset + x];
+					if (size >= puyoToClear) {
+						result[offset + x] |= m_group[offset + x];
+					}
+				}
+			}
+		}
+
+		copyColumns(result, result + m_end + 1, m_group);
+	}
+};
+
+}
+
+}
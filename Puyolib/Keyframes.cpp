@@ -0,0 +1,72 @@
+#include "Keyframes.h"
+#include <algorithm>
+
+namespace ppvs {
+
+void KeyframeStore::configure(const int interval, const size_t budget)
+{
+	m_baseInterval = std::max(interval, 1);
+	m_interval = m_baseInterval;
+	m_budget = budget;
+}
+
+void KeyframeStore::clear()
+{
+	m_keyframes.clear();
+	m_interval = m_baseInterval;
+	m_used = 0;
+}
+
+// The first frame always gets one, after that only new frames on the interval
+bool KeyframeStore::wants(const int frame) const
+{
+	if (m_budget == 0) {
+		return false;
+	}
+	if (m_keyframes.empty()) {
+		return true;
+	}
+	return frame > m_keyframes.back().frame && frame % m_interval == 0;
+}
+
+void KeyframeStore::add(const int frame, std::vector<char>&& state)
+{
+	if (!m_keyframes.empty() && frame <= m_keyframes.back().frame) {
+		return;
+	}
+
+	m_used += state.capacity();
+	m_keyframes.push_back({ frame, std::move(state) });
+	while (m_used > m_budget && m_keyframes.size() > 2) {
+		thin();
+	}
+}
+
+const Keyframe* KeyframeStore::find(const int frame) const
+{
+	const auto it = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), frame, [](const int f, const Keyframe& keyframe) {
+		return f < keyframe.frame;
+	});
+	if (it == m_keyframes.begin()) {
+		return nullptr;
+	}
+	return &*(it - 1);
+}
+
+// Keep the first keyframe and the ones on the doubled interval
+void KeyframeStore::thin()
+{
+	m_interval *= 2;
+	std::vector<Keyframe> kept;
+	kept.reserve(m_keyframes.size() / 2 + 1);
+	m_used = 0;
+	for (size_t i = 0; i < m_keyframes.size(); i++) {
+		if (i == 0 || m_keyframes[i].frame % m_interval == 0) {
+			m_used += m_keyframes[i].state.capacity();
+			kept.push_back(std::move(m_keyframes[i]));
+		}
+	}
+	m_keyframes.swap(kept);
+}
+
+}
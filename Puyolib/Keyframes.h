@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace ppvs {
+
+// Game state at a frame of the replay that is playing (see Game::syncState)
+struct Keyframe {
+	int frame = 0;
+	std::vector<char> state;
+};
+
+// Keyframes captured every so many frames while a replay plays, so seeking only has
+// to simulate from the nearest one. When the memory budget is exceeded, every other
+// keyframe is dropped and the interval doubles, which keeps them evenly spread.
+class KeyframeStore final {
+public:
+	KeyframeStore() = default;
+	~KeyframeStore() = default;
+
+	KeyframeStore(const KeyframeStore&) = delete;
+	KeyframeStore& operator=(const KeyframeStore&) = delete;
+	KeyframeStore(KeyframeStore&&) = delete;
+	KeyframeStore& operator=(KeyframeStore&&) = delete;
+
+	// Also resets the interval to the configured one
+	void configure(int interval, size_t budget);
+	void clear();
+
+	// Whether a keyframe should be taken at this frame
+	[[nodiscard]] bool wants(int frame) const;
+	void add(int frame, std::vector<char>&& state);
+
+	// Latest keyframe at or before frame, nullptr if there is none
+	[[nodiscard]] const Keyframe* find(int frame) const;
+
+	[[nodiscard]] bool empty() const { return m_keyframes.empty(); }
+	[[nodiscard]] size_t size() const { return m_keyframes.size(); }
+	[[nodiscard]] int getInterval() const { return m_interval; }
+	[[nodiscard]] size_t getMemoryUsage() const { return m_used; }
+
+private:
+	void thin();
+
+	std::vector<Keyframe> m_keyframes; // By frame
+	int m_baseInterval = 120;
+	int m_interval = 120;
+	size_t m_budget = 0;
+	size_t m_used = 0;
+};
+
+}
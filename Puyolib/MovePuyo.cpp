@@ -2,6 +2,7 @@
 #include "../PVS_ENet/PVS_Client.h"
 #include "Game.h"
 #include "Player.h"
+#include "StateStream.h"
 #include <algorithm>
 #include <cmath>
 
@@ -1350,6 +1351,43 @@ void MovePuyo::placeShadow()
 }
 
 // Draw move puyo on screen
+// Position, rotation and colors of the moving puyos, the sprites follow from them
+void MovePuyo::syncState(StateStream& stream)
+{
+	stream.value(m_visible);
+	stream.value(m_type);
+	stream.value(m_spawnX);
+	stream.value(m_spawnY);
+	stream.value(m_color1);
+	stream.value(m_color2);
+	stream.value(m_bigColor);
+	stream.value(m_shadowPos);
+	stream.value(m_pos);
+	stream.value(m_posReal);
+	stream.value(m_posXEye1Real);
+	stream.value(m_posYEye1Real);
+	stream.value(m_posXEye2Real);
+	stream.value(m_posYEye2Real);
+	stream.value(m_rotation);
+	stream.value(m_movePuyoAngle);
+	stream.value(m_sprite1Angle);
+	stream.value(m_sprite2Angle);
+	stream.value(m_flip);
+	stream.value(m_transpose);
+	stream.value(m_fallCounter);
+	stream.value(m_rotateCounter);
+	stream.value(m_flipCounter);
+	stream.value(m_dropCounter);
+	stream.value(m_holdCounter);
+	stream.value(m_qScale);
+	stream.value(m_tripletRot);
+	stream.value(m_initCalled);
+
+	if (stream.isLoading()) {
+		setSprite();
+	}
+}
+
 void MovePuyo::draw()
 {
 	drawQuick();
@@ -8,6 +8,7 @@
 namespace ppvs {
 
 class Player;
+class StateStream;
 
 class Shadow {
 public:
@@ -131,6 +132,7 @@ public:
 	bool isAnyTouching(Direction) const;
 	void placePuyos(); // Phase 10 end
 	void placeShadow();
+	void syncState(StateStream& stream);
 
 	// Draw
 	void draw();
@@ -1,4 +1,6 @@
 #include "NextPuyo.h"
+#include "StateStream.h"
+#include <algorithm>
 
 namespace ppvs
 {
@@ -134,6 +136,27 @@ void NextPuyo::update(const std::deque<int>& dq, const PuyoCharacter p, const in
 	}
 }
 
+// Colors and where the pairs are in the move animation
+void NextPuyo::syncState(StateStream& stream)
+{
+	stream.value(m_color11); stream.value(m_color12);
+	stream.value(m_color21); stream.value(m_color22);
+	stream.value(m_color31); stream.value(m_color32);
+	stream.value(m_type1); stream.value(m_type2); stream.value(m_type3);
+	stream.value(m_pair1X); stream.value(m_pair1Y);
+	stream.value(m_pair2X); stream.value(m_pair2Y);
+	stream.value(m_pair3X); stream.value(m_pair3Y);
+	stream.value(m_goNext);
+
+	if (stream.isLoading())
+	{
+		setPuyo();
+		const float scale = (33.0f + static_cast<float>(std::min(m_goNext, 16) - 1)) / 48.0f;
+		m_sprite21.setScale(m_goNext > 0 ? scale : 33.0f / 48.0f);
+		m_sprite22.setScale(m_goNext > 0 ? scale : 33.0f / 48.0f);
+	}
+}
+
 void NextPuyo::draw()
 {
 	// Set positions of sprites
@@ -7,6 +7,8 @@
 
 namespace ppvs {
 
+class StateStream;
+
 class NextPuyo {
 public:
 	NextPuyo();
@@ -23,6 +25,7 @@ public:
 	void setPuyo();
 	void play();
 	void update(const std::deque<int>& dq, PuyoCharacter p, int turn);
+	void syncState(StateStream& stream);
 	
     [[nodiscard]] int getOrientation() const;
 	void draw();
@@ -0,0 +1,51 @@
+#include "NullFrontend.h"
+
+namespace ppvs {
+
+FeImage* NullFrontend::loadImage(const char*)
+{
+	return &m_image;
+}
+
+FeImage* NullFrontend::loadImage(const std::string&)
+{
+	return &m_image;
+}
+
+FeFont* NullFrontend::loadFont(const char*, double)
+{
+	return nullptr;
+}
+
+FeShader* NullFrontend::loadShader(const char*)
+{
+	return nullptr;
+}
+
+FeSound* NullFrontend::loadSound(const char*)
+{
+	return nullptr;
+}
+
+FeSound* NullFrontend::loadSound(const std::string&)
+{
+	return nullptr;
+}
+
+FeInput NullFrontend::inputState(const int pl)
+{
+	if (pl < 0 || pl >= kMaxInputs) {
+		return {};
+	}
+	return m_input[pl];
+}
+
+void NullFrontend::setInputState(const int pl, const FeInput input)
+{
+	if (pl < 0 || pl >= kMaxInputs) {
+		return;
+	}
+	m_input[pl] = input;
+}
+
+}
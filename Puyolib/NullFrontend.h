@@ -0,0 +1,90 @@
+#pragma once
+
+#include "Frontend.h"
+
+namespace ppvs {
+
+// Image without pixels. Every image request returns the same instance.
+class NullImage final : public FeImage {
+public:
+	NullImage() = default;
+	~NullImage() override = default;
+
+	NullImage(const NullImage&) = delete;
+	NullImage& operator=(const NullImage&) = delete;
+	NullImage(NullImage&&) = delete;
+	NullImage& operator=(NullImage&&) = delete;
+
+	int width() override { return 0; }
+	int height() override { return 0; }
+	FePixel pixel(int, int) override { return { 0, 0, 0, 0 }; }
+	bool error() override { return false; }
+
+	void setFilter(FilterType) override { }
+};
+
+// Frontend that renders nothing and plays nothing, for simulating games without
+// a display or audio device (replay verification, AI self-play, batch analysis).
+// Fonts, shaders and sounds are never created; Puyolib treats them as missing.
+// Combine with GameSettings::headless to also skip presentation-only updates.
+class NullFrontend final : public Frontend {
+public:
+	NullFrontend() = default;
+	~NullFrontend() override = default;
+
+	NullFrontend(const NullFrontend&) = delete;
+	NullFrontend& operator=(const NullFrontend&) = delete;
+	NullFrontend(NullFrontend&&) = delete;
+	NullFrontend& operator=(NullFrontend&&) = delete;
+
+	// - Graphics -
+	FeImage* loadImage(const char* nameU8) override;
+	FeImage* loadImage(const std::string& nameU8) override;
+	FeFont* loadFont(const char* nameU8, double fontSize) override;
+
+	void pushMatrix() override { }
+	void popMatrix() override { }
+	void identity() override { }
+	void translate(float, float, float) override { }
+	void rotate(float, float, float, float) override { }
+	void scale(float, float, float) override { }
+
+	ViewportGeometry viewport() override { return { 640, 480 }; }
+
+	bool hasShaders() override { return false; }
+	FeShader* loadShader(const char* source) override;
+
+	void setBlendMode(BlendingMode) override { }
+	void setColor(int, int, int, int) override { }
+	void unsetColor() override { }
+
+	void setDepthFunction(DepthFunction) override { }
+	void clearDepth() override { }
+
+	void enableAlphaTesting(float) override { }
+	void disableAlphaTesting() override { }
+
+	void drawRect(FeImage*, double, double, double, double) override { }
+	void drawRects(FeImage*, const FeQuad*, size_t) override { }
+
+	void clear() override { }
+	void swapBuffers() override { }
+
+	// - Audio -
+	FeSound* loadSound(const char* nameU8) override;
+	FeSound* loadSound(const std::string& nameU8) override;
+	void musicEvent(FeMusicEvent) override { }
+	void musicVolume(float, bool) override { }
+
+	// - Input -
+	FeInput inputState(int pl) override;
+	void setInputState(int pl, FeInput input);
+
+private:
+	static constexpr int kMaxInputs = 16;
+
+	NullImage m_image;
+	FeInput m_input[kMaxInputs] {};
+};
+
+}
@@ -18,110 +18,6 @@ int getDigits(const int number)
 	return digits ? digits : 1;
 }
 
-Particle::Particle(const float x, const float y, const int color, const GameData* data)
-{
-	m_timer = 0;
-	m_scale = 1;
-
-	// Set sprite
-	m_sprite.setImage(data->imgPuyo);
-	m_sprite.setSubRect(5 * kPuyoX + color * kPuyoX, 11 * kPuyoY, kPuyoX, kPuyoY);
-	m_sprite.setCenter(11, 10);
-
-	// Set position
-	// Don't forget to that the position must be absolute
-	m_posX = x;
-	m_posY = y;
-
-	// Set random initial speed
-	m_speedX = static_cast<float>(getRandom(601) - 300) / 100.0f;
-	m_gravityTimer = -6 + static_cast<float>(getRandom(333)) / 100.0f;
-}
-
-Particle::~Particle() = default;
-
-void Particle::draw(FeRenderTarget* ri)
-{
-	m_sprite.setPosition(m_posX, m_posY);
-	m_sprite.setScale(m_scale, m_scale);
-	m_sprite.draw(ri);
-}
-
-// Particle's main function
-void Particle::play()
-{
-	m_timer++;
-	m_scale = 1.2f - static_cast<float>(m_timer) * 0.05f;
-	if (m_scale < 0.1f) {
-		m_sprite.setVisible(false);
-	}
-	m_gravityTimer += 0.3f;
-	m_posY += m_gravityTimer;
-	m_posX += m_speedX;
-}
-
-bool Particle::shouldDestroy() const
-{
-	return m_timer > 60;
-}
-
-//===========================================================================
-
-ParticleThrow::ParticleThrow(const float x, const float y, const int color, const GameData* data)
-{
-	// Set sprite
-	m_sprite.setImage(data->imgPuyo);
-	const int xRect = 2 * kPuyoX * (color / 2);
-	const int yRect = 12 * kPuyoY + kPuyoY * (color % 2);
-	m_sprite.setSubRect(xRect, yRect, kPuyoX, kPuyoY);
-	m_sprite.setCenter(kPuyoX / 2, kPuyoY / 2);
-
-	// Set position
-	// Don't forget to that the position must be absolute
-	m_posX = x;
-	m_posY = y;
-
-	// Set random initial speed
-	m_speedX = static_cast<float>(getRandom(601) - 300) / 100.0f;
-	m_gravityTimer = -6.f + static_cast<float>(getRandom(333)) / 100.0f;
-	m_rotateSpeed = static_cast<float>((getRandom(21) - 10) * 2);
-}
-
-ParticleThrow::~ParticleThrow() = default;
-
-void ParticleThrow::draw(FeRenderTarget* ri)
-{
-	m_sprite.setPosition(m_posX, m_posY);
-	m_sprite.setScale(m_scale, m_scale);
-	m_sprite.setRotation(m_rotate);
-	m_sprite.draw(ri);
-}
-
-// Particle's main function
-void ParticleThrow::play()
-{
-	m_timer++;
-
-	// Scale
-	m_scale = 1.2f + static_cast<float>(m_timer) * 0.03f;
-	if (m_scale < 0.1f) {
-        m_sprite.setVisible(false);
-    }
-
-    // Rotate
-	m_rotate += m_rotateSpeed;
-	m_gravityTimer += 0.5f;
-	m_posY += m_gravityTimer;
-	m_posX += m_speedX;
-}
-
-bool ParticleThrow::shouldDestroy() const
-{
-	return m_timer > 60;
-}
-
-//===========================================================================
-
 ChainWord::ChainWord(const GameData* data)
 {
 	// Set sprite
@@ -169,6 +65,12 @@ void ChainWord::showAt(const float x, const float y, const int n)
 	m_timer = 0;
 }
 
+void ChainWord::hide()
+{
+	m_visible = false;
+	m_timer = 100;
+}
+
 void ChainWord::move()
 {
 	if (m_timer > 50) {
@@ -534,6 +436,13 @@ void ScoreCounter::setPointBonus(int p, int b)
 	m_timer = 0;
 }
 
+void ScoreCounter::play()
+{
+	if (m_timer < 31) {
+		m_timer++;
+	}
+}
+
 void ScoreCounter::draw()
 {
 	// Set sprites for normal view
@@ -564,9 +473,6 @@ void ScoreCounter::draw()
 	for (auto& sprite : m_sprite) {
 		sprite.draw(m_data->front);
 	}
-	if (m_timer < 31) {
-		m_timer++;
-	}
 }
 
 void ScoreCounter::setImage(const int spr, const int score)
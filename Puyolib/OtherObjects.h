@@ -4,55 +4,109 @@
 #include "Frontend.h"
 #include "Sprite.h"
 #include "global.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
 
 namespace ppvs {
 
-// The particles puyos spit out after popping
-class Particle {
+// A fixed number of effects of one kind. The slots are allocated once with the pool,
+// away from the owner so it stays small. Effects are made in place in them, so
+// making and removing effects never touches the heap. The live ones are listed in
+// the order they were made. Handles stop working once their effect is gone. When
+// every slot is taken, the oldest effect makes room.
+template <typename T, size_t Capacity>
+class EffectPool final {
 public:
-	Particle(float, float, int, const GameData*);
-	~Particle();
-
-	Particle(const Particle&) = delete;
-	Particle& operator=(const Particle&) = delete;
-	Particle(Particle&&) = delete;
-	Particle& operator=(Particle&&) = delete;
-
-	[[nodiscard]] int getTimer() const { return m_timer; }
-	void draw(FeRenderTarget*);
-	void play();
-    [[nodiscard]] bool shouldDestroy() const;
+	struct Handle {
+		uint32_t slot = 0;
+		uint32_t generation = 0; // 0 for no effect
+	};
+
+	EffectPool()
+		: m_slots(std::make_unique<Slot[]>(Capacity))
+	{
+		for (size_t i = 0; i < Capacity; i++) {
+			m_free[i] = static_cast<uint32_t>(Capacity - 1 - i);
+		}
+	}
+	~EffectPool() = default;
+
+	EffectPool(const EffectPool&) = delete;
+	EffectPool& operator=(const EffectPool&) = delete;
+	EffectPool(EffectPool&&) = delete;
+	EffectPool& operator=(EffectPool&&) = delete;
+
+	template <typename... Args>
+	Handle acquire(Args&&... args)
+	{
+		if (m_count == Capacity) {
+			releaseIf([first = true](const T&) mutable { return std::exchange(first, false); });
+		}
+
+		const uint32_t i = m_free[--m_freeCount];
+		Slot& slot = m_slots[i];
+		slot.effect.emplace(std::forward<Args>(args)...);
+		slot.generation++;
+		m_live[m_count++] = i;
+		return { i, slot.generation };
+	}
+
+	// nullptr if the effect is gone
+	[[nodiscard]] T* get(const Handle handle)
+	{
+		if (handle.slot >= Capacity || m_slots[handle.slot].generation != handle.generation || !m_slots[handle.slot].effect) {
+			return nullptr;
+		}
+		return &*m_slots[handle.slot].effect;
+	}
+
+	// Oldest first
+	template <typename F>
+	void forEach(F&& f)
+	{
+		for (size_t i = 0; i < m_count; i++) {
+			f(*m_slots[m_live[i]].effect);
+		}
+	}
+
+	template <typename Predicate>
+	void releaseIf(Predicate&& predicate)
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < m_count; i++) {
+			const uint32_t slot = m_live[i];
+			if (predicate(static_cast<const T&>(*m_slots[slot].effect))) {
+				m_slots[slot].effect.reset();
+				m_free[m_freeCount++] = slot;
+			} else {
+				m_live[kept++] = slot;
+			}
+		}
+		m_count = kept;
+	}
+
+	void clear()
+	{
+		releaseIf([](const T&) { return true; });
+	}
+
+	[[nodiscard]] size_t size() const { return m_count; }
+	[[nodiscard]] bool empty() const { return m_count == 0; }
 
 private:
-	float m_posX, m_posY, m_speedX;
-	float m_gravityTimer;
-	float m_scale;
-	int m_timer;
-	Sprite m_sprite;
-};
-
-// Puyos that are "thrown" out
-class ParticleThrow {
-public:
-	ParticleThrow(float, float, int, const GameData*);
-	~ParticleThrow();
-
-	ParticleThrow(const ParticleThrow&) = delete;
-	ParticleThrow& operator=(const ParticleThrow&) = delete;
-	ParticleThrow(ParticleThrow&&) = delete;
-	ParticleThrow& operator=(ParticleThrow&&) = delete;
-
-	[[nodiscard]] int getTimer() const { return m_timer; }
-	void draw(FeRenderTarget*);
-	void play();
-    [[nodiscard]] bool shouldDestroy() const;
-
-private:
-	float m_posX = 0.f, m_posY = 0.f, m_speedX = 0.f, m_rotateSpeed = 0.f;
-	float m_gravityTimer = 0.f;
-	float m_scale = 1.f, m_rotate = 0.;
-	int m_timer = 0;
-	Sprite m_sprite {};
+	struct Slot {
+		std::optional<T> effect;
+		uint32_t generation = 0;
+	};
+
+	std::unique_ptr<Slot[]> m_slots;
+	std::array<uint32_t, Capacity> m_live {}; // Slots of the live effects, oldest first
+	std::array<uint32_t, Capacity> m_free {};
+	size_t m_count = 0;
+	size_t m_freeCount = Capacity;
 };
 
 // Object that shows the word XX chain
@@ -70,6 +124,7 @@ public:
 	void setScale(const float scale) { m_scale = scale; }
 	void draw(FeRenderTarget* rw);
 	void showAt(float x, float y, int n);
+	void hide();
 	void move();
 
 private:
@@ -202,6 +257,7 @@ public:
 	void init(GameData*, float x, float y, float scale);
 	void setCounter(int);
 	void setPointBonus(int, int);
+	void play(); // Once per frame, the point x bonus shows for 30 frames
 	void draw();
 
 private:
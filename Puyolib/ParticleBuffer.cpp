@@ -0,0 +1,86 @@
+#include "ParticleBuffer.h"
+#include <algorithm>
+
+namespace ppvs {
+
+ParticleBuffer::ParticleBuffer(const ParticleStyle& style, const size_t capacity)
+	: m_style(style)
+	, m_capacity(std::max<size_t>(capacity, 1))
+{
+}
+
+void ParticleBuffer::emit(const float x, const float y, const float subX, const float subY, const float speedX, const float speedY, const float rotateSpeed)
+{
+	if (m_posX.empty()) {
+		for (auto* array : { &m_posX, &m_posY, &m_speedX, &m_speedY, &m_rotation, &m_rotateSpeed, &m_scale, &m_subX, &m_subY }) {
+			array->resize(m_capacity);
+		}
+		m_age.resize(m_capacity);
+		m_quads.reserve(m_capacity);
+	}
+	if (m_count == m_capacity) {
+		m_first = slot(1);
+		m_count--;
+	}
+
+	const size_t i = slot(m_count++);
+	m_posX[i] = x;
+	m_posY[i] = y;
+	m_speedX[i] = speedX;
+	m_speedY[i] = speedY;
+	m_rotation[i] = 0.f;
+	m_rotateSpeed[i] = rotateSpeed;
+	m_scale[i] = 1.f;
+	m_subX[i] = subX;
+	m_subY[i] = subY;
+	m_age[i] = 0;
+}
+
+void ParticleBuffer::update()
+{
+	// The live particles are at most two runs of slots, the second one starting at 0
+	const size_t firstEnd = std::min(m_first + m_count, m_capacity);
+	const size_t runs[2][2] = { { m_first, firstEnd }, { 0, m_count - (firstEnd - m_first) } };
+	for (const auto& run : runs) {
+		for (size_t i = run[0]; i < run[1]; i++) {
+			m_age[i]++;
+			m_scale[i] = m_style.scaleStart + static_cast<float>(m_age[i]) * m_style.scaleGrowth;
+			m_rotation[i] += m_rotateSpeed[i];
+			m_speedY[i] += m_style.gravity;
+			m_posY[i] += m_speedY[i];
+			m_posX[i] += m_speedX[i];
+		}
+	}
+
+	while (m_count > 0 && m_age[m_first] > kLifetime) {
+		m_first = slot(1);
+		m_count--;
+	}
+}
+
+void ParticleBuffer::clear()
+{
+	m_first = 0;
+	m_count = 0;
+}
+
+void ParticleBuffer::draw(FeRenderTarget* target, FeImage* image) const
+{
+	m_quads.clear();
+	for (size_t n = 0; n < m_count; n++) {
+		const size_t i = slot(n);
+		if (m_scale[i] < 0.1f) {
+			continue;
+		}
+		m_quads.push_back({ m_posX[i], m_posY[i], m_style.centerX, m_style.centerY, m_scale[i], m_rotation[i], m_subX[i], m_subY[i], m_style.width, m_style.height });
+	}
+	if (m_quads.empty()) {
+		return;
+	}
+
+	target->setBlendMode(BlendingMode::AlphaBlending);
+	target->setColor(255, 255, 255, 255);
+	target->drawRects(image, m_quads.data(), m_quads.size());
+}
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Frontend.h"
+#include <cstdint>
+#include <vector>
+
+namespace ppvs {
+
+// How the particles of a buffer move and look
+struct ParticleStyle {
+	float gravity; // Added to the vertical speed every frame
+	float scaleStart, scaleGrowth; // Scale after n frames is scaleStart + n * scaleGrowth
+	float centerX, centerY;
+	float width, height;
+};
+
+// Particles of one kind, each attribute in its own array. Every particle lives
+// for the same number of frames, so the buffer is a ring in the order they were
+// emitted: the ones that expire are always at the front and the draw order stays
+// the same as the emit order. When the ring is full, the oldest particle makes room.
+class ParticleBuffer final {
+public:
+	static constexpr int kLifetime = 60;
+
+	ParticleBuffer(const ParticleStyle& style, size_t capacity);
+	~ParticleBuffer() = default;
+
+	ParticleBuffer(const ParticleBuffer&) = delete;
+	ParticleBuffer& operator=(const ParticleBuffer&) = delete;
+	ParticleBuffer(ParticleBuffer&&) = delete;
+	ParticleBuffer& operator=(ParticleBuffer&&) = delete;
+
+	// Speed is in pixels per frame, rotation speed in the unit of FeRenderTarget::rotate
+	void emit(float x, float y, float subX, float subY, float speedX, float speedY, float rotateSpeed = 0.f);
+	void update();
+	void clear();
+
+	// All visible particles in one drawRects call
+	void draw(FeRenderTarget* target, FeImage* image) const;
+
+	[[nodiscard]] size_t size() const { return m_count; }
+
+private:
+	[[nodiscard]] size_t slot(const size_t i) const { return (m_first + i) % m_capacity; }
+
+	ParticleStyle m_style;
+	size_t m_capacity;
+	size_t m_first = 0; // Slot of the oldest particle
+	size_t m_count = 0;
+
+	// Sized on the first emit, fields of a headless game never get any
+	std::vector<float> m_posX, m_posY;
+	std::vector<float> m_speedX, m_speedY;
+	std::vector<float> m_rotation, m_rotateSpeed;
+	std::vector<float> m_scale;
+	std::vector<float> m_subX, m_subY;
+	std::vector<uint8_t> m_age;
+	mutable std::vector<FeQuad> m_quads; // Scratch space of draw
+};
+
+}
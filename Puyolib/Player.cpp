@@ -2,6 +2,7 @@
 #include "../PVS_ENet/PVS_Client.h"
 #include "Game.h"
 #include "RNG/PuyoRng.h"
+#include "StateStream.h"
 #include <algorithm>
 #include <cmath>
 
@@ -9,6 +10,13 @@ using namespace std;
 
 namespace ppvs {
 
+namespace {
+
+// Scale of the rematch icon after it pops up, one value per frame
+const EasingTable kRematchIconScale(Easing::Elastic, 2, 1, 60, -5, 2);
+
+}
+
 Player::Player(const PlayerType type, const int playerNum, const int totalPlayers, Game* g)
 	: m_feverGauge(g->m_data)
 	, m_feverLight(g->m_data)
@@ -70,6 +78,14 @@ Player::Player(const PlayerType type, const int playerNum, const int totalPlayer
 	// Give CPU an AI
 	if (m_type == CPU) {
 		m_cpuAi = new AI(this);
+		const GameSettings* settings = m_currentGame->m_settings;
+		if (const auto strategy = settings->cpuStrategies.find(playerNum); strategy != settings->cpuStrategies.end()) {
+			BeamSearchSettings beamSettings;
+			beamSettings.beamWidth = settings->cpuBeamWidth;
+			beamSettings.nodeBudget = settings->cpuNodeBudget;
+			beamSettings.timeLimit = settings->cpuTimeLimit;
+			m_cpuAi->setStrategy(strategy->second, beamSettings);
+		}
 	}
 
 	// TEMP: in online version, other players must inform each-other from their randomSeedFever
@@ -228,6 +244,7 @@ void Player::reset()
 	// Reset replay values
 	if (m_currentGame->m_settings->recording == RecordState::RECORDING) {
 		m_recordMessages.clear();
+		m_recordHashes.clear();
 	}
 	m_activeAtStart = 0;
 
@@ -266,6 +283,7 @@ void Player::initValues(int randomSeed)
 
 	// Init nuisance drop pattern RNG
 	m_rngNuisanceDrop->init_genrand(randomSeed);
+	m_nuisanceDropCalls = 0;
 	m_nuisanceList.clear();
 
 	// Other values to initialize
@@ -326,6 +344,13 @@ void Player::initValues(int randomSeed)
 	m_tray = 0;
 	m_garbageDropped = 0;
 	m_garbageCycle = 0;
+	m_maxChain = 0;
+	m_garbageSent = 0;
+	m_garbageReceived = 0;
+	m_stateHashChain = 0;
+	m_desyncFrame = -1;
+	m_desyncSubsystem = "";
+	m_peerStateHashes.clear();
 	m_hasMoved = false;
 	m_destroyPuyosTimer = 0;
 	m_marginTimer = 0;
@@ -499,18 +524,6 @@ Player::~Player()
 {
 	delete m_chainWord;
 	delete m_cpuAi;
-	// Delete light effects
-	while (!m_lightEffect.empty()) {
-		delete m_lightEffect.back();
-		m_lightEffect.pop_back();
-	}
-
-	// Delete other
-	while (!m_secondsObj.empty()) {
-		delete m_secondsObj.back();
-		m_secondsObj.pop_back();
-	}
-
 	delete m_statusText;
 	delete m_statusFont;
 	delete m_rngNuisanceDrop;
@@ -595,28 +608,38 @@ void Player::play()
 
 		if (!m_messages.empty())
 			debugString += std::string("mes: ") + m_messages.front()[0] + "\n";
+		if (m_desyncFrame >= 0)
+			debugString += "desync: " + toString(m_desyncFrame) + " " + m_desyncSubsystem + "\n";
+		const PuyoPool::Stats& pool = m_activeField->getPuyoPoolStats();
+		debugString += "puyos: " + toString(pool.live) + "/" + toString(pool.peak) + " blocks " + toString(pool.blocks) + "\n";
+		if (m_cpuAi)
+			debugString += "chain table: " + toString(static_cast<int>(m_cpuAi->getChainStats().hitRate())) + "%\n";
 	}
 
 	// Pick character (online)
 	if (m_showCharacterTimer > 0) {
 		m_showCharacterTimer--;
-		m_charHolderSprite.setTransparency(1);
-		m_currentCharacterSprite.setTransparency(1);
-		for (auto& i : m_dropSet) {
-			i.setTransparency(1);
-		}
-		if (m_showCharacterTimer < 120) {
-			m_charHolderSprite.setTransparency(static_cast<float>(m_showCharacterTimer) / 120.0f);
-			m_currentCharacterSprite.setTransparency(static_cast<float>(m_showCharacterTimer) / 120.0f);
+		if (!m_data->headless) {
+			m_charHolderSprite.setTransparency(1);
+			m_currentCharacterSprite.setTransparency(1);
 			for (auto& i : m_dropSet) {
-				i.setTransparency(static_cast<float>(m_showCharacterTimer) / 120.0f);
+				i.setTransparency(1);
+			}
+			if (m_showCharacterTimer < 120) {
+				m_charHolderSprite.setTransparency(static_cast<float>(m_showCharacterTimer) / 120.0f);
+				m_currentCharacterSprite.setTransparency(static_cast<float>(m_showCharacterTimer) / 120.0f);
+				for (auto& i : m_dropSet) {
+					i.setTransparency(static_cast<float>(m_showCharacterTimer) / 120.0f);
+				}
 			}
 		}
 	}
 	// Play animation for checkmark
 	if (m_rematchIconTimer < 1000) {
 		m_rematchIconTimer++;
-		m_rematchIcon.setScale(m_globalScale * static_cast<float>(interpolate("elastic", 2, 1, m_rematchIconTimer / 60.0, -5, 2)));
+		if (!m_data->headless) {
+			m_rematchIcon.setScale(m_globalScale * kRematchIconScale.at(m_rematchIconTimer));
+		}
 	}
 	m_rematchIcon.setVisible(m_rematch);
 
@@ -627,25 +650,32 @@ void Player::play()
 
 	// ===== Global events
 
-	// Animate particles
-	m_activeField->animateParticle();
+	// Purely visual animations, skipped when running headless
+	if (!m_data->headless) {
+		// Animate particles
+		m_activeField->animateParticle();
 
-	// Animate chainword
-	m_chainWord->move();
+		// Animate chainword
+		m_chainWord->move();
 
-	// Animate light effects & secondsobj
-	playLightEffect();
+		// Do characterAnimation
+		m_characterAnimation.playAnimation();
+
+		// Move nextPuyo
+		if (static_cast<int>(m_currentPhase) > 0 && m_nextPuyoActive)
+			m_nextPuyo.play();
 
-	// Do characterAnimation
-	m_characterAnimation.playAnimation();
+		// Animate garbage trays
+		m_normalTray.play();
+		m_feverTray.play();
 
-	// Move nextPuyo
-	if (static_cast<int>(m_currentPhase) > 0 && m_nextPuyoActive)
-		m_nextPuyo.play();
+		// Time the point x bonus of the score counter
+		m_scoreCounter.play();
+	}
 
-	// Animate garbage trays
-	m_normalTray.play();
-	m_feverTray.play();
+	// Animate light effects & secondsobj
+	// Not skipped when headless: counter attacks wait for the light effects to disappear
+	playLightEffect();
 
 	// Set scorecounter
 	setScoreCounter();
@@ -879,6 +909,7 @@ void Player::getReady()
 				m_activeAtStart = 0;
 			}
 			m_controls.m_recordEvents.clear();
+			m_currentGame->startReplayStream();
 		}
 		// Reset controls
 		m_controls.release();
@@ -1154,7 +1185,7 @@ void Player::chooseColor()
 	}
 	if (m_colorMenuTimer < -20) {
 		m_spice[m_spiceSelect].setVisible(true);
-		m_spice[m_spiceSelect].setTransparency(static_cast<float>(interpolate("linear", 1, 0, (m_colorMenuTimer + 50) / 30.0, 0, 0)));
+		m_spice[m_spiceSelect].setTransparency(static_cast<float>(interpolate(Easing::Linear, 1, 0, (m_colorMenuTimer + 50) / 30.0, 0, 0)));
 	}
 }
 
@@ -1175,8 +1206,17 @@ void Player::prepare()
 	if (m_cpuAi) {
 		// Determine best chain
 		m_cpuAi->prepare(mpt, color1, color2);
+		// Pairs shown in the next window
+		for (int i = 0; i + 1 < static_cast<int>(m_nextList.size()) && i < 4; i += 2) {
+			const int turn = m_turns + 1 + i / 2;
+			m_cpuAi->addNextPiece(m_useDropPattern ? getFromDropPattern(m_character, turn) : MovePuyoType::DOUBLET, m_nextList[i], m_nextList[i + 1]);
+		}
 		m_cpuAi->m_pinch = m_activeGarbage->gq > 0 ? true : false;
-		m_cpuAi->findLargest();
+		if (m_currentGame->m_settings->cpuThinkAsync) {
+			m_cpuAi->startSearch(m_currentGame->m_settings->cpuThinkFrames);
+		} else {
+			m_cpuAi->findLargest();
+		}
 	}
 
 	// Release controls for ONLINE player
@@ -1192,6 +1232,11 @@ void Player::prepare()
 
 void Player::cpuMove()
 {
+	// Still thinking
+	if (!m_cpuAi->update()) {
+		return;
+	}
+
 	// Get current rotation
 	if (m_movePuyo.getType() == MovePuyoType::BIG) {
 		if (m_movePuyo.getColorBig() != m_cpuAi->m_bestRot) {
@@ -1274,17 +1319,10 @@ void Player::destroyPuyos()
 // Light effect & secondsobj
 void Player::playLightEffect()
 {
-	for (auto& i : m_lightEffect) {
-		i->setTimer(m_garbageSpeed);
-	}
+	m_lightEffect.forEach([this](LightEffect& light) { light.setTimer(m_garbageSpeed); });
 
 	// Check if any should be removed
-	for (size_t i = 0; i < m_lightEffect.size(); i++) {
-		if (m_lightEffect[i]->getTimer() > 300) {
-			delete m_lightEffect[i];
-			m_lightEffect.erase(std::remove(m_lightEffect.begin(), m_lightEffect.end(), m_lightEffect[i]), m_lightEffect.end());
-		}
-	}
+	m_lightEffect.releaseIf([](const LightEffect& light) { return light.getTimer() > 300; });
 	// Play feverlight
 	m_feverLight.setTimer(0.1f);
 
@@ -1292,17 +1330,10 @@ void Player::playLightEffect()
 	m_feverGauge.update();
 
 	// Secondsobj
-	for (auto& i : m_secondsObj) {
-		i->move();
-	}
+	m_secondsObj.forEach([](SecondsObject& seconds) { seconds.move(); });
 
 	// Check if any should be removed
-	for (size_t i = 0; i < m_secondsObj.size(); i++) {
-		if (m_secondsObj[i]->getTimer() > 50) {
-			delete m_secondsObj[i];
-			m_secondsObj.erase(std::remove(m_secondsObj.begin(), m_secondsObj.end(), m_secondsObj[i]), m_secondsObj.end());
-		}
-	}
+	m_secondsObj.releaseIf([](const SecondsObject& seconds) { return seconds.getTimer() > 50; });
 }
 
 void Player::addFeverCount()
@@ -1408,6 +1439,7 @@ int Player::nuisanceDropPattern()
 
 	// Pick an index
 	double rand = m_rngNuisanceDrop->genrand_real1();
+	m_nuisanceDropCalls++;
 	const int randomIndex = static_cast<int>(static_cast<double>(m_nuisanceList.size()) * rand);
 
 	// Swap that index with the end and pop
@@ -1462,7 +1494,7 @@ void Player::startGarbage()
 				middlePv.x = startPv.x - static_cast<float>(dir) * kPuyoX * 3.f;
 				middlePv.y = startPv.y - kPuyoY * 3;
 
-				m_lightEffect.push_back(new LightEffect(m_data, startPv, middlePv, endPv));
+				m_lightEffect.acquire(m_data, startPv, middlePv, endPv);
 
 				// Add self to garbage accumulator
 				player->addAttacker(m_targetGarbage[player], this);
@@ -1505,7 +1537,7 @@ void Player::startGarbage()
 		middlePv.x = startPv.x - static_cast<float>(dir) * kPuyoX * 3.f;
 		middlePv.y = startPv.y - kPuyoY * 3;
 
-		m_lightEffect.push_back(new LightEffect(m_data, startPv, middlePv, endPv));
+		m_lightEffect.acquire(m_data, startPv, middlePv, endPv);
 	} else {
 		m_attackState = NO_ATTACK;
 	}
@@ -1609,6 +1641,7 @@ void Player::endGarbage()
 				continue;
 
 			m_targetGarbage[player]->cq += m_eq;
+			m_garbageSent += m_eq;
 			player->updateTray(m_targetGarbage[player]);
 			playGarbageSound();
 			// End of attack
@@ -1701,7 +1734,7 @@ void Player::endGarbage()
 				const int dir = m_nextPuyo.getOrientation();
 				middlePv.x = startPv.x - static_cast<float>(dir) * kPuyoX * 3;
 				middlePv.y = startPv.y - kPuyoY * 3;
-				m_lightEffect.push_back(new LightEffect(m_data, startPv, middlePv, endPv));
+				m_lightEffect.acquire(m_data, startPv, middlePv, endPv);
 
 				// Add self to garbage accumulator
 				player->addAttacker(m_targetGarbage[player], this);
@@ -2255,9 +2288,9 @@ void Player::dropFeverChain()
 void Player::showSecondsObj(int n)
 {
 	const PosVectorFloat pv = m_feverGauge.getPositionSeconds();
-	m_secondsObj.push_back(new SecondsObject(m_data));
-	m_secondsObj.back()->setScale(m_globalScale);
-	m_secondsObj.back()->showAt(m_nextPuyoOffsetX + (pv.x - 16) * m_nextPuyoScale * m_globalScale, m_nextPuyoOffsetY + (pv.y + 16) * m_nextPuyoScale * m_globalScale * static_cast<float>(m_secondsObj.size()), n);
+	SecondsObject* seconds = m_secondsObj.get(m_secondsObj.acquire(m_data));
+	seconds->setScale(m_globalScale);
+	seconds->showAt(m_nextPuyoOffsetX + (pv.x - 16) * m_nextPuyoScale * m_globalScale, m_nextPuyoOffsetY + (pv.y + 16) * m_nextPuyoScale * m_globalScale * static_cast<float>(m_secondsObj.size()), n);
 }
 
 void Player::setMarginTimer()
@@ -2383,6 +2416,15 @@ void Player::processMessage()
 
 void Player::addMessage(std::string mes)
 {
+	// State hash of the peer, not needed in replays
+	if (m_type == ONLINE && mes[0] == 'h') {
+		std::pair<int, StateHash> hash;
+		if (sscanf(mes.c_str(), "h|%i|%x|%x", &hash.first, &hash.second.field, &hash.second.rng) == 3) {
+			m_peerStateHashes.push_back(hash);
+		}
+		return;
+	}
+
 	// Add to replay
 	if (m_currentGame->m_settings->recording == RecordState::RECORDING) {
 		MessageEvent me = { m_data->matchTimer, "" };
@@ -2555,6 +2597,353 @@ void Player::getUpdate(std::string str)
 	}
 }
 
+// Gameplay state for replay keyframes, see Game::syncState. Sprites, sounds and effects
+// that don't change how the match plays out are left out. Other players are stored by
+// their index in the game.
+void Player::syncState(StateStream& stream)
+{
+	const std::vector<Player*>& players = m_currentGame->m_players;
+	const auto indexOf = [&](const Player* player) {
+		const auto it = std::find(players.begin(), players.end(), player);
+		return it == players.end() ? -1 : static_cast<int>(it - players.begin());
+	};
+	const auto playerAt = [&](const int i) {
+		return i >= 0 && i < static_cast<int>(players.size()) ? players[i] : nullptr;
+	};
+
+	stream.value(m_currentPhase);
+	stream.value(m_dropSpeed);
+	stream.value(m_colors);
+	stream.value(m_scoreVal);
+	stream.value(m_currentScore);
+	stream.value(m_turns);
+	stream.value(m_targetPoint);
+	stream.value(m_createPuyo);
+	stream.value(m_forgiveGarbage);
+	stream.value(m_useDropPattern);
+	stream.value(m_loseWin);
+	stream.value(m_randomSeedFever);
+	stream.value(m_marginTimer);
+	stream.value(m_nextPuyoActive);
+	stream.value(m_destroyPuyosTimer);
+	stream.value(m_foundChain);
+	stream.value(m_colorMenuTimer);
+	stream.value(m_menuHeight);
+	stream.value(m_spiceSelect);
+	stream.value(m_pickedColor);
+	stream.value(m_takeover);
+
+	// Chain
+	stream.value(m_garbageTimer);
+	stream.value(m_garbageSpeed);
+	stream.value(m_chainPopSpeed);
+	stream.value(m_garbageEndTime);
+	stream.value(m_puyoBounceSpeed);
+	stream.value(m_puyoBounceEnd);
+	stream.value(m_gravity);
+	stream.value(m_attackState);
+	stream.value(m_chain);
+	stream.value(m_puyosPopped);
+	stream.value(m_totalGroups);
+	stream.value(m_groupR);
+	stream.value(m_groupG);
+	stream.value(m_groupB);
+	stream.value(m_groupY);
+	stream.value(m_groupP);
+	stream.value(m_predictedChain);
+	stream.value(m_point);
+	stream.value(m_bonus);
+	stream.value(m_linkBonus);
+	stream.value(m_allClear);
+	stream.value(m_rememberMaxY);
+	stream.value(m_rememberX);
+	stream.value(m_dropBonus);
+	stream.value(m_divider);
+	stream.value(m_bonusEq);
+	stream.value(m_diacute);
+	stream.value(m_playVoice);
+	stream.value(m_stutterTimer);
+
+	// Fever
+	stream.value(m_feverMode);
+	stream.value(m_feverEnd);
+	stream.value(m_currentFeverChainAmount);
+	stream.value(m_poppedChain);
+	stream.value(m_feverColor);
+	stream.value(m_feverColorR);
+	stream.value(m_feverColorG);
+	stream.value(m_feverColorB);
+	stream.value(m_feverSuccess);
+	stream.value(m_calledRandomFeverChain);
+
+	// Match
+	stream.value(m_active);
+	stream.value(m_prepareActive);
+	stream.value(m_activeAtStart);
+	stream.value(m_rematch);
+	stream.value(m_wins);
+	stream.value(m_loseConfirm);
+	stream.value(m_waitForConfirm);
+	stream.value(m_hasMoved);
+	stream.value(m_debugCounter);
+	stream.value(m_lightTimer);
+	stream.value(m_loseWinTimer);
+	stream.value(m_readyGoTimer);
+	stream.value(m_transitionTimer);
+	stream.value(m_allClearTimer);
+	stream.value(m_transformScale);
+
+	// Fields and pieces
+	bool fever = m_activeField == &m_fieldFever;
+	stream.value(fever);
+	m_activeField = fever ? &m_fieldFever : &m_fieldNormal;
+	m_fieldNormal.syncState(stream);
+	m_fieldFever.syncState(stream);
+	m_movePuyo.syncState(stream);
+	m_nextPuyo.syncState(stream);
+	m_feverGauge.syncState(stream);
+	m_controls.syncState(stream);
+	stream.deque(m_nextList);
+	stream.vector(m_nuisanceList);
+
+	// Garbage
+	stream.value(m_eq);
+	stream.value(m_tray);
+	stream.value(m_attackers);
+	stream.value(m_garbageDropped);
+	stream.value(m_garbageCycle);
+	stream.value(m_maxChain);
+	stream.value(m_garbageSent);
+	stream.value(m_garbageReceived);
+	stream.value(m_stateHashChain);
+	const auto syncCounter = [&](GarbageCounter& counter) {
+		stream.value(counter.cq);
+		stream.value(counter.gq);
+		std::vector<int> accumulator;
+		for (const Player* player : counter.accumulator) {
+			accumulator.push_back(indexOf(player));
+		}
+		stream.vector(accumulator);
+		if (stream.isLoading()) {
+			counter.accumulator.clear();
+			for (const int i : accumulator) {
+				counter.accumulator.push_back(playerAt(i));
+			}
+		}
+	};
+	syncCounter(m_normalGarbage);
+	syncCounter(m_feverGarbage);
+	bool feverGarbage = m_activeGarbage == &m_feverGarbage;
+	stream.value(feverGarbage);
+	m_activeGarbage = feverGarbage ? &m_feverGarbage : &m_normalGarbage;
+
+	// Targets point to the normal or fever counter of another player
+	struct Target {
+		int player;
+		bool fever;
+	};
+	std::vector<Target> targets;
+	for (const auto& [player, counter] : m_targetGarbage) {
+		targets.push_back({ indexOf(player), counter == &player->m_feverGarbage });
+	}
+	stream.vector(targets);
+	int lastAttacker = indexOf(m_lastAttacker);
+	stream.value(lastAttacker);
+	if (stream.isLoading()) {
+		m_targetGarbage.clear();
+		for (const auto& target : targets) {
+			if (Player* player = playerAt(target.player)) {
+				m_targetGarbage[player] = target.fever ? &player->m_feverGarbage : &player->m_normalGarbage;
+			}
+		}
+		m_lastAttacker = playerAt(lastAttacker);
+	}
+
+	// Random generators are stored as seed and position
+	const auto syncRng = [&](PuyoRng*& rng) {
+		uint32_t seed = rng ? rng->seed() : 0;
+		int index = rng ? rng->index() : 0;
+		stream.value(seed);
+		stream.value(index);
+		if (stream.isLoading() && !stream.failed()) {
+			delete rng;
+			rng = makePuyoRng(m_currentGame->m_legacyRng == true ? "legacy" : "classic", seed, index);
+		}
+	};
+	syncRng(m_rngNextList);
+	syncRng(m_rngFeverChain);
+	syncRng(m_rngFeverColor);
+	stream.value(m_nuisanceDropCalls);
+	if (stream.isLoading()) {
+		// Seeded in initValues
+		m_rngNuisanceDrop->init_genrand(m_randomSeedFever);
+		for (int i = 0; i < m_nuisanceDropCalls; i++) {
+			m_rngNuisanceDrop->genrand_real1();
+		}
+	}
+
+	// Messages that are waiting
+	size_t messages = m_messages.size();
+	stream.value(messages);
+	if (stream.isLoading()) {
+		m_messages.resize(stream.failed() ? 0 : messages);
+	}
+	for (auto& message : m_messages) {
+		stream.string(message);
+	}
+
+	if (stream.isLoading()) {
+		// Effects of the frame that was left are gone
+		m_lightEffect.clear();
+		m_secondsObj.clear();
+		m_chainWord->hide();
+		m_fieldSprite.setVisible(!fever);
+		m_fieldFeverSprite.setVisible(fever);
+		updateTray();
+		setScoreCounter();
+	}
+}
+
+// Point the replay cursors at the first controller event and message at or after time
+void Player::seekRecording(const int time)
+{
+	m_controls.seekEvents(time);
+	const auto it = std::lower_bound(m_recordMessages.begin(), m_recordMessages.end(), time, [](const MessageEvent& message, const int t) {
+		return message.time < t;
+	});
+	m_recordMessageCursor = static_cast<size_t>(it - m_recordMessages.begin());
+	const auto hash = std::lower_bound(m_recordHashes.begin(), m_recordHashes.end(), time, [](const StateHashEvent& event, const int t) {
+		return event.time < t;
+	});
+	m_recordHashCursor = static_cast<size_t>(hash - m_recordHashes.begin());
+}
+
+StateHash Player::computeStateHash() const
+{
+	StateHash hash;
+	StateHasher field;
+	field.add(m_activeField ? m_activeField->getContentHash() : 0);
+	field.add(m_feverMode);
+	hash.field = field.get();
+
+	StateHasher phase;
+	phase.add(static_cast<uint32_t>(m_currentPhase));
+	phase.add(m_turns);
+	phase.add(m_chain);
+	phase.add(static_cast<uint32_t>(m_loseWin));
+	hash.phase = phase.get();
+
+	StateHasher score;
+	score.add(m_scoreVal);
+	score.add(m_currentScore);
+	hash.score = score.get();
+
+	StateHasher garbage;
+	garbage.add(m_normalGarbage.gq);
+	garbage.add(m_normalGarbage.cq);
+	garbage.add(m_feverGarbage.gq);
+	garbage.add(m_feverGarbage.cq);
+	garbage.add(m_eq);
+	hash.garbage = garbage.get();
+
+	StateHasher rng;
+	for (const PuyoRng* generator : { m_rngNextList, m_rngFeverChain, m_rngFeverColor }) {
+		rng.add(generator ? generator->index() : -1);
+	}
+	rng.add(m_nuisanceDropCalls);
+	hash.rng = rng.get();
+	return hash;
+}
+
+// After every frame of play. Recording keeps a hash every stateHashInterval frames,
+// playing a replay compares against them.
+void Player::updateStateHash(const int time)
+{
+	const int interval = m_currentGame->m_settings->stateHashInterval;
+	if (interval <= 0) {
+		return;
+	}
+
+	// The match timer stays at 0 until the match starts
+	if (time == 0) {
+		m_stateHashChain = 0;
+	}
+	const StateHash hash = computeStateHash();
+	StateHasher chain;
+	chain.add(m_stateHashChain);
+	chain.add(hash.field);
+	chain.add(hash.phase);
+	chain.add(hash.score);
+	chain.add(hash.garbage);
+	chain.add(hash.rng);
+	m_stateHashChain = chain.get();
+
+	if (time == 0 || time % interval != 0) {
+		return;
+	}
+	if (m_currentGame->m_settings->recording == RecordState::RECORDING) {
+		m_recordHashes.push_back({ time, m_stateHashChain,
+			static_cast<uint16_t>(hash.field), static_cast<uint16_t>(hash.phase), static_cast<uint16_t>(hash.score),
+			static_cast<uint16_t>(hash.garbage), static_cast<uint16_t>(hash.rng) });
+	} else if (m_currentGame->m_settings->recording == RecordState::REPLAYING) {
+		checkStateHash(time, hash);
+	}
+}
+
+void Player::checkStateHash(const int time, const StateHash& hash)
+{
+	// Continue from the cursor, it only has to search again if the time went back
+	size_t& cursor = m_recordHashCursor;
+	if (cursor > m_recordHashes.size() || (cursor > 0 && m_recordHashes[cursor - 1].time >= time)) {
+		seekRecording(time);
+	}
+	while (cursor < m_recordHashes.size() && m_recordHashes[cursor].time < time) {
+		cursor++;
+	}
+	if (cursor == m_recordHashes.size() || m_recordHashes[cursor].time != time) {
+		return;
+	}
+
+	const StateHashEvent& recorded = m_recordHashes[cursor++];
+	if (recorded.chain != m_stateHashChain && m_desyncFrame < 0) {
+		m_desyncFrame = time;
+		m_desyncSubsystem = stateHashDifference(hash, recorded);
+	}
+}
+
+// Online the peer checks the hash at the same turn, see GameSettings::stateHashTurns.
+// Score and garbage are left out, they depend on when messages arrive.
+void Player::sendStateHash()
+{
+	const int turns = m_currentGame->m_settings->stateHashTurns;
+	if (turns <= 0 || m_turns % turns != 0) {
+		return;
+	}
+	const StateHash hash = computeStateHash();
+	char str[64];
+	sprintf(str, "h|%i|%x|%x", m_turns, hash.field, hash.rng);
+	m_currentGame->m_network->sendToChannel(CHANNEL_GAME, str, m_currentGame->m_channelName.c_str());
+}
+
+// Compare with the hash the peer sent for this turn, if any
+void Player::checkPeerStateHash()
+{
+	while (!m_peerStateHashes.empty() && m_peerStateHashes.front().first < m_turns) {
+		m_peerStateHashes.pop_front();
+	}
+	if (m_peerStateHashes.empty() || m_peerStateHashes.front().first != m_turns) {
+		return;
+	}
+
+	const StateHash peer = m_peerStateHashes.front().second;
+	m_peerStateHashes.pop_front();
+	const StateHash hash = computeStateHash();
+	if (m_desyncFrame < 0 && (hash.field != peer.field || hash.rng != peer.rng)) {
+		m_desyncFrame = m_data->matchTimer;
+		m_desyncSubsystem = hash.field != peer.field ? "field" : "rng";
+	}
+}
+
 void Player::prepareDisconnect()
 {
 	if (m_currentGame->m_settings->rankedMatch && m_type == HUMAN && m_currentGame->m_connected) {
@@ -2667,15 +3056,12 @@ void Player::draw()
 // Draw light effect, secondsObj
 void Player::drawEffect()
 {
-	for (const auto& lightEffect : m_lightEffect) {
-		lightEffect->draw(m_data->front);
-	}
+	FeRenderTarget* target = m_data->front;
+	m_lightEffect.forEach([target](LightEffect& light) { light.draw(target); });
 
-	m_feverLight.draw(m_data->front);
+	m_feverLight.draw(target);
 
-	for (const auto& secondsObj : m_secondsObj) {
-		secondsObj->draw(m_data->front);
-	}
+	m_secondsObj.forEach([target](SecondsObject& seconds) { seconds.draw(target); });
 }
 
 void Player::drawFieldBack(PosVectorFloat /*position*/, const float rotation)
@@ -11,6 +11,7 @@
 #include "RNG/MersenneTwister.h"
 #include "RNG/PuyoRng.h"
 #include "RuleSet/RuleSet.h"
+#include "StateHash.h"
 #include "global.h"
 #include <deque>
 #include <map>
@@ -21,6 +22,7 @@ namespace ppvs {
 
 class Player;
 class Game;
+class StateStream;
 
 struct GarbageCounter {
 	int cq = 0, gq = 0;
@@ -49,9 +51,9 @@ struct ReplayPlayerHeader {
 	PuyoCharacter character;
 	char active; // Active at start
 	char colors;
-	int vectorSizeMovement; // Size of vector in bytes
+	int vectorSizeMovement; // Size of vector in bytes (version 4: number of events)
 	int vectorSizeMessage;
-	int vectorSizeCompressedMovement; // Size of compressed vector in bytes
+	int vectorSizeCompressedMovement; // Size of compressed vector in bytes (version 4: unused)
 	int vectorSizeCompressedMessage;
 };
 
@@ -144,6 +146,15 @@ public:
 	void endFever(); // Phase 54
 	void playFever();
 	void setLose();
+	void syncState(StateStream& stream);
+	void seekRecording(int time);
+
+	// Desync detection
+	[[nodiscard]] StateHash computeStateHash() const;
+	void updateStateHash(int time);
+	void checkStateHash(int time, const StateHash& hash);
+	void sendStateHash();
+	void checkPeerStateHash();
 
 	// Draw code
 	void draw();
@@ -236,6 +247,11 @@ public:
 	int m_garbageCycle = 0;
 	Player* m_lastAttacker = nullptr;
 
+	// Match statistics
+	int m_maxChain = 0;
+	int m_garbageSent = 0;
+	int m_garbageReceived = 0;
+
 	// Online variables
 	Sprite m_overlaySprite;
 	void bindPlayer(const std::string& name, unsigned int id, bool setActive);
@@ -278,7 +294,13 @@ public:
 	// Debugging
 	int m_debug = 0;
 
-	std::vector<MessageEvent> m_recordMessages;
+	std::vector<MessageEvent> m_recordMessages; // Sorted by time
+	size_t m_recordMessageCursor = 0; // Next message to play back
+	std::vector<StateHashEvent> m_recordHashes; // Sorted by time
+	size_t m_recordHashCursor = 0; // Next hash to compare
+	uint32_t m_stateHashChain = 0; // Every frame of the match so far
+	int m_desyncFrame = -1; // First frame that didn't match the replay or the peer
+	const char* m_desyncSubsystem = ""; // See stateHashDifference
 
 private:
 	void processMessage();
@@ -287,9 +309,10 @@ private:
 	// Drop set indicator (during char select)
 	Sprite m_dropSet[16];
 
-	std::vector<LightEffect*> m_lightEffect;
+	EffectPool<LightEffect, 64> m_lightEffect;
 	std::deque<int> m_nextList;
-	std::vector<SecondsObject*> m_secondsObj;
+	std::deque<std::pair<int, StateHash>> m_peerStateHashes; // Turn and hash sent by the peer
+	EffectPool<SecondsObject, 16> m_secondsObj;
 
 	// Timers
 	int m_lightTimer = 0;
@@ -303,6 +326,7 @@ private:
 	PuyoRng* m_rngFeverChain = nullptr;
 	PuyoRng* m_rngFeverColor = nullptr;
 	MersenneTwister* m_rngNuisanceDrop = nullptr;
+	int m_nuisanceDropCalls = 0; // To put m_rngNuisanceDrop back where it was
 	std::vector<int> m_nuisanceList;
 	int m_playerNum = 0;
 	float m_globalScale = 0.f; // Global scale for certain objects (for example sprite animations)
@@ -1,6 +1,7 @@
 #include "Puyo.h"
 #include "Field.h"
 #include "Player.h"
+#include "StateStream.h"
 #include <algorithm>
 #include <cmath>
 
@@ -8,33 +9,22 @@ using namespace std;
 
 namespace ppvs {
 
-Puyo::Puyo(int indexX, int indexY, int color, Field* f, float spriteX, float spriteY, GameData* data)
+Puyo::Puyo(int indexX, int indexY, int color, Field* f, float spriteX, float spriteY)
 {
 	m_field = f;
-	m_data = data;
-	FieldProp prop = m_field->getProperties();
 
 	// Set position and color
-	m_posX = indexX;
-	m_posY = indexY;
-	m_color = color;
+	m_posX = static_cast<int16_t>(indexX);
+	m_posY = static_cast<int16_t>(indexY);
+	m_color = static_cast<int8_t>(color);
 	m_spriteX = spriteX;
 	m_spriteY = spriteY;
-	m_spriteYsc = 0;
-	m_scaleXd = 1;
-	m_scaleYd = 1;
+	m_scalePop = 1;
 	m_scaleX = 1;
 	m_scaleY = 1;
-	m_scaleYcor = 1;
 	m_accelerationY = 0;
 	m_targetY = 0;
 
-	// Set sprite
-	m_sprite.setImage(m_data->imgPuyo);
-
-	// Correction factor in Y
-	m_scaleYcor = static_cast<float>(prop.gridHeight) / (static_cast<float>(kPuyoY + prop.gridHeight) / 2.01f);
-
 	// Other stuff
 	m_droppable = true;
 	m_type = NOPUYO;
@@ -51,13 +41,9 @@ Puyo::Puyo(int indexX, int indexY, int color, Field* f, float spriteX, float spr
 	m_glow = false;
 	m_lastNuisance = false;
 	m_hard = false;
-	m_mark = false;
 	m_destroy = false;
 	m_destroyTimer = 0;
-	m_linkDown = false;
-	m_linkUp = false;
-	m_linkRight = false;
-	m_linkLeft = false;
+	m_links = 0;
 	m_temporary = false;
 }
 
@@ -65,23 +51,17 @@ Puyo::Puyo(const Puyo& self)
 {
 	// Initialize copy of base class
 	// Copy only important things, no sprite stuff
-	m_posX = self.posX();
-	m_posY = self.posY();
-	m_type = self.getType();
-	m_color = self.getColor();
+	m_posX = self.m_posX;
+	m_posY = self.m_posY;
+	m_type = self.m_type;
+	m_color = static_cast<int8_t>(self.getColor());
 	m_droppable = self.m_droppable;
-	m_mark = false;
 	m_destroy = false;
 	m_temporary = self.m_temporary;
 }
 
 Puyo::~Puyo() = default;
 
-Puyo* Puyo::clone()
-{
-	return new Puyo(*this);
-}
-
 // Add to acceleration and set position
 void Puyo::addAccelerationY(float val)
 {
@@ -95,7 +75,14 @@ int Puyo::getColor() const
 	return -1;
 }
 
-void Puyo::updateSprite()
+// Nothing to draw, only the derived puyos have a look
+PuyoSkin::Rect Puyo::look(const PuyoSkin&) const
+{
+	return {};
+}
+
+// Draws the look of the puyo with the skin of the game
+void Puyo::drawLook(FeRenderTarget* target, const BlendingMode blendMode, const int alpha, FeShader* shader)
 {
 	// Bug fixes
 	if (m_fallFlag != 0) {
@@ -115,24 +102,21 @@ void Puyo::updateSprite()
 		m_bounceY = 0;
 	}
 
-	// Position
-    const FieldProp prop = m_field->getProperties();
+	const FieldProp prop = m_field->getProperties();
 
-	// Note: puyo width is now 30 (to remove artifacts)
-	m_sprite.setPosition(m_spriteX - static_cast<float>(m_posX) * 2 + static_cast<float>(prop.gridX) / 2, m_spriteY + m_bounceY);
+	// Correction factor in Y
+	const float scaleYcor = static_cast<float>(prop.gridHeight) / (static_cast<float>(kPuyoY + prop.gridHeight) / 2.01f);
 
-	// Scale
-	m_sprite.setScale(m_scaleX * m_scaleXd, m_scaleY * m_scaleYd * m_scaleYcor);
+	// Note: puyo width is now 30 (to remove artifacts)
+	const PuyoSkin& skin = m_field->m_data->puyoSkin;
+	skin.draw(target, look(skin), m_spriteX - static_cast<float>(m_posX) * 2 + static_cast<float>(prop.gridX) / 2, m_spriteY + m_bounceY,
+		m_scaleX * m_scalePop, m_scaleY * m_scalePop * scaleYcor, blendMode, alpha, shader);
 }
 
 // Draw puyo on screen
 void Puyo::draw(FeRenderTarget* target)
 {
-	updateSprite();
-	if (!m_glow)
-		m_sprite.draw(target);
-	else if (m_data->glowShader)
-		m_sprite.draw(target, m_data->glowShader);
+	drawLook(target);
 }
 
 // Popping animation
@@ -141,17 +125,12 @@ void Puyo::pop()
 	if (m_destroy == true) {
 		m_destroyTimer++;
 		if (m_destroyTimer < 10) {
-			m_scaleXd = 1.3f;
-			m_scaleYd = 1.3f;
-			m_spriteYsc += (m_scaleYd - 1.f) / 2.0f * static_cast<float>(m_field->getProperties().gridHeight);
+			m_scalePop = 1.3f;
 		} else {
-			m_scaleXd = 1.3f - 1.3f * static_cast<float>(m_destroyTimer - 10) / static_cast<float>(m_field->getPlayer()->m_chainPopSpeed);
-			m_scaleYd = 1.3f - 1.3f * static_cast<float>(m_destroyTimer - 10) / static_cast<float>(m_field->getPlayer()->m_chainPopSpeed);
-			m_spriteYsc += (m_scaleY - 1.f) / 2.0f * static_cast<float>(m_field->getProperties().gridHeight);
+			m_scalePop = 1.3f - 1.3f * static_cast<float>(m_destroyTimer - 10) / static_cast<float>(m_field->getPlayer()->m_chainPopSpeed);
 		}
 	} else {
-		m_scaleXd = 1.0f;
-		m_scaleYd = 1.0f;
+		m_scalePop = 1.0f;
 	}
 }
 
@@ -164,24 +143,55 @@ bool Puyo::destroyPuyo()
 	return false;
 }
 
+// Everything but the type and color. The look comes from the skin when the puyo is drawn.
+void Puyo::syncState(StateStream& stream)
+{
+	stream.value(m_fallDelay);
+	stream.value(m_fallFlag);
+	stream.value(m_bounceFlag0);
+	stream.value(m_bounceFlag);
+	stream.value(m_searchBounce);
+	stream.value(m_bounceTimer);
+	stream.value(m_bounceMultiplier);
+	stream.value(m_bounceY);
+	stream.value(m_bottomY);
+	stream.value(m_glow);
+	stream.value(m_hard);
+	stream.value(m_droppable);
+	stream.value(m_lastNuisance);
+	stream.value(m_destroy);
+	stream.value(m_temporary);
+	stream.value(m_posX);
+	stream.value(m_posY);
+	stream.value(m_spriteX);
+	stream.value(m_spriteY);
+	stream.value(m_scaleX);
+	stream.value(m_scaleY);
+	stream.value(m_scalePop);
+	stream.value(m_accelerationY);
+	stream.value(m_targetY);
+	stream.value(m_links);
+	stream.value(m_destroyTimer);
+}
+
 // Connect puyo to another in some direction (though it can be done in base class, only has meaning for colorpuyo for now)
 void Puyo::setLink(Direction dir)
 {
 	switch (dir) {
 	case BELOW:
-		m_linkDown = true;
+		m_links |= kLinkDown;
 		break;
 
 	case ABOVE:
-		m_linkUp = true;
+		m_links |= kLinkUp;
 		break;
 
 	case RIGHT:
-		m_linkRight = true;
+		m_links |= kLinkRight;
 		break;
 
 	case LEFT:
-		m_linkLeft = true;
+		m_links |= kLinkLeft;
 		break;
 	}
 }
@@ -191,19 +201,19 @@ void Puyo::unsetLink(Direction dir)
 {
 	switch (dir) {
 	case BELOW:
-		m_linkDown = false;
+		m_links &= ~kLinkDown;
 		break;
 
 	case ABOVE:
-		m_linkUp = false;
+		m_links &= ~kLinkUp;
 		break;
 
 	case RIGHT:
-		m_linkRight = false;
+		m_links &= ~kLinkRight;
 		break;
 
 	case LEFT:
-		m_linkLeft = false;
+		m_links &= ~kLinkLeft;
 		break;
 	}
 }
@@ -269,8 +279,8 @@ void Puyo::neighborPop(Field*, bool)
 // colorPuyo
 //=======================================
 
-ColorPuyo::ColorPuyo(int indexX, int indexY, int color, Field* f, float spriteX, float spriteY, GameData* data)
-	: Puyo(indexX, indexY, color, f, spriteX, spriteY, data)
+ColorPuyo::ColorPuyo(int indexX, int indexY, int color, Field* f, float spriteX, float spriteY)
+	: Puyo(indexX, indexY, color, f, spriteX, spriteY)
 {
 	m_type = COLORPUYO;
 }
@@ -280,55 +290,36 @@ ColorPuyo::ColorPuyo(const ColorPuyo& self)
 {
 }
 
-ColorPuyo* ColorPuyo::clone()
-{
-	return new ColorPuyo(*this);
-}
-
 int ColorPuyo::getColor() const
 {
 	return m_color;
 }
 
-void ColorPuyo::updateSprite()
+PuyoSkin::Rect ColorPuyo::look(const PuyoSkin& skin) const
 {
-	// Set rectangle
-	int xRect = kPuyoX * (m_linkDown + (m_linkUp << 1) + (m_linkRight << 2) + (m_linkLeft << 3));
-	int yRect = kPuyoY * m_color;
-
 	// Destroy animation
 	if (m_destroy == true) {
-		xRect = 2 * kPuyoX * (m_color / 2);
-		yRect = 12 * kPuyoY + kPuyoY * (m_color % 2);
+		return skin.popping(m_color);
 	}
-
-	m_sprite.setSubRect(xRect, yRect, kPuyoX, kPuyoY);
-	m_sprite.setCenter(kPuyoX / 2, kPuyoY);
-
-	Puyo::updateSprite();
+	return skin.linked(m_color, m_links);
 }
 
 // Draw puyo on screen
 void ColorPuyo::draw(FeRenderTarget* target)
 {
-	updateSprite();
-
 	if (!m_glow) {
-		m_sprite.draw(target);
+		drawLook(target);
+		return;
+	}
+
+	const GameData* data = m_field->m_data;
+	if (data->glowShader) {
+		data->glowShader->setParameter("color", 0.10 + 0.10 * sin(static_cast<double>(data->globalTimer) / 8.0));
+		drawLook(target, BlendingMode::AlphaBlending, 255, data->glowShader);
 	} else {
-		if (m_data->glowShader) {
-			m_data->glowShader->setParameter("color", 0.10 + 0.10 * sin(static_cast<double>(m_data->globalTimer) / 8.0));
-			m_sprite.draw(target, m_data->glowShader);
-		} else {
-			// Without shaders
-			m_sprite.setBlendMode(BlendingMode::AlphaBlending);
-			m_sprite.draw(target);
-			m_sprite.setBlendMode(BlendingMode::AdditiveBlending);
-			m_sprite.setTransparency(0.20f + 0.20f * sin(static_cast<float>(m_data->globalTimer) / 8.f));
-			m_sprite.draw(target);
-			m_sprite.setTransparency(1);
-			m_sprite.setBlendMode(BlendingMode::AlphaBlending);
-		}
+		// Without shaders
+		drawLook(target);
+		drawLook(target, BlendingMode::AdditiveBlending, static_cast<int>((0.20f + 0.20f * sin(static_cast<float>(data->globalTimer) / 8.f)) * 255.f));
 	}
 }
 
@@ -339,17 +330,12 @@ void ColorPuyo::pop()
 		m_glow = false;
 		m_destroyTimer++;
 		if (m_destroyTimer < 10) {
-			m_scaleXd = 1.3f;
-			m_scaleYd = 1.3f;
-			m_spriteYsc = m_spriteYsc + (m_scaleYd - 1) / 2.0f * static_cast<float>(m_field->getProperties().gridHeight);
+			m_scalePop = 1.3f;
 		} else {
-			m_scaleXd = 1.3f - 1.3f * static_cast<float>(m_destroyTimer - 10) / static_cast<float>(m_field->getPlayer()->m_chainPopSpeed);
-			m_scaleYd = 1.3f - 1.3f * static_cast<float>(m_destroyTimer - 10) / static_cast<float>(m_field->getPlayer()->m_chainPopSpeed);
-			m_spriteYsc = m_spriteYsc + (m_scaleY - 1) / 2.0f * static_cast<float>(m_field->getProperties().gridHeight);
+			m_scalePop = 1.3f - 1.3f * static_cast<float>(m_destroyTimer - 10) / static_cast<float>(m_field->getPlayer()->m_chainPopSpeed);
 		}
 	} else {
-		m_scaleXd = 1.0f;
-		m_scaleYd = 1.0f;
+		m_scalePop = 1.0f;
 	}
 }
 
@@ -368,9 +354,7 @@ void ColorPuyo::landProper()
 bool ColorPuyo::destroyPuyo()
 {
 	if (m_destroyTimer > m_field->getPlayer()->m_chainPopSpeed) {
-		m_field->createParticle(m_spriteX, m_spriteY, m_color);
-		m_field->createParticle(m_spriteX, m_spriteY, m_color);
-		m_field->createParticle(m_spriteX, m_spriteY, m_color);
+		m_field->createParticles(m_spriteX, m_spriteY, m_color, 3);
 		m_destroy = false;
 		return true;
 	}
@@ -386,8 +370,8 @@ void ColorPuyo::neighborPop(Field*, bool /*virt*/)
 // nuiancePuyo
 //=======================================
 
-NuisancePuyo::NuisancePuyo(int indexX, int indexY, int color, Field* f, float spriteX, float spriteY, GameData* data)
-	: Puyo(indexX, indexY, color, f, spriteX, spriteY, data)
+NuisancePuyo::NuisancePuyo(int indexX, int indexY, int color, Field* f, float spriteX, float spriteY)
+	: Puyo(indexX, indexY, color, f, spriteX, spriteY)
 {
 	m_type = NUISANCEPUYO;
 }
@@ -397,11 +381,6 @@ NuisancePuyo::NuisancePuyo(const NuisancePuyo& self)
 {
 }
 
-NuisancePuyo* NuisancePuyo::clone()
-{
-	return new NuisancePuyo(*this);
-}
-
 void NuisancePuyo::landProper()
 {
 	m_fallFlag = 0;
@@ -412,18 +391,9 @@ void NuisancePuyo::landProper()
 	m_searchBounce = 0;
 }
 
-void NuisancePuyo::updateSprite()
+PuyoSkin::Rect NuisancePuyo::look(const PuyoSkin& skin) const
 {
-	m_sprite.setSubRect(kPuyoX * 6, kPuyoY * 12, kPuyoX, kPuyoY);
-	m_sprite.setCenter(kPuyoX / 2, kPuyoY);
-
-	Puyo::updateSprite();
-}
-
-void NuisancePuyo::draw(FeRenderTarget* target)
-{
-	updateSprite();
-	m_sprite.draw(target);
+	return skin.nuisance();
 }
 
 int NuisancePuyo::getColor() const
@@ -437,17 +407,12 @@ void NuisancePuyo::pop()
 	if (m_destroy == true) {
 		m_destroyTimer++;
 		if (m_destroyTimer < 10) {
-			m_scaleXd = 1.3f;
-			m_scaleYd = 1.3f;
-			m_spriteYsc += (m_scaleYd - 1.f) / 2.0f * static_cast<float>(m_field->getProperties().gridHeight);
+			m_scalePop = 1.3f;
 		} else {
-			m_scaleXd = 1.3f - 1.3f * static_cast<float>(m_destroyTimer - 10) / static_cast<float>(m_field->getPlayer()->m_chainPopSpeed);
-			m_scaleYd = 1.3f - 1.3f * static_cast<float>(m_destroyTimer - 10) / static_cast<float>(m_field->getPlayer()->m_chainPopSpeed);
-			m_spriteYsc += (m_scaleY - 1.f) / 2.0f * static_cast<float>(m_field->getProperties().gridHeight);
+			m_scalePop = 1.3f - 1.3f * static_cast<float>(m_destroyTimer - 10) / static_cast<float>(m_field->getPlayer()->m_chainPopSpeed);
 		}
 	} else {
-		m_scaleXd = 1;
-		m_scaleYd = 1;
+		m_scalePop = 1;
 	}
 }
 
@@ -470,7 +435,7 @@ void NuisancePuyo::neighborPop(Field* f, bool v)
 	} else {
 		// As a copy: unlink and delete self
 		f->set(m_posX, m_posY, nullptr);
-		delete this;
+		f->releasePuyo(this);
 	}
 }
 
@@ -478,8 +443,8 @@ void NuisancePuyo::neighborPop(Field* f, bool v)
 // hardPuyo
 //=======================================
 
-HardPuyo::HardPuyo(int indexX, int indexY, int color, Field* f, float spriteX, float spriteY, GameData* data)
-	: Puyo(indexX, indexY, color, f, spriteX, spriteY, data)
+HardPuyo::HardPuyo(int indexX, int indexY, int color, Field* f, float spriteX, float spriteY)
+	: Puyo(indexX, indexY, color, f, spriteX, spriteY)
 {
 	m_type = HARDPUYO;
 	m_hard = true;
@@ -494,9 +459,11 @@ HardPuyo::HardPuyo(const HardPuyo& self)
 	m_vlife = self.m_vlife;
 }
 
-HardPuyo* HardPuyo::clone()
+void HardPuyo::syncState(StateStream& stream)
 {
-	return new HardPuyo(*this);
+	Puyo::syncState(stream);
+	stream.value(m_life);
+	stream.value(m_vlife);
 }
 
 void HardPuyo::landProper()
@@ -509,23 +476,10 @@ void HardPuyo::landProper()
 	m_searchBounce = 0;
 }
 
-void HardPuyo::updateSprite()
-{
-	if (m_life == 2) {
-		m_sprite.setSubRect(kPuyoX * 14, kPuyoY * 11, kPuyoX, kPuyoY);
-		m_sprite.setCenter(kPuyoX / 2, kPuyoY);
-	} else {
-		m_sprite.setSubRect(kPuyoX * 6, kPuyoY * 12, kPuyoX, kPuyoY);
-		m_sprite.setCenter(kPuyoX / 2, kPuyoY);
-	}
-
-	Puyo::updateSprite();
-}
-
-void HardPuyo::draw(FeRenderTarget* target)
+// Looks like a nuisance puyo once it was hit
+PuyoSkin::Rect HardPuyo::look(const PuyoSkin& skin) const
 {
-	updateSprite();
-	m_sprite.draw(target);
+	return m_life == 2 ? skin.hard() : skin.nuisance();
 }
 
 int HardPuyo::getColor() const
@@ -539,17 +493,12 @@ void HardPuyo::pop()
 	if (m_destroy == true) {
 		m_destroyTimer++;
 		if (m_destroyTimer < 10) {
-			m_scaleXd = 1.3f;
-			m_scaleYd = 1.3f;
-			m_spriteYsc += (m_scaleYd - 1.f) / 2.0f * static_cast<float>(m_field->getProperties().gridHeight);
+			m_scalePop = 1.3f;
 		} else {
-			m_scaleXd = 1.3f - 1.3f * static_cast<float>(m_destroyTimer - 10) / static_cast<float>(m_field->getPlayer()->m_chainPopSpeed);
-			m_scaleYd = 1.3f - 1.3f * static_cast<float>(m_destroyTimer - 10) / static_cast<float>(m_field->getPlayer()->m_chainPopSpeed);
-			m_spriteYsc += (m_scaleY - 1.f) / 2.0f * static_cast<float>(m_field->getProperties().gridHeight);
+			m_scalePop = 1.3f - 1.3f * static_cast<float>(m_destroyTimer - 10) / static_cast<float>(m_field->getPlayer()->m_chainPopSpeed);
 		}
 	} else {
-		m_scaleXd = 1.f;
-		m_scaleYd = 1.f;
+		m_scalePop = 1.f;
 	}
 }
 
@@ -578,7 +527,7 @@ void HardPuyo::neighborPop(Field* f, bool v)
 		m_vlife -= 1;
 		if (m_vlife <= 0) {
 			f->set(m_posX, m_posY, nullptr);
-			delete this;
+			f->releasePuyo(this);
 		}
 	}
 }
@@ -1,12 +1,14 @@
 #pragma once
 
 #include "FieldProp.h"
-#include "Sprite.h"
+#include "PuyoSkin.h"
 #include "global.h"
+#include <cstdint>
 
 namespace ppvs {
 
 class Field;
+class StateStream;
 
 // Puyo should be a base class to derive the following classes:
 // ColorPuyo, NuisancePuyo, and possibly other ones like for example: PointPuyo, IceCube, BombPuyo, StarPuyo, etc.
@@ -18,12 +20,19 @@ enum PuyoType {
 	HARDPUYO
 };
 
+// A puyo keeps its place and its animation values, the sheet it is drawn from is
+// shared, see PuyoSkin. Small types keep the pool slots of a field small.
 class Puyo {
 public:
-	Puyo(int indexX, int indexY, int color, Field* f, float spriteX, float spriteY, GameData* data);
+	// Bits of the link mask, also the column of the link variant on the sheet
+	static constexpr uint8_t kLinkDown = 1;
+	static constexpr uint8_t kLinkUp = 2;
+	static constexpr uint8_t kLinkRight = 4;
+	static constexpr uint8_t kLinkLeft = 8;
+
+	Puyo(int indexX, int indexY, int color, Field* f, float spriteX, float spriteY);
 	Puyo(const Puyo& self); // Copy constructor
 	virtual ~Puyo();
-	virtual Puyo* clone();
 
 	// Get and set
 	[[nodiscard]] int posX() const { return m_posX; } // Returns indexed position
@@ -44,7 +53,7 @@ public:
 	void setAccelerationY(const float val) { m_accelerationY = val; }
 	void addAccelerationY(float val);
 	void setFallDelay(const int val) { m_fallDelay = static_cast<float>(val); }
-	[[nodiscard]] PuyoType getType() const { return m_type; }
+	[[nodiscard]] PuyoType getType() const { return static_cast<PuyoType>(m_type); }
 
 	// Virtual functions
 	virtual void draw(FeRenderTarget* target);
@@ -53,7 +62,7 @@ public:
 	virtual void landProper();
 	virtual bool destroyPuyo();
 	virtual void neighborPop(Field* f, bool v);
-	virtual void updateSprite();
+	virtual void syncState(StateStream& stream);
 
 	// Set animation
 	void setLink(Direction);
@@ -62,86 +71,89 @@ public:
 	void setFallTarget(int target);
 
 	// Public variables
-	GameData* m_data = nullptr;
 	float m_fallDelay = 0.f;
-	int m_fallFlag = 0;
+	int8_t m_fallFlag = 0;
 	bool m_bounceFlag0 = false; // Flag 0
-	int m_bounceFlag = 0, m_searchBounce = 0;
+	int8_t m_bounceFlag = 0, m_searchBounce = 0;
 	float m_bounceTimer = 0.f;
 	float m_bounceMultiplier = 0.f;
 	float m_bounceY = 0.f;
-	int m_bottomY = 0;
+	int8_t m_bottomY = 0;
 	bool m_glow = false;
 	bool m_hard = false;
 	bool m_droppable = false;
 	bool m_lastNuisance = false;
-	bool m_mark = false;
 	bool m_destroy = false;
 	bool m_temporary = false;
 
 protected:
-	int m_posX = 0, m_posY = 0; // Position in the field
-	float m_spriteX = 0.f, m_spriteY = 0.f, m_spriteYsc = 0.f; // Position on the screen (MMF legacy)
-	float m_scaleX = 0.f, m_scaleY = 0.f, m_scaleYcor = 0.f; // Standard scaling
-	float m_scaleXd = 0.f, m_scaleYd = 0.f; // Scaling factor for destruction
-	float m_accelerationY = 0.f, m_targetY = 0.f; // Acceleration factor
-	PuyoType m_type = NOPUYO;
-	int m_color = 0;
-	bool m_linkDown = false, m_linkUp = false, m_linkRight = false, m_linkLeft = false;
+	// Where the puyo is on the sheet of the skin
+	[[nodiscard]] virtual PuyoSkin::Rect look(const PuyoSkin& skin) const;
+	void drawLook(FeRenderTarget* target, BlendingMode blendMode = BlendingMode::AlphaBlending, int alpha = 255, FeShader* shader = nullptr);
+
 	Field* m_field = nullptr;
-	Sprite m_sprite {};
-	int m_destroyTimer = 0;
+	int16_t m_posX = 0, m_posY = 0; // Position in the field
+	float m_spriteX = 0.f, m_spriteY = 0.f; // Position on the screen (MMF legacy)
+	float m_scaleX = 0.f, m_scaleY = 0.f; // Standard scaling
+	float m_scalePop = 0.f; // Scaling factor for destruction
+	float m_accelerationY = 0.f, m_targetY = 0.f; // Acceleration factor
+	uint8_t m_type = NOPUYO;
+	int8_t m_color = 0;
+	uint8_t m_links = 0; // kLink* bits
+	int16_t m_destroyTimer = 0;
 };
 
 class ColorPuyo final : public Puyo {
 public:
-	ColorPuyo(int indexX, int indexY, int color, Field*, float spriteX, float spriteY, GameData* data);
+	ColorPuyo(int indexX, int indexY, int color, Field*, float spriteX, float spriteY);
 	ColorPuyo(const ColorPuyo& self);
 	~ColorPuyo() override = default;
-	ColorPuyo* clone() override;
 
-	void updateSprite() override;
 	void draw(FeRenderTarget* target) override;
 	[[nodiscard]] int getColor() const override;
 	void pop() override;
 	void landProper() override;
 	bool destroyPuyo() override;
 	void neighborPop(Field* f, bool v) override;
+
+private:
+	[[nodiscard]] PuyoSkin::Rect look(const PuyoSkin& skin) const override;
 };
 
 class NuisancePuyo final : public Puyo {
 public:
-	NuisancePuyo(int indexX, int indexY, int color, Field*, float spriteX, float spriteY, GameData* data);
+	NuisancePuyo(int indexX, int indexY, int color, Field*, float spriteX, float spriteY);
 	NuisancePuyo(const NuisancePuyo& self);
 	~NuisancePuyo() override = default;
-	NuisancePuyo* clone() override;
 
-	void updateSprite() override;
-	void draw(FeRenderTarget* target) override;
 	[[nodiscard]] int getColor() const override;
 	void pop() override;
 	void landProper() override;
 	bool destroyPuyo() override;
 	void neighborPop(Field* f, bool v) override;
+
+private:
+	[[nodiscard]] PuyoSkin::Rect look(const PuyoSkin& skin) const override;
 };
 
 class HardPuyo final : public Puyo {
 public:
-	HardPuyo(int indexX, int indexY, int color, Field*, float spriteX, float spriteY, GameData* data);
+	HardPuyo(int indexX, int indexY, int color, Field*, float spriteX, float spriteY);
 	HardPuyo(const HardPuyo& self);
 	~HardPuyo() override = default;
-	HardPuyo* clone() override;
 
-	void updateSprite() override;
-	void draw(FeRenderTarget* target) override;
 	[[nodiscard]] int getColor() const override;
 	void pop() override;
 	void landProper() override;
 	bool destroyPuyo() override;
 	void neighborPop(Field* f, bool v) override;
+	void syncState(StateStream& stream) override;
+
+	int8_t m_life;
+	int8_t m_vlife;
 
-	int m_life;
-	int m_vlife;
+private:
+	[[nodiscard]] PuyoSkin::Rect look(const PuyoSkin& skin) const override;
 };
 
 }
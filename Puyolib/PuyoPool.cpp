@@ -0,0 +1,59 @@
+#include "PuyoPool.h"
+#include <algorithm>
+
+namespace ppvs {
+
+Puyo* PuyoPool::clone(const Puyo& puyo)
+{
+	switch (puyo.getType()) {
+	case COLORPUYO:
+		return acquire<ColorPuyo>(static_cast<const ColorPuyo&>(puyo));
+	case NUISANCEPUYO:
+		return acquire<NuisancePuyo>(static_cast<const NuisancePuyo&>(puyo));
+	case HARDPUYO:
+		return acquire<HardPuyo>(static_cast<const HardPuyo&>(puyo));
+	default:
+		return acquire<Puyo>(puyo);
+	}
+}
+
+void PuyoPool::release(Puyo* puyo)
+{
+	if (!puyo) {
+		return;
+	}
+	const auto arena = static_cast<size_t>(puyo->getType());
+	puyo->~Puyo();
+	m_arenas[arena < kNumArenas ? arena : kPlainArena].free.push_back(puyo);
+	m_stats.released++;
+	m_stats.live--;
+}
+
+void* PuyoPool::take(const size_t arena, const size_t size)
+{
+	Arena& a = m_arenas[arena];
+	if (a.free.empty()) {
+		// Slots stay aligned like anything new returns
+		constexpr size_t align = alignof(std::max_align_t);
+		const size_t slotSize = (size + align - 1) / align * align;
+		a.blocks.emplace_back(new unsigned char[slotSize * kSlotsPerBlock]);
+		a.free.reserve(a.blocks.size() * kSlotsPerBlock);
+		unsigned char* block = a.blocks.back().get();
+		for (size_t i = kSlotsPerBlock; i-- > 0;) {
+			a.free.push_back(block + i * slotSize);
+		}
+		m_stats.blocks++;
+	}
+	void* slot = a.free.back();
+	a.free.pop_back();
+	return slot;
+}
+
+void PuyoPool::count()
+{
+	m_stats.acquired++;
+	m_stats.live++;
+	m_stats.peak = std::max(m_stats.peak, m_stats.live);
+}
+
+}
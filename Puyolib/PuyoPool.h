@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Puyo.h"
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ppvs {
+
+// Storage for the puyos of a field. Every puyo type has its own free list of slots,
+// taken from blocks that stay until the pool is destroyed. Once a match has made
+// enough blocks, placing, popping and predicting don't touch the heap anymore.
+class PuyoPool final {
+public:
+	struct Stats {
+		size_t acquired = 0; // Since the pool was made
+		size_t released = 0;
+		size_t live = 0;
+		size_t peak = 0; // Most live puyos at once
+		size_t blocks = 0; // Allocations from the heap
+	};
+
+	PuyoPool() = default;
+	~PuyoPool() = default;
+
+	PuyoPool(const PuyoPool&) = delete;
+	PuyoPool& operator=(const PuyoPool&) = delete;
+	PuyoPool(PuyoPool&&) = delete;
+	PuyoPool& operator=(PuyoPool&&) = delete;
+
+	// Constructs a T in a free slot
+	template <typename T, typename... Args>
+	T* acquire(Args&&... args)
+	{
+		void* slot = take(arenaOf<T>(), sizeof(T));
+		T* puyo = new (slot) T(std::forward<Args>(args)...);
+		count();
+		return puyo;
+	}
+
+	// Copy of a puyo of any type, see the copy constructors of Puyo
+	Puyo* clone(const Puyo& puyo);
+
+	// Destroys a puyo of this pool. Does nothing with nullptr, like delete.
+	void release(Puyo* puyo);
+
+	[[nodiscard]] const Stats& stats() const { return m_stats; }
+
+private:
+	static constexpr size_t kSlotsPerBlock = 64;
+	static constexpr size_t kNumArenas = HARDPUYO + 1;
+	// Plain puyos, and puyos of a type without an arena of its own
+	static constexpr size_t kPlainArena = NOPUYO;
+
+	struct Arena {
+		std::vector<std::unique_ptr<unsigned char[]>> blocks;
+		std::vector<void*> free;
+	};
+
+	// Arenas are indexed by PuyoType
+	template <typename T>
+	static constexpr size_t arenaOf()
+	{
+		static_assert(std::is_base_of_v<Puyo, T>);
+		if constexpr (std::is_same_v<T, ColorPuyo>) {
+			return COLORPUYO;
+		} else if constexpr (std::is_same_v<T, NuisancePuyo>) {
+			return NUISANCEPUYO;
+		} else if constexpr (std::is_same_v<T, HardPuyo>) {
+			return HARDPUYO;
+		} else {
+			static_assert(std::is_same_v<T, Puyo>, "Puyo type without an arena");
+			return kPlainArena;
+		}
+	}
+
+	void* take(size_t arena, size_t size);
+	void count();
+
+	Arena m_arenas[kNumArenas];
+	Stats m_stats;
+};
+
+}
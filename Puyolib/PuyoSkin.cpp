@@ -0,0 +1,39 @@
+#include "PuyoSkin.h"
+#include "global.h"
+
+namespace ppvs {
+
+PuyoSkin::PuyoSkin()
+{
+	// A row per color, a column per combination of links
+	for (int color = 0; color < kColors; color++) {
+		for (int links = 0; links < 16; links++) {
+			m_linked[color][links] = { static_cast<int16_t>(kPuyoX * links), static_cast<int16_t>(kPuyoY * color) };
+		}
+
+		// Two colors share a column below the link variants
+		m_popping[color] = { static_cast<int16_t>(2 * kPuyoX * (color / 2)), static_cast<int16_t>(12 * kPuyoY + kPuyoY * (color % 2)) };
+	}
+	m_nuisance = { kPuyoX * 6, kPuyoY * 12 };
+	m_hard = { kPuyoX * 14, kPuyoY * 11 };
+}
+
+void PuyoSkin::draw(FeRenderTarget* target, const Rect rect, const float x, const float y, const float scaleX, const float scaleY,
+	const BlendingMode blendMode, const int alpha, FeShader* shader) const
+{
+	target->pushMatrix();
+	target->translate(x - static_cast<float>(kPuyoX / 2) * scaleX, y - static_cast<float>(kPuyoY) * scaleY, 0);
+	target->scale(scaleX, scaleY, 1);
+	target->setBlendMode(blendMode);
+	target->setColor(255, 255, 255, alpha);
+	if (shader) {
+		shader->bind();
+	}
+	target->drawRect(m_image, rect.x, rect.y, kPuyoX, kPuyoY);
+	if (shader) {
+		shader->unbind();
+	}
+	target->popMatrix();
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Frontend.h"
+#include <cstdint>
+
+namespace ppvs {
+
+// Where the looks of a puyo are on the puyo sheet of a skin. Shared by every puyo of a
+// game: a puyo only keeps its animation values and asks the skin for the rest.
+class PuyoSkin final {
+public:
+	// Top left of a puyo sized rectangle on the sheet
+	struct Rect {
+		int16_t x, y;
+	};
+
+	// Colors with a row of link variants on the sheet
+	static constexpr int kColors = 11;
+
+	PuyoSkin();
+	~PuyoSkin() = default;
+
+	PuyoSkin(const PuyoSkin&) = delete;
+	PuyoSkin& operator=(const PuyoSkin&) = delete;
+	PuyoSkin(PuyoSkin&&) = delete;
+	PuyoSkin& operator=(PuyoSkin&&) = delete;
+
+	void setImage(FeImage* image) { m_image = image; }
+	[[nodiscard]] FeImage* image() const { return m_image; }
+
+	// links is a mask of Puyo::kLink* values
+	[[nodiscard]] Rect linked(int color, uint8_t links) const { return m_linked[index(color)][links & 15]; }
+	[[nodiscard]] Rect popping(int color) const { return m_popping[index(color)]; }
+	[[nodiscard]] Rect nuisance() const { return m_nuisance; }
+	[[nodiscard]] Rect hard() const { return m_hard; }
+
+	// Draws a puyo with the bottom center of its rectangle at x, y, like a Sprite
+	// centered there would be
+	void draw(FeRenderTarget* target, Rect rect, float x, float y, float scaleX, float scaleY,
+		BlendingMode blendMode = BlendingMode::AlphaBlending, int alpha = 255, FeShader* shader = nullptr) const;
+
+private:
+	static int index(const int color) { return color < 0 ? 0 : color >= kColors ? kColors - 1 : color; }
+
+	FeImage* m_image = nullptr;
+	Rect m_linked[kColors][16] {};
+	Rect m_popping[kColors] {};
+	Rect m_nuisance {};
+	Rect m_hard {};
+};
+
+}
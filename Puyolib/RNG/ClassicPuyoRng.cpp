@@ -3,6 +3,7 @@
 
 ClassicPuyoRng::ClassicPuyoRng(const uint32_t seed, const int index)
 	: m_pool(new ClassicRng(seed))
+	, m_seed(seed)
 	, m_index(index)
 {
 }
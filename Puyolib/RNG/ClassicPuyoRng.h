@@ -8,8 +8,11 @@ public:
 	explicit ClassicPuyoRng(uint32_t seed = 0, int index = 0);
 
 	Piece next(int colors) override;
+	[[nodiscard]] uint32_t seed() const override { return m_seed; }
+	[[nodiscard]] int index() const override { return m_index; }
 
 private:
 	ClassicPool m_pool;
+	uint32_t m_seed;
 	int m_index;
 };
@@ -3,6 +3,7 @@
 
 LegacyPuyoRng::LegacyPuyoRng(const uint32_t seed, const int index)
 	: m_mt(new MersenneTwister)
+	, m_seed(seed)
 {
 	m_mt->init_genrand(seed);
 	for (int i = 0; i < index; i++) {
@@ -10,8 +11,14 @@ LegacyPuyoRng::LegacyPuyoRng(const uint32_t seed, const int index)
 	}
 }
 
+LegacyPuyoRng::~LegacyPuyoRng()
+{
+	delete m_mt;
+}
+
 Piece LegacyPuyoRng::next(int colors)
 {
+	m_index++;
 	switch (static_cast<int>(m_mt->random() * colors)) {
 	default:
 	case 0:
@@ -7,10 +7,17 @@ class MersenneTwister;
 class LegacyPuyoRng final : public PuyoRng {
 public:
 	LegacyPuyoRng(uint32_t seed, int index);
+	~LegacyPuyoRng() override;
+
+	LegacyPuyoRng(const LegacyPuyoRng&) = delete;
+	LegacyPuyoRng& operator=(const LegacyPuyoRng&) = delete;
 
 	Piece next(int colors) override;
+	[[nodiscard]] uint32_t seed() const override { return m_seed; }
+	[[nodiscard]] int index() const override { return m_index; }
 
 private:
 	MersenneTwister* m_mt;
+	uint32_t m_seed;
 	int m_index{};
 };
@@ -19,6 +19,10 @@ class PuyoRng {
 public:
 	virtual ~PuyoRng() = default;
 	virtual Piece next(int colors) = 0;
+
+	// Where the sequence is at: makePuyoRng with the same seed and index continues from here
+	[[nodiscard]] virtual uint32_t seed() const = 0;
+	[[nodiscard]] virtual int index() const = 0;
 };
 
 PuyoRng* makePuyoRng(const std::string& name, uint32_t seed, int index);
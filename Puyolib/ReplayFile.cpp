@@ -0,0 +1,320 @@
+#include "ReplayFile.h"
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <zlib.h>
+
+namespace ppvs {
+
+namespace {
+
+constexpr char kIndexMagic[4] = { 'R', 'I', 'D', 'X' };
+constexpr unsigned int kMaxChunkSize = 64 * 1024 * 1024;
+constexpr size_t kMaxMessageLength = sizeof(MessageEvent::message) - 1;
+
+void putU16(std::vector<unsigned char>& out, const unsigned int v)
+{
+	out.push_back(static_cast<unsigned char>(v));
+	out.push_back(static_cast<unsigned char>(v >> 8));
+}
+
+void putU32(std::vector<unsigned char>& out, const unsigned int v)
+{
+	out.push_back(static_cast<unsigned char>(v));
+	out.push_back(static_cast<unsigned char>(v >> 8));
+	out.push_back(static_cast<unsigned char>(v >> 16));
+	out.push_back(static_cast<unsigned char>(v >> 24));
+}
+
+unsigned int getU32(const unsigned char* p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | static_cast<unsigned int>(p[3]) << 24;
+}
+
+void putVarint(std::vector<unsigned char>& out, unsigned int v)
+{
+	while (v >= 0x80) {
+		out.push_back(static_cast<unsigned char>(v | 0x80));
+		v >>= 7;
+	}
+	out.push_back(static_cast<unsigned char>(v));
+}
+
+// Zigzag, so that small negative deltas stay short too
+void putDelta(std::vector<unsigned char>& out, const int delta)
+{
+	putVarint(out, (static_cast<unsigned int>(delta) << 1) ^ static_cast<unsigned int>(delta >> 31));
+}
+
+// Reads from an uncompressed chunk, ok becomes false when going past the end
+struct ChunkReader {
+	const unsigned char* pos;
+	const unsigned char* end;
+	bool ok = true;
+
+	unsigned int varint()
+	{
+		unsigned int v = 0;
+		for (int shift = 0; shift < 35; shift += 7) {
+			if (pos == end) {
+				ok = false;
+				return 0;
+			}
+			const unsigned char b = *pos++;
+			v |= static_cast<unsigned int>(b & 0x7F) << shift;
+			if (!(b & 0x80)) {
+				return v;
+			}
+		}
+		ok = false;
+		return 0;
+	}
+
+	int delta()
+	{
+		const unsigned int v = varint();
+		return static_cast<int>((v >> 1) ^ (0 - (v & 1)));
+	}
+
+	unsigned char byte()
+	{
+		if (pos == end) {
+			ok = false;
+			return 0;
+		}
+		return *pos++;
+	}
+
+	uint16_t u16()
+	{
+		if (!has(2)) {
+			return 0;
+		}
+		pos += 2;
+		return static_cast<uint16_t>(pos[-2] | pos[-1] << 8);
+	}
+
+	uint32_t u32()
+	{
+		if (!has(4)) {
+			return 0;
+		}
+		pos += 4;
+		return getU32(pos - 4);
+	}
+
+	// Whether n more bytes can be read
+	bool has(const size_t n)
+	{
+		ok = ok && static_cast<size_t>(end - pos) >= n;
+		return ok;
+	}
+};
+
+}
+
+bool writeReplayChunk(std::ostream& out, const int frame, const std::vector<ReplayStreams>& players, std::vector<ReplayChunkIndex>& index)
+{
+	bool empty = true;
+	std::vector<unsigned char> raw;
+	for (const auto& player : players) {
+		putVarint(raw, static_cast<unsigned int>(player.events->size()));
+		int previous = frame;
+		for (const ControllerEvent& event : *player.events) {
+			putDelta(raw, event.time - previous);
+			raw.push_back(static_cast<unsigned char>(event.ev));
+			previous = event.time;
+			empty = false;
+		}
+
+		putVarint(raw, static_cast<unsigned int>(player.messages->size()));
+		previous = frame;
+		for (const MessageEvent& message : *player.messages) {
+			const size_t length = strnlen(message.message, kMaxMessageLength);
+			putDelta(raw, message.time - previous);
+			putVarint(raw, static_cast<unsigned int>(length));
+			raw.insert(raw.end(), message.message, message.message + length);
+			previous = message.time;
+			empty = false;
+		}
+
+		putVarint(raw, static_cast<unsigned int>(player.hashes->size()));
+		previous = frame;
+		for (const StateHashEvent& hash : *player.hashes) {
+			putDelta(raw, hash.time - previous);
+			putU32(raw, hash.chain);
+			for (const uint16_t value : { hash.field, hash.phase, hash.score, hash.garbage, hash.rng }) {
+				putU16(raw, value);
+			}
+			previous = hash.time;
+			empty = false;
+		}
+	}
+	if (empty) {
+		return true;
+	}
+
+	uLongf compressedSize = compressBound(static_cast<uLong>(raw.size()));
+	std::vector<unsigned char> compressed(compressedSize);
+	if (compress(compressed.data(), &compressedSize, raw.data(), static_cast<uLong>(raw.size())) != Z_OK) {
+		return false;
+	}
+
+	index.push_back({ frame, static_cast<unsigned int>(out.tellp()) });
+	std::vector<unsigned char> header;
+	putU32(header, static_cast<unsigned int>(raw.size()));
+	putU32(header, static_cast<unsigned int>(compressedSize));
+	out.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+	out.write(reinterpret_cast<const char*>(compressed.data()), static_cast<std::streamsize>(compressedSize));
+	return out.good();
+}
+
+bool writeReplayIndex(std::ostream& out, const std::vector<ReplayChunkIndex>& index)
+{
+	std::vector<unsigned char> footer;
+	for (const auto& chunk : index) {
+		putU32(footer, static_cast<unsigned int>(chunk.frame));
+		putU32(footer, chunk.offset);
+	}
+	putU32(footer, static_cast<unsigned int>(index.size()));
+	footer.insert(footer.end(), kIndexMagic, kIndexMagic + 4);
+	out.write(reinterpret_cast<const char*>(footer.data()), static_cast<std::streamsize>(footer.size()));
+	return out.good();
+}
+
+bool readReplayIndex(std::istream& in, std::vector<ReplayChunkIndex>& index)
+{
+	index.clear();
+	in.seekg(0, std::ios::end);
+	const auto size = static_cast<unsigned long long>(in.tellg());
+	if (!in || size < 8) {
+		return false;
+	}
+
+	unsigned char tail[8];
+	in.seekg(static_cast<std::streamoff>(size - 8), std::ios::beg);
+	in.read(reinterpret_cast<char*>(tail), 8);
+	if (!in || std::memcmp(tail + 4, kIndexMagic, 4) != 0) {
+		return false;
+	}
+	const unsigned int count = getU32(tail);
+	if (count > (size - 8) / 8) {
+		return false;
+	}
+
+	std::vector<unsigned char> entries(count * 8);
+	in.seekg(static_cast<std::streamoff>(size - 8 - entries.size()), std::ios::beg);
+	in.read(reinterpret_cast<char*>(entries.data()), static_cast<std::streamsize>(entries.size()));
+	if (!in) {
+		return false;
+	}
+	index.resize(count);
+	for (unsigned int i = 0; i < count; i++) {
+		index[i].frame = static_cast<int>(getU32(&entries[i * 8]));
+		index[i].offset = getU32(&entries[i * 8 + 4]);
+	}
+	return true;
+}
+
+bool readReplayChunk(std::istream& in, const int version, const ReplayChunkIndex& chunk, const std::vector<ReplayStreams>& players)
+{
+	unsigned char header[8];
+	in.seekg(chunk.offset, std::ios::beg);
+	in.read(reinterpret_cast<char*>(header), 8);
+	if (!in) {
+		return false;
+	}
+	uLongf rawSize = getU32(header);
+	const unsigned int compressedSize = getU32(header + 4);
+	if (rawSize > kMaxChunkSize || compressedSize > kMaxChunkSize) {
+		return false;
+	}
+
+	std::vector<unsigned char> compressed(compressedSize);
+	in.read(reinterpret_cast<char*>(compressed.data()), compressedSize);
+	std::vector<unsigned char> raw(rawSize);
+	if (!in || uncompress(raw.data(), &rawSize, compressed.data(), compressedSize) != Z_OK || rawSize != raw.size()) {
+		return false;
+	}
+
+	ChunkReader reader { raw.data(), raw.data() + raw.size() };
+	for (const auto& player : players) {
+		unsigned int count = reader.varint();
+		int time = chunk.frame;
+		// Every event takes at least two bytes
+		if (!reader.has(count * 2ull)) {
+			return false;
+		}
+		for (unsigned int i = 0; i < count; i++) {
+			time += reader.delta();
+			player.events->emplace_back(time, static_cast<char>(reader.byte()));
+		}
+
+		count = reader.varint();
+		time = chunk.frame;
+		if (!reader.has(count * 2ull)) {
+			return false;
+		}
+		for (unsigned int i = 0; i < count; i++) {
+			time += reader.delta();
+			const unsigned int length = reader.varint();
+			if (!reader.has(length)) {
+				return false;
+			}
+			MessageEvent message {};
+			message.time = time;
+			std::memcpy(message.message, reader.pos, std::min<size_t>(length, kMaxMessageLength));
+			reader.pos += length;
+			player.messages->push_back(message);
+		}
+
+		if (version < 5) {
+			continue;
+		}
+		count = reader.varint();
+		time = chunk.frame;
+		// Delta, chain and five subsystems
+		if (!reader.has(count * 15ull)) {
+			return false;
+		}
+		for (unsigned int i = 0; i < count; i++) {
+			StateHashEvent hash {};
+			time += reader.delta();
+			hash.time = time;
+			hash.chain = reader.u32();
+			for (uint16_t* value : { &hash.field, &hash.phase, &hash.score, &hash.garbage, &hash.rng }) {
+				*value = reader.u16();
+			}
+			player.hashes->push_back(hash);
+		}
+	}
+	return reader.ok && reader.pos == reader.end;
+}
+
+bool readReplayChunks(std::istream& in, const int version, const std::vector<ReplayStreams>& players)
+{
+	const auto clear = [&players] {
+		for (const auto& player : players) {
+			player.events->clear();
+			player.messages->clear();
+			player.hashes->clear();
+		}
+	};
+	clear();
+
+	std::vector<ReplayChunkIndex> index;
+	if (!readReplayIndex(in, index)) {
+		return false;
+	}
+	for (const auto& chunk : index) {
+		if (!readReplayChunk(in, version, chunk, players)) {
+			// Part of the input is worse than none, it plays as another match
+			clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+}
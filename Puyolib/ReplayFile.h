@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Controller.h"
+#include "Player.h"
+#include <iosfwd>
+#include <vector>
+
+namespace ppvs {
+
+// Replay format version 4: after the replay, rule set and player headers come chunks
+// holding every player's input for kReplayChunkFrames frames each, then an index of
+// the chunks. Older versions store one zlib blob of raw structs per player instead.
+//
+// Chunk: rawSize and compressedSize (u32), then zlib data. Uncompressed, a chunk has
+// for each player the number of controller events (varint) followed by each event as a
+// time delta (zigzag varint) and the event byte, then the number of messages followed
+// by each message as a time delta, a length (varint) and the text. Version 5 adds the
+// number of state hashes followed by each as a time delta, the chain (u32) and the
+// field, phase, score, garbage and rng hashes (u16). Time deltas are to the previous
+// event of the same list, the first one to the chunk start frame.
+//
+// Index at the end of the file: per chunk the start frame (i32) and file offset (u32),
+// then the number of chunks (u32) and "RIDX". Integers are little endian.
+constexpr int kReplayChunkFrames = 600;
+
+// Recorded input of a player that is written or read
+struct ReplayStreams {
+	std::vector<ControllerEvent>* events;
+	std::vector<MessageEvent>* messages;
+	std::vector<StateHashEvent>* hashes;
+};
+
+struct ReplayChunkIndex {
+	int frame; // First frame in the chunk
+	unsigned int offset; // From the start of the file
+};
+
+// Compresses everything in the streams into one chunk of version 5 that starts at
+// frame, at the current position of out, and adds it to the index. Writes nothing if
+// the streams are empty. Returns false if writing failed.
+bool writeReplayChunk(std::ostream& out, int frame, const std::vector<ReplayStreams>& players, std::vector<ReplayChunkIndex>& index);
+
+// Index after the last chunk
+bool writeReplayIndex(std::ostream& out, const std::vector<ReplayChunkIndex>& index);
+
+// Index from the end of the file
+bool readReplayIndex(std::istream& in, std::vector<ReplayChunkIndex>& index);
+
+// Appends the input of one chunk to the streams
+bool readReplayChunk(std::istream& in, int version, const ReplayChunkIndex& chunk, const std::vector<ReplayStreams>& players);
+
+// Reads all chunks. The streams are cleared first and left empty if reading failed.
+bool readReplayChunks(std::istream& in, int version, const std::vector<ReplayStreams>& players);
+
+}
@@ -0,0 +1,401 @@
+#include "ReplayIndex.h"
+#include "Game.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace ppvs {
+
+namespace {
+
+constexpr char kIndexMagic[4] = { 'R', 'I', 'D', 'B' };
+constexpr unsigned int kIndexVersion = 1;
+constexpr int kMaxPlayers = 64;
+
+class IndexWriter {
+public:
+	explicit IndexWriter(std::vector<char>& out)
+		: m_out(out)
+	{
+	}
+
+	void u8(const unsigned int v) { m_out.push_back(static_cast<char>(v)); }
+	void u16(const unsigned int v)
+	{
+		u8(v);
+		u8(v >> 8);
+	}
+	void u32(const unsigned int v)
+	{
+		u16(v);
+		u16(v >> 16);
+	}
+	void u64(const uint64_t v)
+	{
+		u32(static_cast<unsigned int>(v));
+		u32(static_cast<unsigned int>(v >> 32));
+	}
+	void string(const std::string& s)
+	{
+		const size_t length = std::min<size_t>(s.size(), 0xFFFF);
+		u16(static_cast<unsigned int>(length));
+		m_out.insert(m_out.end(), s.begin(), s.begin() + static_cast<std::ptrdiff_t>(length));
+	}
+
+private:
+	std::vector<char>& m_out;
+};
+
+// ok becomes false when reading past the end
+class IndexReader {
+public:
+	IndexReader(const char* data, const size_t size)
+		: m_pos(reinterpret_cast<const unsigned char*>(data))
+		, m_end(m_pos + size)
+	{
+	}
+
+	[[nodiscard]] bool ok() const { return m_ok; }
+
+	unsigned int u8()
+	{
+		if (m_pos == m_end) {
+			m_ok = false;
+			return 0;
+		}
+		return *m_pos++;
+	}
+	unsigned int u16()
+	{
+		const unsigned int low = u8();
+		return low | u8() << 8;
+	}
+	unsigned int u32()
+	{
+		const unsigned int low = u16();
+		return low | u16() << 16;
+	}
+	uint64_t u64()
+	{
+		const uint64_t low = u32();
+		return low | static_cast<uint64_t>(u32()) << 32;
+	}
+	std::string string()
+	{
+		const unsigned int length = u16();
+		if (static_cast<size_t>(m_end - m_pos) < length) {
+			m_ok = false;
+			return {};
+		}
+		std::string s(reinterpret_cast<const char*>(m_pos), length);
+		m_pos += length;
+		return s;
+	}
+
+private:
+	const unsigned char* m_pos;
+	const unsigned char* m_end;
+	bool m_ok = true;
+};
+
+std::string lowerCase(std::string s)
+{
+	for (char& c : s) {
+		c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+	}
+	return s;
+}
+
+// Offline rules become the online rules of the same mode, so a search finds both
+Rules onlineRules(const Rules rules)
+{
+	switch (rules) {
+	case Rules::TSU:
+		return Rules::TSU_ONLINE;
+	case Rules::FEVER:
+		return Rules::FEVER_ONLINE;
+	case Rules::ENDLESSFEVERVS:
+		return Rules::ENDLESSFEVERVS_ONLINE;
+	default:
+		return rules;
+	}
+}
+
+std::string fixedString(const char* s, const size_t size)
+{
+	return { s, strnlen(s, size) };
+}
+
+void setNames(ReplayIndexEntry& entry)
+{
+	entry.names.clear();
+	for (const auto& player : entry.players) {
+		entry.names += lowerCase(player.name) + "\n";
+	}
+}
+
+}
+
+ReplayIndex::ReplayIndex(std::string folder, std::string indexFile)
+	: m_folder(std::move(folder))
+	, m_indexFile(std::move(indexFile))
+{
+}
+
+ReplayIndex::~ReplayIndex()
+{
+	m_cancel = true;
+	if (m_thread.joinable()) {
+		m_thread.join();
+	}
+}
+
+ReplayIndex& ReplayIndex::shared()
+{
+	static ReplayIndex index("User/Replays/", "User/Replays/index.dat");
+	return index;
+}
+
+void ReplayIndex::startScan()
+{
+	if (m_scanning) {
+		return;
+	}
+	if (m_thread.joinable()) {
+		m_thread.join();
+	}
+	m_scanning = true;
+	m_thread = std::thread([this] {
+		if (!m_loaded) {
+			m_loaded = true;
+			load();
+		}
+		scan();
+		m_scanning = false;
+	});
+}
+
+std::vector<ReplayIndexEntry> ReplayIndex::find(const ReplayFilter& filter, const size_t limit, size_t* total) const
+{
+	const std::string name = lowerCase(filter.name);
+	const Rules rules = onlineRules(static_cast<Rules>(filter.rules));
+	std::vector<ReplayIndexEntry> found;
+	size_t matches = 0;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (const auto& entry : m_entries) {
+		if (!entry.valid
+			|| (filter.rules >= 0 && onlineRules(entry.rules) != rules)
+			|| (!filter.from.empty() && entry.date < filter.from)
+			|| (!filter.to.empty() && entry.date > filter.to)
+			|| (!name.empty() && entry.names.find(name) == std::string::npos)) {
+			continue;
+		}
+		if (found.size() < limit) {
+			found.push_back(entry);
+		}
+		matches++;
+	}
+	if (total) {
+		*total = matches;
+	}
+	return found;
+}
+
+bool ReplayIndex::readEntry(const std::string& path, ReplayIndexEntry& entry)
+{
+	entry.valid = false;
+	entry.players.clear();
+	entry.names.clear();
+
+	std::ifstream in(path, std::ios::binary);
+	ReplayHeader rh {};
+	ReplayRuleSetHeader rrh {};
+	in.read(reinterpret_cast<char*>(&rh), sizeof(ReplayHeader));
+	in.read(reinterpret_cast<char*>(&rrh), sizeof(ReplayRuleSetHeader));
+	if (!in || std::memcmp(rh.mw, "RPVS", 4) != 0 || rh.versionNumber > kReplayVersion
+		|| rrh.numPlayers < 1 || rrh.numPlayers > kMaxPlayers) {
+		return false;
+	}
+	entry.version = rh.versionNumber;
+	entry.date = fixedString(rh.date, sizeof(rh.date));
+	entry.time = fixedString(rh.time, sizeof(rh.time));
+	entry.duration = rh.duration;
+	entry.activePlayers = rh.numberOfActivePlayers;
+	entry.rules = rrh.ruleSetType;
+
+	// Before version 4 the input of a player follows its header
+	for (int i = 0; i < rrh.numPlayers; i++) {
+		ReplayPlayerHeader rph {};
+		in.read(reinterpret_cast<char*>(&rph), sizeof(ReplayPlayerHeader));
+		if (!in) {
+			entry.players.clear();
+			return false;
+		}
+		entry.players.push_back({ fixedString(rph.name, sizeof(rph.name)), rph.character, rph.currentWins, rph.active != 0 });
+		if (rh.versionNumber < 4) {
+			in.seekg(static_cast<std::streamoff>(rph.vectorSizeCompressedMovement) + rph.vectorSizeCompressedMessage, std::ios::cur);
+		}
+	}
+	setNames(entry);
+	entry.valid = true;
+	return true;
+}
+
+bool ReplayIndex::load()
+{
+	std::ifstream in(m_indexFile, std::ios::binary);
+	std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	if (data.size() < 12 || std::memcmp(data.data(), kIndexMagic, 4) != 0) {
+		return false;
+	}
+
+	IndexReader reader(data.data() + 4, data.size() - 4);
+	if (reader.u32() != kIndexVersion) {
+		return false;
+	}
+	const unsigned int count = reader.u32();
+	std::vector<ReplayIndexEntry> entries;
+	for (unsigned int i = 0; i < count && reader.ok(); i++) {
+		ReplayIndexEntry entry;
+		entry.path = reader.string();
+		entry.size = reader.u64();
+		entry.modified = static_cast<int64_t>(reader.u64());
+		entry.valid = reader.u8() != 0;
+		entry.version = static_cast<short>(reader.u16());
+		entry.date = reader.string();
+		entry.time = reader.string();
+		entry.duration = static_cast<int>(reader.u32());
+		entry.activePlayers = static_cast<int>(reader.u8());
+		entry.rules = static_cast<Rules>(reader.u8());
+		const unsigned int players = reader.u8();
+		for (unsigned int p = 0; p < players && reader.ok(); p++) {
+			ReplayIndexEntry::Player player;
+			player.name = reader.string();
+			player.character = static_cast<PuyoCharacter>(reader.u8());
+			player.wins = static_cast<short>(reader.u16());
+			player.active = reader.u8() != 0;
+			entry.players.push_back(std::move(player));
+		}
+		setNames(entry);
+		entries.push_back(std::move(entry));
+	}
+	if (!reader.ok()) {
+		return false;
+	}
+	publish(std::move(entries));
+	return true;
+}
+
+// Written next to the index first, so that a crash can't leave half an index
+bool ReplayIndex::save() const
+{
+	std::vector<char> data(kIndexMagic, kIndexMagic + 4);
+	IndexWriter writer(data);
+	writer.u32(kIndexVersion);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		writer.u32(static_cast<unsigned int>(m_entries.size()));
+		for (const auto& entry : m_entries) {
+			writer.string(entry.path);
+			writer.u64(entry.size);
+			writer.u64(static_cast<uint64_t>(entry.modified));
+			writer.u8(entry.valid);
+			writer.u16(static_cast<unsigned int>(entry.version));
+			writer.string(entry.date);
+			writer.string(entry.time);
+			writer.u32(static_cast<unsigned int>(entry.duration));
+			writer.u8(static_cast<unsigned int>(entry.activePlayers));
+			writer.u8(static_cast<unsigned int>(entry.rules));
+			writer.u8(static_cast<unsigned int>(entry.players.size()));
+			for (const auto& player : entry.players) {
+				writer.string(player.name);
+				writer.u8(player.character);
+				writer.u16(static_cast<unsigned int>(player.wins));
+				writer.u8(player.active);
+			}
+		}
+	}
+
+	const std::string temp = m_indexFile + ".tmp";
+	{
+		std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+		out.write(data.data(), static_cast<std::streamsize>(data.size()));
+		if (!out) {
+			out.close();
+			remove(temp.c_str());
+			return false;
+		}
+	}
+	remove(m_indexFile.c_str());
+	return rename(temp.c_str(), m_indexFile.c_str()) == 0;
+}
+
+void ReplayIndex::scan()
+{
+	// Entries of the last scan by path, the ones that didn't change are kept
+	std::vector<ReplayIndexEntry> previous;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		previous = m_entries;
+	}
+	const auto byPath = [](const ReplayIndexEntry& a, const ReplayIndexEntry& b) {
+		return a.path < b.path;
+	};
+	std::sort(previous.begin(), previous.end(), byPath);
+
+	std::vector<ReplayIndexEntry> entries;
+	bool changed = false;
+	std::error_code error;
+	for (fs::recursive_directory_iterator it(m_folder, fs::directory_options::skip_permission_denied, error), end; it != end; it.increment(error)) {
+		if (m_cancel) {
+			return;
+		}
+		if (!it->is_regular_file(error) || it->path().extension() != ".rvs") {
+			continue;
+		}
+
+		ReplayIndexEntry entry;
+		entry.path = it->path().generic_string();
+		entry.size = it->file_size(error);
+		entry.modified = static_cast<int64_t>(it->last_write_time(error).time_since_epoch().count());
+		const auto known = std::lower_bound(previous.begin(), previous.end(), entry, byPath);
+		if (known != previous.end() && known->path == entry.path && known->size == entry.size && known->modified == entry.modified) {
+			entries.push_back(*known);
+			continue;
+		}
+		readEntry(entry.path, entry);
+		entries.push_back(std::move(entry));
+		changed = true;
+	}
+
+	if (changed || entries.size() != previous.size()) {
+		publish(std::move(entries));
+		save();
+	}
+}
+
+void ReplayIndex::publish(std::vector<ReplayIndexEntry> entries)
+{
+	std::sort(entries.begin(), entries.end(), [](const ReplayIndexEntry& a, const ReplayIndexEntry& b) {
+		if (a.date != b.date) {
+			return a.date > b.date;
+		}
+		if (a.time != b.time) {
+			return a.time > b.time;
+		}
+		return a.path > b.path;
+	});
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_entries.swap(entries);
+	}
+	m_generation++;
+}
+
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "RuleSet/RuleSet.h"
+#include "global.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ppvs {
+
+// What the headers of a replay file say
+struct ReplayIndexEntry {
+	struct Player {
+		std::string name;
+		PuyoCharacter character {};
+		int wins = 0;
+		bool active = false;
+	};
+
+	std::string path;
+	uint64_t size = 0; // Size and modification time tell if the file changed since
+	int64_t modified = 0;
+	bool valid = false; // Not a replay that can be played
+	int version = 0;
+	std::string date; // YYYY/MM/DD
+	std::string time; // HH:MM:SS
+	int duration = 0; // Frames
+	int activePlayers = 0;
+	Rules rules {};
+	std::vector<Player> players;
+	std::string names; // Lower case player names, for searching
+};
+
+struct ReplayFilter {
+	std::string name; // Part of a player name in any case, empty for all
+	int rules = -1; // A Rules value, -1 for all. Offline and online rules of a mode match each other.
+	std::string from; // First and last date (YYYY/MM/DD), empty for no limit
+	std::string to;
+};
+
+// Headers of every replay in a folder. They are kept in a file, so browsing needs to
+// open the replays only the first time. Scanning runs on its own thread and only
+// reads replays whose size or modification time changed.
+class ReplayIndex final {
+public:
+	ReplayIndex(std::string folder, std::string indexFile);
+	~ReplayIndex();
+
+	ReplayIndex(const ReplayIndex&) = delete;
+	ReplayIndex& operator=(const ReplayIndex&) = delete;
+	ReplayIndex(ReplayIndex&&) = delete;
+	ReplayIndex& operator=(ReplayIndex&&) = delete;
+
+	// Index of User/Replays/, loaded the first time
+	static ReplayIndex& shared();
+
+	// Loads the index file if that wasn't done yet, then brings it up to date in the
+	// background. Does nothing while a scan is running.
+	void startScan();
+	[[nodiscard]] bool isScanning() const { return m_scanning; }
+
+	// Changes whenever the entries change
+	[[nodiscard]] unsigned int generation() const { return m_generation; }
+
+	// Matching entries, newest first. total is set to the number of matches, which can
+	// be more than limit.
+	std::vector<ReplayIndexEntry> find(const ReplayFilter& filter, size_t limit, size_t* total = nullptr) const;
+
+	// Reads the headers of one replay
+	static bool readEntry(const std::string& path, ReplayIndexEntry& entry);
+
+	bool load();
+	bool save() const;
+
+private:
+	void scan();
+	void publish(std::vector<ReplayIndexEntry> entries);
+
+	std::string m_folder;
+	std::string m_indexFile;
+	mutable std::mutex m_mutex;
+	std::vector<ReplayIndexEntry> m_entries; // Newest first
+	bool m_loaded = false;
+	std::thread m_thread;
+	std::atomic<bool> m_scanning { false };
+	std::atomic<bool> m_cancel { false };
+	std::atomic<unsigned int> m_generation { 0 };
+};
+
+}
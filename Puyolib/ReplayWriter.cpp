@@ -0,0 +1,188 @@
+#include "ReplayWriter.h"
+#include "global.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace ppvs {
+
+namespace {
+
+template <typename T>
+std::vector<T> takeBefore(std::vector<T>& list, const int end)
+{
+	const auto last = std::find_if(list.begin(), list.end(), [end](const T& entry) {
+		return entry.time >= end;
+	});
+	std::vector<T> taken(list.begin(), last);
+	list.erase(list.begin(), last);
+	return taken;
+}
+
+}
+
+ReplayWriter::Chunk ReplayWriter::takeChunk(const int frame, const int end, const std::vector<ReplayStreams>& players)
+{
+	Chunk chunk;
+	chunk.frame = frame;
+	for (const auto& player : players) {
+		chunk.events.push_back(takeBefore(*player.events, end));
+		chunk.messages.push_back(takeBefore(*player.messages, end));
+		chunk.hashes.push_back(takeBefore(*player.hashes, end));
+	}
+	return chunk;
+}
+
+ReplayWriter::ReplayWriter(std::string folder, const size_t maxQueued)
+	: m_folder(std::move(folder))
+	, m_maxQueued(maxQueued)
+{
+	m_thread = std::thread(&ReplayWriter::run, this);
+}
+
+ReplayWriter::~ReplayWriter()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	m_thread.join();
+}
+
+bool ReplayWriter::isFull()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_jobs.size() >= m_maxQueued;
+}
+
+void ReplayWriter::addChunk(Chunk chunk, const size_t headerSize)
+{
+	Job job;
+	job.type = JobType::CHUNK;
+	job.chunks.push_back(std::move(chunk));
+	job.headerSize = headerSize;
+	push(std::move(job));
+}
+
+void ReplayWriter::finish(std::vector<Chunk> chunks, std::vector<char> headers, std::vector<std::string> folders, std::string path)
+{
+	Job job;
+	job.type = JobType::FINISH;
+	job.chunks = std::move(chunks);
+	job.headerSize = headers.size();
+	job.headers = std::move(headers);
+	job.folders = std::move(folders);
+	job.path = std::move(path);
+	push(std::move(job));
+}
+
+void ReplayWriter::discard()
+{
+	Job job;
+	job.type = JobType::DISCARD;
+	push(std::move(job));
+}
+
+void ReplayWriter::push(Job job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(std::move(job));
+	}
+	m_wake.notify_one();
+}
+
+void ReplayWriter::run()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true) {
+		m_wake.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+		if (m_jobs.empty()) {
+			break;
+		}
+		Job job = std::move(m_jobs.front());
+		m_jobs.pop_front();
+		lock.unlock();
+		process(job);
+		lock.lock();
+	}
+
+	// Nobody finished the replay
+	close();
+}
+
+void ReplayWriter::process(Job& job)
+{
+	// Input that can't be written makes the whole replay useless, so after a failure
+	// everything is skipped until the replay is finished or dropped
+	if (job.type != JobType::DISCARD && open(job.headerSize)) {
+		for (auto& chunk : job.chunks) {
+			std::vector<ReplayStreams> streams;
+			for (size_t i = 0; i < chunk.events.size(); i++) {
+				streams.push_back({ &chunk.events[i], &chunk.messages[i], &chunk.hashes[i] });
+			}
+			m_failed = m_failed || !writeReplayChunk(m_file, chunk.frame, streams, m_index);
+		}
+	}
+	if (job.type == JobType::CHUNK) {
+		return;
+	}
+
+	if (job.type == JobType::FINISH && !m_failed) {
+		m_failed = !writeReplayIndex(m_file, m_index) || job.headers.size() != m_headerSize;
+	}
+	if (job.type == JobType::FINISH && !m_failed) {
+		m_file.seekp(0, std::ios::beg);
+		m_file.write(job.headers.data(), static_cast<std::streamsize>(job.headers.size()));
+		m_file.close();
+		m_failed = m_file.fail();
+	}
+	if (job.type == JobType::DISCARD || m_failed) {
+		close();
+		m_failed = false;
+		return;
+	}
+
+	for (const auto& folder : job.folders) {
+		createFolder(folder);
+	}
+	remove(job.path.c_str());
+	if (rename(m_tempPath.c_str(), job.path.c_str()) != 0) {
+		remove(m_tempPath.c_str());
+	}
+	m_tempPath.clear();
+}
+
+// Starts a new file unless one is open, false if writing failed
+bool ReplayWriter::open(const size_t headerSize)
+{
+	if (m_failed || m_file.is_open()) {
+		return !m_failed;
+	}
+
+	createFolder(m_folder);
+	m_tempPath = m_folder + "recording-" + toString(std::chrono::steady_clock::now().time_since_epoch().count())
+		+ "-" + toString(m_fileCount++) + ".tmp";
+	m_file.clear();
+	m_file.open(m_tempPath.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+	m_index.clear();
+	m_headerSize = headerSize;
+	const std::vector<char> placeholder(headerSize, 0);
+	m_file.write(placeholder.data(), static_cast<std::streamsize>(placeholder.size()));
+	m_failed = !m_file.good();
+	return !m_failed;
+}
+
+// Closes and removes the file that was being written
+void ReplayWriter::close()
+{
+	m_file.close();
+	if (!m_tempPath.empty()) {
+		remove(m_tempPath.c_str());
+		m_tempPath.clear();
+	}
+	m_index.clear();
+}
+
+}
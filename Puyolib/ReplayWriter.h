@@ -0,0 +1,93 @@
+#pragma once
+
+#include "ReplayFile.h"
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ppvs {
+
+// Writes a replay while the match is still going. The game thread hands over the
+// input of every finished chunk, an I/O thread compresses and appends it to a
+// temporary file. At the end of the match the headers are put in the space left
+// for them and the file is moved to its real name. None of the calls wait for the
+// disk: when too many chunks are queued, isFull() tells the game thread to keep the
+// input for now and try again later.
+class ReplayWriter final {
+public:
+	// Input of every player from frame on, moved out of their recordings
+	struct Chunk {
+		int frame = 0;
+		std::vector<std::vector<ControllerEvent>> events;
+		std::vector<std::vector<MessageEvent>> messages;
+		std::vector<std::vector<StateHashEvent>> hashes;
+	};
+
+	// Removes the input before end from the front of the streams
+	static Chunk takeChunk(int frame, int end, const std::vector<ReplayStreams>& players);
+
+	// Temporary files are made in folder
+	explicit ReplayWriter(std::string folder, size_t maxQueued = 8);
+	~ReplayWriter();
+
+	ReplayWriter(const ReplayWriter&) = delete;
+	ReplayWriter& operator=(const ReplayWriter&) = delete;
+	ReplayWriter(ReplayWriter&&) = delete;
+	ReplayWriter& operator=(ReplayWriter&&) = delete;
+
+	[[nodiscard]] bool isFull();
+
+	// A new file starts with headerSize bytes left free
+	void addChunk(Chunk chunk, size_t headerSize);
+
+	// Writes the last chunks and the index, then the headers at the start, creates the
+	// folders in order and moves the file to path. Queued even if the queue is full.
+	void finish(std::vector<Chunk> chunks, std::vector<char> headers, std::vector<std::string> folders, std::string path);
+
+	// Drops the file that is being written
+	void discard();
+
+private:
+	enum class JobType {
+		CHUNK,
+		FINISH,
+		DISCARD,
+	};
+
+	struct Job {
+		JobType type = JobType::CHUNK;
+		std::vector<Chunk> chunks;
+		size_t headerSize = 0;
+		std::vector<char> headers;
+		std::vector<std::string> folders;
+		std::string path;
+	};
+
+	void push(Job job);
+	void run();
+	void process(Job& job);
+	bool open(size_t headerSize);
+	void close();
+
+	std::string m_folder;
+	size_t m_maxQueued;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::deque<Job> m_jobs;
+	bool m_stop = false;
+	std::thread m_thread;
+
+	// Only used by the I/O thread
+	std::ofstream m_file;
+	std::string m_tempPath;
+	int m_fileCount = 0;
+	size_t m_headerSize = 0;
+	std::vector<ReplayChunkIndex> m_index;
+	bool m_failed = false;
+};
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+
+namespace ppvs {
+
+// FNV-1a over 32 bit values
+class StateHasher {
+public:
+	void add(const uint32_t v)
+	{
+		for (int i = 0; i < 32; i += 8) {
+			m_hash ^= (v >> i) & 0xFF;
+			m_hash *= 16777619u;
+		}
+	}
+	[[nodiscard]] uint32_t get() const { return m_hash; }
+
+private:
+	uint32_t m_hash = 2166136261u;
+};
+
+// Simulation state of a player in one frame, one hash per subsystem so that a
+// mismatch tells where two games that should be the same went apart
+struct StateHash {
+	uint32_t field = 0; // Puyos of the active field and fever mode
+	uint32_t phase = 0; // Phase, turns, chain and win state
+	uint32_t score = 0;
+	uint32_t garbage = 0; // Garbage queues of both fields
+	uint32_t rng = 0; // Positions of the random generators
+};
+
+// Recorded every GameSettings::stateHashInterval frames. The chain covers every frame
+// of the match up to time, the subsystems only that frame and are cut to 16 bits.
+struct StateHashEvent {
+	int time;
+	uint32_t chain;
+	uint16_t field, phase, score, garbage, rng;
+};
+
+// Name of the first subsystem that doesn't match the recorded one, "unknown" if they
+// all match (an earlier frame differed)
+inline const char* stateHashDifference(const StateHash& hash, const StateHashEvent& recorded)
+{
+	if (static_cast<uint16_t>(hash.field) != recorded.field) {
+		return "field";
+	}
+	if (static_cast<uint16_t>(hash.phase) != recorded.phase) {
+		return "phase";
+	}
+	if (static_cast<uint16_t>(hash.score) != recorded.score) {
+		return "score";
+	}
+	if (static_cast<uint16_t>(hash.garbage) != recorded.garbage) {
+		return "garbage";
+	}
+	if (static_cast<uint16_t>(hash.rng) != recorded.rng) {
+		return "rng";
+	}
+	return "unknown";
+}
+
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstring>
+#include <deque>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace ppvs {
+
+// Reads or writes the gameplay state of objects, so that a single syncState function
+// describes both directions and the order can't get mixed up. Only used for data that
+// stays in memory (replay keyframes), the layout is not meant to be stored in files.
+class StateStream {
+public:
+	// Write into buffer
+	explicit StateStream(std::vector<char>& buffer)
+		: m_buffer(&buffer)
+	{
+	}
+
+	// Read from data
+	StateStream(const char* data, const size_t size)
+		: m_data(data)
+		, m_size(size)
+	{
+	}
+
+	[[nodiscard]] bool isLoading() const { return m_buffer == nullptr; }
+	[[nodiscard]] bool failed() const { return m_failed; }
+	void fail() { m_failed = true; }
+
+	template <typename T>
+	void value(T& v)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "StateStream can only copy plain values");
+		bytes(&v, sizeof(T));
+	}
+
+	template <typename T>
+	void vector(std::vector<T>& v)
+	{
+		size_t size = v.size();
+		value(size);
+		if (isLoading()) {
+			if (size > remaining() / sizeof(T)) {
+				m_failed = true;
+				return;
+			}
+			v.resize(size);
+		}
+		if (size > 0) {
+			static_assert(std::is_trivially_copyable_v<T>, "StateStream can only copy plain values");
+			bytes(v.data(), size * sizeof(T));
+		}
+	}
+
+	template <typename T>
+	void deque(std::deque<T>& d)
+	{
+		size_t size = d.size();
+		value(size);
+		if (isLoading()) {
+			if (size > remaining() / sizeof(T)) {
+				m_failed = true;
+				return;
+			}
+			d.resize(size);
+		}
+		for (auto& v : d) {
+			value(v);
+		}
+	}
+
+	void string(std::string& s)
+	{
+		size_t size = s.size();
+		value(size);
+		if (isLoading()) {
+			if (size > remaining()) {
+				m_failed = true;
+				return;
+			}
+			s.resize(size);
+		}
+		if (size > 0) {
+			bytes(&s[0], size);
+		}
+	}
+
+private:
+	[[nodiscard]] size_t remaining() const { return m_failed ? 0 : m_size - m_pos; }
+
+	void bytes(void* p, const size_t n)
+	{
+		if (!isLoading()) {
+			const auto* src = static_cast<const char*>(p);
+			m_buffer->insert(m_buffer->end(), src, src + n);
+			return;
+		}
+		if (n > remaining()) {
+			// Leave the value as it was
+			m_failed = true;
+			return;
+		}
+		std::memcpy(p, m_data + m_pos, n);
+		m_pos += n;
+	}
+
+	std::vector<char>* m_buffer = nullptr;
+	const char* m_data = nullptr;
+	size_t m_size = 0;
+	size_t m_pos = 0;
+	bool m_failed = false;
+};
+
+}
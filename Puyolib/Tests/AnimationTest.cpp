@@ -0,0 +1,196 @@
+// Plays data/animation/animation.xml and compares everything it draws and every sound
+// it plays with data/animation/golden.txt. The golden file was written by the script
+// interpreter that came before AnimationTimeline, so compiled scripts must play the
+// same. AnimationTest --print writes the log to stdout instead.
+
+#include "../Animation.h"
+#include "Check.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace ppvs;
+
+namespace {
+
+constexpr int kDuration = 120;
+constexpr int kFrames = kDuration + 5;
+
+class LogImage final : public FeImage {
+public:
+	explicit LogImage(std::string name)
+		: m_name(std::move(name))
+	{
+	}
+
+	int width() override { return 0; }
+	int height() override { return 0; }
+	FePixel pixel(int, int) override { return { 0, 0, 0, 0 }; }
+	bool error() override { return false; }
+	void setFilter(FilterType) override { }
+
+	[[nodiscard]] const std::string& name() const { return m_name; }
+
+private:
+	std::string m_name;
+};
+
+class LogSound final : public FeSound {
+public:
+	LogSound(std::string name, std::vector<std::string>& log)
+		: m_name(std::move(name))
+		, m_log(log)
+	{
+	}
+
+	void play() override { m_log.push_back("play " + m_name); }
+	void stop() override { }
+
+private:
+	std::string m_name;
+	std::vector<std::string>& m_log;
+};
+
+// Writes a line for every rectangle drawn, with the transforms and the color and
+// blending it was drawn with
+class LogFrontend final : public Frontend {
+public:
+	FeImage* loadImage(const char* nameU8) override { return loadImage(std::string(nameU8)); }
+	FeImage* loadImage(const std::string& nameU8) override
+	{
+		auto& image = m_images[nameU8];
+		if (!image) {
+			image = std::make_unique<LogImage>(fileName(nameU8));
+		}
+		return image.get();
+	}
+	FeFont* loadFont(const char*, double) override { return nullptr; }
+
+	void pushMatrix() override { m_transform.clear(); }
+	void popMatrix() override { }
+	void identity() override { }
+	void translate(const float x, const float y, float) override { m_transform += format(" t %.2f %.2f", x, y); }
+	void rotate(const float v, float, float, float) override { m_transform += format(" r %.2f", v); }
+	void scale(const float x, const float y, float) override { m_transform += format(" s %.2f %.2f", x, y); }
+
+	ViewportGeometry viewport() override { return { 640, 480 }; }
+
+	bool hasShaders() override { return false; }
+	FeShader* loadShader(const char*) override { return nullptr; }
+
+	void setBlendMode(const BlendingMode blend) override { m_blend = static_cast<int>(blend); }
+	void setColor(const int r, const int g, const int b, const int a) override { m_color = format("%d %d %d %d", r, g, b, a); }
+	void unsetColor() override { }
+
+	void setDepthFunction(DepthFunction) override { }
+	void clearDepth() override { }
+
+	void enableAlphaTesting(float) override { }
+	void disableAlphaTesting() override { }
+
+	void drawRect(FeImage* image, const double subX, const double subY, const double subW, const double subH) override
+	{
+		const std::string name = image ? static_cast<LogImage*>(image)->name() : "none";
+		log.push_back(name + format(" rect %.0f %.0f %.0f %.0f blend %d color ", subX, subY, subW, subH, m_blend) + m_color + m_transform);
+	}
+	void drawRects(FeImage*, const FeQuad*, size_t) override { log.emplace_back("drawRects"); }
+
+	void clear() override { }
+	void swapBuffers() override { }
+
+	FeSound* loadSound(const char* nameU8) override { return loadSound(std::string(nameU8)); }
+	FeSound* loadSound(const std::string& nameU8) override { return new LogSound(fileName(nameU8), log); }
+	void musicEvent(FeMusicEvent) override { }
+	void musicVolume(float, bool) override { }
+
+	FeInput inputState(int) override { return {}; }
+
+	std::vector<std::string> log;
+
+private:
+	static std::string fileName(const std::string& path)
+	{
+		return path.substr(path.find_last_of('/') + 1);
+	}
+
+	template <typename... Args>
+	static std::string format(const char* f, Args... args)
+	{
+		char buffer[128];
+		std::snprintf(buffer, sizeof(buffer), f, args...);
+		return buffer;
+	}
+
+	std::map<std::string, std::unique_ptr<LogImage>> m_images;
+	std::string m_transform;
+	std::string m_color;
+	int m_blend = 0;
+};
+
+std::vector<std::string> playScript()
+{
+	LogFrontend front;
+	GameData data;
+	data.front = &front;
+	data.playSounds = true;
+	data.windowFocus = true;
+
+	Animation animation;
+	animation.init(&data, { 300.f, 200.f }, 0.75f, "data/animation/", "animation.xml", kDuration);
+
+	// A frame that looks like the one before is one line
+	std::vector<std::string> log;
+	std::vector<std::string> last;
+	// "missing" is not in the script, the sprites stay as the last one left them
+	for (const char* name : { "all", "short", "missing" }) {
+		log.push_back(std::string("animation ") + name);
+		animation.prepareAnimation(name);
+		for (int frame = 0; frame < kFrames; frame++) {
+			front.log.clear();
+			animation.playAnimation();
+			animation.draw();
+			if (front.log == last) {
+				log.push_back("frame " + std::to_string(frame) + " same");
+				continue;
+			}
+			log.push_back("frame " + std::to_string(frame));
+			log.insert(log.end(), front.log.begin(), front.log.end());
+			last = front.log;
+		}
+	}
+	return log;
+}
+
+}
+
+int main(const int argc, char** argv)
+{
+	const std::vector<std::string> log = playScript();
+	if (argc > 1 && std::strcmp(argv[1], "--print") == 0) {
+		for (const auto& line : log) {
+			std::printf("%s\n", line.c_str());
+		}
+		return 0;
+	}
+
+	std::ifstream golden("data/animation/golden.txt");
+	std::vector<std::string> expected;
+	for (std::string line; std::getline(golden, line);) {
+		expected.push_back(line);
+	}
+	CHECK(!expected.empty());
+	for (size_t i = 0; i < std::max(log.size(), expected.size()); i++) {
+		const std::string got = i < log.size() ? log[i] : "(end)";
+		const std::string want = i < expected.size() ? expected[i] : "(end)";
+		if (!CHECK(got == want)) {
+			std::fprintf(stderr, "line %zu\n  expected: %s\n  got:      %s\n", i + 1, want.c_str(), got.c_str());
+			break;
+		}
+	}
+	return testResult();
+}
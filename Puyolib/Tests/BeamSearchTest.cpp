@@ -0,0 +1,83 @@
+// The beam search must pick the same move on every run and every machine, the node
+// budget counts whole levels.
+
+#include "../BeamSearch.h"
+#include "Check.h"
+#include <random>
+
+using namespace ppvs;
+
+namespace {
+
+constexpr int kWidth = 6;
+constexpr int kHeight = 15;
+const PosVectorInt kSpawn(2, 11);
+
+struct Move {
+	bool found = false;
+	int pos = -1, rot = -1, chain = -1, depth = 0;
+
+	bool operator==(const Move& other) const
+	{
+		return found == other.found && pos == other.pos && rot == other.rot && chain == other.chain && depth == other.depth;
+	}
+};
+
+Move searchWith(const BeamSearchSettings& settings, const FieldState& state, const AIPiece pieces[3])
+{
+	BeamSearch search(settings);
+	Move move;
+	move.found = search.search(state, pieces, 3, 4, kSpawn, move.pos, move.rot, move.chain);
+	move.depth = search.getDepth();
+	return move;
+}
+
+}
+
+int main()
+{
+	std::mt19937 rng(77);
+	std::uniform_int_distribution<int> color(0, 3);
+	std::uniform_int_distribution<int> height(0, 6);
+
+	for (int n = 0; n < 50; n++) {
+		FieldState state(kWidth, kHeight);
+		for (int x = 0; x < kWidth; x++) {
+			const int h = height(rng);
+			for (int y = 0; y < h; y++) {
+				state.addColorPuyo(x, y, color(rng));
+			}
+		}
+		state.drop();
+		state.simulateChain(4);
+
+		AIPiece pieces[3];
+		for (auto& piece : pieces) {
+			piece.color1 = color(rng);
+			piece.color2 = color(rng);
+		}
+
+		// The same search gives the same move every time
+		const Move reference = searchWith({}, state, pieces);
+		CHECK(reference.found);
+		CHECK(reference.depth == 3);
+		for (int i = 0; i < 5; i++) {
+			CHECK(searchWith({}, state, pieces) == reference);
+		}
+
+		// A time limit that isn't reached changes nothing
+		BeamSearchSettings limited;
+		limited.timeLimit = 10 * 1000 * 1000;
+		CHECK(searchWith(limited, state, pieces) == reference);
+
+		// The first piece tries 4 rotations in every column
+		BeamSearchSettings budget;
+		budget.nodeBudget = kWidth * 4 - 1;
+		CHECK(!searchWith(budget, state, pieces).found);
+		budget.nodeBudget = kWidth * 4;
+		const Move first = searchWith(budget, state, pieces);
+		CHECK(first.found && first.depth == 1);
+	}
+
+	return testResult();
+}
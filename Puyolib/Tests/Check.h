@@ -0,0 +1,32 @@
+#pragma once
+
+// Checks for the test programs. A failed check prints where it failed and the test
+// goes on, main() returns testResult() so ctest sees every failure at once.
+
+#include <cstdio>
+
+namespace ppvs {
+
+inline int gFailedChecks = 0;
+
+inline bool check(const bool ok, const char* what, const char* file, const int line)
+{
+	if (!ok) {
+		std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what);
+		gFailedChecks++;
+	}
+	return ok;
+}
+
+inline int testResult()
+{
+	if (gFailedChecks > 0) {
+		std::fprintf(stderr, "%d checks failed\n", gFailedChecks);
+		return 1;
+	}
+	return 0;
+}
+
+}
+
+#define CHECK(cond) ::ppvs::check(static_cast<bool>(cond), #cond, __FILE__, __LINE__)
@@ -0,0 +1,166 @@
+// Compares the group search kernel at every SIMD level with the search it replaced,
+// which flooded one group at a time, on random fields. That search is checked in turn
+// against Field::findConnected, the way Field::searchChain has always used it.
+
+#include "../Field.h"
+#include "../FieldState.h"
+#include "../Game.h"
+#include "../GroupSearch.h"
+#include "../NullFrontend.h"
+#include "Check.h"
+#include <random>
+#include <vector>
+
+using namespace ppvs;
+
+namespace {
+
+using Column = FieldState::Column;
+
+// The search before the kernel: flood every group from its first puyo and keep the
+// ones that are large enough. Returns the number of popped puyos.
+int referenceSearch(const FieldState& state, const int puyoToClear, Column popped[FieldState::kMaxColumns])
+{
+	const Column visible = state.visibleRows();
+	Column seen[FieldState::kMaxColumns] {};
+	int count = 0;
+	for (int x = 0; x < state.width(); x++) {
+		for (int y = 0; y < state.height(); y++) {
+			const Column bit = Column(1) << y;
+			if (!(visible & bit) || (seen[x] & bit) || state.getColor(x, y) < 0) {
+				continue;
+			}
+			Column group[FieldState::kMaxColumns];
+			const int size = state.floodGroup(x, y, group);
+			for (int i = 0; i < state.width(); i++) {
+				seen[i] |= group[i];
+				if (size >= puyoToClear) {
+					popped[i] |= group[i];
+				}
+			}
+			if (size >= puyoToClear) {
+				count += size;
+			}
+		}
+	}
+	return count;
+}
+
+// Groups of the visible rows found with Field::findConnected. Returns the number of
+// popped puyos.
+int fieldSearch(Field& field, const int puyoToClear, Column popped[FieldState::kMaxColumns])
+{
+	const FieldProp properties = field.getProperties();
+	std::vector<PosVectorInt> group;
+	int count = 0;
+	field.unmark();
+	for (int x = 0; x < properties.gridX; x++) {
+		for (int y = 0; y < properties.gridY - 3; y++) {
+			group.clear();
+			if (!field.findConnected(x, y, puyoToClear, group)) {
+				continue;
+			}
+			count += static_cast<int>(group.size());
+			for (const PosVectorInt& pos : group) {
+				popped[pos.x] |= Column(1) << pos.y;
+			}
+		}
+	}
+	return count;
+}
+
+// Fills both the state and the field with the same puyos
+void randomField(std::mt19937& rng, FieldState& state, Field& field, FieldProp properties)
+{
+	const int width = std::uniform_int_distribution<int>(1, FieldState::kMaxColumns)(rng);
+	const int height = std::uniform_int_distribution<int>(4, FieldState::kMaxRows)(rng);
+	const int colors = std::uniform_int_distribution<int>(1, FieldState::kMaxColors)(rng);
+	// Sparse fields have many small groups, dense ones a few large groups
+	const double fill = std::uniform_real_distribution<double>(0.1, 1.0)(rng);
+
+	state.reset(width, height);
+	properties.gridX = width;
+	properties.gridY = height;
+	field.clearField();
+	field.init(properties, field.getPlayer());
+	std::uniform_real_distribution<double> chance(0.0, 1.0);
+	std::uniform_int_distribution<int> color(0, colors - 1);
+	for (int x = 0; x < width; x++) {
+		for (int y = 0; y < height; y++) {
+			if (chance(rng) >= fill) {
+				continue;
+			}
+			if (chance(rng) < 0.05) {
+				state.addNuisancePuyo(x, y);
+				field.addNuisancePuyo(x, y);
+			} else {
+				const int c = color(rng);
+				state.addColorPuyo(x, y, c);
+				field.addColorPuyo(x, y, c);
+			}
+		}
+	}
+}
+
+}
+
+int main()
+{
+	std::mt19937 rng(20240601);
+	std::uniform_int_distribution<int> puyoToClear(1, 12);
+
+	const int levels = static_cast<int>(getSupportedSimdLevel()) + 1;
+	std::printf("checking %d SIMD levels\n", levels);
+
+	// A field needs a player to belong to
+	auto* settings = new GameSettings(RuleSetInfo(Rules::TSU));
+	settings->numPlayers = 2;
+	settings->startWithCharacterSelect = false;
+	settings->playSound = false;
+	settings->playMusic = false;
+	settings->headless = true;
+	Game game(settings);
+	game.initGame(new NullFrontend);
+	Player* player = game.m_players[0];
+	const FieldProp properties = player->getNormalField()->getProperties();
+	Field field;
+	field.init(properties, player);
+
+	FieldState state;
+	for (int n = 0; n < 5000; n++) {
+		randomField(rng, state, field, properties);
+		const int toClear = puyoToClear(rng);
+
+		Column expected[FieldState::kMaxColumns] {};
+		const int expectedCount = referenceSearch(state, toClear, expected);
+
+		Column fieldPopped[FieldState::kMaxColumns] {};
+		const int fieldCount = fieldSearch(field, toClear, fieldPopped);
+		bool fieldSame = fieldCount == expectedCount;
+		for (int x = 0; x < FieldState::kMaxColumns; x++) {
+			fieldSame = fieldSame && fieldPopped[x] == expected[x];
+		}
+		if (!CHECK(fieldSame)) {
+			std::fprintf(stderr, "field %d: %dx%d, puyoToClear %d: Field::findConnected found %d puyos, expected %d\n",
+				n, state.width(), state.height(), toClear, fieldCount, expectedCount);
+		}
+
+		for (int level = 0; level < levels; level++) {
+			setSimdLevel(static_cast<SimdLevel>(level));
+			Column popped[FieldState::kMaxColumns] {};
+			const int count = state.findPoppingPuyos(toClear, popped);
+
+			bool same = count == expectedCount;
+			for (int x = 0; x < FieldState::kMaxColumns; x++) {
+				same = same && popped[x] == expected[x];
+			}
+			if (!CHECK(same)) {
+				std::fprintf(stderr, "field %d: %dx%d, puyoToClear %d, level %d: %d puyos, expected %d\n",
+					n, state.width(), state.height(), toClear, level, count, expectedCount);
+			}
+		}
+	}
+	setSimdLevel(getSupportedSimdLevel());
+
+	return testResult();
+}
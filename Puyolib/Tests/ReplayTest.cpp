@@ -0,0 +1,302 @@
+// Records a match and plays it back. Seeking through the replay keyframes must land
+// on the same state as playing straight to that frame, the state hashes must find the
+// frame and subsystem that differ, the replay index must find the replay by its rules,
+// and a damaged replay must not load part of its input.
+
+#include "../Game.h"
+#include "../NullFrontend.h"
+#include "../ReplayFile.h"
+#include "../ReplayIndex.h"
+#include "Check.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+using namespace ppvs;
+
+namespace {
+
+constexpr int kMaxFrames = 60000;
+// Frames of the replay that are checked. Playback only has to agree with itself, so
+// it doesn't matter whether the match is over by then.
+constexpr int kReplayFrames = 3000;
+
+GameSettings* headlessSettings(const RecordState recording)
+{
+	auto* settings = new GameSettings(RuleSetInfo(Rules::TSU));
+	settings->numPlayers = 2;
+	settings->numHumans = 0;
+	settings->startWithCharacterSelect = false;
+	settings->pickColors = false;
+	settings->playSound = false;
+	settings->playMusic = false;
+	settings->headless = true;
+	settings->recording = recording;
+	return settings;
+}
+
+// Two human players press random buttons until the first match is saved. Returns
+// the replay file.
+std::string recordReplay()
+{
+	GameSettings* settings = headlessSettings(RecordState::RECORDING);
+	settings->numHumans = 2;
+	settings->useCpuPlayers = true; // Offline
+	auto* front = new NullFrontend;
+	Game game(settings);
+	game.initGame(front);
+	gRng.init_genrand(1);
+	game.m_menuSelect = 0;
+	game.m_currentGameStatus = GameStatus::REMATCHING;
+	for (auto* player : game.m_players) {
+		player->m_active = true;
+		player->m_rematch = true;
+	}
+
+	// Hold a random set of buttons for a few frames, then let go
+	std::mt19937 rng(1);
+	std::uniform_int_distribution<int> buttons(0, 63);
+	for (int i = 0; i < kMaxFrames; i++) {
+		for (int pl = 0; pl < 2; pl++) {
+			const int held = i % 8 < 6 ? buttons(rng) : 0;
+			front->setInputState(pl, { false, (held & 1) != 0, (held & 6) == 2, (held & 6) == 4, (held & 24) == 8, (held & 24) == 16, false });
+		}
+		game.playGame();
+
+		std::error_code error;
+		for (fs::recursive_directory_iterator it("User/Replays", error), end; !error && it != end; it.increment(error)) {
+			if (it->path().extension() == ".rvs") {
+				return it->path().string();
+			}
+		}
+	}
+	return "";
+}
+
+Game* startReplay(const std::string& file)
+{
+	GameSettings* settings = headlessSettings(RecordState::REPLAYING);
+	settings->replayPlayList.push_back(file);
+	auto* game = new Game(settings);
+	game->initGame(new NullFrontend);
+	game->nextReplay();
+	return game;
+}
+
+void playTo(Game& game, const int frame)
+{
+	while (game.m_replayTimer != 0 || game.m_data->matchTimer < frame) {
+		game.playGame();
+	}
+}
+
+// Hashes of every player, in order
+std::vector<uint32_t> gameState(const Game& game)
+{
+	std::vector<uint32_t> state;
+	for (const auto* player : game.m_players) {
+		const StateHash hash = player->computeStateHash();
+		state.insert(state.end(), { hash.field, hash.phase, hash.score, hash.garbage, hash.rng });
+	}
+	return state;
+}
+
+void checkReplay(const std::string& file)
+{
+	// Reference: the state of every frame when playing straight through
+	std::vector<std::vector<uint32_t>> frames;
+	{
+		Game* game = startReplay(file);
+		for (int i = 0; i < kMaxFrames && game->m_data->matchTimer < kReplayFrames; i++) {
+			game->playGame();
+			if (game->m_replayTimer == 0) {
+				frames.resize(std::max<size_t>(frames.size(), game->m_data->matchTimer + 1));
+				frames[game->m_data->matchTimer] = gameState(*game);
+			}
+		}
+		delete game;
+	}
+	const int end = static_cast<int>(frames.size()) - 1;
+	if (!CHECK(end == kReplayFrames)) {
+		return;
+	}
+
+	Game* game = startReplay(file);
+	playTo(*game, end);
+	CHECK(game->m_replayKeyframes.size() > 0);
+
+	// Backwards and forwards, on and off keyframes
+	for (const int target : { end / 2, 7, end / 3, end - 5, 1, end / 5 * 4, end / 7 }) {
+		if (!CHECK(game->seekReplay(target)) || !CHECK(game->m_data->matchTimer == target)) {
+			continue;
+		}
+		for (int n = 0; n < 300 && game->m_data->matchTimer < end; n++) {
+			if (!CHECK(gameState(*game) == frames[game->m_data->matchTimer])) {
+				std::fprintf(stderr, "seek to %d went apart at frame %d\n", target, game->m_data->matchTimer);
+				break;
+			}
+			game->playGame();
+		}
+	}
+
+	// Stepping back a frame at a time goes through the keyframes too
+	game->m_replayState = ReplayState::REWIND;
+	game->playGame();
+	CHECK(gameState(*game) == frames[game->m_data->matchTimer]);
+	delete game;
+}
+
+// State hashes of every player as a recording would keep them, from a playback. A
+// replay only places puyos on recorded place messages, which local players don't
+// send, so the hashes in the file itself don't match its playback.
+std::vector<std::vector<StateHashEvent>> playbackHashes(const std::string& file)
+{
+	Game* game = startReplay(file);
+	const int interval = game->m_settings->stateHashInterval;
+	std::vector<std::vector<StateHashEvent>> hashes(game->m_players.size());
+	while (game->m_replayTimer != 0 || game->m_data->matchTimer < kReplayFrames) {
+		game->playGame();
+		// Hashed before the match timer went up
+		const int time = game->m_data->matchTimer - 1;
+		if (game->m_replayTimer != 0 || time <= 0 || time % interval != 0) {
+			continue;
+		}
+		for (size_t i = 0; i < hashes.size(); i++) {
+			const Player* player = game->m_players[i];
+			const StateHash hash = player->computeStateHash();
+			hashes[i].push_back({ time, player->m_stateHashChain,
+				static_cast<uint16_t>(hash.field), static_cast<uint16_t>(hash.phase), static_cast<uint16_t>(hash.score),
+				static_cast<uint16_t>(hash.garbage), static_cast<uint16_t>(hash.rng) });
+		}
+	}
+	delete game;
+	return hashes;
+}
+
+Game* startReplay(const std::string& file, const std::vector<std::vector<StateHashEvent>>& hashes)
+{
+	Game* game = startReplay(file);
+	for (size_t i = 0; i < hashes.size(); i++) {
+		game->m_players[i]->m_recordHashes = hashes[i];
+		game->m_players[i]->seekRecording(0);
+	}
+	return game;
+}
+
+void checkStateHashes(const std::string& file)
+{
+	const auto hashes = playbackHashes(file);
+	if (!CHECK(hashes.size() == 2) || !CHECK(hashes[1].size() > 10)) {
+		return;
+	}
+
+	// The same playback matches, also when seeking back and forth
+	Game* game = startReplay(file, hashes);
+	playTo(*game, kReplayFrames);
+	CHECK(game->seekReplay(kReplayFrames / 3));
+	playTo(*game, kReplayFrames / 2);
+	CHECK(game->seekReplay(10));
+	playTo(*game, kReplayFrames);
+	for (const auto* player : game->m_players) {
+		CHECK(player->m_desyncFrame == -1);
+	}
+	delete game;
+
+	// One subsystem of one player is off in one frame
+	auto tampered = hashes;
+	StateHashEvent& event = tampered[1][tampered[1].size() / 2];
+	event.chain ^= 1;
+	event.score ^= 1;
+	game = startReplay(file, tampered);
+	playTo(*game, kReplayFrames);
+	CHECK(game->m_players[0]->m_desyncFrame == -1);
+	CHECK(game->m_players[1]->m_desyncFrame == event.time);
+	CHECK(std::string(game->m_players[1]->m_desyncSubsystem) == "score");
+	delete game;
+}
+
+// The replay is offline Tsu, a search for either Tsu finds it
+void checkReplayIndex()
+{
+	ReplayIndex index("User/Replays/", "User/Replays/index.dat");
+	index.startScan();
+	while (index.isScanning()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	ReplayFilter filter;
+	size_t total = 0;
+	for (const Rules rules : { Rules::TSU, Rules::TSU_ONLINE }) {
+		filter.rules = static_cast<int>(rules);
+		index.find(filter, 10, &total);
+		CHECK(total == 1);
+	}
+	filter.rules = static_cast<int>(Rules::FEVER_ONLINE);
+	index.find(filter, 10, &total);
+	CHECK(total == 0);
+}
+
+// Loads the input of every player, true if none of them has any
+bool replayEmpty(const std::string& file)
+{
+	Game* game = startReplay(file);
+	bool empty = true;
+	for (const auto* player : game->m_players) {
+		empty = empty && player->m_controls.m_recordEvents.empty() && player->m_recordMessages.empty() && player->m_recordHashes.empty();
+	}
+	delete game;
+	return empty;
+}
+
+void checkDamagedReplay(const std::string& file)
+{
+	CHECK(!replayEmpty(file));
+
+	// The chunks before the last one can still be read
+	const std::string damaged = "damaged.rvs";
+	fs::copy_file(file, damaged, fs::copy_options::overwrite_existing);
+	std::vector<ReplayChunkIndex> index;
+	{
+		std::ifstream in(damaged, std::ios::binary);
+		if (!CHECK(readReplayIndex(in, index)) || !CHECK(index.size() > 1)) {
+			return;
+		}
+	}
+	{
+		std::fstream out(damaged, std::ios::in | std::ios::out | std::ios::binary);
+		out.seekp(index.back().offset);
+		const char size[4] = { '\xff', '\xff', '\xff', '\xff' };
+		out.write(size, sizeof(size));
+	}
+	CHECK(replayEmpty(damaged));
+}
+
+}
+
+int main()
+{
+	// Replays are saved to User/Replays in the working directory, which only creates
+	// the last part of the path
+	const fs::path cwd = fs::current_path();
+	const fs::path dir = fs::temp_directory_path() / "puyovs-replaytest";
+	fs::remove_all(dir);
+	fs::create_directories(dir / "User");
+	fs::current_path(dir);
+
+	const std::string file = recordReplay();
+	if (CHECK(!file.empty())) {
+		checkReplay(file);
+		checkStateHashes(file);
+		checkReplayIndex();
+		checkDamagedReplay(file);
+	}
+
+	fs::current_path(cwd);
+	fs::remove_all(dir);
+	return testResult();
+}
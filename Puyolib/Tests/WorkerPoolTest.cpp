@@ -0,0 +1,59 @@
+// Batches must run every task once, also from a posted job and when two batches
+// are started at the same time.
+
+#include "../WorkerPool.h"
+#include "Check.h"
+#include <future>
+#include <memory>
+#include <vector>
+
+using namespace ppvs;
+
+namespace {
+
+// Every task adds its index to its own slot
+bool runBatch(WorkerPool& pool, const int count)
+{
+	std::vector<int> slots(count, 0);
+	pool.run(count, [&slots](const int i) { slots[i] += i; });
+	for (int i = 0; i < count; i++) {
+		if (slots[i] != i) {
+			return false;
+		}
+	}
+	return true;
+}
+
+}
+
+int main()
+{
+	WorkerPool pool(3);
+	CHECK(pool.threadCount() == 3);
+
+	for (const int count : { 0, 1, 2, 7, 100, 1000 }) {
+		CHECK(runBatch(pool, count));
+	}
+
+	// Jobs run on the pool and may start batches of their own, also while the
+	// calling thread runs one
+	for (int n = 0; n < 50; n++) {
+		std::vector<std::future<bool>> results;
+		for (int job = 0; job < 3; job++) {
+			auto task = std::make_shared<std::packaged_task<bool()>>([&pool] { return runBatch(pool, 200); });
+			results.push_back(task->get_future());
+			CHECK(pool.post([task] { (*task)(); }));
+		}
+		CHECK(runBatch(pool, 200));
+		for (auto& result : results) {
+			CHECK(result.get());
+		}
+	}
+
+	// Without threads jobs can't be posted and batches run on the caller
+	WorkerPool empty(0);
+	CHECK(!empty.post([] {}));
+	CHECK(runBatch(empty, 100));
+
+	return testResult();
+}
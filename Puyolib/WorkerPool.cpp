@@ -0,0 +1,166 @@
+#include "WorkerPool.h"
+#include <algorithm>
+
+namespace ppvs {
+
+WorkerPool::WorkerPool(const int threads)
+{
+	m_numQueues = std::max(threads, 0) + 1;
+	m_queues = std::make_unique<Queue[]>(m_numQueues);
+	for (int i = 0; i < threads; i++) {
+		m_threads.emplace_back(&WorkerPool::workerLoop, this, i);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	for (auto& thread : m_threads) {
+		thread.join();
+	}
+}
+
+WorkerPool& WorkerPool::shared()
+{
+	// Leave one core to the game thread, more than 8 threads won't help with field sized tasks
+	static WorkerPool pool(std::clamp(static_cast<int>(std::thread::hardware_concurrency()) - 1, 0, 7));
+	return pool;
+}
+
+void WorkerPool::run(const int count, const std::function<void(int)>& task)
+{
+	if (count <= 0) {
+		return;
+	}
+
+	// Nothing to share the work with
+	if (m_threads.empty() || count == 1) {
+		for (int i = 0; i < count; i++) {
+			task(i);
+		}
+		return;
+	}
+
+	// Waiting for the other batch would only serialize the two
+	std::unique_lock<std::mutex> runLock(m_runMutex, std::try_to_lock);
+	if (!runLock.owns_lock()) {
+		for (int i = 0; i < count; i++) {
+			task(i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_task.store(&task);
+		m_remaining = count;
+	}
+
+	// Hand out consecutive ranges, stealing evens out the rest
+	for (int q = 0; q < m_numQueues; q++) {
+		std::lock_guard<std::mutex> lock(m_queues[q].mutex);
+		for (int i = q * count / m_numQueues; i < (q + 1) * count / m_numQueues; i++) {
+			m_queues[q].tasks.push_back(i);
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_batch++;
+	}
+	m_wake.notify_all();
+
+	// Work along
+	int i;
+	while (popTask(m_numQueues - 1, i)) {
+		task(i);
+		finishTask();
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [this] { return m_remaining == 0; });
+	m_task.store(nullptr);
+}
+
+bool WorkerPool::post(std::function<void()> job)
+{
+	if (m_threads.empty()) {
+		return false;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(std::move(job));
+	}
+	m_wake.notify_one();
+	return true;
+}
+
+void WorkerPool::workerLoop(const int self)
+{
+	unsigned int batch = 0;
+	while (true) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this, batch] { return m_stop || m_batch != batch || !m_jobs.empty(); });
+			if (m_stop) {
+				return;
+			}
+			// Tasks of a batch go first, its caller is waiting for them
+			if (m_batch == batch) {
+				job = std::move(m_jobs.front());
+				m_jobs.pop_front();
+			}
+			batch = m_batch;
+		}
+		if (job) {
+			job();
+			continue;
+		}
+
+		// A late wakeup may already see the tasks of a newer batch. The batch of a
+		// popped task can't end before it is finished, so m_task still belongs to it.
+		int i;
+		while (popTask(self, i)) {
+			(*m_task.load())(i);
+			finishTask();
+		}
+	}
+}
+
+// Take from the front of the own queue, or steal from the back of another one
+bool WorkerPool::popTask(const int self, int& task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_queues[self].mutex);
+		if (!m_queues[self].tasks.empty()) {
+			task = m_queues[self].tasks.front();
+			m_queues[self].tasks.pop_front();
+			return true;
+		}
+	}
+	for (int offset = 1; offset < m_numQueues; offset++) {
+		Queue& victim = m_queues[(self + offset) % m_numQueues];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			task = victim.tasks.back();
+			victim.tasks.pop_back();
+			return true;
+		}
+	}
+	return false;
+}
+
+void WorkerPool::finishTask()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (--m_remaining == 0) {
+		m_done.notify_one();
+	}
+}
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ppvs {
+
+// Small pool of worker threads for spreading CPU-heavy loops, such as the AI
+// placement search, over several cores. Every thread has its own task queue and
+// steals from the back of the other queues once it runs dry, so uneven tasks
+// still keep all threads busy. The calling thread works along until the batch is done.
+class WorkerPool final {
+public:
+	explicit WorkerPool(int threads);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+	WorkerPool(WorkerPool&&) = delete;
+	WorkerPool& operator=(WorkerPool&&) = delete;
+
+	// Pool shared by the whole game, sized after the number of cores
+	static WorkerPool& shared();
+
+	// Number of threads besides the calling thread
+	[[nodiscard]] int threadCount() const { return static_cast<int>(m_threads.size()); }
+
+	// Run task(i) for every i in [0, count) and return once all of them have finished.
+	// Tasks may run in any order and on any thread, so they must only write to
+	// their own results. One batch is shared at a time, a batch started while another
+	// one is running is done by the calling thread alone.
+	void run(int count, const std::function<void(int)>& task);
+
+	// Run job on one of the threads and return right away. Jobs are picked up in
+	// order between batches and may call run(). Returns false if there are no
+	// threads, the job is dropped in that case.
+	bool post(std::function<void()> job);
+
+private:
+	struct Queue {
+		std::mutex mutex;
+		std::deque<int> tasks;
+	};
+
+	void workerLoop(int self);
+	bool popTask(int self, int& task);
+	void finishTask();
+
+	std::vector<std::thread> m_threads;
+	std::unique_ptr<Queue[]> m_queues; // One per worker, the last one belongs to the caller
+	int m_numQueues = 0;
+
+	std::mutex m_runMutex; // Held by the batch that is shared
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	std::atomic<const std::function<void(int)>*> m_task { nullptr }; // Set before the tasks of a batch are queued
+	std::deque<std::function<void()>> m_jobs;
+	unsigned int m_batch = 0;
+	int m_remaining = 0;
+	bool m_stop = false;
+};
+
+}
@@ -40,7 +40,7 @@ float tunnelShaderColor[6][3] = {
 };
 
 // Global randomizer
-MersenneTwister gRng;
+thread_local MersenneTwister gRng;
 
 // Load ini file
 UserSettings gUserSettings;
@@ -91,31 +91,6 @@ int toInt(const std::string& s)
 	return i;
 }
 
-// Input t must go from 0 to 1
-double interpolate(std::string type, double s, double e, double t, double alpha, double beta)
-{
-	double out = 0;
-	if (type == "linear")
-		out = (e - s) * t + s;
-	else if (type == "quadratic")
-		out = (e - s) * t * t + s;
-	else if (type == "squareroot")
-		out = (e - s) * pow(t, 0.5) + s;
-	else if (type == "cubic")
-		out = (e - s) * t * t * t + s;
-	else if (type == "cuberoot")
-		out = (e - s) * pow(t, 1.0 / 3.0) + s;
-	else if (type == "exponential")
-		out = (e - s) / (exp(alpha) - 1) * exp(alpha * t) + s - (e - s) / (exp(alpha) - 1);
-	else if (type == "elastic") // beta=wavenumber
-		out = (e - s) / (exp(alpha) - 1) * cos(beta * t * 2 * kPiF) * exp(alpha * t) + s - (e - s) / (exp(alpha) - 1);
-	else if (type == "sin")
-		out = s + e * sin(alpha * t * 2 * kPiF); // s=offset, e=amplitude, alpha=wavenumber
-	else if (type == "cos")
-		out = s + e * cos(alpha * t * 2 * kPiF); // s=offset, e=amplitude, alpha=wavenumber
-	return out;
-}
-
 void splitString(std::string& in, char delimiter, StringList& v)
 {
 	std::stringstream stream(in);
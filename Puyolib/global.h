@@ -1,5 +1,7 @@
 #pragma once
+#include "Easing.h"
 #include "Frontend.h"
+#include "PuyoSkin.h"
 #include "RNG/MersenneTwister.h"
 #include "Sound.h"
 
@@ -68,6 +70,12 @@ enum PuyoCharacter : unsigned char {
 
 constexpr int kNumCharacters = 24;
 
+// Move selection of CPU players
+enum class AIStrategy {
+	GREEDY, // Longest chain of the current piece
+	BEAM, // Beam search over the current and next pieces
+};
+
 enum class RecordState : int {
 	NOT_RECORDING,
 	RECORDING,
@@ -108,6 +116,7 @@ struct GameData {
 	FeImage* imgDropSet {};
 	FeShader* glowShader {};
 	FeShader* tunnelShader {};
+	PuyoSkin puyoSkin; // Looks of the puyos in the field, drawn from imgPuyo
 	Sounds snd;
 	UserSettings gUserSettings;
 	int globalTimer {}; // Global timer in game
@@ -115,6 +124,7 @@ struct GameData {
 	int quadrupletCenter {}; // Center of rotation for quadruplets
 	bool windowFocus {};
 	bool playSounds {}, playMusic {};
+	bool headless {}; // Skip work that only affects presentation (particles, animations, sprite effects)
 };
 
 struct TranslatableStrings {
@@ -155,8 +165,8 @@ extern const std::string kFolderUserBackgrounds;
 extern const std::string kFolderUserPuyo;
 extern const std::string kFolderUserCharacter;
 
-// Global RNG
-extern MersenneTwister gRng;
+// Global RNG, one per thread so that several games can run side by side
+extern thread_local MersenneTwister gRng;
 
 // Shader
 extern bool useShaders;
@@ -170,7 +180,6 @@ int getRandom(int);
 std::string Lower(std::string str);
 void setBuffer(Sound& s, FeSound* sb);
 int sign(int i);
-double interpolate(std::string type, double startVal, double endVal, double t, double alpha = 1, double beta = 1);
 void splitString(std::string& in, char delimiter, StringList& v);
 void createFolder(std::string folderName);
 
@@ -0,0 +1,365 @@
+// Simulates replays without a display and prints statistics about each of them.
+//
+// ReplayAnalyzer [-j threads] [--json] <directory | file | glob>...
+//
+// Directories are searched recursively for .rvs files, globs (* and ?) only match
+// file names in one directory. Replays are handed out in batches to a worker pool and
+// the results of a batch are printed as soon as it is done, so memory stays the same
+// no matter how many replays there are. Totals are printed to stderr at the end.
+//
+// CSV has one line per player of a replay, --json one object per replay. Replays that
+// don't play out like they were recorded get status desync, with the first frame at
+// which a player's state hash didn't match and the part of the state that differed.
+
+#include "../Puyolib/Game.h"
+#include "../Puyolib/NullFrontend.h"
+#include "../Puyolib/WorkerPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+using namespace ppvs;
+
+namespace {
+
+// Frames to keep simulating after the recorded duration before giving up
+constexpr int kExtraFrames = 60 * 60;
+
+struct PlayerResult {
+	std::string name;
+	int score = 0;
+	int maxChain = 0;
+	int garbageSent = 0;
+	int garbageReceived = 0;
+	int desyncFrame = -1;
+	std::string desyncSubsystem;
+};
+
+struct ReplayResult {
+	std::string file;
+	const char* status = "ok"; // ok, unreadable, unsupported, unfinished, desync
+	int version = 0;
+	int frames = 0;
+	int winner = -1; // Player index, -1 if nobody won
+	std::vector<PlayerResult> players;
+};
+
+ReplayResult analyze(const std::string& file)
+{
+	ReplayResult result;
+	result.file = file;
+
+	// Check the header first, Game doesn't report load errors
+	ReplayHeader header {};
+	{
+		std::ifstream in(file, std::ios::binary);
+		in.read(reinterpret_cast<char*>(&header), sizeof(ReplayHeader));
+		if (!in || std::memcmp(header.mw, "RPVS", 4) != 0) {
+			result.status = "unreadable";
+			return result;
+		}
+	}
+	result.version = header.versionNumber;
+	if (header.versionNumber > kReplayVersion) {
+		result.status = "unsupported";
+		return result;
+	}
+
+	// gRng is per thread and only seeded on the main one. Seeding it from the replay
+	// gives the same result whichever thread plays it.
+	gRng.init_genrand(header.randomSeed);
+
+	auto* settings = new GameSettings(RuleSetInfo(Rules::TSU));
+	settings->numPlayers = 2;
+	settings->numHumans = 0;
+	settings->startWithCharacterSelect = false;
+	settings->pickColors = false;
+	settings->playSound = false;
+	settings->playMusic = false;
+	settings->headless = true;
+	settings->recording = RecordState::REPLAYING;
+	settings->replayKeyframeBudget = 0;
+	settings->replayPlayList.push_back(file);
+
+	Game game(settings);
+	game.initGame(new NullFrontend);
+	game.nextReplay();
+
+	// Play until every player who took part has won or lost
+	const int limit = std::max(header.duration, 0) + kExtraFrames;
+	bool finished = false;
+	while (!finished && game.m_data->matchTimer < limit) {
+		game.playGame();
+		finished = true;
+		for (const auto& player : game.m_players) {
+			if (player->m_active && player->m_loseWin == LoseWinState::NOWIN) {
+				finished = false;
+			}
+		}
+	}
+	if (!finished) {
+		result.status = "unfinished";
+	}
+
+	result.frames = game.m_data->matchTimer;
+	for (size_t i = 0; i < game.m_players.size(); i++) {
+		const Player* player = game.m_players[i];
+		if (player->m_loseWin == LoseWinState::WIN) {
+			result.winner = static_cast<int>(i);
+		}
+		result.players.push_back({ player->m_onlineName, player->m_scoreVal, player->m_maxChain, player->m_garbageSent, player->m_garbageReceived,
+			player->m_desyncFrame, player->m_desyncSubsystem });
+		if (player->m_desyncFrame >= 0) {
+			result.status = "desync";
+		}
+	}
+	return result;
+}
+
+// Lists the replays of the arguments one by one, without collecting them first
+class ReplaySource {
+public:
+	explicit ReplaySource(std::vector<std::string> args)
+		: m_args(std::move(args))
+	{
+	}
+
+	bool next(std::string& path)
+	{
+		while (true) {
+			std::error_code error;
+			if (m_walking) {
+				for (; m_walk != fs::recursive_directory_iterator(); m_walk.increment(error)) {
+					if (m_walk->is_regular_file(error) && m_walk->path().extension() == ".rvs") {
+						path = m_walk->path().string();
+						m_walk.increment(error);
+						return true;
+					}
+				}
+				m_walking = false;
+			}
+			if (m_globbing) {
+				for (; m_glob != fs::directory_iterator(); m_glob.increment(error)) {
+					if (m_glob->is_regular_file(error) && matches(m_pattern.c_str(), m_glob->path().filename().string().c_str())) {
+						path = m_glob->path().string();
+						m_glob.increment(error);
+						return true;
+					}
+				}
+				m_globbing = false;
+			}
+
+			if (m_arg >= m_args.size()) {
+				return false;
+			}
+			const fs::path arg = m_args[m_arg++];
+			const std::string name = arg.filename().string();
+			if (fs::is_directory(arg, error)) {
+				m_walk = fs::recursive_directory_iterator(arg, fs::directory_options::skip_permission_denied, error);
+				m_walking = !error;
+			} else if (name.find_first_of("*?") != std::string::npos) {
+				const fs::path parent = arg.has_parent_path() ? arg.parent_path() : fs::path(".");
+				m_glob = fs::directory_iterator(parent, error);
+				m_pattern = name;
+				m_globbing = !error;
+			} else {
+				path = arg.string();
+				return true;
+			}
+		}
+	}
+
+private:
+	static bool matches(const char* pattern, const char* name)
+	{
+		if (*pattern == '\0') {
+			return *name == '\0';
+		}
+		if (*pattern == '*') {
+			return matches(pattern + 1, name) || (*name != '\0' && matches(pattern, name + 1));
+		}
+		return *name != '\0' && (*pattern == '?' || *pattern == *name) && matches(pattern + 1, name + 1);
+	}
+
+	std::vector<std::string> m_args;
+	size_t m_arg = 0;
+	fs::recursive_directory_iterator m_walk;
+	bool m_walking = false;
+	fs::directory_iterator m_glob;
+	std::string m_pattern;
+	bool m_globbing = false;
+};
+
+std::string jsonString(const std::string& s)
+{
+	std::string out = "\"";
+	for (const char c : s) {
+		if (c == '"' || c == '\\') {
+			out += '\\';
+			out += c;
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			out += escaped;
+		} else {
+			out += c;
+		}
+	}
+	return out + "\"";
+}
+
+std::string csvString(const std::string& s)
+{
+	if (s.find_first_of(",\"\n") == std::string::npos) {
+		return s;
+	}
+	std::string out = "\"";
+	for (const char c : s) {
+		if (c == '"') {
+			out += '"';
+		}
+		out += c;
+	}
+	return out + "\"";
+}
+
+void printResult(const ReplayResult& result, const bool json)
+{
+	if (json) {
+		std::string line = "{\"file\":" + jsonString(result.file) + ",\"status\":\"" + result.status + "\""
+			+ ",\"version\":" + std::to_string(result.version) + ",\"frames\":" + std::to_string(result.frames)
+			+ ",\"winner\":" + std::to_string(result.winner) + ",\"players\":[";
+		for (size_t i = 0; i < result.players.size(); i++) {
+			const PlayerResult& player = result.players[i];
+			line += (i > 0 ? ",{\"name\":" : "{\"name\":") + jsonString(player.name)
+				+ ",\"score\":" + std::to_string(player.score) + ",\"maxChain\":" + std::to_string(player.maxChain)
+				+ ",\"garbageSent\":" + std::to_string(player.garbageSent)
+				+ ",\"garbageReceived\":" + std::to_string(player.garbageReceived)
+				+ ",\"desyncFrame\":" + std::to_string(player.desyncFrame)
+				+ ",\"desyncSubsystem\":" + jsonString(player.desyncSubsystem) + "}";
+		}
+		line += "]}\n";
+		fputs(line.c_str(), stdout);
+		return;
+	}
+
+	const std::string prefix = csvString(result.file) + "," + result.status + "," + std::to_string(result.version) + ","
+		+ std::to_string(result.frames) + "," + std::to_string(result.winner) + ",";
+	if (result.players.empty()) {
+		// The 8 player columns are empty, the prefix already ends with a separator
+		fputs((prefix + ",,,,,,,\n").c_str(), stdout);
+		return;
+	}
+	for (size_t i = 0; i < result.players.size(); i++) {
+		const PlayerResult& player = result.players[i];
+		const std::string line = prefix + std::to_string(i) + "," + csvString(player.name) + ","
+			+ std::to_string(player.score) + "," + std::to_string(player.maxChain) + ","
+			+ std::to_string(player.garbageSent) + "," + std::to_string(player.garbageReceived) + ","
+			+ std::to_string(player.desyncFrame) + "," + player.desyncSubsystem + "\n";
+		fputs(line.c_str(), stdout);
+	}
+}
+
+void printUsage()
+{
+	fputs("Usage: ReplayAnalyzer [-j threads] [--json] <directory | file | glob>...\n", stderr);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	int threads = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+	bool json = false;
+	std::vector<std::string> args;
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "-j", 2) == 0) {
+			// Both "-j 8" and "-j8"
+			const char* value = argv[i][2] != '\0' ? argv[i] + 2 : i + 1 < argc ? argv[++i] : nullptr;
+			char* end = nullptr;
+			const long count = value ? strtol(value, &end, 10) : 0;
+			if (!value || *value == '\0' || *end != '\0' || count < 1 || count > std::numeric_limits<int>::max()) {
+				fprintf(stderr, "ReplayAnalyzer: -j needs a number of threads\n");
+				printUsage();
+				return 1;
+			}
+			threads = static_cast<int>(count);
+		} else if (strcmp(argv[i], "--json") == 0) {
+			json = true;
+		} else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+			printUsage();
+			return 0;
+		} else if (argv[i][0] == '-') {
+			fprintf(stderr, "ReplayAnalyzer: unknown option %s\n", argv[i]);
+			printUsage();
+			return 1;
+		} else {
+			args.emplace_back(argv[i]);
+		}
+	}
+	if (args.empty()) {
+		printUsage();
+		return 1;
+	}
+
+	// Before the threads start, so they don't race to set up the globals
+	initGlobal();
+
+	if (!json) {
+		fputs("file,status,version,frames,winner,player,name,score,max_chain,garbage_sent,garbage_received,desync_frame,desync_subsystem\n", stdout);
+	}
+
+	WorkerPool pool(threads - 1);
+	ReplaySource source(std::move(args));
+	const size_t batchSize = static_cast<size_t>(threads) * 16;
+	std::vector<std::string> batch;
+	std::vector<ReplayResult> results;
+	long long replays = 0;
+	long long failed = 0;
+	long long frames = 0;
+	const auto start = std::chrono::steady_clock::now();
+
+	bool more = true;
+	while (more) {
+		batch.clear();
+		std::string path;
+		while (batch.size() < batchSize && (more = source.next(path))) {
+			batch.push_back(path);
+		}
+		if (batch.empty()) {
+			break;
+		}
+
+		results.clear();
+		results.resize(batch.size());
+		pool.run(static_cast<int>(batch.size()), [&](const int i) {
+			results[i] = analyze(batch[i]);
+		});
+
+		for (const auto& result : results) {
+			printResult(result, json);
+			replays++;
+			frames += result.frames;
+			if (strcmp(result.status, "ok") != 0) {
+				failed++;
+			}
+		}
+		fflush(stdout);
+	}
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	fprintf(stderr, "%lld replays (%lld not ok), %lld frames in %.2f s with %d threads: %.1f replays/s, %.0f frames/s\n",
+		replays, failed, frames, seconds, threads,
+		seconds > 0 ? static_cast<double>(replays) / seconds : 0.0,
+		seconds > 0 ? static_cast<double>(frames) / seconds : 0.0);
+	return 0;
+}